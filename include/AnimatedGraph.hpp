@@ -0,0 +1,114 @@
+/** @file AnimatedGraph.hpp
+ *  @brief Graph of z = f(x,y,t) whose frames are computed on worker threads while the previous one is drawn.
+ *
+ *  Frames go through a ring of three slots, each with its own vertex array, vertex buffer and index
+ *  buffer. At every animation tick a free slot is mapped and handed to the producer pool, which samples
+ *  f at that tick's t and writes vertices and indices straight into the mapped buffers. Update() picks up
+ *  the newest finished frame on the render thread; frames overtaken by a newer one, and ticks that find
+ *  every slot busy, are counted as dropped instead of delaying the window.
+ *
+ *  A slot is only mapped again after the fence placed behind its last draw has signaled, so the
+ *  unsynchronized map never races the GPU and the render thread never waits for it.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef ANIMATEDGRAPH_HPP
+#define ANIMATEDGRAPH_HPP
+
+#include <glad/glad.h>
+
+#include "GLState.hpp"
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Frame counters of an AnimatedGraph
+struct AnimationStats {
+    uint64_t produced; // frames the producers finished
+    uint64_t displayed; // frames that were drawn
+    uint64_t dropped; // finished frames overtaken by a newer one before they were drawn
+    uint64_t skipped; // ticks that started no frame because every slot was busy
+    double latencyMs; // smoothed time from a frame's tick until it is ready to draw
+    double worstLatencyMs; // largest latency seen
+};
+
+class AnimatedGraph{
+public:
+    // Constructor
+    AnimatedGraph();
+    // Destructor deletes the OpenGL objects
+    ~AnimatedGraph();
+    AnimatedGraph(const AnimatedGraph&) = delete;
+    AnimatedGraph& operator=(const AnimatedGraph&) = delete;
+    // Creates the slots for a dimension*dimension graph of equation (in x, y and t) drawn with color
+    // index graphIndex (vertex attribute 4). Frames are computed on producers, framesPerSecond times a
+    // second of animation time; onReady is called on a producer thread whenever a frame is finished.
+    void Create(const std::string& equation, unsigned int dimension, GLuint graphIndex, ThreadPool& producers,
+                unsigned int framesPerSecond, std::function<void()> onReady, GLState& state);
+    // Waits for frames being computed and deletes the OpenGL objects (while the context still exists)
+    void Destroy();
+    // Shows the newest finished frame and starts the next frame when its tick is due.
+    // Returns true if a new frame is ready to be drawn.
+    bool Update();
+    // Returns when Update should run next to keep the animation on time
+    std::chrono::steady_clock::time_point NextDeadline() const;
+    // Draws the current frame with the bound program and fences its buffers.
+    // Returns the number of indices drawn (0 before the first frame).
+    GLsizei Draw(GLState& state);
+    // Returns the frame counters
+    AnimationStats GetStats() const;
+private:
+    // What a slot is being used for
+    enum SlotState { SLOT_FREE, SLOT_PRODUCING, SLOT_READY, SLOT_CURRENT };
+    struct Slot {
+        GLuint vertexArray = 0;
+        GLuint vertexBuffer = 0; // dimension^2 vertices of 12 floats
+        GLuint indexBuffer = 0; // 6*(dimension-1)^2 indices
+        GLsync fence = nullptr; // placed after the last draw from this slot
+        float* vertices = nullptr; // mapped vertexBuffer while producing
+        GLuint* indices = nullptr; // mapped indexBuffer while producing
+        std::vector<float> heights; // normalized heights of the frame
+        std::atomic<int> state{SLOT_FREE};
+        std::atomic<unsigned int> chunksLeft{0}; // row chunks of the current phase still running
+        float t = 0.0f; // animation time of the frame
+        uint64_t sequence = 0; // frame number, newer frames are larger
+        std::chrono::steady_clock::time_point tick; // when the frame was due
+    };
+
+    // Returns true if the GPU is done with slot's buffers
+    bool FenceSignaled(Slot& slot);
+    // Maps slot and queues the producers for a frame at animation time t
+    void StartFrame(Slot& slot, float t, std::chrono::steady_clock::time_point tick);
+    // Runs on a producer: samples f for rows [rowBegin, rowEnd), and queues the meshing when all rows are done
+    void ProduceHeights(Slot& slot, unsigned int rowBegin, unsigned int rowEnd);
+    // Runs on a producer: builds vertices and indices for rows [rowBegin, rowEnd), marking the slot ready when all are done
+    void ProduceMesh(Slot& slot, unsigned int rowBegin, unsigned int rowEnd);
+    // Unmaps slot's buffers. Returns false if the driver lost their contents.
+    bool Unmap(Slot& slot);
+
+    static const unsigned int SLOT_COUNT = 3;
+    Slot m_slots[SLOT_COUNT];
+    Slot* m_current; // slot drawn by Draw, nullptr before the first frame
+
+    std::string m_equation; // f(x,y,t)
+    unsigned int m_dimension;
+    unsigned int m_chunkRows; // rows per producer task
+    GLsizei m_indexCount;
+    GLuint m_graphIndex; // value of vertex attribute 4
+    ThreadPool* m_producers;
+    std::function<void()> m_onReady;
+
+    std::chrono::steady_clock::time_point m_start; // t = 0
+    std::chrono::steady_clock::duration m_tickInterval; // time between frames
+    std::chrono::steady_clock::time_point m_nextTick; // when the next frame is due
+    uint64_t m_sequence; // frames started
+
+    AnimationStats m_stats;
+};
+
+#endif
@@ -0,0 +1,48 @@
+/** @file AxesGrid.hpp
+ *  @brief The x-y grid and the three axes, drawn procedurally instead of from a mesh and texture.
+ *
+ *  The grid is a single square whose fragment shader (shaders/grid_frag.glsl) draws every line
+ *  analytically with anti-aliased edges, so it looks the same at any distance and costs four
+ *  vertices. The axes are one small arrow mesh drawn three times with instancing, the vertex
+ *  shader (shaders/axes_vert.glsl) turning and coloring each instance.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef AXESGRID_HPP
+#define AXESGRID_HPP
+
+#include <glad/glad.h>
+
+#include "GLState.hpp"
+#include "ShaderProgram.hpp"
+
+#include <string>
+
+class AxesGrid{
+public:
+    // Constructor
+    AxesGrid();
+    // Destructor deletes the OpenGL objects
+    ~AxesGrid();
+    AxesGrid(const AxesGrid&) = delete;
+    AxesGrid& operator=(const AxesGrid&) = delete;
+    // Compiles the grid and axes programs, connects their FrameMatrices block to frameMatricesBinding
+    // and builds the arrow mesh. Returns false (after printing why) on failure.
+    bool Create(const std::string& gridVertexSource, const std::string& gridFragmentSource,
+                const std::string& axesVertexSource, const std::string& axesFragmentSource,
+                GLuint frameMatricesBinding, GLState& state);
+    // Deletes the programs and buffers (while the context still exists)
+    void Destroy();
+    // Draws the grid and the axes, leaving the axes program bound.
+    // Returns the number of vertices drawn, as triangle list indices for the profiler.
+    GLsizei Draw(GLState& state);
+private:
+    ShaderProgram m_gridProgram;
+    ShaderProgram m_axesProgram;
+    GLuint m_gridVertexArray; // no attributes, the square comes from gl_VertexID
+    GLuint m_axesVertexArray;
+    GLuint m_axesVertexBuffer; // triangles of one arrow along x
+    GLsizei m_axesVertexCount;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/** @file ContourSet.hpp
+ * @brief Level curves of a grid of samples, extracted with marching squares and welded into polylines.
+ *
+ * The grid is split into tiles of Graph::CHUNK_CELLS*CHUNK_CELLS cells, and the smallest and largest
+ * sample of every tile are kept, so a level only visits the tiles it passes through. Tiles are
+ * extracted in parallel, every level at once, and the segments of each level are then welded on
+ * the grid edges they cross into polylines, also in parallel. Both steps are linear in the number
+ * of cells and segments.
+ *
+ * Levels that were extracted once are kept until they are dropped, so going from one set of levels
+ * to another (e.g. halving the interval between them) only extracts the new ones.
+ *
+ * A cell is cut like a graph's triangles: not at all if a sample is undefined (NaN). Saddle cells,
+ * with two opposite corners on each side of the level, are resolved by the average of the four.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef ContourSet_HPP
+#define ContourSet_HPP
+
+#include <map>
+#include <vector>
+#include <glm/glm.hpp>
+
+// One polyline of a level
+struct ContourLine {
+    std::vector<glm::vec2> points; // (x, y) of every crossing, in order along the line
+    std::vector<unsigned long long> edges; // grid edge of every point: 2*sample, + 1 if it runs to the sample above
+    bool closed; // the last point joins the first
+};
+
+class ContourSet {
+public:
+    // Most levels setInterval accepts, so a tiny interval can not fill memory with lines
+    static const unsigned int MAX_LEVELS = 1000;
+
+    // Constructor keeps dimension*dimension samples, row by row (y then x) and NaN where undefined,
+    // over [domainMin, domainMax]^2, and the range of every tile
+    ContourSet(std::vector<float> values, unsigned int dimension, float domainMin = -5.0f, float domainMax = 5.0f);
+    // Extracts the levels that are not extracted yet, on threadCount threads (0 for one per core),
+    // and drops the lines of those that are not in levels
+    void setLevels(const std::vector<float>& levels, unsigned int threadCount = 0);
+    // Sets the levels to every multiple of interval between the smallest and largest sample.
+    // Returns false, changing nothing, if interval is not positive or that is more than MAX_LEVELS levels.
+    bool setInterval(float interval, unsigned int threadCount = 0);
+    // Returns the interval of the last setInterval, 0 if it was not called
+    float getInterval() const;
+    // Returns the lines of every level, lowest level first
+    const std::map<float, std::vector<ContourLine>>& getLevels() const;
+    // Returns the smallest defined sample, NaN if there is none
+    float getMin() const;
+    // Returns the largest defined sample, NaN if there is none
+    float getMax() const;
+private:
+    // Where a level crosses one cell: a line between two of its edges
+    struct Segment {
+        unsigned int level; // index in the levels being extracted
+        unsigned long long edges[2];
+        glm::vec2 points[2];
+    };
+
+    // Appends the segments of every level in tile (tileX, tileY) that the tile's range contains
+    void extractTile(unsigned int tileX, unsigned int tileY, const std::vector<float>& levels,
+                     std::vector<Segment>& segments) const;
+    // Returns where level crosses grid edge (2*sample + axis), as (x, y)
+    glm::vec2 crossing(unsigned long long edge, float level) const;
+    // Joins the segments of one level that share an edge into polylines
+    static std::vector<ContourLine> weld(const std::vector<Segment>& segments);
+
+    std::vector<float> m_values; // the samples, row by row
+    unsigned int m_dimension; // samples per side
+    float m_domainMin; // x and y of the first sample
+    float m_domainMax; // x and y of the last sample
+    unsigned int m_tileDimension; // tiles per side
+    std::vector<glm::vec2> m_tileRanges; // smallest and largest defined sample of every tile, NaN if it has none
+    float m_min; // smallest defined sample
+    float m_max; // largest defined sample
+    float m_interval; // of the last setInterval
+
+    std::map<float, std::vector<ContourLine>> m_levels; // lines of every level extracted
+};
+
+#endif
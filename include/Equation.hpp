@@ -0,0 +1,47 @@
+/** @file Equation.hpp
+ * @brief Compiles an equation string once and evaluates it for given variable values.
+ *
+ * Wraps exprtk so that only Equation.cpp pays for including it. An Equation is bound to
+ * its own variable storage, so it can not be copied and must not be shared between threads;
+ * every worker compiles its own instance (or uses forThread).
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef Equation_HPP
+#define Equation_HPP
+
+#include <string>
+#include <vector>
+
+struct EquationState;
+
+class Equation {
+public:
+    // Constructor compiles the equation in terms of the given variable names (x and y by default)
+    Equation(std::string equation, std::vector<std::string> variables = {"x", "y"});
+    //Destructor clears any allocated memory
+    ~Equation();
+    Equation(const Equation&) = delete;
+    Equation& operator=(const Equation&) = delete;
+    // Returns true if the equation compiled
+    bool isValid() const;
+    // Returns the parser error if the equation did not compile
+    std::string getError() const;
+    // Returns the equation string
+    std::string getEquation() const;
+    // Evaluates the equation with the variables set in declaration order (unused ones are ignored)
+    float value(float a, float b = 0.0f, float c = 0.0f);
+    // Returns variable index (in declaration order) as the last evaluation left it, for equations
+    // that assign to their variables, such as "x := cos(u); y := sin(u)"
+    float getVariable(unsigned int index) const;
+    // Returns the calling thread's compiled copy of an equation, compiling it on first use. The
+    // copy is kept for later calls, so workers that see the same equation again skip the parser.
+    static Equation& forThread(const std::string& equation, const std::vector<std::string>& variables = {"x", "y"});
+private:
+    std::string m_equation; // the equation as typed
+    std::string m_error; // parser error, empty when valid
+    EquationState* m_state; // exprtk symbol table, expression and variable storage
+};
+
+#endif
@@ -0,0 +1,84 @@
+/** @file FrameProfiler.hpp
+ *  @brief Records where frame time goes: CPU time per stage, GPU time and submitted geometry.
+ *
+ *  CPU stages are timed with std::chrono. GPU time comes from GL_TIME_ELAPSED queries kept in
+ *  a small ring, so a result is only read once it is available and the CPU never waits on the
+ *  GPU. A frame is finished (added to the rolling window and the CSV file) when its query
+ *  result comes back, a few frames after it was drawn.
+ *
+ *  Does nothing until Enable() is called.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef FRAMEPROFILER_HPP
+#define FRAMEPROFILER_HPP
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// CPU stages timed every frame
+enum ProfileStage { PROFILE_INPUT = 0, PROFILE_PREDRAW, PROFILE_DRAW, PROFILE_SWAP, PROFILE_STAGE_COUNT };
+
+// Everything measured for one frame
+struct FrameRecord {
+    uint64_t frame; // frame number, starting at 0
+    double stageMilliseconds[PROFILE_STAGE_COUNT]; // CPU time of each stage
+    double gpuMilliseconds; // GPU time of the frame, -1 if the query result was never read
+    uint64_t triangles; // triangles submitted
+    uint64_t vertices; // vertices submitted (indices drawn)
+};
+
+class FrameProfiler{
+public:
+    // Constructor
+    FrameProfiler();
+    // Turns profiling on. Needs a current OpenGL context. Frames are also written to csvPath
+    // when it is not empty. Returns false if the file can not be opened.
+    bool Enable(const std::string& csvPath = "");
+    // Returns true if profiling is on
+    bool IsEnabled() const;
+    // Starts and stops the CPU timer of a stage. A stage may be timed several times per frame.
+    void BeginStage(ProfileStage stage);
+    void EndStage(ProfileStage stage);
+    // Starts the GPU timer of a frame, before its first OpenGL call
+    void BeginFrame();
+    // Stops the GPU timer, after the last draw call and before the swap
+    void EndGPU();
+    // Counts the geometry of a glDrawElements(GL_TRIANGLES, ...) call
+    void CountDraw(GLsizei indexCount);
+    // Closes the frame after the swap
+    void EndFrame();
+    // Returns true about twice a second, when the summary is worth showing again
+    bool ReportDue();
+    // Returns p50/p95/p99 of CPU and GPU frame times and the last frame's triangle count
+    std::string Summary() const;
+    // Waits for the outstanding queries, writes their frames and deletes the queries.
+    // Call before the context is destroyed.
+    void Finish();
+private:
+    // Reads the query of a ring slot and finishes its frame. Returns false if the result is
+    // not available yet and wait is false.
+    bool resolveSlot(unsigned int slot, bool wait);
+    // Adds a finished frame to the rolling window and the CSV file
+    void finishFrame(const FrameRecord& record);
+
+    bool m_enabled; // profiling is on
+    std::ofstream m_csv; // optional per frame dump
+    uint64_t m_frameNumber; // number of the frame being recorded
+    FrameRecord m_current; // frame being recorded
+    std::chrono::steady_clock::time_point m_stageStart[PROFILE_STAGE_COUNT]; // when each running stage started
+    std::vector<GLuint> m_queries; // ring of GL_TIME_ELAPSED queries
+    std::vector<FrameRecord> m_pending; // frame waiting on each query
+    std::vector<bool> m_pendingValid; // true if the slot holds a frame
+    std::vector<FrameRecord> m_history; // last frames, used as a ring
+    size_t m_historyNext; // next slot of m_history to overwrite
+    std::chrono::steady_clock::time_point m_enabledAt; // when Enable was called
+    std::chrono::steady_clock::time_point m_lastReport; // when ReportDue last returned true
+};
+
+#endif
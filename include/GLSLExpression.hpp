@@ -0,0 +1,22 @@
+/** @file GLSLExpression.hpp
+ * @brief Translates an equation in x and y into GLSL so it can be evaluated on the GPU.
+ *
+ * Covers the part of the exprtk syntax that graphs use: + - * / % ^, implicit multiplication
+ * ("2x", "x y", "(x+1)(y-1)"), comparisons, the constants pi and e, and the common functions.
+ * Precedence follows exprtk (^ is right associative and binds tighter than unary minus).
+ * The result calls the f_* helpers of shaders/graph_vert.glsl where GLSL would otherwise
+ * differ from the CPU, e.g. sqrt of a negative number is NaN instead of undefined.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef GLSLExpression_HPP
+#define GLSLExpression_HPP
+
+#include <string>
+
+// Translates equation into a GLSL float expression in x and y. Returns false and sets error if
+// it uses something that has no translation; such equations are evaluated on the CPU instead.
+bool EquationToGLSL(const std::string& equation, std::string& glsl, std::string& error);
+
+#endif
@@ -0,0 +1,58 @@
+/** @file GLState.hpp
+ *  @brief Shadows the bits of OpenGL state we change so redundant calls never reach the driver.
+ *
+ *  All state changes made by the renderer should go through one GLState. If something else
+ *  changes the context behind its back, call Reset() so the next calls are issued again.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+
+class GLState{
+public:
+    // Constructor
+    GLState();
+    // Forgets all cached state so the next calls are issued again
+    void Reset();
+    // glEnable/glDisable of a capability
+    void SetEnabled(GLenum capability, bool enabled);
+    // glBlendFunc
+    void BlendFunc(GLenum source, GLenum destination);
+    // glBlendFuncSeparate, with other factors for alpha than for color
+    void BlendFuncSeparate(GLenum sourceColor, GLenum destinationColor, GLenum sourceAlpha, GLenum destinationAlpha);
+    // glDepthMask
+    void DepthMask(bool write);
+    // glViewport
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    // glClearColor
+    void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+    // glPolygonMode for front and back faces
+    void PolygonMode(GLenum mode);
+    // glUseProgram
+    void UseProgram(GLuint program);
+    // glBindVertexArray
+    void BindVertexArray(GLuint vertexArray);
+    // glActiveTexture and glBindTexture of a 2D texture
+    void BindTexture(unsigned int slot, GLuint texture);
+    // glBindBufferBase of a uniform buffer binding point
+    void BindUniformBuffer(GLuint bindingPoint, GLuint buffer);
+private:
+    std::unordered_map<GLenum, bool> m_capabilities; // enabled state by capability
+    GLenum m_blendFactors[4]; // current blend function: color source and destination, alpha source and destination
+    int m_depthMask; // 1 if depth writes are on, 0 if off
+    GLint m_viewport[4]; // current viewport
+    GLfloat m_clearColor[4]; // current clear color
+    GLenum m_polygonMode; // current polygon mode
+    GLuint m_program; // program in use
+    GLuint m_vertexArray; // bound vertex array
+    unsigned int m_activeTexture; // active texture slot
+    std::unordered_map<unsigned int, GLuint> m_textures; // bound texture by slot
+    std::unordered_map<GLuint, GLuint> m_uniformBuffers; // bound buffer by binding point
+};
+
+#endif
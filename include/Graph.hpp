@@ -8,40 +8,112 @@
 #define Graph_HPP
 
 #include <string>
+#include <vector>
+#include <glm/glm.hpp>
 #include "Texture.hpp"
 
+class Equation;
+
+// Summary of f(x,y) over a sampled grid
+struct HeightStats {
+    float min; // smallest finite value of f, NaN if there is none
+    float max; // largest finite value of f, NaN if there is none
+    unsigned int undefinedCount; // samples where f is NaN
+    unsigned int outOfBoundsCount; // defined samples outside the plotted z range
+    unsigned int sampleCount; // samples taken
+};
+
+// Triangles of one tile of a graph and the box around them, so tiles outside the view can be skipped
+struct GraphChunk {
+    unsigned int firstIndex; // first of its indices in getIBO
+    unsigned int indexCount; // indices of the tile
+    glm::vec3 min; // corners of the bounding box of its vertices (x, height, y as in the VBO)
+    glm::vec3 max;
+};
+
 class Graph {
 public:
-    // Constructor loads a graph from an equation in form f(x,y), where z = f(x,y), and with a given dimension
-    Graph(std::string equation, unsigned int dimension, unsigned int id);
+    // Cells per side of the tiles getIBO is ordered by (see getChunks)
+    static const unsigned int CHUNK_CELLS = 32;
+
+    // Constructor loads a graph from an equation in form f(x,y), where z = f(x,y), and with a given dimension,
+    // sampled over [domainMin, domainMax]^2. The height map is written to ./generated/graph<id>.ppm unless
+    // writeHeightMap is false (it is then only written if getTexture needs it).
+    Graph(std::string equation, unsigned int dimension, unsigned int id, float domainMin = -5.0f, float domainMax = 5.0f,
+          bool writeHeightMap = true);
+    // Constructor builds a graph from dimension*dimension normalized heights that were already
+    // sampled (see sampleHeights and refineHeights) instead of evaluating the equation
+    Graph(std::string equation, unsigned int dimension, unsigned int id, std::vector<float> heights,
+          float domainMin, float domainMax, bool writeHeightMap);
     //Destructor clears any allocated memory
     ~Graph();
-    // Returns the texture of the graph
-    Texture getTexture() const;
+    // Returns the height map texture of the graph, uploading it on first use (needs an OpenGL
+    // context; everything else in Graph works without one)
+    const Texture& getTexture();
     // Returns the vector buffer object of points in x,y,z triplets
-    std::vector<float> getVBO() const;
+    const std::vector<float>& getVBO() const;
     // Returns the index buffer object of the points
-    std::vector<unsigned int> getIBO() const;
+    const std::vector<unsigned int>& getIBO() const;
+    // Returns the dimension*dimension normalized heights, row by row
+    const float* getHeights() const;
+    // Returns the tiles of CHUNK_CELLS*CHUNK_CELLS cells that have triangles, in the order of their
+    // indices in getIBO, each with its bounding box
+    const std::vector<GraphChunk>& getChunks() const;
+    // Maps a value of f(x,y) to a normalized height in [0, 1], or -1 if it is undefined or out of bounds
+    static float toHeight(float z);
+    // Maps a normalized height back to the value of f(x,y), or NaN if it is undefined or out of bounds
+    static float fromHeight(float height);
+    // Returns the default color of graph id: blue, green and red for the first three, then
+    // hues spread by the golden angle
+    static glm::vec3 paletteColor(unsigned int id);
+    // Multiplies the r g b of vertexCount 12 float vertices by color. Graph vertices are gray
+    // shades; their color is applied like this or by the shader when they are drawn.
+    static void tintVertices(float* vertices, size_t vertexCount, glm::vec3 color);
+    // Returns the x (or y) coordinate of sample i on a grid of the given dimension spanning [-5, 5]
+    static float sampleCoordinate(unsigned int i, unsigned int dimension);
+    // Writes the 12 float vertices (x y z, NORMALIZED normal, shade r g b a, s t) of rows [rowBegin, rowEnd)
+    // of a dimension*dimension grid of heights over [domainMin, domainMax]^2. vertices holds the whole grid.
+    static void buildVertices(const float* heights, unsigned int dimension, float domainMin, float domainMax,
+                              unsigned int rowBegin, unsigned int rowEnd, float* vertices);
+    // Writes 6 indices for every cell in rows [rowBegin, rowEnd) of a dimension*dimension grid (rowEnd at most
+    // dimension - 1), the two triangles of getIBO. A triangle touching an undefined height is collapsed onto
+    // its first vertex instead of being left out, so the count and place of every triangle is fixed.
+    static void buildGridIndices(const float* heights, unsigned int dimension, unsigned int rowBegin, unsigned int rowEnd,
+                                 unsigned int* indices);
+    // Evaluates f on a dimension*dimension grid over [domainMin, domainMax]^2, row by row (y then x),
+    // storing normalized heights (see toHeight). Fills stats if it is not nullptr.
+    static void sampleHeights(Equation& expression, unsigned int dimension, float* heights, HeightStats* stats = nullptr,
+                              float domainMin = -5.0f, float domainMax = 5.0f);
+    // Fills a dimension*dimension grid of normalized heights from the grid with half the spacing,
+    // (dimension + 1)/2 samples wide: samples both grids share are copied and only the others are
+    // evaluated. dimension must be odd.
+    static void refineHeights(Equation& expression, const float* coarseHeights, unsigned int dimension, float* heights,
+                              float domainMin = -5.0f, float domainMax = 5.0f);
 private:
-    //Sets up the values for m_VBO and m_IBO for the Graph
+    // Builds the vertices and indices from m_heightData, writing the height map first if asked
+    void build(bool writeHeightMap);
+
+    //Sets up the values for m_IBO for the Graph tile by tile, leaving out triangles that touch an undefined height,
+    //and the bounding box of every tile in m_chunks
     void updateBuffers();
 
-    //Calculates the approximated NORAMLIZED normal vectors for m_normals
-    void calculateNormals();
+    // Writes the height map to m_heightMapPath as a .ppm
+    void writeHeightMap();
 
-    std::vector<float> m_positions; // stored x y z
-    std::vector<float> m_colors; // stored r g b a
-    
     std::string m_equation; // string in the form z = f(x,y)
 
-    Texture* m_heightTexture; // the path of the material file
+    std::string m_heightMapPath; // where the .ppm height map is written
+    bool m_heightMapWritten; // true once the .ppm exists
+    Texture* m_heightTexture; // height map texture, nullptr until getTexture is called
     float* m_heightData; // stores the values at given f(x,y) 
-    std::vector<float> m_normals; // store the NORMALIZED normal values at (x,y)
 
     unsigned int m_dimension; // dimension of the graph
+    float m_domainMin; // x and y of the first sample
+    float m_domainMax; // x and y of the last sample
 
     std::vector<float> m_VBO; // the vertex buffer object for rendering
     std::vector<unsigned int> m_IBO; // the index buffer object for rendering
+    std::vector<GraphChunk> m_chunks; // the tiles of m_IBO
 };
 
 #endif
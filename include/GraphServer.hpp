@@ -0,0 +1,108 @@
+/** @file GraphServer.hpp
+ * @brief Long running graph service on a Unix domain socket.
+ *
+ * Clients connect to the socket and send one JSON object per line, for example
+ *   {"equation": "sin(x)*cos(y)", "output": "heights", "min": -5, "max": 5, "resolution": 401}
+ * and get back, for every request, one JSON header line followed by "bytes" bytes of payload:
+ *   heights  resolution^2 float32 heights normalized like Graph (-1 where undefined), row by row
+ *   mesh     "vertices"*12 float32 (the Graph VBO layout) followed by "indices" uint32
+ *   image    the graph and grid drawn by SoftwareRasterizer as png, ppm or raw rgb
+ * Errors are answered with {"ok":false,"error":...} and no payload. {"command":"stats"}
+ * returns the cache counters.
+ *
+ * Requests are evaluated on a shared ThreadPool; each worker keeps compiled Equations
+ * for reuse. Finished responses go into an LRU cache, and identical requests that arrive
+ * while one is being computed wait for that result instead of computing it again.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef GraphServer_HPP
+#define GraphServer_HPP
+
+#include "LRUCache.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Image;
+
+// A computed answer, shared between the cache and the connections sending it
+struct GraphResponse {
+    std::string fields; // JSON members of the header line, without braces
+    std::vector<uint8_t> payload; // bytes sent after the header line
+};
+
+class GraphServer {
+public:
+    // Constructor sets the socket path, the evaluator threads (0 for one per core) and the cache size
+    GraphServer(std::string socketPath, unsigned int threadCount = 0, size_t cacheBytes = 256u << 20);
+    // Destructor frees the grid texture
+    ~GraphServer();
+    GraphServer(const GraphServer&) = delete;
+    GraphServer& operator=(const GraphServer&) = delete;
+    // Listens on the socket until SIGINT or SIGTERM. Returns false if the socket could not be opened.
+    bool run();
+    // Answers one request line. Sets header to the JSON header line (with its newline) and
+    // payload to the bytes that follow it.
+    void respond(const std::string& requestLine, std::string& header, std::shared_ptr<const GraphResponse>& payload);
+private:
+    // A validated request
+    struct Request {
+        std::string equation;
+        std::string output; // heights, mesh or image
+        float domainMin, domainMax;
+        unsigned int resolution;
+        unsigned int width, height; // image size
+        float theta, phi, radius; // image camera
+        std::string format; // png, ppm or rgb
+    };
+    // One client connection
+    struct Connection {
+        std::thread thread;
+        int socket; // -1 once closed
+        bool done; // the thread has finished
+    };
+
+    // Fills request from the fields of a request line and returns its cache key. Sets error if it is invalid.
+    std::string parseRequest(std::map<std::string, std::string>& fields, Request& request, std::string& error) const;
+    // Computes a response on the calling thread
+    std::shared_ptr<const GraphResponse> compute(const Request& request);
+    // Returns the cached response for key, or computes it on the pool (once, however many ask)
+    std::shared_ptr<const GraphResponse> lookup(const std::string& key, const Request& request, bool& cached);
+    // Returns the stats header members
+    std::string statsFields();
+    // Reads requests from a client and answers them until it disconnects
+    void serveConnection(Connection* connection);
+    // Joins the threads of closed connections
+    void reapConnections();
+
+    std::string m_socketPath; // path of the listening socket
+    ThreadPool m_pool; // evaluates requests
+
+    std::mutex m_cacheMutex; // guards m_cache, m_inFlight and the counters
+    LRUCache<GraphResponse> m_cache; // finished responses by request key
+    std::unordered_map<std::string, std::shared_future<std::shared_ptr<const GraphResponse>>> m_inFlight; // being computed
+    uint64_t m_hits; // answered from m_cache
+    uint64_t m_joined; // answered by waiting for an identical request
+    uint64_t m_misses; // computed
+
+    std::mutex m_connectionsMutex; // guards m_connections
+    std::list<Connection> m_connections; // open and finished-but-not-joined connections
+
+    std::vector<float> m_gridVertices; // grid .obj drawn under images
+    std::vector<unsigned int> m_gridIndices;
+    Image* m_diffuse; // grid texture
+};
+
+#endif
@@ -0,0 +1,29 @@
+/** @file Hash.hpp
+ * @brief 64-bit FNV-1a hash used to tell whether cached data still matches its source.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef Hash_HPP
+#define Hash_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hashes size bytes at data, continuing from a previous hash if one is given
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Hashes the characters of a string, continuing from a previous hash if one is given
+inline uint64_t HashString(const std::string& text, uint64_t hash = 0xcbf29ce484222325ull) {
+    return HashBytes(text.data(), text.size(), hash);
+}
+
+#endif
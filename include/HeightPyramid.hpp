@@ -0,0 +1,90 @@
+/** @file HeightPyramid.hpp
+ * @brief Tiled, multi-resolution height maps stored on disk for graphs too large for memory.
+ *
+ * File layout (little endian):
+ *   PyramidHeader
+ *   uint64 tile offsets for every level, level 0 first, tiles stored row by row
+ *   tiles of tileSize*tileSize floats
+ *
+ * Heights use the same normalization as Graph's height map ([0, 1], -1 where undefined).
+ * Level 0 holds dimension*dimension samples over [-5, 5]^2 and every level above it is a
+ * 2x2 box-filtered copy of the one below, until a level fits in a single tile.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef HeightPyramid_HPP
+#define HeightPyramid_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class Equation;
+
+// Header found at the start of every pyramid file
+struct PyramidHeader {
+    char magic[4]; // "HPYR"
+    uint32_t version; // format version, bumped on layout changes
+    uint32_t dimension; // samples per side at level 0
+    uint32_t tileSize; // samples per tile side (a power of two)
+    uint32_t levelCount; // number of levels including level 0
+    float domainMin; // x and y of the first sample
+    float domainMax; // x and y of the last level 0 sample
+};
+
+class HeightPyramidWriter {
+public:
+    // Constructor sets up a pyramid of dimension*dimension samples split into tiles of tileSize*tileSize
+    HeightPyramidWriter(std::string filePath, unsigned int dimension, unsigned int tileSize = 256);
+    // Evaluates z = f(x,y) tile by tile and writes every level. Only two tiles are held in memory.
+    bool write(const std::string& equation);
+private:
+    // Evaluates one level 0 tile
+    void evaluateTile(Equation& expression, unsigned int tileX, unsigned int tileY, std::vector<float>& tile);
+    // Builds one tile of a level by box filtering the four tiles below it
+    void downsampleTile(std::fstream& file, unsigned int level, unsigned int tileX, unsigned int tileY,
+                        std::vector<float>& child, std::vector<float>& tile);
+
+    std::string m_filePath; // where the pyramid is written
+    PyramidHeader m_header; // header of the file being written
+    std::vector<uint64_t> m_offsets; // tile offsets of every level
+    std::vector<unsigned int> m_levelOffsets; // index of the first tile of each level in m_offsets
+};
+
+class HeightPyramidReader {
+public:
+    // Constructor opens a pyramid file and reads its header and tile index
+    HeightPyramidReader(std::string filePath);
+    // Returns true if the file was opened and its header is valid
+    bool isOpen() const;
+    // Returns the number of levels
+    unsigned int getLevelCount() const;
+    // Returns the samples per side of a level
+    unsigned int getDimension(unsigned int level) const;
+    // Returns the samples per tile side
+    unsigned int getTileSize() const;
+    // Returns the x (or y) coordinate of sample i of a level
+    float sampleCoordinate(unsigned int level, unsigned int i) const;
+    // Returns the coarsest level that still has at least samplesAcross samples over [minX, maxX]
+    unsigned int chooseLevel(float minX, float maxX, unsigned int samplesAcross) const;
+    // Reads one tile of a level
+    bool readTile(unsigned int level, unsigned int tileX, unsigned int tileY, std::vector<float>& tile);
+    // Returns the samples of a level inside [minX, maxX] x [minY, maxY] row by row, reading only
+    // the tiles that overlap the region. width, height and the first sample indices are returned.
+    std::vector<float> readRegion(unsigned int level, float minX, float maxX, float minY, float maxY,
+                                  unsigned int& width, unsigned int& height,
+                                  unsigned int& firstColumn, unsigned int& firstRow);
+private:
+    // Returns the tiles per side of a level
+    unsigned int tilesPerSide(unsigned int level) const;
+
+    std::ifstream m_file; // the open pyramid
+    bool m_open; // true if the header validated
+    PyramidHeader m_header; // header of the file
+    std::vector<uint64_t> m_offsets; // tile offsets of every level
+    std::vector<unsigned int> m_levelOffsets; // index of the first tile of each level in m_offsets
+};
+
+#endif
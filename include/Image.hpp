@@ -53,7 +53,7 @@ private:
     // Filepath to the image loaded
     std::string m_filepath;
     // Raw pixel data
-    uint8_t* m_pixelData;
+    uint8_t* m_pixelData{nullptr};
     // Size and format of image
     int m_width{0}; // Width of the image
     int m_height{0}; // Height of the image
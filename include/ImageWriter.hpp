@@ -0,0 +1,31 @@
+/** @file ImageWriter.hpp
+ *  @brief Encodes 8 bit RGB pixels as binary PPM or PNG, in memory or to files.
+ *
+ *  The PNG writer has no dependencies: rows are stored in uncompressed deflate blocks,
+ *  which is fast to write and readable by every PNG decoder.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef ImageWriter_HPP
+#define ImageWriter_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Encodes width*height RGB pixels, top row first, as a binary (P6) PPM into out
+void EncodePPM(std::vector<uint8_t>& out, unsigned int width, unsigned int height, const uint8_t* pixels);
+
+// Encodes width*height RGB pixels, top row first, as a PNG into out
+void EncodePNG(std::vector<uint8_t>& out, unsigned int width, unsigned int height, const uint8_t* pixels);
+
+// Writes width*height RGB pixels, top row first, as a binary (P6) PPM. Returns false on failure.
+bool WritePPM(const std::string& filePath, unsigned int width, unsigned int height, const uint8_t* pixels);
+
+// Writes width*height RGB pixels, top row first, as a PNG. Returns false on failure.
+bool WritePNG(const std::string& filePath, unsigned int width, unsigned int height, const uint8_t* pixels);
+
+// Writes a PNG if filePath ends in .png, a PPM otherwise. Returns false on failure.
+bool WriteImage(const std::string& filePath, unsigned int width, unsigned int height, const uint8_t* pixels);
+
+#endif
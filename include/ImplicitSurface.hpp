@@ -0,0 +1,94 @@
+/** @file ImplicitSurface.hpp
+ * @brief Triangle mesh of an implicit surface F(x,y,z) = 0, such as a sphere or a torus, from marching cubes.
+ *
+ * F is sampled dimension times per side over [domainMin, domainMax]^3, and the volume is split into
+ * bricks of BRICK_CELLS^3 cells that are extracted in parallel, each into one GraphChunk so the
+ * surface is culled like a graph. Empty space is skipped first: F is sampled on a lattice every
+ * BLOCK_CELLS cells, and a block of BLOCK_CELLS^3 cells is only sampled in full if its corners differ
+ * in sign or the smallest |F| at them could drop to 0 within the block at the steepest slope seen
+ * between lattice samples around it (with a safety factor of 2). exprtk can not bound F over an
+ * interval, so this is an estimate: a feature thinner than a block that no lattice sample sees,
+ * such as a tiny sphere between them, can be missed.
+ *
+ * The marching cubes cases are generated rather than tabulated: the crossings on each face of a
+ * cell are joined so inside corners (F < 0) are cut off on their own, which both cells sharing the
+ * face agree on, and the loops they form around the cell are fanned into triangles. Every vertex
+ * sits on the cell edge where F changes sign and is shared by all triangles on that edge, those
+ * of neighbouring bricks included. Its normal is the gradient of F.
+ *
+ * Vertices use the 12 float layout of Graph::buildVertices, in the model space of graphs: (x, z, y).
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef ImplicitSurface_HPP
+#define ImplicitSurface_HPP
+
+#include <string>
+#include <vector>
+
+#include "Graph.hpp"
+
+class Equation;
+
+class ImplicitSurface {
+public:
+    // Cells per side of the bricks extracted in parallel, one GraphChunk each
+    static const unsigned int BRICK_CELLS = 32;
+    // Cells per side of the blocks that are skipped when the surface can not pass through them
+    static const unsigned int BLOCK_CELLS = 8;
+
+    // Constructor extracts F(x,y,z) = 0 from dimension^3 samples over [domainMin, domainMax]^3,
+    // on threadCount threads (0 for one per core)
+    ImplicitSurface(std::string equation, unsigned int dimension, float domainMin = -5.0f, float domainMax = 5.0f,
+                    unsigned int threadCount = 0);
+    // Returns the 12 float vertices
+    const std::vector<float>& getVBO() const;
+    // Returns the triangle indices, brick by brick
+    const std::vector<unsigned int>& getIBO() const;
+    // Returns the bricks that have triangles, in the order of their indices in getIBO, each with its bounding box
+    const std::vector<GraphChunk>& getChunks() const;
+    // Returns how many times F was evaluated, to compare with dimension^3
+    size_t getSampleCount() const;
+    // Returns true if equation is F(x,y,z): it only compiles once z is a variable
+    static bool isImplicit(const std::string& equation);
+private:
+    // Triangles of one brick, with vertex indices local to it
+    struct BrickMesh {
+        std::vector<float> vertices; // 12 floats each
+        std::vector<unsigned int> indices;
+        std::vector<unsigned long long> keys; // 1 + grid edge of every vertex on a face of the brick, 0 inside it
+        size_t sampleCount; // evaluations of F
+    };
+
+    // Returns F at grid sample (x, y, z)
+    float sample(Equation& expression, unsigned int x, unsigned int y, unsigned int z) const;
+    // Returns the coordinate of grid sample i along an axis
+    float coordinate(float i) const;
+    // Returns the grid sample of lattice sample i along an axis
+    unsigned int latticeSample(unsigned int i) const;
+    // Samples F on the lattice and the steepest slope along the lattice edges of every block
+    void sampleLattice(unsigned int threadCount);
+    // Returns true if the surface may pass through block (x, y, z)
+    bool blockMayCross(unsigned int x, unsigned int y, unsigned int z) const;
+    // Runs marching cubes over the blocks of brick (x, y, z) that the surface may pass through
+    void extractBrick(unsigned int x, unsigned int y, unsigned int z, BrickMesh& mesh) const;
+    // Appends the bricks to the buffers, welding the vertices they share
+    void weldBricks(std::vector<BrickMesh>& bricks);
+
+    std::string m_equation; // F(x,y,z)
+    unsigned int m_dimension; // samples per side
+    float m_domainMin; // x, y and z of the first sample
+    float m_domainMax; // x, y and z of the last sample
+    unsigned int m_latticeDimension; // lattice samples per side, every BLOCK_CELLS grid samples and the last one
+    unsigned int m_blockDimension; // blocks per side
+    std::vector<float> m_lattice; // F on the lattice, x fastest
+    std::vector<float> m_blockSlopes; // largest |change of F|/distance along the 12 lattice edges of each block
+    size_t m_sampleCount; // evaluations of F
+
+    std::vector<float> m_VBO; // the vertex buffer object for rendering
+    std::vector<unsigned int> m_IBO; // the index buffer object for rendering
+    std::vector<GraphChunk> m_chunks; // the bricks of m_IBO
+};
+
+#endif
@@ -0,0 +1,24 @@
+/** @file JSONLine.hpp
+ * @brief Just enough JSON for line based requests and results: flat objects of strings,
+ * numbers, booleans and null.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef JSONLine_HPP
+#define JSONLine_HPP
+
+#include <map>
+#include <string>
+
+// Parses a flat JSON object. String values are unescaped, other values are kept as written
+// (e.g. "401", "true"). Returns false and sets error on malformed input or nested values.
+bool ParseJSONObject(const std::string& text, std::map<std::string, std::string>& fields, std::string& error);
+
+// Returns text as a quoted, escaped JSON string
+std::string JSONString(const std::string& text);
+
+// Returns a number as JSON text, null for NaN or infinity
+std::string JSONNumber(double value);
+
+#endif
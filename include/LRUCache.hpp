@@ -0,0 +1,92 @@
+/** @file LRUCache.hpp
+ * @brief Least recently used cache of shared, immutable values with a byte budget.
+ *
+ * Not thread safe: callers guard it with their own mutex. Values are handed out as
+ * shared_ptr, so an entry evicted while a reader still holds it stays alive until released.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef LRUCache_HPP
+#define LRUCache_HPP
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+template <typename Value>
+class LRUCache {
+public:
+    // Constructor sets the total size of the values the cache may hold
+    LRUCache(size_t capacityBytes) {
+        m_capacity = capacityBytes;
+        m_size = 0;
+    }
+
+    // Returns the value stored under key and marks it most recently used, nullptr if absent
+    std::shared_ptr<const Value> get(const std::string& key) {
+        auto found = m_index.find(key);
+        if (found == m_index.end()) {
+            return nullptr;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        return found->second->value;
+    }
+
+    // Stores value under key as the most recently used entry, evicting the least recently
+    // used entries until everything fits. Values larger than the whole cache are not stored.
+    void put(const std::string& key, std::shared_ptr<const Value> value, size_t bytes) {
+        erase(key);
+        if (bytes > m_capacity) {
+            return;
+        }
+        while (m_size + bytes > m_capacity && !m_entries.empty()) {
+            erase(m_entries.back().key);
+        }
+        m_entries.push_front(Entry{key, std::move(value), bytes});
+        m_index[key] = m_entries.begin();
+        m_size += bytes;
+    }
+
+    // Removes the entry stored under key, if any
+    void erase(const std::string& key) {
+        auto found = m_index.find(key);
+        if (found == m_index.end()) {
+            return;
+        }
+        m_size -= found->second->bytes;
+        m_entries.erase(found->second);
+        m_index.erase(found);
+    }
+
+    // Returns the number of entries
+    size_t count() const {
+        return m_entries.size();
+    }
+
+    // Returns the total size of the stored values in bytes
+    size_t size() const {
+        return m_size;
+    }
+
+    // Returns the byte budget
+    size_t capacity() const {
+        return m_capacity;
+    }
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const Value> value;
+        size_t bytes; // size charged against m_capacity
+    };
+
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> m_index; // key --> entry
+    size_t m_capacity; // byte budget
+    size_t m_size; // bytes stored
+};
+
+#endif
@@ -0,0 +1,39 @@
+/** @file MappedFile.hpp
+ * @brief Read-only view of a whole file in memory.
+ *
+ * Uses mmap on Linux and Mac so parsers can tokenize the file in place without copying it.
+ * On Windows (MINGW) the file is read into a buffer instead.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef MappedFile_HPP
+#define MappedFile_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MappedFile {
+public:
+    // Constructor maps the whole file read-only
+    MappedFile(std::string filePath);
+    //Destructor unmaps the file
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    // Returns true if the file could be opened (an empty file is open with size 0)
+    bool isOpen() const;
+    // Returns the first byte of the file
+    const char* getData() const;
+    // Returns the size of the file in bytes
+    size_t getSize() const;
+private:
+    bool m_open; // true if the file was opened
+    const char* m_data; // start of the mapping (or m_buffer)
+    size_t m_size; // size of the file in bytes
+    bool m_mapped; // true if m_data must be unmapped
+    std::vector<char> m_buffer; // file contents when mmap is not available
+};
+
+#endif
@@ -0,0 +1,68 @@
+/** @file MinMaxPyramid.hpp
+ * @brief Lowest and highest height of every block of a graph's cells, for finding where a ray meets it.
+ *
+ * Level 0 is the cells of the dimension*dimension grid of heights, each with its two triangles as
+ * Graph draws them. Every level above it keeps the lowest and highest drawn height of 2x2 blocks of
+ * the level below, until one block covers the whole graph. A ray is traced down the pyramid nearest
+ * block first, skipping every block whose box it misses or that lies behind a hit already found, so
+ * a query visits a few blocks per level instead of every cell under the ray.
+ *
+ * Positions are in the model space of the graph's vertices: (x, height, y), see Graph::buildVertices.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef MinMaxPyramid_HPP
+#define MinMaxPyramid_HPP
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Where a ray first meets the triangles of a graph
+struct PyramidHit {
+    float distance; // t of the hit along origin + t*direction
+    glm::vec3 position; // model position of the hit, (x, height, y)
+    unsigned int column; // cell that was hit
+    unsigned int row;
+};
+
+class MinMaxPyramid {
+public:
+    // Constructor builds the pyramid over dimension*dimension normalized heights (see Graph::getHeights),
+    // sampled over [domainMin, domainMax]^2
+    MinMaxPyramid(const float* heights, unsigned int dimension, float domainMin = -5.0f, float domainMax = 5.0f);
+    // Finds the nearest point at t >= 0 where origin + t*direction (in model space) meets a triangle
+    // of the graph. Returns false if the ray misses it.
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, PyramidHit& hit) const;
+    // Returns the number of levels, the cells included
+    unsigned int getLevelCount() const;
+private:
+    // Block of a level, and where the ray enters its box
+    struct Block {
+        unsigned int level;
+        unsigned int column;
+        unsigned int row;
+        float enter;
+    };
+
+    // Returns the model position of sample (column, row), whose height is NaN if it is undefined
+    glm::vec3 vertex(unsigned int column, unsigned int row) const;
+    // Returns the lowest and highest drawn height of a block as x and y, x > y if nothing is drawn in it
+    glm::vec2 bounds(unsigned int level, unsigned int column, unsigned int row) const;
+    // Returns true and sets enter if the ray meets the box of a block before maxDistance
+    bool enterBlock(const Block& block, const glm::vec3& origin, const glm::vec3& inverseDirection,
+                    float maxDistance, float& enter) const;
+    // Intersects the ray with the triangles of a cell, keeping the hit if it is nearer than hit.distance
+    void intersectCell(unsigned int column, unsigned int row, const glm::vec3& origin, const glm::vec3& direction,
+                       PyramidHit& hit) const;
+
+    unsigned int m_dimension; // samples per side
+    float m_domainMin; // x and y of the first sample
+    float m_domainMax; // x and y of the last sample
+    std::vector<float> m_heights; // model height of every sample, row by row, NaN where undefined
+    std::vector<unsigned int> m_sizes; // blocks per side of every level, level 0 being the cells
+    std::vector<std::vector<glm::vec2>> m_levels; // bounds of the blocks of levels 1 and up, row by row
+};
+
+#endif
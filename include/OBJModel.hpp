@@ -7,11 +7,21 @@
 #ifndef OBJModel_HPP
 #define OBJModel_HPP
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+// Modification time, size and content hash of a file a mesh cache was built from
+struct FileStamp {
+    int64_t modified; // seconds since the epoch
+    uint64_t size; // bytes
+    uint64_t hash; // HashBytes of the contents
+};
 
 class OBJModel {
 public:
-    // Constructor loads a filename with the .obj extension
+    // Constructor loads a filename with the .obj extension. The processed buffers are cached
+    // next to it in <fileName>.meshcache and reused while the .obj and .mtl are unchanged.
     OBJModel(std::string fileName);
     //Destructor clears any allocated memory
     ~OBJModel();
@@ -24,13 +34,20 @@ public:
 private:
     //Sets up the values for m_VBO and m_IBO
     void populateBuffers();
+    // Reads the texture file (map_Kd) out of the material file
+    std::string readTexture() const;
+    // Loads m_VBO, m_IBO and the material paths from the cache if it matches the source files
+    bool loadCache(const std::string& fileName, const std::string& cacheFile);
+    // Writes m_VBO, m_IBO and the material paths to the cache
+    void writeCache(const std::string& fileName, const std::string& cacheFile) const;
 
     std::vector<float> m_Verts; // v
     std::vector<float> m_VertTexts; // vt
     std::vector<float> m_VertNorms; // vn
     std::string m_MaterialFile; // the path of the material file
+    std::string m_TextureFile; // the path of the texture named by the material file
     std::string m_ObjectPath; // the path of the object
-    std::vector<unsigned int> m_Faces; // face stored: v1 v1_n v2 v2_n v3 v3_n...
+    std::vector<unsigned int> m_Faces; // face stored: v1 v1_t v1_n v2 v2_t v2_n v3 v3_t v3_n...
     std::vector<float> m_VBO; // the vertex buffer object for rendering
     std::vector<unsigned int> m_IBO; // the index buffer object for rendering
 };
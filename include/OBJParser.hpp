@@ -0,0 +1,39 @@
+/** @file OBJParser.hpp
+ * @brief Fast in-place parser for .obj files.
+ *
+ * Tokenizes a memory mapped file without copying lines or tokens. Understands every face
+ * form (v, v/t, v//n, v/t/n) with positive or negative (relative) indices, and fan
+ * triangulates polygons.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef OBJParser_HPP
+#define OBJParser_HPP
+
+#include <string>
+#include <vector>
+
+// Index stored in OBJData::faces when a corner has no texture coordinate or normal
+const unsigned int OBJ_NO_INDEX = (unsigned int)-1;
+
+// Raw contents of an .obj file
+struct OBJData {
+    std::vector<float> verts; // v: x y z
+    std::vector<float> texts; // vt: s t
+    std::vector<float> norms; // vn: x y z
+    std::vector<unsigned int> faces; // triangle corners stored: v t n (0 indexed, OBJ_NO_INDEX if missing)
+    std::string materialFile; // mtllib as written in the file
+};
+
+// Parses the .obj text in [begin, end) into data. Returns false and sets error on malformed input.
+bool ParseOBJ(const char* begin, const char* end, OBJData& data, std::string& error);
+
+// Parses the .obj text in [begin, end) on threadCount threads (0 for one per core), splitting it on
+// line boundaries. Produces exactly what ParseOBJ does; small inputs are parsed serially.
+bool ParseOBJParallel(const char* begin, const char* end, OBJData& data, std::string& error, unsigned int threadCount = 0);
+
+// Memory maps an .obj file and parses it. Returns false and sets error if it can not be read or parsed.
+bool ParseOBJFile(const std::string& fileName, OBJData& data, std::string& error);
+
+#endif
@@ -0,0 +1,29 @@
+/** @file OffscreenContext.hpp
+ *  @brief OpenGL context without a window or display, for headless rendering.
+ *
+ *  Uses EGL on Mesa's surfaceless platform (llvmpipe works, no GPU or X server needed),
+ *  falling back to the default EGL display. Nothing is drawn to a surface: render into an
+ *  OffscreenTarget instead. Only available on Linux.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef OFFSCREENCONTEXT_HPP
+#define OFFSCREENCONTEXT_HPP
+
+class OffscreenContext{
+public:
+    // Constructor
+    OffscreenContext();
+    // Destructor releases the context
+    ~OffscreenContext();
+    // Creates an OpenGL 4.1 core context, makes it current and loads the OpenGL functions.
+    // Returns false (after printing why) if that is not possible.
+    bool Create();
+    // Releases the context
+    void Destroy();
+private:
+    void* m_display; // EGLDisplay
+    void* m_context; // EGLContext
+};
+
+#endif
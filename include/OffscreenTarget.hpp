@@ -0,0 +1,54 @@
+/** @file OffscreenTarget.hpp
+ *  @brief Framebuffer object with color and depth attachments, read back through pixel buffers.
+ *
+ *  StartReadback() queues glReadPixels into a pixel buffer object and returns immediately.
+ *  FinishReadback() maps the oldest queued buffer, so while one image is being copied out the
+ *  GPU can already be drawing the next one.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef OFFSCREENTARGET_HPP
+#define OFFSCREENTARGET_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+class OffscreenTarget{
+public:
+    // Constructor
+    OffscreenTarget();
+    // Destructor deletes the OpenGL objects
+    ~OffscreenTarget();
+    // Creates a width*height RGBA8 + 24 bit depth framebuffer and bufferCount pixel buffers.
+    // Returns false if the framebuffer is incomplete.
+    bool Create(GLsizei width, GLsizei height, unsigned int bufferCount = 2);
+    // Deletes the OpenGL objects (while the context still exists)
+    void Destroy();
+    // Makes the framebuffer the draw and read target
+    void Bind();
+    // Returns true if every pixel buffer holds a readback that was not finished yet
+    bool ReadbackQueueFull() const;
+    // Returns true if a readback was started and not finished yet
+    bool ReadbackPending() const;
+    // Copies the framebuffer into the next free pixel buffer without waiting for it
+    void StartReadback();
+    // Maps the oldest pending pixel buffer and copies it into pixels as RGB, top row first.
+    // Returns false if no readback is pending.
+    bool FinishReadback(std::vector<uint8_t>& pixels);
+    // Returns the size of the framebuffer
+    GLsizei GetWidth() const;
+    GLsizei GetHeight() const;
+private:
+    GLuint m_framebuffer; // framebuffer object
+    GLuint m_colorBuffer; // RGBA8 renderbuffer
+    GLuint m_depthBuffer; // depth renderbuffer
+    std::vector<GLuint> m_pixelBuffers; // ring of GL_PIXEL_PACK_BUFFERs
+    unsigned int m_nextBuffer; // pixel buffer the next readback goes to
+    unsigned int m_pending; // readbacks started but not finished
+    GLsizei m_width;
+    GLsizei m_height;
+};
+
+#endif
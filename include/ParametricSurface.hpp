@@ -0,0 +1,64 @@
+/** @file ParametricSurface.hpp
+ * @brief Triangle mesh of a parametric surface (u,v) -> (x,y,z), such as a sphere, a torus or a Möbius strip.
+ *
+ * The equation is three components separated by commas, "x(u,v), y(u,v), z(u,v)", optionally after
+ * statements that name shared subexpressions, e.g. "var r := 3 + cos(v); r*cos(u), r*sin(u), sin(v)".
+ * It is compiled into one exprtk program that assigns x, y and z, so each sample evaluates the
+ * shared parts once for all three components.
+ *
+ * The surface is sampled dimension times per side over [uMin, uMax]x[vMin, vMax], u along the columns
+ * and v along the rows, in bands of Graph::CHUNK_CELLS rows on a thread pool. Normals are the cross
+ * product of the central differences along u and v. Vertices and indices use the layout of Graph:
+ * 12 floats in the model space (x, z, y), tiles of CHUNK_CELLS*CHUNK_CELLS cells as GraphChunks, and
+ * no triangle touching a sample where a component is undefined.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef ParametricSurface_HPP
+#define ParametricSurface_HPP
+
+#include <string>
+#include <vector>
+
+#include "Graph.hpp"
+
+class ParametricSurface {
+public:
+    // Constructor samples the surface dimension*dimension times over [uMin, uMax]x[vMin, vMax],
+    // on threadCount threads (0 for one per core)
+    ParametricSurface(std::string equation, unsigned int dimension, float uMin, float uMax, float vMin, float vMax,
+                      unsigned int threadCount = 0);
+    // Returns the 12 float vertices, row by row
+    const std::vector<float>& getVBO() const;
+    // Returns the triangle indices, tile by tile
+    const std::vector<unsigned int>& getIBO() const;
+    // Returns the tiles that have triangles, in the order of their indices in getIBO, each with its bounding box
+    const std::vector<GraphChunk>& getChunks() const;
+    // Turns "x(u,v), y(u,v), z(u,v)" (after any statements) into the program that assigns x, y and z.
+    // Returns false if the last statement is not three components.
+    static bool toProgram(const std::string& equation, std::string& program);
+    // Returns true if equation is three components in u and v that compile
+    static bool isParametric(const std::string& equation);
+private:
+    // Samples the positions of rows [rowBegin, rowEnd), NaN where a component is undefined
+    void sampleRows(const std::string& program, unsigned int rowBegin, unsigned int rowEnd);
+    // Writes the vertices of rows [rowBegin, rowEnd) from the positions
+    void buildRows(unsigned int rowBegin, unsigned int rowEnd);
+    // Sets up m_IBO tile by tile, leaving out triangles that touch an undefined sample, and the bounding
+    // box of every tile in m_chunks (see Graph::updateBuffers)
+    void buildIndices();
+
+    unsigned int m_dimension; // samples per side
+    float m_uMin; // u of the first column
+    float m_uMax; // u of the last column
+    float m_vMin; // v of the first row
+    float m_vMax; // v of the last row
+    std::vector<glm::vec3> m_positions; // (x, y, z) of every sample, row by row
+
+    std::vector<float> m_VBO; // the vertex buffer object for rendering
+    std::vector<unsigned int> m_IBO; // the index buffer object for rendering
+    std::vector<GraphChunk> m_chunks; // the tiles of m_IBO
+};
+
+#endif
@@ -0,0 +1,60 @@
+/** @file RenderScheduler.hpp
+ *  @brief Decides when a frame needs to be drawn so an idle window costs no CPU or GPU time.
+ *
+ *  Anything that changes what is on screen (camera, toggles, geometry, window exposure)
+ *  calls MarkDirty(). The main loop waits in WaitEvent(), which blocks on
+ *  SDL_WaitEventTimeout while nothing is dirty, and only draws when FrameDue() says so.
+ *  An optional frame cap spaces out frames while something keeps changing. Other threads
+ *  wake the loop with Wake(), and WakeBy() bounds the wait for timed work such as animation.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef RENDERSCHEDULER_HPP
+#define RENDERSCHEDULER_HPP
+
+#if defined(LINUX) || defined(MINGW)
+    #include <SDL2/SDL.h>
+#else // This works for Mac
+    #include <SDL.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+
+// Swap interval modes accepted by SetVSync
+enum VSyncMode { VSYNC_OFF = 0, VSYNC_ON = 1, VSYNC_ADAPTIVE = -1 };
+
+class RenderScheduler{
+public:
+    // Constructor, starts dirty so the first frame is always drawn
+    RenderScheduler();
+    // Limits drawing to framesPerSecond (0 for no cap)
+    void SetFrameCap(unsigned int framesPerSecond);
+    // Sets the swap interval of the current context. Adaptive vsync falls back to vsync
+    // when the driver does not support it. Returns the mode that was applied.
+    VSyncMode SetVSync(VSyncMode mode);
+    // Requests a redraw. Safe to call from any thread.
+    void MarkDirty();
+    // Wakes a WaitEvent that is blocked on another thread, e.g. when background work finished
+    void Wake();
+    // Makes the next WaitEvent return by deadline at the latest, e.g. for the next animation step
+    void WakeBy(std::chrono::steady_clock::time_point deadline);
+    // Returns true if something changed since the last frame
+    bool IsDirty() const;
+    // Returns true if a frame should be drawn now (dirty, and the frame cap allows it)
+    bool FrameDue() const;
+    // Returns the next event. Does not block when a frame is due, otherwise blocks until an
+    // event arrives, the next capped frame is due or the idle timeout passes.
+    // Returns false if no event arrived.
+    bool WaitEvent(SDL_Event& event);
+    // Called right before a frame is drawn. Changes made while it draws mark the next frame dirty.
+    void BeginFrame();
+private:
+    std::atomic<bool> m_dirty; // something on screen changed
+    std::chrono::steady_clock::duration m_frameInterval; // minimum time between frames, zero for no cap
+    std::chrono::steady_clock::time_point m_lastFrame; // when the last frame was started
+    std::chrono::steady_clock::time_point m_wakeDeadline; // set by WakeBy, used by the next WaitEvent
+    bool m_hasWakeDeadline; // m_wakeDeadline is set
+};
+
+#endif
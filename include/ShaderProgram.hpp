@@ -0,0 +1,70 @@
+/** @file ShaderProgram.hpp
+ *  @brief Compiles and links a vertex/fragment (and optional geometry) shader program and caches its uniform locations.
+ *
+ *  Every active uniform is looked up once when the program is linked, so drawing never
+ *  calls glGetUniformLocation. Integer and float uniforms remember their last value and are only
+ *  sent to the driver when they change.
+ *
+ *  Once a cache directory is set, linked programs are saved there with glGetProgramBinary and
+ *  later loaded with glProgramBinary instead of being compiled again. A cached binary is keyed
+ *  by the shader sources and the driver's vendor, renderer and version strings, and is compiled
+ *  from source again whenever the driver rejects it.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef SHADERPROGRAM_HPP
+#define SHADERPROGRAM_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+class ShaderProgram{
+public:
+    // Constructor
+    ShaderProgram();
+    // Destructor deletes the program
+    ~ShaderProgram();
+    // Loads glGetProgramBinary and glProgramBinary (OpenGL 4.1, which glad does not load) from
+    // the current context. Call after gladLoadGLLoader; without it binaries are never cached.
+    static void LoadBinaryFunctions(GLADloadproc loader);
+    // Sets the directory program binaries are cached in, or turns caching off if it is empty
+    static void SetBinaryCacheDirectory(const std::string& directory);
+    // Compiles and links the program, with a geometry shader if geometrySource is not empty,
+    // or loads it from the binary cache. Returns false (after printing the log) on failure.
+    bool Create(const std::string& vertexSource, const std::string& fragmentSource, const std::string& geometrySource = "");
+    // Deletes the program (while the context still exists)
+    void Destroy();
+    // Returns the OpenGL id of the program
+    GLuint GetID() const;
+    // Returns the cached location of a uniform, or -1 if the program does not use it
+    GLint GetUniformLocation(const std::string& name) const;
+    // Sets an int (or sampler) uniform if it differs from the last value set
+    void SetInt(GLint location, int value);
+    // Sets a float uniform if it differs from the last value set
+    void SetFloat(GLint location, float value);
+    // Connects a uniform block to a binding point. Returns false if the block does not exist.
+    bool BindUniformBlock(const std::string& name, GLuint bindingPoint);
+private:
+    // Compiles and links the program from source. Returns false (after printing the log) on failure.
+    bool Build(const std::string& vertexSource, const std::string& fragmentSource, const std::string& geometrySource);
+    // Creates the program from a cached binary. Returns false if there is none or the driver rejects it.
+    bool LoadBinary(const std::string& cacheFile, uint64_t key);
+    // Saves the linked program to the binary cache
+    void SaveBinary(const std::string& cacheFile, uint64_t key) const;
+    // Looks up every active uniform once after linking
+    void CacheUniformLocations();
+
+    // Store a unique ID for the program
+    GLuint m_programID;
+    // Location of every active uniform by name
+    std::unordered_map<std::string, GLint> m_locations;
+    // Last value set for int uniforms by location
+    std::unordered_map<GLint, int> m_intValues;
+    // Last value set for float uniforms by location
+    std::unordered_map<GLint, float> m_floatValues;
+};
+
+#endif
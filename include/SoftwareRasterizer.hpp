@@ -0,0 +1,108 @@
+/** @file SoftwareRasterizer.hpp
+ *  @brief Multithreaded CPU renderer for machines without OpenGL.
+ *
+ *  Draws indexed triangles in the 12 float vertex layout used by Graph and OBJModel
+ *  (x y z, xn yn zn, r g b a, s t) with the shading of shaders/vert.glsl and
+ *  shaders/frag.glsl ported to C++. The derivatives frag.glsl takes for its grid
+ *  highlights are computed exactly from the triangle instead of over 2x2 pixel quads.
+ *  Vertices with texture coordinates are the grid .obj, which stands in for the
+ *  procedural AxesGrid and is textured with the diffuse image as before.
+ *
+ *  A draw runs in three parallel passes on a ThreadPool:
+ *    1. vertices are transformed and shaded,
+ *    2. triangles are clipped against the near plane, set up and binned into 64x64 pixel
+ *       tiles (every thread bins a contiguous range of triangles),
+ *    3. tiles are rasterized one per thread with edge functions evaluated four pixels at a
+ *       time (SSE when available), a depth test and alpha blending.
+ *  Each tile walks the bins in submission order, so the image is the same for every
+ *  thread count.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef SOFTWARERASTERIZER_HPP
+#define SOFTWARERASTERIZER_HPP
+
+#include "ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Image;
+
+// Interpolated vertex outputs: r g b a, s t, model x z, textured, coloring x y z
+const unsigned int SOFTWARE_VARYING_COUNT = 12;
+
+// Values of the shader uniforms for one draw
+struct SoftwareUniforms {
+    glm::mat4 model; // u_ModelMatrix
+    glm::mat4 view; // u_ViewMatrix
+    glm::mat4 projection; // u_Projection
+    int coloring; // u_coloring
+    int highlight; // u_highlight
+    Image* diffuse; // texture of the grid .obj, sampled bilinearly with clamp to edge (nullptr samples white)
+};
+
+class SoftwareRasterizer{
+public:
+    // Constructor creates a width*height color and depth buffer. threadCount 0 uses one thread per core.
+    SoftwareRasterizer(unsigned int width, unsigned int height, unsigned int threadCount = 0);
+    // Clears the color buffer to a color and the depth buffer to 1
+    void Clear(float r, float g, float b);
+    // Draws indices.size()/3 triangles (like glDrawElements with GL_TRIANGLES), depth tested
+    // with GL_LESS and blended with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+    void DrawElements(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                      const SoftwareUniforms& uniforms);
+    // Copies the color buffer into pixels as 8 bit RGB, top row first
+    void ReadPixels(std::vector<uint8_t>& pixels) const;
+    // Returns the size of the buffers
+    unsigned int GetWidth() const;
+    unsigned int GetHeight() const;
+private:
+    // A vertex after the vertex shader
+    struct ShadedVertex {
+        glm::vec4 clip; // clip space position
+        float varyings[SOFTWARE_VARYING_COUNT];
+    };
+    // A triangle ready to rasterize
+    struct ScreenTriangle {
+        float edgeA[3], edgeB[3], edgeC[3]; // edge i is A*x + B*y + C, positive inside, opposite vertex i
+        bool edgeInclusive[3]; // true if pixels exactly on edge i belong to this triangle
+        float inverseArea; // 1 / (sum of the edge functions)
+        float depth[3]; // window depth of each vertex
+        float inverseW[3]; // 1/w of each vertex
+        float varyings[3][SOFTWARE_VARYING_COUNT]; // varyings of each vertex divided by w
+        int minX, minY, maxX, maxY; // pixel bounds
+    };
+
+    // Runs the vertex shader on vertices [begin, end)
+    void shadeVertices(const std::vector<float>& vertices, size_t begin, size_t end,
+                       const SoftwareUniforms& uniforms, std::vector<ShadedVertex>& shaded) const;
+    // Clips one triangle against the near plane, sets it up and appends it to a thread's bins
+    void setupTriangle(const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2, unsigned int thread);
+    // Adds a clipped triangle in clip space to a thread's triangles and bins
+    void binTriangle(const ShadedVertex* corners[3], unsigned int thread);
+    // Rasterizes every binned triangle overlapping a tile
+    void rasterizeTile(unsigned int tile, const SoftwareUniforms& uniforms);
+    // Runs work(i) for every chunk i < m_threadCount, chunk 0 on the calling thread, and waits for all of them
+    template <typename Work>
+    void runChunks(Work work);
+    // Shades and blends one covered pixel
+    void shadePixel(const ScreenTriangle& triangle, float b0, float b1, float b2, unsigned int pixel,
+                    const SoftwareUniforms& uniforms);
+
+    unsigned int m_width; // framebuffer size
+    unsigned int m_height;
+    unsigned int m_threadCount; // threads used by every pass
+    std::unique_ptr<ThreadPool> m_pool; // the m_threadCount - 1 threads helping the caller, none for one thread
+    unsigned int m_tilesX; // tiles per row
+    unsigned int m_tilesY; // tiles per column
+    std::vector<float> m_color; // RGB color buffer, top row first
+    std::vector<float> m_depth; // depth buffer
+    std::vector<std::vector<ScreenTriangle>> m_triangles; // set up triangles of each thread
+    std::vector<std::vector<std::vector<uint32_t>>> m_bins; // per thread, per tile: indices into m_triangles
+};
+
+#endif
@@ -0,0 +1,52 @@
+/** @file SurfaceIntersection.hpp
+ * @brief Curves where two graphs z = f(x,y) and z = g(x,y) sampled on the same grid meet.
+ *
+ * The difference f - g is formed from the heights of both graphs in parallel bands of rows, and
+ * its zero set is extracted with ContourSet, tile by tile in parallel and welded into polylines.
+ * Every point of those lines lies on a grid edge where f - g changes sign, so it is refined on
+ * that edge with REFINE_STEPS steps of false position (Illinois) on the equations themselves, and
+ * lifted to z = f(x,y) there. Each step costs two evaluations per point, so the whole is linear
+ * in the number of samples.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef SurfaceIntersection_HPP
+#define SurfaceIntersection_HPP
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// One curve where two graphs meet
+struct IntersectionCurve {
+    std::vector<glm::vec3> points; // (x, y, z) in order along the curve
+    bool closed; // the last point joins the first
+};
+
+class SurfaceIntersection {
+public:
+    // Steps of false position taken on the equations for every point
+    static const unsigned int REFINE_STEPS = 6;
+
+    // Constructor finds where z = first(x,y) and z = second(x,y) meet, from the dimension*dimension
+    // normalized heights of both (see Graph::toHeight) over [domainMin, domainMax]^2, on threadCount
+    // threads (0 for one per core)
+    SurfaceIntersection(const std::string& first, const std::string& second, const float* firstHeights,
+                        const float* secondHeights, unsigned int dimension, float domainMin = -5.0f,
+                        float domainMax = 5.0f, unsigned int threadCount = 0);
+    // Returns the curves, in no particular order
+    const std::vector<IntersectionCurve>& getCurves() const;
+private:
+    // Refines the points of curves [begin, end) on the grid edges they were found on
+    void refineCurves(const std::vector<std::vector<unsigned long long>>& edges, size_t begin, size_t end);
+
+    std::string m_first; // f(x,y)
+    std::string m_second; // g(x,y)
+    unsigned int m_dimension; // samples per side
+    float m_domainMin; // x and y of the first sample
+    float m_domainMax; // x and y of the last sample
+    std::vector<IntersectionCurve> m_curves;
+};
+
+#endif
@@ -28,6 +28,8 @@ public:
     void Bind(unsigned int slot=0) const;
     // Be done with our texture
     void Unbind();
+    // Returns the OpenGL id of the texture
+    GLuint GetID() const;
 private:
     // Store a unique ID for the texture
     GLuint m_textureID;
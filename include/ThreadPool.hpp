@@ -0,0 +1,44 @@
+/** @file ThreadPool.hpp
+ * @brief Fixed set of worker threads running queued tasks.
+ *
+ * @author Antoine Assaf
+ */
+
+#ifndef ThreadPool_HPP
+#define ThreadPool_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // Constructor starts threadCount workers (0 for one per core)
+    ThreadPool(unsigned int threadCount = 0);
+    // Destructor finishes the queued tasks and joins the workers
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    // Queues a task. Tasks start in the order they were submitted.
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task has finished
+    void wait();
+    // Returns the number of workers
+    unsigned int size() const;
+private:
+    // Runs tasks until the pool is destroyed
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks; // queued tasks
+    std::mutex m_mutex; // guards m_tasks, m_running and m_stopping
+    std::condition_variable m_taskReady; // signaled when a task is queued or the pool stops
+    std::condition_variable m_idle; // signaled when the last running task finishes
+    unsigned int m_running; // tasks being run right now
+    bool m_stopping; // set by the destructor
+};
+
+#endif
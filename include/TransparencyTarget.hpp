@@ -0,0 +1,93 @@
+/** @file TransparencyTarget.hpp
+ *  @brief Framebuffers for drawing overlapping translucent graphs in any order.
+ *
+ *  Everything opaque is drawn into an offscreen color and depth buffer first. The translucent
+ *  graphs are then drawn in one of two ways, and End() composites them over the opaque picture
+ *  and copies the result to the framebuffer that was bound before:
+ *
+ *  - Weighted blended order-independent transparency (McGuire and Bavoil): one pass, with the
+ *    depth test against the opaque depth but no depth writes, adds every fragment's premultiplied
+ *    color times a depth weight into an RGBA16F buffer whose alpha multiplies up how much of the
+ *    background shows through, and the weights into an R16F buffer. One blend function serves
+ *    both buffers, so no per-buffer blending is needed.
+ *  - Depth peeling: exact, for screenshots. Every layer draws the graphs again keeping only the
+ *    nearest fragment behind the previous layer, and is added under the layers before it. An
+ *    occlusion query stops peeling at the first empty layer.
+ *
+ *  The graph fragment shader (shaders/frag.glsl) writes what each mode expects, see
+ *  TransparencyMode.
+ *
+ *  @author Antoine Assaf
+ */
+#ifndef TRANSPARENCYTARGET_HPP
+#define TRANSPARENCYTARGET_HPP
+
+#include <glad/glad.h>
+
+#include "GLState.hpp"
+#include "ShaderProgram.hpp"
+
+#include <string>
+
+// How translucent graphs are drawn, also the value of u_Transparency in shaders/frag.glsl
+enum TransparencyMode { TRANSPARENCY_OFF, TRANSPARENCY_BLENDED, TRANSPARENCY_PEELED };
+
+class TransparencyTarget{
+public:
+    // Texture slot of the depth of the previous layer while peeling (u_PeelDepth in frag.glsl)
+    static const unsigned int PEEL_DEPTH_SLOT = 2;
+
+    // Constructor
+    TransparencyTarget();
+    // Destructor deletes the OpenGL objects
+    ~TransparencyTarget();
+    TransparencyTarget(const TransparencyTarget&) = delete;
+    TransparencyTarget& operator=(const TransparencyTarget&) = delete;
+    // Compiles the program that composites the layers. Returns false if it does not compile.
+    bool Create(const std::string& vertexSource, const std::string& fragmentSource, GLState& state);
+    // Deletes the program, buffers and queries (while the context still exists)
+    void Destroy();
+    // Makes the opaque buffers the draw target, (re)allocating them for width*height.
+    // The framebuffer bound before is where End() puts the picture.
+    // Returns false (after printing why) if a framebuffer is incomplete.
+    bool BeginOpaque(GLsizei width, GLsizei height, GLState& state);
+    // Makes the weighted blended buffers the draw target, with depth writes off
+    void BeginBlended(GLState& state);
+    // Starts depth peeling layer number layer (0 first). Binds the previous layer's depth at PEEL_DEPTH_SLOT.
+    void BeginLayer(unsigned int layer, GLState& state);
+    // Adds the layer under the ones before it. Waits for the layer's occlusion query and
+    // returns false if nothing was drawn, when no more layers are needed.
+    bool EndLayer(GLState& state);
+    // Composites the translucent graphs (if any were drawn) over the opaque buffers, copies
+    // them to the framebuffer bound at BeginOpaque and restores the state drawing starts from
+    void End(GLState& state);
+private:
+    // Creates a width*height texture sampled with texelFetch
+    GLuint CreateTexture(GLint internalFormat, GLenum format, GLenum type, GLState& state);
+    // Deletes the textures and framebuffers
+    void DeleteBuffers();
+    // Draws a triangle over the viewport that copies (or resolves) the textures at slots 0 and 1
+    void DrawFullscreen(bool resolve, GLState& state);
+
+    ShaderProgram m_compositeProgram;
+    GLint m_resolveLocation; // u_Resolve of the composite program
+    GLuint m_vertexArray; // no attributes, the triangle comes from gl_VertexID
+    GLuint m_query; // GL_ANY_SAMPLES_PASSED of the current layer
+    GLsizei m_width;
+    GLsizei m_height;
+    GLint m_destination; // framebuffer bound at BeginOpaque
+
+    GLuint m_opaqueFramebuffer; // m_opaqueColor and m_opaqueDepth
+    GLuint m_opaqueColor; // RGBA8
+    GLuint m_opaqueDepth; // 24 bit depth, also the depth of m_blendedFramebuffer
+    GLuint m_blendedFramebuffer; // m_accumulation and m_weights, m_opaqueDepth
+    GLuint m_accumulation; // RGBA16F, premultiplied color and the share of the background still visible
+    GLuint m_weights; // R16F, sum of the weights of the weighted blended fragments
+    GLuint m_peeledFramebuffer; // m_accumulation alone, the layers are added under each other in it
+    GLuint m_layerFramebuffers[2]; // m_layerColor and one of m_layerDepth, alternating between layers
+    GLuint m_layerColor; // RGBA8, premultiplied color of the current layer
+    GLuint m_layerDepth[2]; // depth of the current and of the previous layer
+    TransparencyMode m_mode; // what was drawn since BeginOpaque
+};
+
+#endif
@@ -0,0 +1,12 @@
+#version 410 core
+//
+// Flat color of an axis from axes_vert.glsl
+
+in vec3 v_color;
+
+out vec4 color;
+
+void main()
+{
+    color = vec4(v_color, 1.0);
+}
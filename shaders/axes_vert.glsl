@@ -0,0 +1,30 @@
+#version 410 core
+//
+// The three axes (see AxesGrid), drawn as instances of one arrow along the model's x axis.
+// Instance 0 is the x axis, 1 the y axis (model z) and 2 the z axis (model y, which is up).
+
+// Arrow along x: a thin shaft with a cone at each end
+layout(location=0) in vec3 position;
+
+// Matrices that change once per frame, shared through a uniform buffer (binding point 0)
+layout(std140) uniform FrameMatrices {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection;
+};
+
+const vec3 AXIS_COLORS[3] = vec3[3](vec3(1.0, 0.5, 0.5), vec3(0.5, 1.0, 0.5), vec3(0.5, 0.56, 1.0));
+
+out vec3 v_color;
+
+void main()
+{
+    vec3 p = position;
+    if (gl_InstanceID == 1) {
+        p = position.yzx;
+    } else if (gl_InstanceID == 2) {
+        p = position.zxy;
+    }
+    v_color = AXIS_COLORS[gl_InstanceID];
+    gl_Position = u_Projection*u_ViewMatrix*u_ModelMatrix*vec4(p, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 410 core
+//
+// Copies a buffer of translucent graphs with premultiplied color (see TransparencyTarget),
+// or resolves the weighted blended buffers into premultiplied color and, in alpha, how
+// much of what is behind them still shows through.
+
+// The buffer to copy, or for u_Resolve the weighted sum of the fragments' premultiplied
+// colors and, in alpha, the product of their 1 - alpha
+uniform sampler2D u_Layer;
+// Sum of the weights of the fragments, for u_Resolve
+uniform sampler2D u_Weights;
+// 1 to resolve weighted blended buffers, 0 to copy u_Layer
+uniform int u_Resolve;
+
+out vec4 color;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 layer = texelFetch(u_Layer, pixel, 0);
+    if (u_Resolve == 0) {
+        color = layer;
+        return;
+    }
+
+    float revealage = layer.a;
+    if (revealage >= 1.0) {
+        discard;
+    }
+    // The weighted average color covers what the fragments together do not let through
+    vec3 average = layer.rgb/max(texelFetch(u_Weights, pixel, 0).r, 1e-5);
+    color = vec4(average*(1.0 - revealage), revealage);
+}
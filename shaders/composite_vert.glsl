@@ -0,0 +1,11 @@
+#version 410 core
+//
+// A triangle covering the viewport (see TransparencyTarget), made from gl_VertexID
+// so it needs no vertex buffer. composite_frag.glsl does the work.
+
+void main()
+{
+    // (-1,-1) (3,-1) (-1,3): the part inside the viewport is all of it
+    vec2 corner = vec2((gl_VertexID & 1)*4 - 1, (gl_VertexID >> 1)*4 - 1);
+    gl_Position = vec4(corner, 0.0, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 410 core
+//
+// Contour lines of the graphs (see ContourSet), line strips at their level on each graph,
+// drawn a second time flattened onto the x-y grid, and the curves where graphs meet (see
+// SurfaceIntersection), depending on u_Mode.
+
+// A point of a line in the model space of graphs (x, height, y), and the color of its graph
+layout(location=0) in vec3 position;
+layout(location=1) in vec3 lineColor;
+
+// Matrices that change once per frame, shared through a uniform buffer (binding point 0)
+layout(std140) uniform FrameMatrices {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection;
+};
+
+// 0 draws contour lines on their graph, 1 on the grid at u_FloorHeight (just above its lines on
+// the camera's side), and 2 draws intersection curves in their own color
+uniform int u_Mode;
+uniform float u_FloorHeight;
+
+// Lines on graphs lie in their triangles, so they are pulled this far in front of them (in depth over w)
+const float DEPTH_BIAS = 0.0005;
+// Lines on a graph are its color mixed this far towards white, those on the grid are its full color
+const float SURFACE_LIGHTEN = 0.6;
+
+out vec3 v_color;
+
+void main()
+{
+    vec3 p = position;
+    if (u_Mode == 1) {
+        p.y = u_FloorHeight;
+        v_color = lineColor;
+    } else if (u_Mode == 2) {
+        v_color = lineColor;
+    } else {
+        v_color = mix(lineColor, vec3(1.0), SURFACE_LIGHTEN);
+    }
+    gl_Position = u_Projection*u_ViewMatrix*u_ModelMatrix*vec4(p, 1.0);
+    if (u_Mode != 1) {
+        gl_Position.z -= DEPTH_BIAS*gl_Position.w;
+    }
+}
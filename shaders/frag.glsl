@@ -5,26 +5,55 @@
   //       our pipeline.
   in vec4 v_vertexColors;
   in vec3 v_normals;
-  in vec2 v_textureCoordinates;
-  in float highlight;
+  in vec3 v_position;
   in vec3 coloring;
 
-  uniform sampler2D u_DiffuseTexture;
+  uniform int u_highlight;
+
+  // For the distance of fragments from the camera, shared through a uniform buffer (binding point 0)
+  layout(std140) uniform FrameMatrices {
+      mat4 u_ModelMatrix;
+      mat4 u_ViewMatrix;
+      mat4 u_Projection;
+  };
+
+  // How this pass draws translucent graphs (TransparencyMode in TransparencyTarget.hpp):
+  // 0 blended in draw order, 1 weighted blended, 2 one layer of depth peeling
+  uniform int u_Transparency;
+  // Depth of the previous layer while depth peeling
+  uniform sampler2D u_PeelDepth;
+
+  // Texel of the grid texture that graphs used to be shaded with, kept so they look the same
+  const vec3 GRAPH_SHADE = vec3(218.0f, 118.0f, 119.0f)/255.0f;
+  // Width of the x-y grid highlights in model units
+  const float HIGHLIGHT_WIDTH = 0.02f;
   
   // The fragment shader should have exactly one output.
   // That output is the final color in which we rasterize this 
   // fragment. We can name it anything we want, but it should
   // be outputting a vec4.
-  out vec4 color;
+  layout(location = 0) out vec4 color;
+  // Weight of the fragment in the second buffer, while weighted blended
+  layout(location = 1) out vec4 weight;
 
-  void main()
+  // How much of this fragment the lines at whole x and y cover, anti-aliased over a pixel.
+  // Lines are never drawn thinner than a pixel, so they do not break up in the distance.
+  float gridCoverage(vec2 coordinate)
   {
-    
-   vec3 diffuseColor = vec3(0.0f, 0.0f, 0.0f);
-   diffuseColor = texture(u_DiffuseTexture, v_textureCoordinates).rgb;
-
+   vec2 pixel = max(fwidth(coordinate), vec2(1e-6f));
+   vec2 distance = abs(coordinate - round(coordinate));
+   vec2 width = max(vec2(HIGHLIGHT_WIDTH), pixel);
+   vec2 coverage = clamp((width*0.5f - distance)/pixel + 0.5f, 0.0f, 1.0f);
+   return max(coverage.x, coverage.y);
+  }
 
-   //vec4 VertexColors = vec4(v_vertexColors.r, v_vertexColors.g, v_vertexColors.b, 1.0f);
+  void main()
+  {
+   // Per fragment, so the highlights are as sharp on a coarse graph as on a fine one
+   float highlight = 1.0f;
+   if (u_highlight != 0) {
+       highlight = 1.0f + 0.2f * gridCoverage(v_position.xz);
+   }
 
    // color is a vec4 representing color. Because we are in a fragment
    // shader, we are expecting in our pipeline a color output.
@@ -32,10 +61,29 @@
    // to output one final color.
    
    if (coloring.x < 0 && coloring.y < 0 && coloring.z < 0) {
-       color = vec4(diffuseColor, 1.0f) * v_vertexColors * highlight;
+       color = vec4(GRAPH_SHADE, 1.0f) * v_vertexColors * highlight;
    } else {
        color = vec4(coloring, 1.0f) * highlight;
    }
+
+   // Peeling keeps only what is behind the layers peeled already (after the highlights, which need derivatives)
+   if (u_Transparency == 2 && gl_FragCoord.z <= texelFetch(u_PeelDepth, ivec2(gl_FragCoord.xy), 0).r) {
+       discard;
+   }
+
+   // Both ways of drawing translucent graphs in any order add up premultiplied colors
+   if (u_Transparency != 0) {
+       float alpha = clamp(color.a, 0.0f, 1.0f);
+       color = vec4(color.rgb*alpha, alpha);
+   }
+   if (u_Transparency == 1) {
+       // Nearer fragments weigh more, after McGuire and Bavoil's weight functions but steeper,
+       // for the 0.1 to 30 depth range of this scene. The distance comes from the projection.
+       float distance = u_Projection[3][2]/(gl_FragCoord.z*2.0f - 1.0f + u_Projection[2][2]);
+       float w = color.a*clamp(10.0f/(1e-5f + pow(distance/10.0f, 6.0f)), 1e-2f, 3e3f);
+       // Dividing the sums resolves to the average color, weighted by w and alpha
+       weight = vec4(color.a*w);
+       color = vec4(color.rgb*w, color.a);
+   }
   }
   // ==================================================================
-
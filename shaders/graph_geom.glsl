@@ -0,0 +1,35 @@
+#version 410 core
+//
+// Drops the triangles of a GPU evaluated graph (graph_vert.glsl) that touch a
+// sample where f is undefined or out of range, like Graph leaves them out of
+// its index buffer, and passes the others on to frag.glsl unchanged.
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+in vec4 g_vertexColors[];
+in vec3 g_normals[];
+in vec3 g_position[];
+in vec3 g_coloring[];
+in float g_defined[];
+
+out vec4 v_vertexColors;
+out vec3 v_normals;
+out vec3 v_position;
+out vec3 coloring;
+
+void main()
+{
+    if (g_defined[0] < 0.5 || g_defined[1] < 0.5 || g_defined[2] < 0.5) {
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        v_vertexColors = g_vertexColors[i];
+        v_normals = g_normals[i];
+        v_position = g_position[i];
+        coloring = g_coloring[i];
+        gl_Position = gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,141 @@
+#version 410 core
+//
+// Graph evaluated on the GPU (--gpu). The equation is translated to GLSL by
+// GLSLExpression and appended to this file as
+//     float f(float x, float y) { return ...; }
+// Every vertex is one sample of a flat dimension*dimension grid, and computes
+// the same position, normal and shade that Graph computes on the CPU.
+
+// Column and row of the sample
+layout(location=0) in vec2 sampleIndex;
+
+// Matrices that change once per frame, shared through a uniform buffer (binding point 0)
+layout(std140) uniform FrameMatrices {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection;
+};
+
+// One color per graph, shared through a uniform buffer (binding point 1)
+layout(std140) uniform GraphColors {
+    vec4 u_GraphColors[1024];
+};
+
+uniform int u_coloring;
+// Which entry of u_GraphColors this graph uses
+uniform int u_GraphIndex;
+// Samples per side and the x and y of the first and last sample
+uniform int u_Dimension;
+uniform float u_DomainMin;
+uniform float u_DomainMax;
+
+// Same outputs as vert.glsl, passed on by graph_geom.glsl
+out vec4 g_vertexColors;
+out vec3 g_normals;
+out vec3 g_position;
+out vec3 g_coloring;
+// 1 if f is defined and inside the plotted z range here
+out float g_defined;
+
+float f(float x, float y);
+
+// Heights outside [-Z_BOUND, Z_BOUND] are not drawn, as in Graph
+const float Z_BOUND = 50.0;
+
+float f_nan() {
+    return uintBitsToFloat(0x7fc00000u);
+}
+float f_infinity() {
+    return uintBitsToFloat(0x7f800000u);
+}
+
+// Helpers the translated equation calls where GLSL leaves a result undefined
+// or differs from exprtk, which the CPU uses
+float f_sqrt(float a) {
+    return a < 0.0 ? f_nan() : sqrt(a);
+}
+float f_log(float a) {
+    return a < 0.0 ? f_nan() : (a == 0.0 ? -f_infinity() : log(a));
+}
+float f_log2(float a) {
+    return f_log(a)/log(2.0);
+}
+float f_log10(float a) {
+    return f_log(a)/log(10.0);
+}
+float f_asin(float a) {
+    return abs(a) > 1.0 ? f_nan() : asin(a);
+}
+float f_acos(float a) {
+    return abs(a) > 1.0 ? f_nan() : acos(a);
+}
+float f_pow(float a, float b) {
+    if (a < 0.0) {
+        // Only whole exponents are defined for a negative base
+        if (b != floor(b)) {
+            return f_nan();
+        }
+        float magnitude = pow(-a, b);
+        return mod(b, 2.0) == 0.0 ? magnitude : -magnitude;
+    }
+    if (a == 0.0) {
+        return b > 0.0 ? 0.0 : (b == 0.0 ? 1.0 : f_infinity());
+    }
+    return pow(a, b);
+}
+// % keeps the sign of a, like fmod
+float f_mod(float a, float b) {
+    return a - b*trunc(a/b);
+}
+// Halves round away from zero
+float f_round(float a) {
+    return sign(a)*floor(abs(a) + 0.5);
+}
+
+bool isDefined(float z) {
+    return !isnan(z) && z >= -Z_BOUND && z <= Z_BOUND;
+}
+
+// x (or y) of sample i
+float sampleCoordinate(float i) {
+    return u_DomainMin + (u_DomainMax - u_DomainMin)*i/(float(u_Dimension) - 1.0);
+}
+
+void main()
+{
+    float x = sampleCoordinate(sampleIndex.x);
+    float y = sampleCoordinate(sampleIndex.y);
+    float z = f(x, y);
+    g_defined = isDefined(z) ? 1.0 : 0.0;
+    float height = isDefined(z) ? (z + Z_BOUND)/(Z_BOUND*2.0) : -1.0;
+    vec3 position = vec3(x, clamp(height*(Z_BOUND*2.0) - Z_BOUND, -Z_BOUND, Z_BOUND), y);
+
+    // Normal from the central differences, zero on the border and next to undefined heights
+    vec3 normal = vec3(0.0);
+    float last = float(u_Dimension - 1);
+    if (sampleIndex.x > 0.0 && sampleIndex.x < last && sampleIndex.y > 0.0 && sampleIndex.y < last) {
+        float leftPoint = f(sampleCoordinate(sampleIndex.x - 1.0), y);
+        float rightPoint = f(sampleCoordinate(sampleIndex.x + 1.0), y);
+        float downPoint = f(x, sampleCoordinate(sampleIndex.y - 1.0));
+        float upPoint = f(x, sampleCoordinate(sampleIndex.y + 1.0));
+        if (isDefined(leftPoint) && isDefined(rightPoint) && isDefined(downPoint) && isDefined(upPoint)) {
+            float spacing = 2.0*(u_DomainMax - u_DomainMin)/(float(u_Dimension) - 1.0);
+            float partial_x = (rightPoint - leftPoint)/spacing;
+            float partial_y = (upPoint - downPoint)/spacing;
+            normal = normalize(cross(vec3(0.0, partial_y, 1.0), vec3(1.0, partial_x, 0.0)));
+        }
+    }
+
+    float yellowTint = clamp(height*8.0 - 3.8, 0.0, 1.0);
+    g_vertexColors = vec4(vec3(1.0 - yellowTint), 0.9) * u_GraphColors[u_GraphIndex];
+    g_normals = normal;
+    g_position = position;
+
+    // Normal coloring, as vert.glsl does for graphs
+    g_coloring = vec3(-1.0);
+    if (u_coloring == 1) {
+        g_coloring = vec3(abs(normal.x), abs(normal.z), abs(normal.y));
+    }
+
+    gl_Position = u_Projection * u_ViewMatrix * u_ModelMatrix * vec4(position, 1.0);
+}
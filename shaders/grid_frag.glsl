@@ -0,0 +1,32 @@
+#version 410 core
+//
+// Lines of the x-y grid on the square of grid_vert.glsl, anti-aliased analytically so
+// they stay one smooth pixel or more wide however far away or coarse the view is.
+
+in vec2 v_coordinate;
+
+const float GRID_EXTENT = 5.0;
+const float LINE_WIDTH = 0.02;
+const vec3 LINE_COLOR = vec3(0.46, 0.45, 0.47);
+
+out vec4 color;
+
+void main()
+{
+    // How much of this fragment each line covers, over one pixel of falloff.
+    // Lines are never drawn thinner than a pixel, so they do not break up in the distance.
+    vec2 pixel = max(fwidth(v_coordinate), vec2(1e-6));
+    vec2 distance = abs(v_coordinate - round(v_coordinate));
+    vec2 width = max(vec2(LINE_WIDTH), pixel);
+    vec2 coverage = clamp((width*0.5 - distance)/pixel + 0.5, 0.0, 1.0);
+
+    // Lines of constant x run along y, and the other way around, within the grid only
+    vec2 inside = step(abs(v_coordinate.yx), vec2(GRID_EXTENT + LINE_WIDTH*0.5));
+    float alpha = max(coverage.x*inside.x, coverage.y*inside.y);
+
+    // Nothing between the lines, not even depth, so graphs show through
+    if (alpha < 1.0/255.0) {
+        discard;
+    }
+    color = vec4(LINE_COLOR, alpha);
+}
@@ -0,0 +1,32 @@
+#version 410 core
+//
+// The x-y grid (see AxesGrid): one square in the model's y = 0 plane, made from
+// gl_VertexID so it needs no vertex buffer. grid_frag.glsl draws the lines on it.
+
+// Matrices that change once per frame, shared through a uniform buffer (binding point 0)
+layout(std140) uniform FrameMatrices {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    mat4 u_Projection;
+};
+
+// Lines are at whole x and y from -GRID_EXTENT to GRID_EXTENT, and LINE_WIDTH wide
+const float GRID_EXTENT = 5.0;
+const float LINE_WIDTH = 0.02;
+
+// x and y of this corner, in model units
+out vec2 v_coordinate;
+
+void main()
+{
+    // Corners of a triangle strip: (-1,-1) (1,-1) (-1,1) (1,1), a little past the outer lines
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1)*2.0 - 1.0;
+    v_coordinate = corner*(GRID_EXTENT + LINE_WIDTH);
+
+    // The lines used to be thin boxes around y = 0. Lifting the square to the side the camera
+    // is on keeps them in front of a graph lying in that plane, from above and from below.
+    vec3 eye = inverse(u_ViewMatrix*u_ModelMatrix)[3].xyz;
+    float height = eye.y >= 0.0 ? LINE_WIDTH*0.5 : -LINE_WIDTH*0.5;
+
+    gl_Position = u_Projection*u_ViewMatrix*u_ModelMatrix*vec4(v_coordinate.x, height, v_coordinate.y, 1.0);
+}
@@ -8,47 +8,42 @@ layout(location=0) in vec3 position;
 layout(location=1) in vec3 normals;
 layout(location=2) in vec4 vertexColors;
 layout(location=3) in vec2 textureCoordinates;
+// Which graph this vertex belongs to (entry 0, once the grid, is unused)
+layout(location=4) in uint graphIndex;
 
-// Uniform variables
-uniform mat4 u_ModelMatrix;
-uniform mat4 u_ViewMatrix;
-// We'll use a perspective projection
-uniform mat4 u_Projection; 
+// Matrices that change once per frame, shared through a uniform buffer (binding point 0)
+layout(std140) uniform FrameMatrices {
+    mat4 u_ModelMatrix;
+    mat4 u_ViewMatrix;
+    // We'll use a perspective projection
+    mat4 u_Projection;
+};
+
+// One color per graph, indexed by graphIndex, shared through a uniform buffer (binding point 1)
+layout(std140) uniform GraphColors {
+    vec4 u_GraphColors[1024];
+};
 
 uniform int u_coloring;
-uniform int u_highlight;
 
 // Pass vertex colors into the fragment shader
 out vec4 v_vertexColors;
-// Pass texture coordinates to the fragment shader
 out vec3 v_normals;
-out vec2 v_textureCoordinates;
-// Highlight based on position
-out float highlight;
+// Position in the model, for the x-y grid highlights drawn by frag.glsl
+out vec3 v_position;
 out vec3 coloring;
 
 void main()
 {
     v_normals = normals;	
-    v_vertexColors 	 = vertexColors;
-    v_textureCoordinates = textureCoordinates;
-    
-    highlight = 1.0f;
-    vec3 m_coloring = vec3(-1.0f,-1.0f,-1.0f);
+    v_vertexColors 	 = vertexColors * u_GraphColors[graphIndex];
+    v_position = position;
 
-    // is this texture part of a graph?
-    if (textureCoordinates.x <= 0.01f && textureCoordinates.y <= .01f) {
-        if (position.x - floor(position.x) < .01f || position.x - floor(position.x) > .99f) { 
-            highlight = 1.0f + 0.2f * u_highlight;
-        }
-        if (position.z - floor(position.z) < .01f || position.z - floor(position.z) > .99f) {
-            highlight = 1.0f + 0.2f * u_highlight;
-        }
-        if (u_coloring == 1) {
-            m_coloring.x = abs(normals.x);
-            m_coloring.y = abs(normals.z);
-            m_coloring.z = abs(normals.y);
-        }
+    vec3 m_coloring = vec3(-1.0f,-1.0f,-1.0f);
+    if (u_coloring == 1) {
+        m_coloring.x = abs(normals.x);
+        m_coloring.y = abs(normals.z);
+        m_coloring.z = abs(normals.y);
     }
 
     coloring = m_coloring;
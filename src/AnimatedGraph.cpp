@@ -0,0 +1,288 @@
+/** @file AnimatedGraph.cpp
+ *  @brief Class implementation for a graph of f(x,y,t) produced on worker threads.
+ *
+ *  @author Antoine Assaf
+ */
+#include "AnimatedGraph.hpp"
+
+#include "Equation.hpp"
+#include "Graph.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// Constructor
+AnimatedGraph::AnimatedGraph(){
+	m_current = nullptr;
+	m_dimension = 0;
+	m_chunkRows = 1;
+	m_indexCount = 0;
+	m_graphIndex = 0;
+	m_producers = nullptr;
+	m_tickInterval = std::chrono::steady_clock::duration::zero();
+	m_sequence = 0;
+	m_stats = AnimationStats{0, 0, 0, 0, 0.0, 0.0};
+}
+
+// Destructor deletes the OpenGL objects
+AnimatedGraph::~AnimatedGraph(){
+	Destroy();
+}
+
+// Creates the slots for a dimension*dimension graph of equation (in x, y and t) drawn with color
+// index graphIndex (vertex attribute 4). Frames are computed on producers, framesPerSecond times a
+// second of animation time; onReady is called on a producer thread whenever a frame is finished.
+void AnimatedGraph::Create(const std::string& equation, unsigned int dimension, GLuint graphIndex, ThreadPool& producers,
+                           unsigned int framesPerSecond, std::function<void()> onReady, GLState& state){
+	m_equation = equation;
+	m_dimension = dimension;
+	m_indexCount = (GLsizei)(6*(dimension - 1)*(dimension - 1));
+	m_graphIndex = graphIndex;
+	m_producers = &producers;
+	m_onReady = onReady;
+	// A few chunks per producer keeps them all busy when rows cost different amounts
+	m_chunkRows = std::max(1u, dimension/(producers.size()*4));
+
+	for(Slot& slot : m_slots){
+		slot.heights.resize((size_t)dimension*dimension);
+
+		glGenVertexArrays(1, &slot.vertexArray);
+		state.BindVertexArray(slot.vertexArray);
+
+		glGenBuffers(1, &slot.vertexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, slot.vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)dimension*dimension*12*sizeof(GLfloat), nullptr, GL_STREAM_DRAW);
+		glGenBuffers(1, &slot.indexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, slot.indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)m_indexCount*sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+
+		// Same layout as the arena: position, normal, color, texture coordinates
+		const GLint components[4] = {3, 3, 4, 2};
+		const GLsizei offsets[4] = {0, 3, 6, 10};
+		for(GLuint attribute = 0; attribute < 4; attribute++){
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribPointer(attribute, components[attribute], GL_FLOAT, GL_FALSE, sizeof(GLfloat)*12,
+			                      (GLvoid*)(sizeof(GLfloat)*offsets[attribute]));
+		}
+		// Attribute 4 (the color index) is left disabled and set as a constant in Draw
+	}
+	state.BindVertexArray(0);
+
+	m_tickInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(1.0/std::max(1u, framesPerSecond)));
+	m_start = std::chrono::steady_clock::now();
+	m_nextTick = m_start;
+}
+
+// Waits for frames being computed and deletes the OpenGL objects (while the context still exists)
+void AnimatedGraph::Destroy(){
+	if(m_producers == nullptr){
+		return;
+	}
+	// Producers write into mapped buffers, so they must be done before anything is unmapped
+	m_producers->wait();
+	for(Slot& slot : m_slots){
+		if(slot.vertices != nullptr){
+			Unmap(slot);
+		}
+		if(slot.fence != nullptr){
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+		}
+		glDeleteBuffers(1, &slot.vertexBuffer);
+		glDeleteBuffers(1, &slot.indexBuffer);
+		glDeleteVertexArrays(1, &slot.vertexArray);
+		slot.vertexBuffer = 0;
+		slot.indexBuffer = 0;
+		slot.vertexArray = 0;
+		slot.state = SLOT_FREE;
+	}
+	m_current = nullptr;
+	m_producers = nullptr;
+}
+
+// Returns true if the GPU is done with slot's buffers
+bool AnimatedGraph::FenceSignaled(Slot& slot){
+	if(slot.fence == nullptr){
+		return true;
+	}
+	// A zero timeout only asks, it never blocks the render thread
+	GLenum status = glClientWaitSync(slot.fence, 0, 0);
+	if(status == GL_TIMEOUT_EXPIRED){
+		return false;
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+	return true;
+}
+
+// Unmaps slot's buffers. Returns false if the driver lost their contents.
+bool AnimatedGraph::Unmap(Slot& slot){
+	// GL_ARRAY_BUFFER is used for both so the element binding of a vertex array is never touched
+	glBindBuffer(GL_ARRAY_BUFFER, slot.vertexBuffer);
+	bool vertices = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+	glBindBuffer(GL_ARRAY_BUFFER, slot.indexBuffer);
+	bool indices = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+	slot.vertices = nullptr;
+	slot.indices = nullptr;
+	return vertices && indices;
+}
+
+// Maps slot and queues the producers for a frame at animation time t
+void AnimatedGraph::StartFrame(Slot& slot, float t, std::chrono::steady_clock::time_point tick){
+	// The fence has signaled, so the old contents can be thrown away without waiting for the GPU
+	const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+	glBindBuffer(GL_ARRAY_BUFFER, slot.vertexBuffer);
+	slot.vertices = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)m_dimension*m_dimension*12*sizeof(GLfloat), access);
+	glBindBuffer(GL_ARRAY_BUFFER, slot.indexBuffer);
+	slot.indices = (GLuint*)glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)m_indexCount*sizeof(GLuint), access);
+	if(slot.vertices == nullptr || slot.indices == nullptr){
+		std::cout << "Could not map the buffers of an animated graph" << std::endl;
+		Unmap(slot);
+		return;
+	}
+
+	slot.t = t;
+	slot.tick = tick;
+	slot.sequence = ++m_sequence;
+	slot.state = SLOT_PRODUCING;
+	unsigned int chunks = (m_dimension + m_chunkRows - 1)/m_chunkRows;
+	slot.chunksLeft = chunks;
+	for(unsigned int row = 0; row < m_dimension; row += m_chunkRows){
+		unsigned int rowEnd = std::min(row + m_chunkRows, m_dimension);
+		m_producers->submit([this, &slot, row, rowEnd](){ ProduceHeights(slot, row, rowEnd); });
+	}
+}
+
+// Runs on a producer: samples f for rows [rowBegin, rowEnd), and queues the meshing when all rows are done
+void AnimatedGraph::ProduceHeights(Slot& slot, unsigned int rowBegin, unsigned int rowEnd){
+	Equation& expression = Equation::forThread(m_equation, {"x", "y", "t"});
+	for(unsigned int y = rowBegin; y < rowEnd; y++){
+		float* row = slot.heights.data() + (size_t)y*m_dimension;
+		float ySample = Graph::sampleCoordinate(y, m_dimension);
+		for(unsigned int x = 0; x < m_dimension; x++){
+			row[x] = Graph::toHeight(expression.value(Graph::sampleCoordinate(x, m_dimension), ySample, slot.t));
+		}
+	}
+	if(--slot.chunksLeft != 0){
+		return;
+	}
+	// Normals and triangles look at the next row, so meshing waits for every height
+	unsigned int chunks = (m_dimension + m_chunkRows - 1)/m_chunkRows;
+	slot.chunksLeft = chunks;
+	for(unsigned int row = 0; row < m_dimension; row += m_chunkRows){
+		unsigned int rowEnd = std::min(row + m_chunkRows, m_dimension);
+		m_producers->submit([this, &slot, row, rowEnd](){ ProduceMesh(slot, row, rowEnd); });
+	}
+}
+
+// Runs on a producer: builds vertices and indices for rows [rowBegin, rowEnd), marking the slot ready when all are done
+void AnimatedGraph::ProduceMesh(Slot& slot, unsigned int rowBegin, unsigned int rowEnd){
+	Graph::buildVertices(slot.heights.data(), m_dimension, -5.0f, 5.0f, rowBegin, rowEnd, slot.vertices);
+	Graph::buildGridIndices(slot.heights.data(), m_dimension, rowBegin, std::min(rowEnd, m_dimension - 1), slot.indices);
+	if(--slot.chunksLeft != 0){
+		return;
+	}
+	slot.state = SLOT_READY;
+	if(m_onReady){
+		m_onReady();
+	}
+}
+
+// Shows the newest finished frame and starts the next frame when its tick is due.
+// Returns true if a new frame is ready to be drawn.
+bool AnimatedGraph::Update(){
+	auto now = std::chrono::steady_clock::now();
+
+	// Take the newest finished frame; older ones were overtaken and are dropped
+	Slot* newest = nullptr;
+	for(Slot& slot : m_slots){
+		if(slot.state != SLOT_READY){
+			continue;
+		}
+		m_stats.produced++;
+		if(newest == nullptr || slot.sequence > newest->sequence){
+			if(newest != nullptr){
+				Unmap(*newest);
+				newest->state = SLOT_FREE;
+				m_stats.dropped++;
+			}
+			newest = &slot;
+		} else {
+			Unmap(slot);
+			slot.state = SLOT_FREE;
+			m_stats.dropped++;
+		}
+	}
+	bool changed = false;
+	if(newest != nullptr){
+		if(!Unmap(*newest)){
+			newest->state = SLOT_FREE;
+			m_stats.dropped++;
+		} else if(m_current != nullptr && newest->sequence < m_current->sequence){
+			newest->state = SLOT_FREE;
+			m_stats.dropped++;
+		} else {
+			if(m_current != nullptr){
+				m_current->state = SLOT_FREE;
+			}
+			newest->state = SLOT_CURRENT;
+			m_current = newest;
+			m_stats.displayed++;
+			double latency = std::chrono::duration<double, std::milli>(now - newest->tick).count();
+			m_stats.latencyMs = m_stats.displayed == 1 ? latency : m_stats.latencyMs*0.9 + latency*0.1;
+			m_stats.worstLatencyMs = std::max(m_stats.worstLatencyMs, latency);
+			changed = true;
+		}
+	}
+
+	if(now < m_nextTick){
+		return changed;
+	}
+	// Ticks that passed while the window was busy are skipped rather than produced late
+	auto missed = (now - m_nextTick)/m_tickInterval;
+	m_stats.skipped += (uint64_t)missed;
+	auto tick = m_nextTick + missed*m_tickInterval;
+	m_nextTick = tick + m_tickInterval;
+
+	Slot* free = nullptr;
+	for(Slot& slot : m_slots){
+		if(slot.state == SLOT_FREE && FenceSignaled(slot)){
+			free = &slot;
+			break;
+		}
+	}
+	if(free == nullptr){
+		// Every slot is being produced, waiting to be drawn or still read by the GPU
+		m_stats.skipped++;
+		return changed;
+	}
+	StartFrame(*free, std::chrono::duration<float>(tick - m_start).count(), tick);
+	return changed;
+}
+
+// Returns when Update should run next to keep the animation on time
+std::chrono::steady_clock::time_point AnimatedGraph::NextDeadline() const{
+	return m_nextTick;
+}
+
+// Draws the current frame with the bound program and fences its buffers.
+// Returns the number of indices drawn (0 before the first frame).
+GLsizei AnimatedGraph::Draw(GLState& state){
+	if(m_current == nullptr){
+		return 0;
+	}
+	state.BindVertexArray(m_current->vertexArray);
+	glVertexAttribI4ui(4, m_graphIndex, 0, 0, 0);
+	glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, (void*)0);
+	if(m_current->fence != nullptr){
+		glDeleteSync(m_current->fence);
+	}
+	m_current->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return m_indexCount;
+}
+
+// Returns the frame counters
+AnimationStats AnimatedGraph::GetStats() const{
+	return m_stats;
+}
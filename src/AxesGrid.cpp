@@ -0,0 +1,129 @@
+/** @file AxesGrid.cpp
+ *  @brief Class implementation for the procedural x-y grid and axes.
+ *
+ *  @author Antoine Assaf
+ */
+#include "AxesGrid.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Arrow size, as the axes of the grid .obj used to be
+const float SHAFT_LENGTH = 5.0f; // shaft from -SHAFT_LENGTH to SHAFT_LENGTH
+const float SHAFT_HALF_WIDTH = 0.02f;
+const float CONE_START = 4.963f; // cones from +-CONE_START to +-CONE_TIP
+const float CONE_TIP = 5.222f;
+const float CONE_RADIUS = 0.056f;
+const unsigned int CONE_SEGMENTS = 32;
+
+// Returns the triangles of an arrow along x: a square shaft with a cone at each end
+static std::vector<glm::vec3> BuildArrow(){
+	std::vector<glm::vec3> vertices;
+
+	// The four sides of the shaft, going around it
+	const glm::vec2 corners[4] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+	for(unsigned int i = 0; i < 4; i++){
+		glm::vec2 a = corners[i]*SHAFT_HALF_WIDTH;
+		glm::vec2 b = corners[(i + 1) % 4]*SHAFT_HALF_WIDTH;
+		glm::vec3 a0(-SHAFT_LENGTH, a.x, a.y), b0(-SHAFT_LENGTH, b.x, b.y);
+		glm::vec3 a1(SHAFT_LENGTH, a.x, a.y), b1(SHAFT_LENGTH, b.x, b.y);
+		vertices.insert(vertices.end(), {a0, b0, b1, a0, b1, a1});
+	}
+
+	// A cone and its base at each end
+	for(float end : {-1.0f, 1.0f}){
+		glm::vec3 tip(end*CONE_TIP, 0.0f, 0.0f);
+		glm::vec3 center(end*CONE_START, 0.0f, 0.0f);
+		for(unsigned int i = 0; i < CONE_SEGMENTS; i++){
+			float a = 2.0f*glm::pi<float>()*i/CONE_SEGMENTS;
+			float b = 2.0f*glm::pi<float>()*(i + 1)/CONE_SEGMENTS;
+			glm::vec3 rimA(end*CONE_START, CONE_RADIUS*std::cos(a), CONE_RADIUS*std::sin(a));
+			glm::vec3 rimB(end*CONE_START, CONE_RADIUS*std::cos(b), CONE_RADIUS*std::sin(b));
+			vertices.insert(vertices.end(), {rimA, rimB, tip, center, rimB, rimA});
+		}
+	}
+	return vertices;
+}
+
+// Constructor
+AxesGrid::AxesGrid(){
+	m_gridVertexArray = 0;
+	m_axesVertexArray = 0;
+	m_axesVertexBuffer = 0;
+	m_axesVertexCount = 0;
+}
+
+// Destructor deletes the OpenGL objects
+AxesGrid::~AxesGrid(){
+	Destroy();
+}
+
+// Compiles the grid and axes programs, connects their FrameMatrices block to frameMatricesBinding
+// and builds the arrow mesh. Returns false (after printing why) on failure.
+bool AxesGrid::Create(const std::string& gridVertexSource, const std::string& gridFragmentSource,
+                      const std::string& axesVertexSource, const std::string& axesFragmentSource,
+                      GLuint frameMatricesBinding, GLState& state){
+	if(!m_gridProgram.Create(gridVertexSource, gridFragmentSource) ||
+	   !m_axesProgram.Create(axesVertexSource, axesFragmentSource)){
+		return false;
+	}
+	if(!m_gridProgram.BindUniformBlock("FrameMatrices", frameMatricesBinding) ||
+	   !m_axesProgram.BindUniformBlock("FrameMatrices", frameMatricesBinding)){
+		std::cout << "Could not find uniform block FrameMatrices in the grid or axes shaders, maybe a misspelling?" << std::endl;
+		return false;
+	}
+
+	// A core profile draws nothing without a vertex array, even one without attributes
+	glGenVertexArrays(1, &m_gridVertexArray);
+
+	std::vector<glm::vec3> arrow = BuildArrow();
+	m_axesVertexCount = (GLsizei)arrow.size();
+	glGenVertexArrays(1, &m_axesVertexArray);
+	state.BindVertexArray(m_axesVertexArray);
+	glGenBuffers(1, &m_axesVertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_axesVertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, arrow.size()*sizeof(glm::vec3), arrow.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid*)0);
+	state.BindVertexArray(0);
+	return true;
+}
+
+// Deletes the programs and buffers (while the context still exists)
+void AxesGrid::Destroy(){
+	m_gridProgram.Destroy();
+	m_axesProgram.Destroy();
+	if(m_gridVertexArray != 0){
+		glDeleteVertexArrays(1, &m_gridVertexArray);
+		m_gridVertexArray = 0;
+	}
+	if(m_axesVertexArray != 0){
+		glDeleteVertexArrays(1, &m_axesVertexArray);
+		glDeleteBuffers(1, &m_axesVertexBuffer);
+		m_axesVertexArray = 0;
+		m_axesVertexBuffer = 0;
+	}
+	m_axesVertexCount = 0;
+}
+
+// Draws the grid and the axes, leaving the axes program bound.
+// Returns the number of vertices drawn, as triangle list indices for the profiler.
+GLsizei AxesGrid::Draw(GLState& state){
+	if(m_gridVertexArray == 0){
+		return 0;
+	}
+	state.UseProgram(m_gridProgram.GetID());
+	state.BindVertexArray(m_gridVertexArray);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	state.UseProgram(m_axesProgram.GetID());
+	state.BindVertexArray(m_axesVertexArray);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, m_axesVertexCount, 3);
+
+	// The strip's two triangles, then three arrows
+	return 6 + 3*m_axesVertexCount;
+}
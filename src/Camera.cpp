@@ -75,7 +75,6 @@ float Camera::GetViewZDirection(){
 
 
 Camera::Camera(){
-    std::cout << "(Constructor) Created a Camera!\n";
 	// Position us at the origin.
     m_eyePosition = glm::vec3(0.0f,0.0f, 0.0f);
 	// Looking down along the z-axis initially.
@@ -0,0 +1,280 @@
+/** @file ContourSet.cpp
+ * @brief Class implementation for extracting level curves of a grid with marching squares.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "ContourSet.hpp"
+#include "Graph.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <unordered_map>
+
+// Marks the missing second segment on an edge
+const unsigned int NO_SEGMENT = 0xFFFFFFFFu;
+
+// Constructor keeps dimension*dimension samples over [domainMin, domainMax]^2 and the range of every tile
+ContourSet::ContourSet(std::vector<float> values, unsigned int dimension, float domainMin, float domainMax) {
+    m_values = std::move(values);
+    m_dimension = dimension;
+    m_domainMin = domainMin;
+    m_domainMax = domainMax;
+    m_min = NAN;
+    m_max = NAN;
+    m_interval = 0.0f;
+
+    // Samples on the border of two tiles count for both
+    unsigned int cells = m_dimension - 1;
+    m_tileDimension = (cells + Graph::CHUNK_CELLS - 1)/Graph::CHUNK_CELLS;
+    m_tileRanges.assign((size_t)m_tileDimension*m_tileDimension, glm::vec2(NAN));
+    for (unsigned int tileY = 0; tileY < m_tileDimension; tileY++) {
+        for (unsigned int tileX = 0; tileX < m_tileDimension; tileX++) {
+            glm::vec2& range = m_tileRanges[(size_t)tileY*m_tileDimension + tileX];
+            unsigned int endY = std::min((tileY + 1)*Graph::CHUNK_CELLS, cells);
+            unsigned int endX = std::min((tileX + 1)*Graph::CHUNK_CELLS, cells);
+            for (unsigned int y = tileY*Graph::CHUNK_CELLS; y <= endY; y++) {
+                for (unsigned int x = tileX*Graph::CHUNK_CELLS; x <= endX; x++) {
+                    // fmin and fmax skip NaN
+                    float value = m_values[(size_t)y*m_dimension + x];
+                    range.x = std::fmin(range.x, value);
+                    range.y = std::fmax(range.y, value);
+                }
+            }
+            m_min = std::fmin(m_min, range.x);
+            m_max = std::fmax(m_max, range.y);
+        }
+    }
+}
+
+// Extracts the levels that are not extracted yet and drops the lines of those that are not in levels
+void ContourSet::setLevels(const std::vector<float>& levels, unsigned int threadCount) {
+    std::set<float> wanted(levels.begin(), levels.end());
+    std::map<float, std::vector<ContourLine>> kept;
+    std::vector<float> missing;
+    for (float level : wanted) {
+        auto found = m_levels.find(level);
+        if (found != m_levels.end()) {
+            kept[level] = std::move(found->second);
+        } else {
+            missing.push_back(level);
+        }
+    }
+    m_levels.swap(kept);
+    if (missing.empty()) {
+        return;
+    }
+
+    std::vector<std::vector<Segment>> tileSegments((size_t)m_tileDimension*m_tileDimension);
+    std::vector<std::vector<Segment>> levelSegments(missing.size());
+    std::vector<std::vector<ContourLine>> lines(missing.size());
+    {
+        // Every tile at once, then every level
+        ThreadPool pool(threadCount);
+        for (unsigned int tileY = 0; tileY < m_tileDimension; tileY++) {
+            for (unsigned int tileX = 0; tileX < m_tileDimension; tileX++) {
+                std::vector<Segment>& segments = tileSegments[(size_t)tileY*m_tileDimension + tileX];
+                pool.submit([this, tileX, tileY, &missing, &segments]() { extractTile(tileX, tileY, missing, segments); });
+            }
+        }
+        pool.wait();
+        for (std::vector<Segment>& segments : tileSegments) {
+            for (const Segment& segment : segments) {
+                levelSegments[segment.level].push_back(segment);
+            }
+            std::vector<Segment>().swap(segments);
+        }
+        for (size_t level = 0; level < missing.size(); level++) {
+            pool.submit([level, &levelSegments, &lines]() { lines[level] = weld(levelSegments[level]); });
+        }
+        pool.wait();
+    }
+    // Levels without lines are kept too, so they are not extracted again
+    for (size_t level = 0; level < missing.size(); level++) {
+        m_levels[missing[level]] = std::move(lines[level]);
+    }
+}
+
+// Sets the levels to every multiple of interval between the smallest and largest sample
+bool ContourSet::setInterval(float interval, unsigned int threadCount) {
+    if (!(interval > 0.0f)) {
+        return false;
+    }
+    std::vector<float> levels;
+    if (!std::isnan(m_min)) {
+        // In double, so a level is the same float whichever interval it is a multiple of
+        double first = std::ceil(m_min/(double)interval);
+        double last = std::floor(m_max/(double)interval);
+        if (last - first + 1 > MAX_LEVELS) {
+            return false;
+        }
+        for (double k = first; k <= last; k++) {
+            levels.push_back((float)(k*interval));
+        }
+    }
+    setLevels(levels, threadCount);
+    m_interval = interval;
+    return true;
+}
+
+// Returns the interval of the last setInterval, 0 if it was not called
+float ContourSet::getInterval() const {
+    return m_interval;
+}
+
+// Returns the lines of every level, lowest level first
+const std::map<float, std::vector<ContourLine>>& ContourSet::getLevels() const {
+    return m_levels;
+}
+
+// Returns the smallest defined sample, NaN if there is none
+float ContourSet::getMin() const {
+    return m_min;
+}
+
+// Returns the largest defined sample, NaN if there is none
+float ContourSet::getMax() const {
+    return m_max;
+}
+
+// Appends the segments of every level in tile (tileX, tileY) that the tile's range contains
+void ContourSet::extractTile(unsigned int tileX, unsigned int tileY, const std::vector<float>& levels,
+                             std::vector<Segment>& segments) const {
+    glm::vec2 range = m_tileRanges[(size_t)tileY*m_tileDimension + tileX];
+    unsigned int cells = m_dimension - 1;
+    unsigned int endY = std::min((tileY + 1)*Graph::CHUNK_CELLS, cells);
+    unsigned int endX = std::min((tileX + 1)*Graph::CHUNK_CELLS, cells);
+
+    for (unsigned int level = 0; level < levels.size(); level++) {
+        // A sample is above the level if it is at least the level, so one must be below it
+        float value = levels[level];
+        if (!(range.x < value && value <= range.y)) {
+            continue;
+        }
+        for (unsigned int y = tileY*Graph::CHUNK_CELLS; y < endY; y++) {
+            for (unsigned int x = tileX*Graph::CHUNK_CELLS; x < endX; x++) {
+                // Corners counter-clockwise from (x, y), and edge k from corner k to corner k + 1
+                size_t curr = (size_t)y*m_dimension + x;
+                float corners[4] = {m_values[curr], m_values[curr + 1], m_values[curr + m_dimension + 1],
+                                    m_values[curr + m_dimension]};
+                unsigned int above = 0;
+                bool defined = true;
+                for (unsigned int k = 0; k < 4; k++) {
+                    defined = defined && !std::isnan(corners[k]);
+                    above |= (corners[k] >= value ? 1u : 0u) << k;
+                }
+                if (!defined || above == 0 || above == 15) {
+                    continue;
+                }
+                unsigned long long edges[4] = {2*curr, 2*(curr + 1) + 1, 2*(curr + m_dimension), 2*curr + 1};
+
+                unsigned int crossed[4];
+                unsigned int count = 0;
+                for (unsigned int k = 0; k < 4; k++) {
+                    if ((above >> k & 1) != (above >> (k + 1) % 4 & 1)) {
+                        crossed[count++] = k;
+                    }
+                }
+                std::pair<unsigned int, unsigned int> pairs[2] = {{crossed[0], crossed[1]}, {0, 0}};
+                unsigned int pairCount = 1;
+                if (count == 4) {
+                    // A saddle: the corners on the side of the average are joined through the
+                    // middle of the cell, and the other two are cut off by a segment each
+                    bool middleAbove = (corners[0] + corners[1] + corners[2] + corners[3])*0.25f >= value;
+                    if (middleAbove == ((above & 1) != 0)) {
+                        pairs[0] = {0, 1}; // around corner 1
+                        pairs[1] = {2, 3}; // around corner 3
+                    } else {
+                        pairs[0] = {3, 0}; // around corner 0
+                        pairs[1] = {1, 2}; // around corner 2
+                    }
+                    pairCount = 2;
+                }
+                for (unsigned int p = 0; p < pairCount; p++) {
+                    Segment segment;
+                    segment.level = level;
+                    segment.edges[0] = edges[pairs[p].first];
+                    segment.edges[1] = edges[pairs[p].second];
+                    segment.points[0] = crossing(segment.edges[0], value);
+                    segment.points[1] = crossing(segment.edges[1], value);
+                    segments.push_back(segment);
+                }
+            }
+        }
+    }
+}
+
+// Returns where level crosses grid edge (2*sample + axis), as (x, y)
+glm::vec2 ContourSet::crossing(unsigned long long edge, float level) const {
+    size_t sample = edge/2;
+    unsigned int axis = edge & 1;
+    float a = m_values[sample];
+    float b = m_values[sample + (axis == 0 ? 1 : m_dimension)];
+    // Both cells on the edge compute the same point, so the lines meet exactly
+    float t = (level - a)/(b - a);
+    float column = (float)(sample % m_dimension) + (axis == 0 ? t : 0.0f);
+    float row = (float)(sample / m_dimension) + (axis == 1 ? t : 0.0f);
+    float span = m_domainMax - m_domainMin;
+    return glm::vec2(m_domainMin + span*column/(m_dimension - 1.0f), m_domainMin + span*row/(m_dimension - 1.0f));
+}
+
+// Joins the segments of one level that share an edge into polylines
+std::vector<ContourLine> ContourSet::weld(const std::vector<Segment>& segments) {
+    // Every edge crossed is shared by the segments of the (at most two) cells on it
+    std::unordered_map<unsigned long long, std::pair<unsigned int, unsigned int>> ends;
+    ends.reserve(segments.size()*2);
+    for (unsigned int s = 0; s < segments.size(); s++) {
+        for (unsigned int end = 0; end < 2; end++) {
+            auto inserted = ends.emplace(segments[s].edges[end], std::make_pair(s, NO_SEGMENT));
+            if (!inserted.second) {
+                inserted.first->second.second = s;
+            }
+        }
+    }
+
+    std::vector<ContourLine> lines;
+    std::vector<unsigned char> visited(segments.size(), 0);
+    auto follow = [&](unsigned int s, unsigned int from) {
+        ContourLine line;
+        line.closed = false;
+        unsigned long long start = segments[s].edges[from];
+        line.points.push_back(segments[s].points[from]);
+        line.edges.push_back(start);
+        while (true) {
+            visited[s] = 1;
+            unsigned long long edge = segments[s].edges[1 - from];
+            if (edge == start) {
+                line.closed = true;
+                break;
+            }
+            line.points.push_back(segments[s].points[1 - from]);
+            line.edges.push_back(edge);
+            const std::pair<unsigned int, unsigned int>& shared = ends[edge];
+            unsigned int next = shared.first == s ? shared.second : shared.first;
+            if (next == NO_SEGMENT || visited[next]) {
+                break;
+            }
+            from = segments[next].edges[0] == edge ? 0 : 1;
+            s = next;
+        }
+        lines.push_back(std::move(line));
+    };
+
+    // Open lines start on an edge with a single segment, on the border of the grid or of undefined samples
+    for (unsigned int s = 0; s < segments.size(); s++) {
+        for (unsigned int end = 0; end < 2; end++) {
+            if (!visited[s] && ends[segments[s].edges[end]].second == NO_SEGMENT) {
+                follow(s, end);
+            }
+        }
+    }
+    // What is left are loops
+    for (unsigned int s = 0; s < segments.size(); s++) {
+        if (!visited[s]) {
+            follow(s, 0);
+        }
+    }
+    return lines;
+}
@@ -0,0 +1,103 @@
+/** @file Equation.cpp
+ * @brief Class implementation for compiling and evaluating an equation string.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "Equation.hpp"
+#include "exprtk.hpp"
+
+#include <memory>
+#include <unordered_map>
+
+// Compiled equations kept by each thread for forThread
+const size_t EQUATIONS_PER_THREAD = 64;
+
+typedef exprtk::symbol_table<float> symbol_table_t;
+typedef exprtk::expression<float> expression_t;
+typedef exprtk::parser<float> parser_t;
+
+// Everything exprtk needs to keep alive for the compiled expression
+struct EquationState {
+    std::vector<float> values; // variable storage, never resized after binding
+    symbol_table_t symbolTable;
+    expression_t expression;
+};
+
+// Constructor compiles the equation in terms of the given variable names (x and y by default)
+Equation::Equation(std::string equation, std::vector<std::string> variables) {
+    m_equation = equation;
+    m_state = new EquationState();
+    m_state->values.resize(variables.size(), 0.0f);
+
+    for (size_t i = 0; i < variables.size(); i++) {
+        m_state->symbolTable.add_variable(variables[i], m_state->values[i]);
+    }
+
+    m_state->symbolTable.add_constant("e", 2.71828);
+    m_state->symbolTable.add_constant("pi", 3.14159);
+    m_state->symbolTable.add_constants();
+
+    m_state->expression.register_symbol_table(m_state->symbolTable);
+
+    parser_t parser;
+    if (!parser.compile(equation, m_state->expression)) {
+        m_error = parser.error();
+    }
+}
+
+//Destructor clears any allocated memory
+Equation::~Equation() {
+    if (m_state != nullptr) {
+        delete m_state;
+    }
+}
+
+// Returns true if the equation compiled
+bool Equation::isValid() const {
+    return m_error.empty();
+}
+
+// Returns the parser error if the equation did not compile
+std::string Equation::getError() const {
+    return m_error;
+}
+
+// Returns the equation string
+std::string Equation::getEquation() const {
+    return m_equation;
+}
+
+// Evaluates the equation with the variables set in declaration order (unused ones are ignored)
+float Equation::value(float a, float b, float c) {
+    std::vector<float>& values = m_state->values;
+    if (values.size() > 0) values[0] = a;
+    if (values.size() > 1) values[1] = b;
+    if (values.size() > 2) values[2] = c;
+    return m_state->expression.value();
+}
+
+// Returns variable index (in declaration order) as the last evaluation left it
+float Equation::getVariable(unsigned int index) const {
+    return m_state->values[index];
+}
+
+// Returns the calling thread's compiled copy of an equation, compiling it on first use. The
+// copy is kept for later calls (up to EQUATIONS_PER_THREAD different equations per thread).
+Equation& Equation::forThread(const std::string& equation, const std::vector<std::string>& variables) {
+    thread_local std::unordered_map<std::string, std::unique_ptr<Equation>> equations;
+    std::string key = equation;
+    for (const std::string& variable : variables) {
+        key += '\0' + variable;
+    }
+    auto found = equations.find(key);
+    if (found != equations.end()) {
+        return *found->second;
+    }
+    if (equations.size() >= EQUATIONS_PER_THREAD) {
+        equations.clear();
+    }
+    std::unique_ptr<Equation>& slot = equations[key];
+    slot.reset(new Equation(equation, variables));
+    return *slot;
+}
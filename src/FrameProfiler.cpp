@@ -0,0 +1,238 @@
+/** @file FrameProfiler.cpp
+ *  @brief Class implementation for CPU stage timers and GPU timer queries.
+ *
+ *  @author Antoine Assaf
+ */
+#include "FrameProfiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+// Queries in flight. A result is read QUERY_COUNT frames after it was issued, by which time the
+// GPU has normally finished the frame.
+const unsigned int QUERY_COUNT = 4;
+// Frames in the rolling window used for percentiles
+const size_t HISTORY_SIZE = 240;
+// Time between two summaries
+const std::chrono::milliseconds REPORT_INTERVAL(500);
+
+// Returns the given percentile (0 to 1) of values, reordering them
+static double Percentile(std::vector<double>& values, double percentile){
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = (size_t)(percentile*(values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Returns the total CPU time of a frame
+static double CPUMilliseconds(const FrameRecord& record){
+    double total = 0.0;
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        total += record.stageMilliseconds[i];
+    }
+    return total;
+}
+
+// Constructor
+FrameProfiler::FrameProfiler()
+    : m_enabled(false), m_frameNumber(0), m_current(), m_historyNext(0) {
+}
+
+// Turns profiling on. Needs a current OpenGL context. Frames are also written to csvPath
+// when it is not empty. Returns false if the file can not be opened.
+bool FrameProfiler::Enable(const std::string& csvPath){
+    if (!csvPath.empty()) {
+        m_csv.open(csvPath);
+        if (!m_csv.is_open()) {
+            std::cout << "Could not open " << csvPath << " for writing" << std::endl;
+            return false;
+        }
+        m_csv << "frame,input_ms,predraw_ms,draw_ms,swap_ms,cpu_ms,gpu_ms,triangles,vertices" << std::endl;
+    }
+
+    m_queries.resize(QUERY_COUNT);
+    glGenQueries(QUERY_COUNT, m_queries.data());
+    m_pending.resize(QUERY_COUNT);
+    m_pendingValid.assign(QUERY_COUNT, false);
+    m_history.reserve(HISTORY_SIZE);
+    m_enabledAt = std::chrono::steady_clock::now();
+    m_lastReport = m_enabledAt;
+    m_enabled = true;
+    return true;
+}
+
+// Returns true if profiling is on
+bool FrameProfiler::IsEnabled() const{
+    return m_enabled;
+}
+
+// Starts the CPU timer of a stage
+void FrameProfiler::BeginStage(ProfileStage stage){
+    if (!m_enabled) {
+        return;
+    }
+    m_stageStart[stage] = std::chrono::steady_clock::now();
+}
+
+// Stops the CPU timer of a stage
+void FrameProfiler::EndStage(ProfileStage stage){
+    if (!m_enabled) {
+        return;
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_stageStart[stage];
+    m_current.stageMilliseconds[stage] += elapsed.count();
+}
+
+// Starts the GPU timer of a frame, before its first OpenGL call
+void FrameProfiler::BeginFrame(){
+    if (!m_enabled) {
+        return;
+    }
+    // The slot was last used QUERY_COUNT frames ago. Wait for it only if the GPU is that far behind.
+    unsigned int slot = m_frameNumber % QUERY_COUNT;
+    if (m_pendingValid[slot]) {
+        resolveSlot(slot, true);
+    }
+    // Older frames that completed early are finished now so the window stays current
+    for (unsigned int i = 1; i < QUERY_COUNT; i++) {
+        unsigned int older = (slot + i) % QUERY_COUNT;
+        if (m_pendingValid[older] && !resolveSlot(older, false)) {
+            break;
+        }
+    }
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[slot]);
+}
+
+// Stops the GPU timer, after the last draw call and before the swap
+void FrameProfiler::EndGPU(){
+    if (!m_enabled) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+// Counts the geometry of a glDrawElements(GL_TRIANGLES, ...) call
+void FrameProfiler::CountDraw(GLsizei indexCount){
+    m_current.triangles += indexCount/3;
+    m_current.vertices += indexCount;
+}
+
+// Closes the frame after the swap
+void FrameProfiler::EndFrame(){
+    if (!m_enabled) {
+        return;
+    }
+    unsigned int slot = m_frameNumber % QUERY_COUNT;
+    m_current.frame = m_frameNumber;
+    m_current.gpuMilliseconds = -1.0;
+    m_pending[slot] = m_current;
+    m_pendingValid[slot] = true;
+
+    m_current = FrameRecord();
+    m_frameNumber++;
+}
+
+// Returns true about twice a second, when the summary is worth showing again
+bool FrameProfiler::ReportDue(){
+    if (!m_enabled || m_history.empty()) {
+        return false;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastReport < REPORT_INTERVAL) {
+        return false;
+    }
+    m_lastReport = now;
+    return true;
+}
+
+// Returns p50/p95/p99 of CPU and GPU frame times and the last frame's triangle count
+std::string FrameProfiler::Summary() const{
+    if (m_history.empty()) {
+        return "no frames profiled";
+    }
+    std::vector<double> cpu;
+    std::vector<double> gpu;
+    for (size_t i = 0; i < m_history.size(); i++) {
+        cpu.push_back(CPUMilliseconds(m_history[i]));
+        if (m_history[i].gpuMilliseconds >= 0.0) {
+            gpu.push_back(m_history[i].gpuMilliseconds);
+        }
+    }
+    const FrameRecord& last = m_history[(m_historyNext + m_history.size() - 1) % m_history.size()];
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(2)
+            << "cpu " << Percentile(cpu, 0.5) << "/" << Percentile(cpu, 0.95) << "/" << Percentile(cpu, 0.99) << " ms"
+            << "  gpu ";
+    if (gpu.empty()) {
+        summary << "n/a";
+    } else {
+        summary << Percentile(gpu, 0.5) << "/" << Percentile(gpu, 0.95) << "/" << Percentile(gpu, 0.99) << " ms";
+    }
+    summary << " (p50/p95/p99 of " << m_history.size() << " frames)  "
+            << last.triangles << " triangles, " << last.vertices << " vertices";
+    return summary.str();
+}
+
+// Waits for the outstanding queries, writes their frames and deletes the queries.
+// Call before the context is destroyed.
+void FrameProfiler::Finish(){
+    if (!m_enabled) {
+        return;
+    }
+    for (unsigned int i = 0; i < QUERY_COUNT; i++) {
+        unsigned int slot = (m_frameNumber + i) % QUERY_COUNT;
+        if (m_pendingValid[slot]) {
+            resolveSlot(slot, true);
+        }
+    }
+    glDeleteQueries(QUERY_COUNT, m_queries.data());
+    m_queries.clear();
+    m_csv.close();
+    m_enabled = false;
+}
+
+// Reads the query of a ring slot and finishes its frame. Returns false if the result is
+// not available yet and wait is false.
+bool FrameProfiler::resolveSlot(unsigned int slot, bool wait){
+    if (!wait) {
+        GLint available = 0;
+        glGetQueryObjectiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+    }
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(m_queries[slot], GL_QUERY_RESULT, &nanoseconds);
+    // Some drivers return garbage for the very first query. A frame can not have taken longer
+    // than profiling has been running, so such results are dropped.
+    std::chrono::duration<double, std::milli> running = std::chrono::steady_clock::now() - m_enabledAt;
+    double milliseconds = nanoseconds/1e6;
+    m_pending[slot].gpuMilliseconds = milliseconds <= running.count() ? milliseconds : -1.0;
+    m_pendingValid[slot] = false;
+    finishFrame(m_pending[slot]);
+    return true;
+}
+
+// Adds a finished frame to the rolling window and the CSV file
+void FrameProfiler::finishFrame(const FrameRecord& record){
+    if (m_history.size() < HISTORY_SIZE) {
+        m_history.push_back(record);
+    } else {
+        m_history[m_historyNext] = record;
+    }
+    m_historyNext = (m_historyNext + 1) % HISTORY_SIZE;
+
+    if (m_csv.is_open()) {
+        m_csv << record.frame;
+        for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+            m_csv << "," << record.stageMilliseconds[i];
+        }
+        m_csv << "," << CPUMilliseconds(record) << "," << record.gpuMilliseconds
+              << "," << record.triangles << "," << record.vertices << "\n";
+    }
+}
@@ -0,0 +1,344 @@
+/** @file GLSLExpression.cpp
+ * @brief Recursive descent translation of equations into GLSL.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "GLSLExpression.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Token kinds
+enum TokenType { TOKEN_NUMBER, TOKEN_NAME, TOKEN_OPERATOR, TOKEN_END };
+
+struct Token {
+    TokenType type;
+    std::string text; // names are lower case, exprtk ignores case
+    size_t offset; // where the token starts in the equation
+};
+
+// Splits an equation into tokens. Returns false and sets error on a character that can not start one.
+static bool tokenize(const std::string& equation, std::vector<Token>& tokens, std::string& error) {
+    size_t p = 0;
+    while (p < equation.size()) {
+        char c = equation[p];
+        if (std::isspace((unsigned char)c)) {
+            p++;
+            continue;
+        }
+        size_t start = p;
+        if (std::isdigit((unsigned char)c) || c == '.') {
+            char* end = nullptr;
+            std::strtod(equation.c_str() + p, &end);
+            p = end - equation.c_str();
+            if (p == start) {
+                error = "malformed number at offset " + std::to_string(start);
+                return false;
+            }
+            tokens.push_back(Token{TOKEN_NUMBER, equation.substr(start, p - start), start});
+        } else if (std::isalpha((unsigned char)c) || c == '_') {
+            while (p < equation.size() && (std::isalnum((unsigned char)equation[p]) || equation[p] == '_')) {
+                p++;
+            }
+            std::string name = equation.substr(start, p - start);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char l) { return (char)std::tolower(l); });
+            tokens.push_back(Token{TOKEN_NAME, name, start});
+        } else {
+            // Two character operators first
+            std::string two = equation.substr(p, 2);
+            if (two == "<=" || two == ">=" || two == "==" || two == "!=" || two == "<>") {
+                tokens.push_back(Token{TOKEN_OPERATOR, two, start});
+                p += 2;
+                continue;
+            }
+            if (std::string("+-*/%^(),<>=").find(c) == std::string::npos) {
+                error = std::string("unsupported character '") + c + "' at offset " + std::to_string(start);
+                return false;
+            }
+            tokens.push_back(Token{TOKEN_OPERATOR, std::string(1, c), start});
+            p++;
+        }
+    }
+    tokens.push_back(Token{TOKEN_END, "", equation.size()});
+    return true;
+}
+
+// Returns a number as a GLSL float literal
+static std::string floatLiteral(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", value);
+    std::string literal = text;
+    if (literal.find_first_of(".e") == std::string::npos) {
+        literal += ".0";
+    }
+    return literal;
+}
+
+// Recursive descent over the tokens, producing fully parenthesized GLSL
+class GLSLTranslator {
+public:
+    GLSLTranslator(const std::vector<Token>& tokens) : m_tokens(tokens), m_next(0) {
+    }
+
+    // Translates the whole equation. Returns false and sets error if it can not.
+    bool translate(std::string& glsl, std::string& error) {
+        if (!comparison(glsl)) {
+            error = m_error;
+            return false;
+        }
+        if (peek().type != TOKEN_END) {
+            error = "unexpected '" + peek().text + "' at offset " + std::to_string(peek().offset);
+            return false;
+        }
+        return true;
+    }
+private:
+    const Token& peek() const {
+        return m_tokens[m_next];
+    }
+
+    // Consumes the next token if it is the operator op
+    bool accept(const std::string& op) {
+        if (peek().type == TOKEN_OPERATOR && peek().text == op) {
+            m_next++;
+            return true;
+        }
+        return false;
+    }
+
+    bool fail(const std::string& message) {
+        if (m_error.empty()) {
+            m_error = message;
+        }
+        return false;
+    }
+
+    // comparison := additive (("<" | "<=" | ">" | ">=" | "=" | "==" | "!=" | "<>") additive)*
+    bool comparison(std::string& out) {
+        if (!additive(out)) {
+            return false;
+        }
+        while (peek().type == TOKEN_OPERATOR) {
+            std::string op = peek().text;
+            if (op == "=") {
+                op = "==";
+            } else if (op == "<>") {
+                op = "!=";
+            }
+            if (op != "<" && op != "<=" && op != ">" && op != ">=" && op != "==" && op != "!=") {
+                break;
+            }
+            m_next++;
+            std::string right;
+            if (!additive(right)) {
+                return false;
+            }
+            out = "float(" + out + " " + op + " " + right + ")";
+        }
+        return true;
+    }
+
+    // additive := term (("+" | "-") term)*
+    bool additive(std::string& out) {
+        if (!term(out)) {
+            return false;
+        }
+        while (peek().type == TOKEN_OPERATOR && (peek().text == "+" || peek().text == "-")) {
+            std::string op = peek().text;
+            m_next++;
+            std::string right;
+            if (!term(right)) {
+                return false;
+            }
+            out = "(" + out + " " + op + " " + right + ")";
+        }
+        return true;
+    }
+
+    // term := unary (("*" | "/" | "%") unary | unary)*, where two terms side by side multiply
+    bool term(std::string& out) {
+        if (!unary(out)) {
+            return false;
+        }
+        while (true) {
+            std::string op;
+            if (accept("*")) {
+                op = "*";
+            } else if (accept("/")) {
+                op = "/";
+            } else if (accept("%")) {
+                op = "%";
+            } else if (peek().type == TOKEN_NUMBER || peek().type == TOKEN_NAME ||
+                       (peek().type == TOKEN_OPERATOR && peek().text == "(")) {
+                op = "*"; // implicit, e.g. "2x" or "(x+1)(x-1)"
+            } else {
+                return true;
+            }
+            std::string right;
+            if (!unary(right)) {
+                return false;
+            }
+            if (op == "%") {
+                out = "f_mod(" + out + ", " + right + ")";
+            } else {
+                out = "(" + out + " " + op + " " + right + ")";
+            }
+        }
+    }
+
+    // unary := ("-" | "+") unary | power
+    bool unary(std::string& out) {
+        if (accept("-")) {
+            if (!unary(out)) {
+                return false;
+            }
+            out = "(-" + out + ")";
+            return true;
+        }
+        if (accept("+")) {
+            return unary(out);
+        }
+        return power(out);
+    }
+
+    // power := primary ("^" unary)?, so 2^3^2 is 2^9 and -x^2 is -(x^2)
+    bool power(std::string& out) {
+        if (!primary(out)) {
+            return false;
+        }
+        if (accept("^")) {
+            std::string exponent;
+            if (!unary(exponent)) {
+                return false;
+            }
+            out = "f_pow(" + out + ", " + exponent + ")";
+        }
+        return true;
+    }
+
+    // primary := number | variable | constant | function "(" arguments ")" | "(" comparison ")"
+    bool primary(std::string& out) {
+        Token token = peek();
+        if (token.type == TOKEN_NUMBER) {
+            m_next++;
+            out = floatLiteral(std::strtod(token.text.c_str(), nullptr));
+            return true;
+        }
+        if (token.type == TOKEN_OPERATOR && token.text == "(") {
+            m_next++;
+            if (!comparison(out)) {
+                return false;
+            }
+            if (!accept(")")) {
+                return fail("missing ')' at offset " + std::to_string(peek().offset));
+            }
+            out = "(" + out + ")";
+            return true;
+        }
+        if (token.type != TOKEN_NAME) {
+            return fail("unexpected '" + token.text + "' at offset " + std::to_string(token.offset));
+        }
+        m_next++;
+        if (token.text == "x" || token.text == "y") {
+            out = token.text;
+            return true;
+        }
+        if (token.text == "pi") {
+            out = floatLiteral(3.14159265358979323846);
+            return true;
+        }
+        if (token.text == "e") {
+            out = floatLiteral(2.71828182845904523536);
+            return true;
+        }
+        if (!accept("(")) {
+            return fail("unknown variable '" + token.text + "'");
+        }
+        std::vector<std::string> arguments;
+        if (!accept(")")) {
+            do {
+                std::string argument;
+                if (!comparison(argument)) {
+                    return false;
+                }
+                arguments.push_back(argument);
+            } while (accept(","));
+            if (!accept(")")) {
+                return fail("missing ')' after the arguments of " + token.text);
+            }
+        }
+        return call(token.text, arguments, out);
+    }
+
+    // Writes the GLSL for an exprtk function call
+    bool call(const std::string& name, const std::vector<std::string>& a, std::string& out) {
+        // Same name and meaning in GLSL
+        static const char* builtins[] = {"sin", "cos", "tan", "atan", "sinh", "cosh", "tanh", "exp",
+                                         "floor", "ceil", "abs", "trunc"};
+        // Need a helper so undefined results are NaN like on the CPU (or rounding matches)
+        static const char* helpers[] = {"sqrt", "log", "log2", "log10", "asin", "acos", "round"};
+        size_t n = a.size();
+        for (const char* builtin : builtins) {
+            if (name == builtin && n == 1) {
+                out = name + "(" + a[0] + ")";
+                return true;
+            }
+        }
+        for (const char* helper : helpers) {
+            if (name == helper && n == 1) {
+                out = "f_" + name + "(" + a[0] + ")";
+                return true;
+            }
+        }
+        if (name == "sgn" && n == 1) {
+            out = "sign(" + a[0] + ")";
+        } else if (name == "frac" && n == 1) {
+            out = "fract(" + a[0] + ")";
+        } else if (name == "atan2" && n == 2) {
+            out = "atan(" + a[0] + ", " + a[1] + ")";
+        } else if (name == "pow" && n == 2) {
+            out = "f_pow(" + a[0] + ", " + a[1] + ")";
+        } else if (name == "mod" && n == 2) {
+            out = "f_mod(" + a[0] + ", " + a[1] + ")";
+        } else if (name == "hypot" && n == 2) {
+            out = "length(vec2(" + a[0] + ", " + a[1] + "))";
+        } else if (name == "clamp" && n == 3) {
+            // exprtk takes the bounds around the value
+            out = "clamp(" + a[1] + ", " + a[0] + ", " + a[2] + ")";
+        } else if ((name == "min" || name == "max") && n >= 2) {
+            out = a[0];
+            for (size_t i = 1; i < n; i++) {
+                out = name + "(" + out + ", " + a[i] + ")";
+            }
+        } else if ((name == "sum" || name == "avg") && n >= 1) {
+            out = a[0];
+            for (size_t i = 1; i < n; i++) {
+                out = "(" + out + " + " + a[i] + ")";
+            }
+            if (name == "avg") {
+                out = "(" + out + " / " + floatLiteral((double)n) + ")";
+            }
+        } else {
+            return fail("no GLSL translation for " + name + " with " + std::to_string(n) + " arguments");
+        }
+        return true;
+    }
+
+    const std::vector<Token>& m_tokens;
+    size_t m_next; // next token to read
+    std::string m_error; // first error found
+};
+
+// Translates equation into a GLSL float expression in x and y
+bool EquationToGLSL(const std::string& equation, std::string& glsl, std::string& error) {
+    std::vector<Token> tokens;
+    if (!tokenize(equation, tokens, error)) {
+        return false;
+    }
+    GLSLTranslator translator(tokens);
+    return translator.translate(glsl, error);
+}
@@ -0,0 +1,149 @@
+/** @file GLState.cpp
+ *  @brief Class implementation for skipping redundant OpenGL state changes.
+ *
+ *  @author Antoine Assaf
+ */
+#include "GLState.hpp"
+
+// Constructor
+GLState::GLState(){
+	Reset();
+}
+
+// Forgets all cached state so the next calls are issued again
+void GLState::Reset(){
+	m_capabilities.clear();
+	m_textures.clear();
+	m_uniformBuffers.clear();
+	m_blendFactors[0] = m_blendFactors[1] = m_blendFactors[2] = m_blendFactors[3] = GL_NONE;
+	m_depthMask = -1;
+	m_viewport[0] = m_viewport[1] = m_viewport[2] = m_viewport[3] = -1;
+	m_clearColor[0] = m_clearColor[1] = m_clearColor[2] = m_clearColor[3] = -1.0f;
+	m_polygonMode = GL_NONE;
+	// ~0 is never a valid name, so the first bind always goes through
+	m_program = ~0u;
+	m_vertexArray = ~0u;
+	m_activeTexture = ~0u;
+}
+
+// glEnable/glDisable of a capability
+void GLState::SetEnabled(GLenum capability, bool enabled){
+	auto current = m_capabilities.find(capability);
+	if(current != m_capabilities.end() && current->second == enabled){
+		return;
+	}
+	if(enabled){
+		glEnable(capability);
+	}else{
+		glDisable(capability);
+	}
+	m_capabilities[capability] = enabled;
+}
+
+// glBlendFunc
+void GLState::BlendFunc(GLenum source, GLenum destination){
+	if(m_blendFactors[0] == source && m_blendFactors[1] == destination &&
+	   m_blendFactors[2] == source && m_blendFactors[3] == destination){
+		return;
+	}
+	glBlendFunc(source, destination);
+	m_blendFactors[0] = m_blendFactors[2] = source;
+	m_blendFactors[1] = m_blendFactors[3] = destination;
+}
+
+// glBlendFuncSeparate, with other factors for alpha than for color
+void GLState::BlendFuncSeparate(GLenum sourceColor, GLenum destinationColor, GLenum sourceAlpha, GLenum destinationAlpha){
+	if(m_blendFactors[0] == sourceColor && m_blendFactors[1] == destinationColor &&
+	   m_blendFactors[2] == sourceAlpha && m_blendFactors[3] == destinationAlpha){
+		return;
+	}
+	glBlendFuncSeparate(sourceColor, destinationColor, sourceAlpha, destinationAlpha);
+	m_blendFactors[0] = sourceColor;
+	m_blendFactors[1] = destinationColor;
+	m_blendFactors[2] = sourceAlpha;
+	m_blendFactors[3] = destinationAlpha;
+}
+
+// glDepthMask
+void GLState::DepthMask(bool write){
+	if(m_depthMask == (write ? 1 : 0)){
+		return;
+	}
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	m_depthMask = write ? 1 : 0;
+}
+
+// glViewport
+void GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height){
+	if(m_viewport[0] == x && m_viewport[1] == y && m_viewport[2] == width && m_viewport[3] == height){
+		return;
+	}
+	glViewport(x, y, width, height);
+	m_viewport[0] = x;
+	m_viewport[1] = y;
+	m_viewport[2] = width;
+	m_viewport[3] = height;
+}
+
+// glClearColor
+void GLState::ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a){
+	if(m_clearColor[0] == r && m_clearColor[1] == g && m_clearColor[2] == b && m_clearColor[3] == a){
+		return;
+	}
+	glClearColor(r, g, b, a);
+	m_clearColor[0] = r;
+	m_clearColor[1] = g;
+	m_clearColor[2] = b;
+	m_clearColor[3] = a;
+}
+
+// glPolygonMode for front and back faces
+void GLState::PolygonMode(GLenum mode){
+	if(m_polygonMode == mode){
+		return;
+	}
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+	m_polygonMode = mode;
+}
+
+// glUseProgram
+void GLState::UseProgram(GLuint program){
+	if(m_program == program){
+		return;
+	}
+	glUseProgram(program);
+	m_program = program;
+}
+
+// glBindVertexArray
+void GLState::BindVertexArray(GLuint vertexArray){
+	if(m_vertexArray == vertexArray){
+		return;
+	}
+	glBindVertexArray(vertexArray);
+	m_vertexArray = vertexArray;
+}
+
+// glActiveTexture and glBindTexture of a 2D texture
+void GLState::BindTexture(unsigned int slot, GLuint texture){
+	auto current = m_textures.find(slot);
+	if(current != m_textures.end() && current->second == texture){
+		return;
+	}
+	if(m_activeTexture != slot){
+		glActiveTexture(GL_TEXTURE0 + slot);
+		m_activeTexture = slot;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	m_textures[slot] = texture;
+}
+
+// glBindBufferBase of a uniform buffer binding point
+void GLState::BindUniformBuffer(GLuint bindingPoint, GLuint buffer){
+	auto current = m_uniformBuffers.find(bindingPoint);
+	if(current != m_uniformBuffers.end() && current->second == buffer){
+		return;
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+	m_uniformBuffers[bindingPoint] = buffer;
+}
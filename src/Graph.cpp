@@ -5,12 +5,14 @@
  */
 
 #include "Graph.hpp"
-#include "exprtk.hpp"
+#include "Equation.hpp"
 
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cmath>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -19,115 +21,180 @@
 float z_bound = 50.0f;
 
 // Constructor loads a graph from an equation in form f(x,y), where z = f(x,y), and with a given dimension
-Graph::Graph(std::string equation, unsigned int dimension, unsigned int id) {
+Graph::Graph(std::string equation, unsigned int dimension, unsigned int id, float domainMin, float domainMax,
+             bool writeHeightMap) {
   
     m_equation = equation;
     m_dimension = dimension;
+    m_domainMin = domainMin;
+    m_domainMax = domainMax;
+    m_heightTexture = nullptr;
+    m_heightMapWritten = false;
+    m_heightMapPath = "./generated/graph" + std::to_string(id) + ".ppm";
     
-    typedef exprtk::symbol_table<float> symbol_table_t;
-    typedef exprtk::expression<float> expression_t;
-    typedef exprtk::parser<float> parser_t;
+    Equation expression(equation);
 
-    //initiate variables x & y
-    float x;
-    float y;
-
-    symbol_table_t symbol_table;
-    symbol_table.add_variable("x", x);
-    symbol_table.add_variable("y", y);
-
-    symbol_table.add_constant("e", 2.71828);
-    symbol_table.add_constant("pi", 3.14159);
-    symbol_table.add_constants();
+    // Map f(x,y) = [-5, 5] --> [0, 1]. Any point not in domain will be mapped to -1.
+    m_heightData = new float[dimension*dimension];
+    sampleHeights(expression, dimension, m_heightData, nullptr, domainMin, domainMax);
     
-    expression_t expression;
-    expression.register_symbol_table(symbol_table);
+    build(writeHeightMap);
+}
 
-    parser_t parser;
-    parser.compile(equation, expression);
+// Constructor builds a graph from dimension*dimension normalized heights that were already sampled
+Graph::Graph(std::string equation, unsigned int dimension, unsigned int id, std::vector<float> heights,
+             float domainMin, float domainMax, bool writeHeightMap) {
+
+    m_equation = equation;
+    m_dimension = dimension;
+    m_domainMin = domainMin;
+    m_domainMax = domainMax;
+    m_heightTexture = nullptr;
+    m_heightMapWritten = false;
+    m_heightMapPath = "./generated/graph" + std::to_string(id) + ".ppm";
 
-    // Map f(x,y) = [-5, 5] --> [0, 1]. Any point not in domain will be mapped to -1.
     m_heightData = new float[dimension*dimension];
+    std::copy(heights.begin(), heights.begin() + (size_t)dimension*dimension, m_heightData);
+
+    build(writeHeightMap);
+}
+
+// Builds the vertices and indices from m_heightData, writing the height map first if asked
+void Graph::build(bool writeHeightMap) {
+    if (writeHeightMap) {
+        Graph::writeHeightMap();
+    }
     
-    std::vector<float> positions;
-    std::vector<float> colors;
-
-    int index = -1;
-    float last_height = 0.5f;
-    for (y = -5.0; y <= 5.001; y += 10.0/(dimension-1.0)) {
-        for (x = -5.0; x <= 5.001; x += 10.0/(dimension-1.0)) {
-            index++;
-
-            float z = expression.value();
-            float alpha = 1.0f;
-
-            float height = -1.0f;
-
-            try {
-                if (std::isnan(z)) {
-                    height = -1.0f;
-                } else if (z < -z_bound) {
-                    height = -1.0f;
-                    last_height = height;
-                } else if (z > z_bound) {
-                    height = -1.0f;
-                    last_height = last_height;
-                }
-                else {
-                    height = (z + z_bound)/(z_bound*2);
-                    last_height = height;
-                }
-            }
-            catch (...) {
-                height = 0.5f;
-                alpha = 0.0f;
-            }
-            m_heightData[index] = height;
-            positions.push_back(x);
-            positions.push_back(glm::clamp(height * (z_bound*2) - z_bound, -z_bound, z_bound));
-            positions.push_back(y);
+    m_VBO.resize((size_t)m_dimension*m_dimension*12);
+    buildVertices(m_heightData, m_dimension, m_domainMin, m_domainMax, 0, m_dimension, m_VBO.data());
+    Graph::updateBuffers();
+}
+
+// Maps a value of f(x,y) to a normalized height in [0, 1], or -1 if it is undefined or out of bounds
+float Graph::toHeight(float z) {
+    if (std::isnan(z) || z < -z_bound || z > z_bound) {
+        return -1.0f;
+    }
+    return (z + z_bound)/(z_bound*2);
+}
+
+// Maps a normalized height back to the value of f(x,y), or NaN if it is undefined or out of bounds
+float Graph::fromHeight(float height) {
+    if (height < 0.0f) {
+        return NAN;
+    }
+    return height*(z_bound*2) - z_bound;
+}
+
+// Returns the default color of graph id: blue, green and red for the first three, then
+// hues spread by the golden angle
+glm::vec3 Graph::paletteColor(unsigned int id) {
+    if (id == 1) {
+        return glm::vec3(0.0f, 0.0f, 1.0f);
+    } else if (id == 2) {
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+    } else if (id == 3) {
+        return glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+    float hue = std::fmod(id*137.508f, 360.0f)/60.0f;
+    float x = 1.0f - std::fabs(std::fmod(hue, 2.0f) - 1.0f);
+    switch ((int)hue) {
+        case 0: return glm::vec3(1.0f, x, 0.0f);
+        case 1: return glm::vec3(x, 1.0f, 0.0f);
+        case 2: return glm::vec3(0.0f, 1.0f, x);
+        case 3: return glm::vec3(0.0f, x, 1.0f);
+        case 4: return glm::vec3(x, 0.0f, 1.0f);
+        default: return glm::vec3(1.0f, 0.0f, x);
+    }
+}
 
+// Multiplies the r g b of vertexCount 12 float vertices by color
+void Graph::tintVertices(float* vertices, size_t vertexCount, glm::vec3 color) {
+    for (size_t i = 0; i < vertexCount; i++) {
+        vertices[i*12 + 6] *= color.r;
+        vertices[i*12 + 7] *= color.g;
+        vertices[i*12 + 8] *= color.b;
+    }
+}
 
-            float yellowTint = height*8 - 3.8f;
+// Returns the x (or y) coordinate of sample i on a grid of the given dimension spanning [-5, 5]
+float Graph::sampleCoordinate(unsigned int i, unsigned int dimension) {
+    return -5.0f + 10.0f*i/(dimension - 1.0f);
+}
 
-            if (yellowTint > 1.0f) {
-                yellowTint = 1.0f;
-            } else if (yellowTint < 0.0f) {
-                yellowTint = 0.0f;
+// Evaluates f on a dimension*dimension grid over [domainMin, domainMax]^2, row by row (y then x),
+// storing normalized heights (see toHeight). Fills stats if it is not nullptr.
+void Graph::sampleHeights(Equation& expression, unsigned int dimension, float* heights, HeightStats* stats,
+                          float domainMin, float domainMax) {
+    HeightStats summary = {NAN, NAN, 0, 0, dimension*dimension};
+    float span = domainMax - domainMin;
+    unsigned int index = 0;
+    for (unsigned int row = 0; row < dimension; row++) {
+        float y = domainMin + span*row/(dimension - 1.0f);
+        for (unsigned int column = 0; column < dimension; column++) {
+            float x = domainMin + span*column/(dimension - 1.0f);
+            float z = expression.value(x, y);
+            heights[index++] = toHeight(z);
+
+            if (std::isnan(z)) {
+                summary.undefinedCount++;
+                continue;
+            }
+            if (z < -z_bound || z > z_bound) {
+                summary.outOfBoundsCount++;
             }
-           
-            if (id == 1) {
-                colors.push_back(0.0f);
-                colors.push_back(0.0f);
-                colors.push_back(1.0f - yellowTint);
-            } else if (id == 2) {
-                colors.push_back(0.0f);
-                colors.push_back(1.0f - yellowTint);
-                colors.push_back(0.0f);
-            } else {
-                colors.push_back(1.0f - yellowTint);
-                colors.push_back(0.0f);
-                colors.push_back(0.0f);
+            if (std::isfinite(z)) {
+                summary.min = std::isnan(summary.min) ? z : std::min(summary.min, z);
+                summary.max = std::isnan(summary.max) ? z : std::max(summary.max, z);
+            }
+        }
+    }
+    if (stats != nullptr) {
+        *stats = summary;
+    }
+}
+
+// Fills a dimension*dimension grid of normalized heights from the grid with half the spacing
+void Graph::refineHeights(Equation& expression, const float* coarseHeights, unsigned int dimension, float* heights,
+                          float domainMin, float domainMax) {
+    unsigned int coarseDimension = (dimension + 1)/2;
+    float span = domainMax - domainMin;
+    for (unsigned int row = 0; row < dimension; row++) {
+        float y = domainMin + span*row/(dimension - 1.0f);
+        for (unsigned int column = 0; column < dimension; column++) {
+            if (row % 2 == 0 && column % 2 == 0) {
+                // Every other sample of every other row is on the coarse grid
+                heights[row*dimension + column] = coarseHeights[(row/2)*coarseDimension + column/2];
+                continue;
             }
-            colors.push_back(glm::clamp(alpha - 0.1f, 0.0f, 1.0f));
+            float x = domainMin + span*column/(dimension - 1.0f);
+            heights[row*dimension + column] = toHeight(expression.value(x, y));
         }
     }
+}
 
-    m_positions = positions;
-    m_colors = colors;
+//Destructor clears any allocated memory
+Graph::~Graph() {
+    if(m_heightData!=nullptr){
+        delete[] m_heightData;
+    }
+    if (m_heightTexture != nullptr) {
+        delete m_heightTexture;
+    }
+}
 
+// Writes the height map to m_heightMapPath as a .ppm
+void Graph::writeHeightMap() {
     std::ofstream outFile;
 
-    std::string filePath = "./generated/graph" + std::to_string(id) + ".ppm";
-
-    outFile.open(filePath);
+    outFile.open(m_heightMapPath);
 
     outFile << "P3" << std::endl;
-    outFile << "# Generated .ppm file from equation z = " << equation << std::endl;
+    outFile << "# Generated .ppm file from equation z = " << m_equation << std::endl;
     outFile << m_dimension << " " << m_dimension << std::endl;
     outFile << 255 << std::endl;
 
-    for (int i = 0; i < dimension*dimension; i++) {
+    for (int i = 0; i < m_dimension*m_dimension; i++) {
         float pixel = m_heightData[i];
 
         pixel = std::clamp(pixel, 0.0f, 10.0f);
@@ -138,160 +205,181 @@ Graph::Graph(std::string equation, unsigned int dimension, unsigned int id) {
     }
 
     outFile.close();
-
-    m_heightTexture = new Texture();
-    m_heightTexture->LoadTexture(filePath);
-    
-    Graph::calculateNormals();
-    Graph::updateBuffers();        
+    m_heightMapWritten = true;
 }
 
-//Destructor clears any allocated memory
-Graph::~Graph() {
-    if(m_heightData!=nullptr){
-        delete[] m_heightData;
-    }
-    if (m_heightTexture != nullptr) {
-        delete m_heightTexture;
+// Returns the height map texture of the graph, uploading it on first use
+const Texture& Graph::getTexture() {
+    if (m_heightTexture == nullptr) {
+        if (!m_heightMapWritten) {
+            writeHeightMap();
+        }
+        m_heightTexture = new Texture();
+        m_heightTexture->LoadTexture(m_heightMapPath);
     }
-}
-
-// Returns the texture of the graph
-Texture Graph::getTexture() const {
     return *m_heightTexture;
 }
 
 // Returns the vector buffer object of points in x,y,z triplets
-std::vector<float> Graph::getVBO() const {
+const std::vector<float>& Graph::getVBO() const {
     return m_VBO;
 }
 
 // Returns the index buffer object of the points
-std::vector<unsigned int> Graph::getIBO() const {
+const std::vector<unsigned int>& Graph::getIBO() const {
     return m_IBO;
 }
 
+// Returns the dimension*dimension normalized heights, row by row
+const float* Graph::getHeights() const {
+    return m_heightData;
+}
 
-//Sets up the values for m_VBO and m_IBO for the Graph
-void Graph::updateBuffers() {
-    std::vector<float> VBO;
-    std::vector<unsigned int> IBO;
-
-    for (int i = 0; i < m_positions.size()/3; i++) {
-        float x = m_positions[i*3 + 0];
-        float y = m_positions[i*3 + 1];
-        float z = m_positions[i*3 + 2];
-
-        float xn = m_normals[i*3 + 0];
-        float yn = m_normals[i*3 + 1];
-        float zn = m_normals[i*3 + 2];
-
-        float r = m_colors[i*4 + 0];
-        float g = m_colors[i*4 + 1];
-        float b = m_colors[i*4 + 2];
-        float a = m_colors[i*4 + 3];
-
-
-        VBO.push_back(x);
-        VBO.push_back(y);
-        VBO.push_back(z);
-
-        VBO.push_back(xn);
-        VBO.push_back(yn);
-        VBO.push_back(zn);
-
-        VBO.push_back(r);
-        VBO.push_back(g);
-        VBO.push_back(b);
-        VBO.push_back(a);
+// Returns the tiles of CHUNK_CELLS*CHUNK_CELLS cells that have triangles, in the order of their indices in getIBO
+const std::vector<GraphChunk>& Graph::getChunks() const {
+    return m_chunks;
+}
 
-        VBO.push_back(0);
-        VBO.push_back(0);
 
-    }
+//Sets up the values for m_IBO for the Graph tile by tile, leaving out triangles that touch an undefined height,
+//and the bounding box of every tile in m_chunks
+void Graph::updateBuffers() {
+    std::vector<unsigned int> IBO;
+    m_chunks.clear();
+
+    // Tiles instead of whole rows, so each tile's triangles are one contiguous run of the IBO
+    unsigned int cells = m_dimension - 1;
+    for (unsigned int tileY = 0; tileY < cells; tileY += CHUNK_CELLS) {
+        for (unsigned int tileX = 0; tileX < cells; tileX += CHUNK_CELLS) {
+            unsigned int endY = std::min(tileY + CHUNK_CELLS, cells);
+            unsigned int endX = std::min(tileX + CHUNK_CELLS, cells);
+            GraphChunk chunk;
+            chunk.firstIndex = IBO.size();
+
+            for (unsigned int y = tileY; y < endY; y++) {
+                for (unsigned int x = tileX; x < endX; x++) {
+                    unsigned int curr = x + y * m_dimension;
+
+                    if (m_heightData[curr] >= 0.0f && m_heightData[curr + 1] >= 0.0f && m_heightData[curr + m_dimension] >= 0.0f){
+                        //triangle 1
+                        IBO.push_back(curr);
+                        IBO.push_back(curr + 1);
+                        IBO.push_back(curr + m_dimension);
+                    }
+
+                    if (m_heightData[curr + m_dimension + 1] >= 0.0f && m_heightData[curr + 1] >= 0.0f && m_heightData[curr + m_dimension] >= 0.0f) {
+                        //triangle 2
+                        IBO.push_back(curr + 1);
+                        IBO.push_back(curr + m_dimension + 1);
+                        IBO.push_back(curr + m_dimension);
+                   }
+                }
+            }
 
-    for (int y = 0; y < m_dimension - 1; y++) {
-        for (int x = 0; x < m_dimension - 1; x++) {
-            unsigned int curr = x + y * m_dimension;
-            
-            if (m_heightData[curr] >= 0.0f && m_heightData[curr + 1] >= 0.0f && m_heightData[curr + m_dimension] >= 0.0f){
-                //triangle 1
-                IBO.push_back(curr);
-                IBO.push_back(curr + 1);
-                IBO.push_back(curr + m_dimension);
+            chunk.indexCount = IBO.size() - chunk.firstIndex;
+            if (chunk.indexCount == 0) {
+                continue;
+            }
+            // Every vertex of a triangle has a defined height, so only those can widen the box
+            chunk.min = glm::vec3(INFINITY);
+            chunk.max = glm::vec3(-INFINITY);
+            for (unsigned int y = tileY; y <= endY; y++) {
+                for (unsigned int x = tileX; x <= endX; x++) {
+                    unsigned int curr = x + y * m_dimension;
+                    if (m_heightData[curr] >= 0.0f) {
+                        const float* vertex = m_VBO.data() + (size_t)curr*12;
+                        glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+                        chunk.min = glm::min(chunk.min, position);
+                        chunk.max = glm::max(chunk.max, position);
+                    }
+                }
             }
-            
-            if (m_heightData[curr + m_dimension + 1] >= 0.0f && m_heightData[curr + 1] >= 0.0f && m_heightData[curr + m_dimension] >= 0.0f) {
-                //triangle 2
-                IBO.push_back(curr + 1);
-                IBO.push_back(curr + m_dimension + 1);
-                IBO.push_back(curr + m_dimension);
-           }
+            m_chunks.push_back(chunk);
         }
     }
 
-    m_VBO = VBO;
     m_IBO = IBO;
 }
 
-void Graph::calculateNormals() {
-    std::vector<float> normals;
-    for (int y = 0; y < m_dimension; y++) {
-        for (int x = 0; x < m_dimension; x++) {
-            unsigned int curr = x + y * m_dimension;
-            
-            if (x == 0 || x >= m_dimension - 1 || y == 0 || y >= m_dimension - 1) {
-                normals.push_back(0);
-                normals.push_back(0);
-                normals.push_back(0);
-                continue;
-            }
-
-            // PARTIAL DERIVATIVE - RESPECT TO X
-            float leftPoint = m_heightData[(x - 1) + (y) * m_dimension];
-            float rightPoint = m_heightData[(x + 1) + (y) * m_dimension];
-
-            if (leftPoint < 0 || rightPoint < 0) {
-                normals.push_back(0);
-                normals.push_back(0);
-                normals.push_back(0);
-                continue;    
-            }
-
-
-            leftPoint = (leftPoint * (z_bound * 2)) - z_bound;
-            rightPoint = (rightPoint * (z_bound * 2)) - z_bound;
-
-            float partial_x = (rightPoint-leftPoint)/(2*10.0/(m_dimension-1.0));
-
-            // PARTIAL DERIVATIVE - RESPECT TO Y
-            float downPoint = m_heightData[(x) + (y - 1) * m_dimension];
-            float upPoint = m_heightData[(x) + (y + 1) * m_dimension];
-
-            if (downPoint < 0 || upPoint < 0) {
-                normals.push_back(0);
-                normals.push_back(0);
-                normals.push_back(0);
-                continue;
+// Writes the 12 float vertices (x y z, NORMALIZED normal, shade r g b a, s t) of rows [rowBegin, rowEnd)
+// of a dimension*dimension grid of heights over [domainMin, domainMax]^2. vertices holds the whole grid.
+void Graph::buildVertices(const float* heights, unsigned int dimension, float domainMin, float domainMax,
+                          unsigned int rowBegin, unsigned int rowEnd, float* vertices) {
+    float span = domainMax - domainMin;
+    double spacing = 2*(domainMax - domainMin)/(dimension - 1.0); // between the neighbors of a sample
+    for (unsigned int y = rowBegin; y < rowEnd; y++) {
+        float yCoordinate = domainMin + span*y/(dimension - 1.0f);
+        for (unsigned int x = 0; x < dimension; x++) {
+            unsigned int curr = x + y * dimension;
+            float height = heights[curr];
+            float* vertex = vertices + (size_t)curr*12;
+
+            vertex[0] = domainMin + span*x/(dimension - 1.0f);
+            vertex[1] = glm::clamp(height * (z_bound*2) - z_bound, -z_bound, z_bound);
+            vertex[2] = yCoordinate;
+
+            // Approximated normal from the central differences, zero on the border and next to undefined heights
+            glm::vec3 normal(0.0f);
+            if (x > 0 && x < dimension - 1 && y > 0 && y < dimension - 1) {
+                // PARTIAL DERIVATIVE - RESPECT TO X
+                float leftPoint = heights[(x - 1) + (y) * dimension];
+                float rightPoint = heights[(x + 1) + (y) * dimension];
+                // PARTIAL DERIVATIVE - RESPECT TO Y
+                float downPoint = heights[(x) + (y - 1) * dimension];
+                float upPoint = heights[(x) + (y + 1) * dimension];
+
+                if (leftPoint >= 0 && rightPoint >= 0 && downPoint >= 0 && upPoint >= 0) {
+                    leftPoint = (leftPoint * (z_bound * 2)) - z_bound;
+                    rightPoint = (rightPoint * (z_bound * 2)) - z_bound;
+                    downPoint = (downPoint * (z_bound * 2)) - z_bound;
+                    upPoint = (upPoint * (z_bound * 2)) - z_bound;
+
+                    float partial_x = (rightPoint-leftPoint)/spacing;
+                    float partial_y = (upPoint-downPoint)/spacing;
+
+                    glm::vec3 vector_x(1, partial_x, 0);
+                    glm::vec3 vector_y(0, partial_y, 1);
+
+                    normal = glm::normalize(glm::cross(vector_y,vector_x));
+                }
             }
+            vertex[3] = normal.x;
+            vertex[4] = normal.y;
+            vertex[5] = normal.z;
+
+            // The hue of the graph is applied when drawing (see paletteColor and tintVertices)
+            float yellowTint = glm::clamp(height*8 - 3.8f, 0.0f, 1.0f);
+            vertex[6] = 1.0f - yellowTint;
+            vertex[7] = 1.0f - yellowTint;
+            vertex[8] = 1.0f - yellowTint;
+            vertex[9] = 0.9f;
+
+            vertex[10] = 0;
+            vertex[11] = 0;
+        }
+    }
+}
 
-            downPoint = (downPoint * (z_bound * 2)) - z_bound;
-            upPoint = (upPoint * (z_bound * 2)) - z_bound;
-
-            float partial_y = (upPoint-downPoint)/(2*10.0/(m_dimension-1.0));
-
-            glm::vec3 vector_x(1, partial_x, 0);
-            glm::vec3 vector_y(0, partial_y, 1);
-
-            glm::vec3 normal_vec3 = glm::cross(vector_y,vector_x);
-
-            normal_vec3 = glm::normalize(normal_vec3);
-
-            normals.push_back(normal_vec3.x);
-            normals.push_back(normal_vec3.y);
-            normals.push_back(normal_vec3.z);
-
+// Writes 6 indices for every cell in rows [rowBegin, rowEnd) of a dimension*dimension grid (rowEnd at most
+// dimension - 1), the two triangles of getIBO. A triangle touching an undefined height is collapsed onto
+// its first vertex instead of being left out, so the count and place of every triangle is fixed.
+void Graph::buildGridIndices(const float* heights, unsigned int dimension, unsigned int rowBegin, unsigned int rowEnd,
+                             unsigned int* indices) {
+    for (unsigned int y = rowBegin; y < rowEnd; y++) {
+        for (unsigned int x = 0; x < dimension - 1; x++) {
+            unsigned int curr = x + y * dimension;
+            unsigned int* cell = indices + ((size_t)y*(dimension - 1) + x)*6;
+            bool shared = heights[curr + 1] >= 0.0f && heights[curr + dimension] >= 0.0f;
+
+            bool first = shared && heights[curr] >= 0.0f;
+            cell[0] = curr;
+            cell[1] = first ? curr + 1 : curr;
+            cell[2] = first ? curr + dimension : curr;
+
+            bool second = shared && heights[curr + dimension + 1] >= 0.0f;
+            cell[3] = curr + 1;
+            cell[4] = second ? curr + dimension + 1 : curr + 1;
+            cell[5] = second ? curr + dimension : curr + 1;
         }
     }
-    m_normals = normals;
 }
@@ -0,0 +1,528 @@
+/** @file GraphServer.cpp
+ * @brief Class implementation for the graph service.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "GraphServer.hpp"
+
+#include "Camera.hpp"
+#include "Equation.hpp"
+#include "Graph.hpp"
+#include "Image.hpp"
+#include "ImageWriter.hpp"
+#include "JSONLine.hpp"
+#include "OBJModel.hpp"
+#include "SoftwareRasterizer.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <map>
+
+#if !defined(MINGW)
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+// Longest request line accepted
+const size_t MAX_REQUEST_BYTES = 1 << 20;
+// Largest resolution and image side accepted
+const unsigned int MAX_RESOLUTION = 4097;
+const unsigned int MAX_IMAGE_SIDE = 4096;
+
+// Set by SIGINT and SIGTERM
+static volatile std::sig_atomic_t gServerStopRequested = 0;
+
+// Asks run() to return
+static void requestStop(int) {
+    gServerStopRequested = 1;
+}
+
+// Reads a number field. Returns false and sets error if it is present but not a finite number.
+static bool readNumber(std::map<std::string, std::string>& fields, const std::string& name, float& value, std::string& error) {
+    if (fields.count(name) == 0) {
+        return true;
+    }
+    char* end = nullptr;
+    double parsed = std::strtod(fields[name].c_str(), &end);
+    if (end == fields[name].c_str() || *end != '\0' || !std::isfinite(parsed)) {
+        error = "\"" + name + "\" must be a number";
+        return false;
+    }
+    value = (float)parsed;
+    return true;
+}
+
+// Reads a whole number field in [low, high]. Returns false and sets error otherwise.
+static bool readCount(std::map<std::string, std::string>& fields, const std::string& name, unsigned int low,
+                      unsigned int high, unsigned int& value, std::string& error) {
+    float parsed = (float)value;
+    if (!readNumber(fields, name, parsed, error)) {
+        return false;
+    }
+    if (parsed != std::floor(parsed) || parsed < low || parsed > high) {
+        error = "\"" + name + "\" must be a whole number from " + std::to_string(low) + " to " + std::to_string(high);
+        return false;
+    }
+    value = (unsigned int)parsed;
+    return true;
+}
+
+// Returns an error response
+static std::shared_ptr<const GraphResponse> errorResponse(const std::string& error) {
+    std::shared_ptr<GraphResponse> response = std::make_shared<GraphResponse>();
+    response->fields = "\"ok\":false,\"error\":" + JSONString(error);
+    return response;
+}
+
+// Appends the bytes of count values to payload
+template <typename T>
+static void appendBytes(std::vector<uint8_t>& payload, const T* values, size_t count) {
+    const uint8_t* bytes = (const uint8_t*)values;
+    payload.insert(payload.end(), bytes, bytes + count*sizeof(T));
+}
+
+#if !defined(MINGW)
+// Writes every byte of the header and payload. Returns false if the client went away.
+static bool writeAll(int socket, const std::string& header, const std::vector<uint8_t>* payload) {
+    struct iovec parts[2];
+    parts[0].iov_base = (void*)header.data();
+    parts[0].iov_len = header.size();
+    parts[1].iov_base = payload != nullptr ? (void*)payload->data() : nullptr;
+    parts[1].iov_len = payload != nullptr ? payload->size() : 0;
+    int first = 0;
+    while (first < 2) {
+        ssize_t written = writev(socket, parts + first, 2 - first);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (first < 2 && (size_t)written >= parts[first].iov_len) {
+            written -= parts[first].iov_len;
+            first++;
+        }
+        if (first < 2) {
+            parts[first].iov_base = (char*)parts[first].iov_base + written;
+            parts[first].iov_len -= written;
+        }
+    }
+    return true;
+}
+#endif
+
+// Constructor sets the socket path, the evaluator threads (0 for one per core) and the cache size
+GraphServer::GraphServer(std::string socketPath, unsigned int threadCount, size_t cacheBytes)
+    : m_pool(threadCount), m_cache(cacheBytes) {
+    m_socketPath = socketPath;
+    m_hits = 0;
+    m_joined = 0;
+    m_misses = 0;
+    m_diffuse = nullptr;
+}
+
+// Destructor frees the grid texture
+GraphServer::~GraphServer() {
+    delete m_diffuse;
+}
+
+// Fills request from the fields of a request line and returns its cache key. Sets error if it is invalid.
+std::string GraphServer::parseRequest(std::map<std::string, std::string>& fields, Request& request, std::string& error) const {
+    if (fields.count("equation") == 0) {
+        error = "missing \"equation\"";
+        return "";
+    }
+    request.equation = fields["equation"];
+    request.output = fields.count("output") ? fields["output"] : "heights";
+    request.domainMin = -5.0f;
+    request.domainMax = 5.0f;
+    request.resolution = 401;
+    request.width = 640;
+    request.height = 480;
+    request.theta = 45.0f;
+    request.phi = 30.0f;
+    request.radius = 15.0f;
+    request.format = fields.count("format") ? fields["format"] : "png";
+
+    if (!readNumber(fields, "min", request.domainMin, error) || !readNumber(fields, "max", request.domainMax, error) ||
+        !readCount(fields, "resolution", 2, MAX_RESOLUTION, request.resolution, error)) {
+        return "";
+    }
+    if (request.domainMin >= request.domainMax) {
+        error = "\"min\" must be less than \"max\"";
+        return "";
+    }
+
+    std::string key = request.output + "\n" + request.equation + "\n" + JSONNumber(request.domainMin) + " " +
+                      JSONNumber(request.domainMax) + " " + std::to_string(request.resolution);
+    if (request.output == "heights" || request.output == "mesh") {
+        return key;
+    }
+    if (request.output != "image") {
+        error = "\"output\" must be heights, mesh or image";
+        return "";
+    }
+    if (!readCount(fields, "width", 1, MAX_IMAGE_SIDE, request.width, error) ||
+        !readCount(fields, "height", 1, MAX_IMAGE_SIDE, request.height, error) ||
+        !readNumber(fields, "theta", request.theta, error) || !readNumber(fields, "phi", request.phi, error) ||
+        !readNumber(fields, "radius", request.radius, error)) {
+        return "";
+    }
+    if (request.format != "png" && request.format != "ppm" && request.format != "rgb") {
+        error = "\"format\" must be png, ppm or rgb";
+        return "";
+    }
+    return key + " " + std::to_string(request.width) + "x" + std::to_string(request.height) + " " +
+           JSONNumber(request.theta) + " " + JSONNumber(request.phi) + " " + JSONNumber(request.radius) + " " + request.format;
+}
+
+// Computes a response on the calling thread
+std::shared_ptr<const GraphResponse> GraphServer::compute(const Request& request) {
+    Equation& expression = Equation::forThread(request.equation);
+    if (!expression.isValid()) {
+        return errorResponse(expression.getError());
+    }
+
+    std::shared_ptr<GraphResponse> response = std::make_shared<GraphResponse>();
+    response->fields = "\"ok\":true,\"output\":\"" + request.output + "\",\"resolution\":" +
+                       std::to_string(request.resolution) + ",\"min\":" + JSONNumber(request.domainMin) +
+                       ",\"max\":" + JSONNumber(request.domainMax);
+
+    if (request.output == "heights") {
+        HeightStats stats;
+        std::vector<float> heights((size_t)request.resolution*request.resolution);
+        Graph::sampleHeights(expression, request.resolution, heights.data(), &stats, request.domainMin, request.domainMax);
+        appendBytes(response->payload, heights.data(), heights.size());
+        response->fields += ",\"z_min\":" + JSONNumber(stats.min) + ",\"z_max\":" + JSONNumber(stats.max) +
+                            ",\"undefined\":" + std::to_string(stats.undefinedCount) +
+                            ",\"out_of_range\":" + std::to_string(stats.outOfBoundsCount);
+        return response;
+    }
+
+    Graph graph(request.equation, request.resolution, 0, request.domainMin, request.domainMax, false);
+    const std::vector<float>& vertices = graph.getVBO();
+    const std::vector<unsigned int>& indices = graph.getIBO();
+
+    // The graph is tinted in the one copy each output makes of it
+    if (request.output == "mesh") {
+        appendBytes(response->payload, vertices.data(), vertices.size());
+        Graph::tintVertices((float*)response->payload.data(), vertices.size()/12, Graph::paletteColor(1));
+        appendBytes(response->payload, indices.data(), indices.size());
+        response->fields += ",\"vertices\":" + std::to_string(vertices.size()/12) +
+                            ",\"indices\":" + std::to_string(indices.size());
+        return response;
+    }
+
+    // Draw the grid first, then the graph, as VertexSpecification orders them
+    std::vector<float> sceneVertices;
+    sceneVertices.reserve(m_gridVertices.size() + vertices.size());
+    sceneVertices.insert(sceneVertices.end(), m_gridVertices.begin(), m_gridVertices.end());
+    sceneVertices.insert(sceneVertices.end(), vertices.begin(), vertices.end());
+    Graph::tintVertices(sceneVertices.data() + m_gridVertices.size(), vertices.size()/12, Graph::paletteColor(1));
+    std::vector<unsigned int> sceneIndices;
+    sceneIndices.reserve(m_gridIndices.size() + indices.size());
+    sceneIndices.insert(sceneIndices.end(), m_gridIndices.begin(), m_gridIndices.end());
+    unsigned int offset = (unsigned int)(m_gridVertices.size()/12);
+    for (unsigned int index : indices) {
+        sceneIndices.push_back(index + offset);
+    }
+
+    float x = request.radius * glm::sin(glm::radians(request.phi)) * glm::cos(glm::radians(request.theta));
+    float z = request.radius * glm::sin(glm::radians(request.phi)) * glm::sin(glm::radians(request.theta));
+    float y = request.radius * glm::cos(glm::radians(request.phi));
+
+    SoftwareUniforms uniforms;
+    uniforms.model = glm::lookAt(glm::vec3(x, y, z), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    uniforms.view = Camera().GetViewMatrix();
+    uniforms.projection = glm::perspective(glm::radians(45.0f), (float)request.width/(float)request.height, 0.1f, 30.0f);
+    uniforms.coloring = 0;
+    uniforms.highlight = 0;
+    uniforms.diffuse = m_diffuse;
+
+    // One thread per image: the pool already runs one request per core
+    SoftwareRasterizer rasterizer(request.width, request.height, 1);
+    rasterizer.Clear(0.1f, 0.1f, 0.1f);
+    rasterizer.DrawElements(sceneVertices, sceneIndices, uniforms);
+    std::vector<uint8_t> pixels;
+    rasterizer.ReadPixels(pixels);
+
+    if (request.format == "png") {
+        EncodePNG(response->payload, request.width, request.height, pixels.data());
+    } else if (request.format == "ppm") {
+        EncodePPM(response->payload, request.width, request.height, pixels.data());
+    } else {
+        response->payload = std::move(pixels);
+    }
+    response->fields += ",\"width\":" + std::to_string(request.width) + ",\"height\":" + std::to_string(request.height) +
+                        ",\"format\":\"" + request.format + "\"";
+    return response;
+}
+
+// Returns the cached response for key, or computes it on the pool (once, however many ask)
+std::shared_ptr<const GraphResponse> GraphServer::lookup(const std::string& key, const Request& request, bool& cached) {
+    std::shared_ptr<std::promise<std::shared_ptr<const GraphResponse>>> promise;
+    std::shared_future<std::shared_ptr<const GraphResponse>> result;
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        std::shared_ptr<const GraphResponse> response = m_cache.get(key);
+        if (response != nullptr) {
+            m_hits++;
+            cached = true;
+            return response;
+        }
+        auto found = m_inFlight.find(key);
+        if (found != m_inFlight.end()) {
+            m_joined++;
+            cached = true;
+            result = found->second;
+        } else {
+            m_misses++;
+            cached = false;
+            promise = std::make_shared<std::promise<std::shared_ptr<const GraphResponse>>>();
+            result = promise->get_future().share();
+            m_inFlight[key] = result;
+        }
+    }
+
+    if (promise != nullptr) {
+        m_pool.submit([this, key, request, promise]() {
+            // An exception must not leave the pool's thread, or everyone waiting on result waits forever.
+            // Such a failure (e.g. running out of memory) may not happen again, so it is not cached.
+            std::shared_ptr<const GraphResponse> response;
+            bool failed = false;
+            try {
+                response = compute(request);
+            } catch (const std::exception& exception) {
+                response = errorResponse(std::string("could not compute the response: ") + exception.what());
+                failed = true;
+            } catch (...) {
+                response = errorResponse("could not compute the response");
+                failed = true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_cacheMutex);
+                if (!failed) {
+                    m_cache.put(key, response, response->payload.size() + response->fields.size() + key.size());
+                }
+                m_inFlight.erase(key);
+            }
+            promise->set_value(response);
+        });
+    }
+    return result.get();
+}
+
+// Returns the stats header members
+std::string GraphServer::statsFields() {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    return "\"ok\":true,\"output\":\"stats\",\"hits\":" + std::to_string(m_hits) + ",\"joined\":" + std::to_string(m_joined) +
+           ",\"misses\":" + std::to_string(m_misses) + ",\"entries\":" + std::to_string(m_cache.count()) +
+           ",\"cache_bytes\":" + std::to_string(m_cache.size()) + ",\"cache_capacity\":" + std::to_string(m_cache.capacity()) +
+           ",\"threads\":" + std::to_string(m_pool.size());
+}
+
+// Answers one request line. Sets header to the JSON header line (with its newline) and
+// payload to the bytes that follow it.
+void GraphServer::respond(const std::string& requestLine, std::string& header, std::shared_ptr<const GraphResponse>& payload) {
+    auto start = std::chrono::steady_clock::now();
+    bool cached = false;
+    std::string fields;
+
+    Request request;
+    std::string error;
+    std::string key;
+    std::map<std::string, std::string> requestFields;
+    if (ParseJSONObject(requestLine, requestFields, error) && requestFields.count("command")) {
+        payload = nullptr;
+        fields = requestFields["command"] == "stats" ? statsFields() : errorResponse("unknown command")->fields;
+    } else {
+        if (error.empty()) {
+            key = parseRequest(requestFields, request, error);
+        }
+        payload = key.empty() ? errorResponse(error) : lookup(key, request, cached);
+        fields = payload->fields;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    header = "{" + fields + ",\"cached\":" + (cached ? "true" : "false") +
+             ",\"bytes\":" + std::to_string(payload != nullptr ? payload->payload.size() : 0) +
+             ",\"ms\":" + JSONNumber(elapsed.count()) + "}\n";
+}
+
+#if !defined(MINGW)
+
+// Reads requests from a client and answers them until it disconnects
+void GraphServer::serveConnection(Connection* connection) {
+    int socket = connection->socket;
+    std::string buffer;
+    std::vector<char> chunk(1 << 16);
+    size_t scanned = 0; // bytes of buffer known to hold no newline
+
+    while (true) {
+        size_t newline = buffer.find('\n', scanned);
+        if (newline == std::string::npos) {
+            scanned = buffer.size();
+            if (buffer.size() > MAX_REQUEST_BYTES) {
+                writeAll(socket, "{" + errorResponse("request line too long")->fields + "}\n", nullptr);
+                break;
+            }
+            ssize_t received = read(socket, chunk.data(), chunk.size());
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                break;
+            }
+            buffer.append(chunk.data(), received);
+            continue;
+        }
+        std::string line = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        scanned = 0;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::string header;
+        std::shared_ptr<const GraphResponse> response;
+        respond(line, header, response);
+        if (!writeAll(socket, header, response != nullptr ? &response->payload : nullptr)) {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_connectionsMutex);
+    close(socket);
+    connection->socket = -1;
+    connection->done = true;
+}
+
+// Joins the threads of closed connections
+void GraphServer::reapConnections() {
+    std::lock_guard<std::mutex> lock(m_connectionsMutex);
+    for (auto connection = m_connections.begin(); connection != m_connections.end(); ) {
+        if (connection->done) {
+            connection->thread.join();
+            connection = m_connections.erase(connection);
+        } else {
+            connection++;
+        }
+    }
+}
+
+// Listens on the socket until SIGINT or SIGTERM. Returns false if the socket could not be opened.
+bool GraphServer::run() {
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (m_socketPath.size() >= sizeof(address.sun_path)) {
+        std::cout << "Socket path " << m_socketPath << " is too long" << std::endl;
+        return false;
+    }
+    std::strncpy(address.sun_path, m_socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cout << "Could not create a socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    // A socket file nobody answers on is left over from a server that did not exit cleanly
+    if (connect(listener, (struct sockaddr*)&address, sizeof(address)) == 0) {
+        std::cout << "A server is already listening on " << m_socketPath << std::endl;
+        close(listener);
+        return false;
+    }
+    close(listener);
+    unlink(m_socketPath.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        std::cout << "Could not listen on " << m_socketPath << ": " << std::strerror(errno) << std::endl;
+        if (listener >= 0) {
+            close(listener);
+        }
+        return false;
+    }
+
+    // Images are drawn over the same grid as the interactive view
+    OBJModel grid("./objects/grid/grid.obj");
+    m_gridVertices = grid.getVBO();
+    m_gridIndices = grid.getIBO();
+    if (!m_gridVertices.empty()) {
+        m_diffuse = new Image(grid.getTexture());
+        m_diffuse->LoadPPM(true);
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::cout << "Serving graphs on " << m_socketPath << " with " << m_pool.size() << " threads and a "
+              << (m_cache.capacity() >> 20) << " MB cache" << std::endl;
+
+    while (!gServerStopRequested) {
+        struct pollfd waiting = {listener, POLLIN, 0};
+        int ready = poll(&waiting, 1, 250);
+        reapConnections();
+        if (ready <= 0) {
+            continue;
+        }
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(m_connectionsMutex);
+        m_connections.push_back(Connection{std::thread(), client, false});
+        Connection* connection = &m_connections.back();
+        connection->thread = std::thread(&GraphServer::serveConnection, this, connection);
+    }
+
+    close(listener);
+    unlink(m_socketPath.c_str());
+
+    // Wake up connections blocked on reads, then wait for them
+    {
+        std::lock_guard<std::mutex> lock(m_connectionsMutex);
+        for (Connection& connection : m_connections) {
+            if (!connection.done) {
+                shutdown(connection.socket, SHUT_RDWR);
+            }
+        }
+    }
+    for (Connection& connection : m_connections) {
+        connection.thread.join();
+    }
+    m_connections.clear();
+
+    std::cout << "{" << statsFields() << "}" << std::endl;
+    return true;
+}
+
+#else
+
+// Reads requests from a client and answers them until it disconnects
+void GraphServer::serveConnection(Connection* connection) {
+}
+
+// Joins the threads of closed connections
+void GraphServer::reapConnections() {
+}
+
+// Listens on the socket until SIGINT or SIGTERM. Returns false if the socket could not be opened.
+bool GraphServer::run() {
+    std::cout << "The graph server needs Unix domain sockets and is not available on Windows" << std::endl;
+    return false;
+}
+
+#endif
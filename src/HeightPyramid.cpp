@@ -0,0 +1,387 @@
+/** @file HeightPyramid.cpp
+ * @brief Class implementation for writing and reading tiled, multi-resolution height maps.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "HeightPyramid.hpp"
+#include "Equation.hpp"
+#include "Graph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+const uint32_t PYRAMID_VERSION = 1;
+
+// Returns the samples per side of a level given the level 0 dimension
+static unsigned int levelDimension(unsigned int dimension, unsigned int level) {
+    for (unsigned int i = 0; i < level; i++) {
+        dimension = (dimension + 1)/2;
+    }
+    return dimension;
+}
+
+// Returns the tiles per side needed for a level
+static unsigned int levelTiles(unsigned int dimension, unsigned int tileSize, unsigned int level) {
+    return (levelDimension(dimension, level) + tileSize - 1)/tileSize;
+}
+
+// Fills in the tile index of a header: offsets of every tile of every level after the index itself
+static void buildIndex(const PyramidHeader& header, std::vector<uint64_t>& offsets, std::vector<unsigned int>& levelOffsets) {
+    offsets.clear();
+    levelOffsets.clear();
+
+    unsigned int tileCount = 0;
+    for (unsigned int level = 0; level < header.levelCount; level++) {
+        unsigned int tiles = levelTiles(header.dimension, header.tileSize, level);
+        levelOffsets.push_back(tileCount);
+        tileCount += tiles*tiles;
+    }
+
+    uint64_t tileBytes = (uint64_t)header.tileSize*header.tileSize*sizeof(float);
+    uint64_t offset = sizeof(PyramidHeader) + tileCount*sizeof(uint64_t);
+    for (unsigned int i = 0; i < tileCount; i++) {
+        offsets.push_back(offset);
+        offset += tileBytes;
+    }
+}
+
+// Returns true if a header describes a pyramid the writer could have made, and its index and tiles
+// fit in fileSize bytes. Computed in 64 bits, so a corrupt header can not wrap around to a small size.
+static bool headerFits(const PyramidHeader& header, uint64_t fileSize) {
+    bool powerOfTwo = header.tileSize >= 2 && (header.tileSize & (header.tileSize - 1)) == 0;
+    if (header.dimension < 2 || !powerOfTwo || header.levelCount == 0 || !std::isfinite(header.domainMin) ||
+        !std::isfinite(header.domainMax) || !(header.domainMin < header.domainMax)) {
+        return false;
+    }
+    uint64_t tileSamples = (uint64_t)header.tileSize*header.tileSize;
+    if (tileSamples > fileSize/sizeof(float)) {
+        return false;
+    }
+
+    uint64_t dimension = header.dimension;
+    uint64_t tileCount = 0;
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        // Levels are added until one fits in a single tile, and only the last one does
+        if ((dimension <= header.tileSize) != (level + 1 == header.levelCount)) {
+            return false;
+        }
+        uint64_t tiles = (dimension + header.tileSize - 1)/header.tileSize;
+        tileCount += tiles*tiles;
+        if (tileCount > fileSize) {
+            return false;
+        }
+        dimension = (dimension + 1)/2;
+    }
+    return tileCount <= (fileSize - sizeof(PyramidHeader))/(sizeof(uint64_t) + tileSamples*sizeof(float));
+}
+
+// Constructor sets up a pyramid of dimension*dimension samples split into tiles of tileSize*tileSize
+HeightPyramidWriter::HeightPyramidWriter(std::string filePath, unsigned int dimension, unsigned int tileSize) {
+    m_filePath = filePath;
+
+    // Tiles must split evenly in half when downsampling
+    unsigned int size = 2;
+    while (size < tileSize) {
+        size *= 2;
+    }
+
+    std::memcpy(m_header.magic, "HPYR", 4);
+    m_header.version = PYRAMID_VERSION;
+    m_header.dimension = dimension;
+    m_header.tileSize = size;
+    m_header.levelCount = 1;
+    m_header.domainMin = Graph::sampleCoordinate(0, dimension);
+    m_header.domainMax = Graph::sampleCoordinate(dimension - 1, dimension);
+
+    while (levelDimension(dimension, m_header.levelCount - 1) > size) {
+        m_header.levelCount++;
+    }
+
+    buildIndex(m_header, m_offsets, m_levelOffsets);
+}
+
+// Evaluates z = f(x,y) tile by tile and writes every level. Only two tiles are held in memory.
+bool HeightPyramidWriter::write(const std::string& equation) {
+    Equation expression(equation);
+    if (!expression.isValid()) {
+        std::cout << "Could not parse equation " << equation << ": " << expression.getError() << std::endl;
+        return false;
+    }
+
+    std::fstream file(m_filePath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Could not open " << m_filePath << " for writing" << std::endl;
+        return false;
+    }
+
+    file.write((const char*)&m_header, sizeof(PyramidHeader));
+    file.write((const char*)m_offsets.data(), m_offsets.size()*sizeof(uint64_t));
+
+    unsigned int tileSize = m_header.tileSize;
+    std::vector<float> tile(tileSize*tileSize);
+    std::vector<float> child(tileSize*tileSize);
+
+    for (unsigned int level = 0; level < m_header.levelCount; level++) {
+        unsigned int tiles = levelTiles(m_header.dimension, tileSize, level);
+
+        for (unsigned int tileY = 0; tileY < tiles; tileY++) {
+            for (unsigned int tileX = 0; tileX < tiles; tileX++) {
+                if (level == 0) {
+                    evaluateTile(expression, tileX, tileY, tile);
+                } else {
+                    downsampleTile(file, level, tileX, tileY, child, tile);
+                }
+
+                file.seekp(m_offsets[m_levelOffsets[level] + tileX + tileY*tiles]);
+                file.write((const char*)tile.data(), tile.size()*sizeof(float));
+            }
+        }
+    }
+
+    if (!file.good()) {
+        std::cout << "Failed while writing " << m_filePath << std::endl;
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+// Evaluates one level 0 tile
+void HeightPyramidWriter::evaluateTile(Equation& expression, unsigned int tileX, unsigned int tileY, std::vector<float>& tile) {
+    unsigned int tileSize = m_header.tileSize;
+    unsigned int dimension = m_header.dimension;
+
+    for (unsigned int v = 0; v < tileSize; v++) {
+        unsigned int row = tileY*tileSize + v;
+        float y = Graph::sampleCoordinate(row, dimension);
+
+        for (unsigned int u = 0; u < tileSize; u++) {
+            unsigned int column = tileX*tileSize + u;
+
+            // Padding past the edge of the grid is stored as undefined
+            if (row >= dimension || column >= dimension) {
+                tile[u + v*tileSize] = -1.0f;
+                continue;
+            }
+
+            float x = Graph::sampleCoordinate(column, dimension);
+            tile[u + v*tileSize] = Graph::toHeight(expression.value(x, y));
+        }
+    }
+}
+
+// Builds one tile of a level by box filtering the four tiles below it
+void HeightPyramidWriter::downsampleTile(std::fstream& file, unsigned int level, unsigned int tileX, unsigned int tileY,
+                                         std::vector<float>& child, std::vector<float>& tile) {
+    unsigned int tileSize = m_header.tileSize;
+    unsigned int half = tileSize/2;
+    unsigned int childTiles = levelTiles(m_header.dimension, tileSize, level - 1);
+
+    std::fill(tile.begin(), tile.end(), -1.0f);
+
+    for (unsigned int cy = 0; cy < 2; cy++) {
+        for (unsigned int cx = 0; cx < 2; cx++) {
+            unsigned int childX = tileX*2 + cx;
+            unsigned int childY = tileY*2 + cy;
+
+            if (childX >= childTiles || childY >= childTiles) {
+                continue;
+            }
+
+            file.seekg(m_offsets[m_levelOffsets[level - 1] + childX + childY*childTiles]);
+            file.read((char*)child.data(), child.size()*sizeof(float));
+
+            for (unsigned int v = 0; v < tileSize; v += 2) {
+                for (unsigned int u = 0; u < tileSize; u += 2) {
+                    float samples[4] = {
+                        child[u + v*tileSize],
+                        child[(u + 1) + v*tileSize],
+                        child[u + (v + 1)*tileSize],
+                        child[(u + 1) + (v + 1)*tileSize]
+                    };
+
+                    // Average only the defined samples
+                    float sum = 0.0f;
+                    int count = 0;
+                    for (int i = 0; i < 4; i++) {
+                        if (samples[i] >= 0.0f) {
+                            sum += samples[i];
+                            count++;
+                        }
+                    }
+
+                    if (count > 0) {
+                        tile[(cx*half + u/2) + (cy*half + v/2)*tileSize] = sum/count;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Constructor opens a pyramid file and reads its header and tile index
+HeightPyramidReader::HeightPyramidReader(std::string filePath) {
+    m_open = false;
+    m_file.open(filePath, std::ios::in | std::ios::binary);
+
+    if (!m_file.is_open()) {
+        std::cout << "Could not open " << filePath << std::endl;
+        return;
+    }
+
+    m_file.read((char*)&m_header, sizeof(PyramidHeader));
+    if (!m_file.good() || std::memcmp(m_header.magic, "HPYR", 4) != 0 || m_header.version != PYRAMID_VERSION) {
+        std::cout << filePath << " is not a height pyramid" << std::endl;
+        return;
+    }
+
+    // The header is checked against the file before anything is allocated from it
+    m_file.seekg(0, std::ios::end);
+    uint64_t fileSize = (uint64_t)m_file.tellg();
+    m_file.seekg(sizeof(PyramidHeader));
+    if (!headerFits(m_header, fileSize)) {
+        std::cout << filePath << " has a corrupt header" << std::endl;
+        return;
+    }
+
+    buildIndex(m_header, m_offsets, m_levelOffsets);
+
+    // Read the stored index rather than trusting the computed one, and keep every tile in the file
+    m_file.read((char*)m_offsets.data(), m_offsets.size()*sizeof(uint64_t));
+    uint64_t tileBytes = (uint64_t)m_header.tileSize*m_header.tileSize*sizeof(float);
+    for (uint64_t offset : m_offsets) {
+        if (offset > fileSize - tileBytes) {
+            std::cout << filePath << " has a corrupt tile index" << std::endl;
+            return;
+        }
+    }
+    m_open = m_file.good();
+}
+
+// Returns true if the file was opened and its header is valid
+bool HeightPyramidReader::isOpen() const {
+    return m_open;
+}
+
+// Returns the number of levels
+unsigned int HeightPyramidReader::getLevelCount() const {
+    return m_header.levelCount;
+}
+
+// Returns the samples per side of a level
+unsigned int HeightPyramidReader::getDimension(unsigned int level) const {
+    return levelDimension(m_header.dimension, level);
+}
+
+// Returns the samples per tile side
+unsigned int HeightPyramidReader::getTileSize() const {
+    return m_header.tileSize;
+}
+
+// Returns the tiles per side of a level
+unsigned int HeightPyramidReader::tilesPerSide(unsigned int level) const {
+    return levelTiles(m_header.dimension, m_header.tileSize, level);
+}
+
+// Returns the x (or y) coordinate of sample i of a level
+float HeightPyramidReader::sampleCoordinate(unsigned int level, unsigned int i) const {
+    // A sample is the average of a 2^level box of level 0 samples; place it at the box center
+    float scale = (float)(1u << level);
+    float center = i*scale + (scale - 1.0f)*0.5f;
+    float step = (m_header.domainMax - m_header.domainMin)/(m_header.dimension - 1.0f);
+    return m_header.domainMin + center*step;
+}
+
+// Returns the coarsest level that still has at least samplesAcross samples over [minX, maxX]
+unsigned int HeightPyramidReader::chooseLevel(float minX, float maxX, unsigned int samplesAcross) const {
+    float step = (m_header.domainMax - m_header.domainMin)/(m_header.dimension - 1.0f);
+    float available = (maxX - minX)/step;
+
+    unsigned int level = 0;
+    while (level + 1 < m_header.levelCount && available/2.0f >= samplesAcross) {
+        available /= 2.0f;
+        level++;
+    }
+    return level;
+}
+
+// Reads one tile of a level
+bool HeightPyramidReader::readTile(unsigned int level, unsigned int tileX, unsigned int tileY, std::vector<float>& tile) {
+    unsigned int tiles = tilesPerSide(level);
+    if (!m_open || level >= m_header.levelCount || tileX >= tiles || tileY >= tiles) {
+        return false;
+    }
+
+    tile.resize((size_t)m_header.tileSize*m_header.tileSize);
+    m_file.seekg(m_offsets[m_levelOffsets[level] + tileX + tileY*tiles]);
+    m_file.read((char*)tile.data(), tile.size()*sizeof(float));
+    return m_file.good();
+}
+
+// Returns the samples of a level inside [minX, maxX] x [minY, maxY] row by row, reading only
+// the tiles that overlap the region. width, height and the first sample indices are returned.
+std::vector<float> HeightPyramidReader::readRegion(unsigned int level, float minX, float maxX, float minY, float maxY,
+                                                   unsigned int& width, unsigned int& height,
+                                                   unsigned int& firstColumn, unsigned int& firstRow) {
+    std::vector<float> region;
+    width = 0;
+    height = 0;
+    firstColumn = 0;
+    firstRow = 0;
+
+    if (!m_open || level >= m_header.levelCount) {
+        return region;
+    }
+
+    unsigned int dimension = getDimension(level);
+    float step = sampleCoordinate(level, 1) - sampleCoordinate(level, 0);
+    float origin = sampleCoordinate(level, 0);
+
+    // Convert the region to an inclusive range of sample indices
+    auto toIndex = [&](float coordinate) {
+        float index = (coordinate - origin)/step;
+        return (int)std::clamp(index, 0.0f, dimension - 1.0f);
+    };
+    int column0 = toIndex(minX);
+    int column1 = std::min((int)dimension - 1, toIndex(maxX) + 1);
+    int row0 = toIndex(minY);
+    int row1 = std::min((int)dimension - 1, toIndex(maxY) + 1);
+
+    if (column1 < column0 || row1 < row0) {
+        return region;
+    }
+
+    firstColumn = column0;
+    firstRow = row0;
+    width = column1 - column0 + 1;
+    height = row1 - row0 + 1;
+    region.resize(width*height);
+
+    unsigned int tileSize = m_header.tileSize;
+    std::vector<float> tile;
+
+    for (unsigned int tileY = row0/tileSize; tileY <= row1/tileSize; tileY++) {
+        for (unsigned int tileX = column0/tileSize; tileX <= column1/tileSize; tileX++) {
+            if (!readTile(level, tileX, tileY, tile)) {
+                continue;
+            }
+
+            // Copy the overlap of this tile with the region
+            int u0 = std::max(column0, (int)(tileX*tileSize));
+            int u1 = std::min(column1, (int)((tileX + 1)*tileSize) - 1);
+            int v0 = std::max(row0, (int)(tileY*tileSize));
+            int v1 = std::min(row1, (int)((tileY + 1)*tileSize) - 1);
+
+            for (int v = v0; v <= v1; v++) {
+                for (int u = u0; u <= u1; u++) {
+                    region[(u - column0) + (v - row0)*width] = tile[(u - tileX*tileSize) + (v - tileY*tileSize)*tileSize];
+                }
+            }
+        }
+    }
+
+    return region;
+}
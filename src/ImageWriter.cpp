@@ -0,0 +1,148 @@
+/** @file ImageWriter.cpp
+ *  @brief Dependency free PPM and PNG writers.
+ *
+ *  @author Antoine Assaf
+ */
+#include "ImageWriter.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Largest payload of an uncompressed deflate block
+const size_t DEFLATE_STORED_BLOCK = 65535;
+
+// Returns the CRC-32 lookup table
+static std::vector<uint32_t> MakeCRCTable(){
+    std::vector<uint32_t> table(256);
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+// Returns the CRC-32 of data continuing from crc, as used by PNG chunks
+static uint32_t CRC32(const uint8_t* data, size_t size, uint32_t crc = 0){
+    static const std::vector<uint32_t> table = MakeCRCTable();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Appends a big endian 32 bit value
+static void PutBigEndian(std::vector<uint8_t>& out, uint32_t value){
+    out.push_back((uint8_t)(value >> 24));
+    out.push_back((uint8_t)(value >> 16));
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+// Appends one PNG chunk: length, type, data and the CRC of type and data
+static void PutChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data){
+    size_t start = out.size();
+    PutBigEndian(out, (uint32_t)data.size());
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PutBigEndian(out, CRC32(out.data() + start + 4, out.size() - start - 4));
+}
+
+// Writes bytes to filePath. Returns false on failure.
+static bool WriteBytes(const std::string& filePath, const std::vector<uint8_t>& bytes){
+    std::ofstream outFile(filePath, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cout << "Could not open " << filePath << " for writing" << std::endl;
+        return false;
+    }
+    outFile.write((const char*)bytes.data(), bytes.size());
+    return outFile.good();
+}
+
+// Encodes width*height RGB pixels, top row first, as a binary (P6) PPM into out
+void EncodePPM(std::vector<uint8_t>& out, unsigned int width, unsigned int height, const uint8_t* pixels){
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    out.assign(header.begin(), header.end());
+    out.insert(out.end(), pixels, pixels + (size_t)width*height*3);
+}
+
+// Encodes width*height RGB pixels, top row first, as a PNG into out
+void EncodePNG(std::vector<uint8_t>& out, unsigned int width, unsigned int height, const uint8_t* pixels){
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.assign(signature, signature + 8);
+
+    std::vector<uint8_t> header;
+    PutBigEndian(header, width);
+    PutBigEndian(header, height);
+    header.push_back(8); // bit depth
+    header.push_back(2); // RGB
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // not interlaced
+    PutChunk(out, "IHDR", header);
+
+    // Every row starts with filter type 0 (none)
+    size_t rowSize = (size_t)width*3;
+    std::vector<uint8_t> raw;
+    raw.reserve((rowSize + 1)*height);
+    for (unsigned int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), pixels + y*rowSize, pixels + (y + 1)*rowSize);
+    }
+
+    // zlib stream of stored deflate blocks followed by the Adler-32 of the raw data
+    std::vector<uint8_t> compressed;
+    compressed.reserve(raw.size() + raw.size()/DEFLATE_STORED_BLOCK*5 + 16);
+    compressed.push_back(0x78);
+    compressed.push_back(0x01);
+    for (size_t start = 0; ; start += DEFLATE_STORED_BLOCK) {
+        size_t length = std::min(DEFLATE_STORED_BLOCK, raw.size() - start);
+        bool last = start + length >= raw.size();
+        compressed.push_back(last ? 1 : 0);
+        compressed.push_back((uint8_t)length);
+        compressed.push_back((uint8_t)(length >> 8));
+        compressed.push_back((uint8_t)~length);
+        compressed.push_back((uint8_t)(~length >> 8));
+        compressed.insert(compressed.end(), raw.begin() + start, raw.begin() + start + length);
+        if (last) {
+            break;
+        }
+    }
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t i = 0; i < raw.size(); i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    PutBigEndian(compressed, (b << 16) | a);
+    PutChunk(out, "IDAT", compressed);
+
+    PutChunk(out, "IEND", std::vector<uint8_t>());
+}
+
+// Writes width*height RGB pixels, top row first, as a binary (P6) PPM. Returns false on failure.
+bool WritePPM(const std::string& filePath, unsigned int width, unsigned int height, const uint8_t* pixels){
+    std::vector<uint8_t> bytes;
+    EncodePPM(bytes, width, height, pixels);
+    return WriteBytes(filePath, bytes);
+}
+
+// Writes width*height RGB pixels, top row first, as a PNG. Returns false on failure.
+bool WritePNG(const std::string& filePath, unsigned int width, unsigned int height, const uint8_t* pixels){
+    std::vector<uint8_t> bytes;
+    EncodePNG(bytes, width, height, pixels);
+    return WriteBytes(filePath, bytes);
+}
+
+// Writes a PNG if filePath ends in .png, a PPM otherwise. Returns false on failure.
+bool WriteImage(const std::string& filePath, unsigned int width, unsigned int height, const uint8_t* pixels){
+    if (filePath.size() >= 4 && filePath.compare(filePath.size() - 4, 4, ".png") == 0) {
+        return WritePNG(filePath, width, height, pixels);
+    }
+    return WritePPM(filePath, width, height, pixels);
+}
@@ -0,0 +1,455 @@
+/** @file ImplicitSurface.cpp
+ * @brief Class implementation for extracting an implicit surface F(x,y,z) = 0 with marching cubes.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "ImplicitSurface.hpp"
+#include "Equation.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// How much farther than the steepest slope seen the surface is looked for around a block
+const float PRUNING_SAFETY = 2.0f;
+// Marks an edge of a brick without a vertex yet
+const unsigned int NO_VERTEX = 0xFFFFFFFFu;
+
+// Marching cubes cases. Corner c of a cell is at offset (c & 1, (c >> 1) & 1, (c >> 2) & 1), and
+// case bit c is set if F < 0 there.
+struct CubeCases {
+    unsigned char edgeStart[12]; // corner each edge starts from
+    unsigned char edgeAxis[12]; // axis each edge runs along
+    std::vector<unsigned char> triangles[256]; // three edges per triangle, counter-clockwise seen from F > 0 in model space
+};
+
+// Builds the triangles of every case from the crossings on the faces of the cell
+static CubeCases buildCubeCases() {
+    CubeCases cases;
+    unsigned char edgeFrom[8][3]; // edge leaving corner c along an axis, for corners with that bit clear
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        unsigned int edge = axis*4;
+        for (unsigned int corner = 0; corner < 8; corner++) {
+            if ((corner >> axis & 1) == 0) {
+                cases.edgeStart[edge] = corner;
+                cases.edgeAxis[edge] = axis;
+                edgeFrom[corner][axis] = edge++;
+            }
+        }
+    }
+
+    for (unsigned int inside = 0; inside < 256; inside++) {
+        // Every crossing is where one segment on a face ends and the next one starts
+        int next[12];
+        std::fill(next, next + 12, -1);
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            for (unsigned int side = 0; side < 2; side++) {
+                // Corners of the face counter-clockwise seen from outside the cell
+                unsigned int u = 1 << (axis + 1) % 3;
+                unsigned int v = 1 << (axis + 2) % 3;
+                unsigned int base = side << axis;
+                unsigned int corners[4] = {base, base | u, base | u | v, base | v};
+                if (side == 0) {
+                    std::swap(corners[1], corners[3]);
+                }
+                int crossings[4];
+                bool entering[4];
+                unsigned int count = 0;
+                for (unsigned int k = 0; k < 4; k++) {
+                    unsigned int a = corners[k];
+                    unsigned int b = corners[(k + 1) % 4];
+                    if ((inside >> a & 1) != (inside >> b & 1)) {
+                        unsigned int edgeAxis = (a ^ b) == 1 ? 0 : ((a ^ b) == 2 ? 1 : 2);
+                        crossings[count] = edgeFrom[std::min(a, b)][edgeAxis];
+                        entering[count++] = (inside >> b & 1) != 0;
+                    }
+                }
+                // Leaving the inside corners joins back to where the walk entered them, so the
+                // inside region of the face is on the segment's left and inside corners are cut
+                // off on their own when a face has four crossings
+                for (unsigned int j = 0; j < count; j++) {
+                    if (!entering[j]) {
+                        next[crossings[j]] = crossings[(j + count - 1) % count];
+                    }
+                }
+            }
+        }
+
+        // The loops run counter-clockwise around the inside seen from outside the cell, so their fans
+        // face F < 0 in x y z, and F > 0 in model space (x, z, y), which mirrors it
+        bool visited[12] = {false};
+        for (unsigned int edge = 0; edge < 12; edge++) {
+            if (next[edge] < 0 || visited[edge]) {
+                continue;
+            }
+            std::vector<unsigned char> loop;
+            for (int e = edge; !visited[e]; e = next[e]) {
+                visited[e] = true;
+                loop.push_back(e);
+            }
+            for (size_t i = 1; i + 1 < loop.size(); i++) {
+                cases.triangles[inside].push_back(loop[0]);
+                cases.triangles[inside].push_back(loop[i]);
+                cases.triangles[inside].push_back(loop[i + 1]);
+            }
+        }
+    }
+    return cases;
+}
+
+// Returns the marching cubes cases, built on first use
+static const CubeCases& cubeCases() {
+    static const CubeCases cases = buildCubeCases();
+    return cases;
+}
+
+// Constructor extracts F(x,y,z) = 0 from dimension^3 samples over [domainMin, domainMax]^3
+ImplicitSurface::ImplicitSurface(std::string equation, unsigned int dimension, float domainMin, float domainMax,
+                                 unsigned int threadCount) {
+    m_equation = equation;
+    m_dimension = std::max(dimension, 2u);
+    m_domainMin = domainMin;
+    m_domainMax = domainMax;
+    m_sampleCount = 0;
+
+    sampleLattice(threadCount);
+
+    unsigned int cells = m_dimension - 1;
+    unsigned int brickDimension = (cells + BRICK_CELLS - 1)/BRICK_CELLS;
+    std::vector<BrickMesh> bricks((size_t)brickDimension*brickDimension*brickDimension);
+    {
+        ThreadPool pool(threadCount);
+        for (unsigned int z = 0; z < brickDimension; z++) {
+            for (unsigned int y = 0; y < brickDimension; y++) {
+                for (unsigned int x = 0; x < brickDimension; x++) {
+                    BrickMesh& mesh = bricks[((size_t)z*brickDimension + y)*brickDimension + x];
+                    pool.submit([this, x, y, z, &mesh]() { extractBrick(x, y, z, mesh); });
+                }
+            }
+        }
+        pool.wait();
+    }
+    weldBricks(bricks);
+}
+
+// Returns the 12 float vertices
+const std::vector<float>& ImplicitSurface::getVBO() const {
+    return m_VBO;
+}
+
+// Returns the triangle indices, brick by brick
+const std::vector<unsigned int>& ImplicitSurface::getIBO() const {
+    return m_IBO;
+}
+
+// Returns the bricks that have triangles, in the order of their indices in getIBO, each with its bounding box
+const std::vector<GraphChunk>& ImplicitSurface::getChunks() const {
+    return m_chunks;
+}
+
+// Returns how many times F was evaluated
+size_t ImplicitSurface::getSampleCount() const {
+    return m_sampleCount;
+}
+
+// Returns true if equation is F(x,y,z): it only compiles once z is a variable
+bool ImplicitSurface::isImplicit(const std::string& equation) {
+    return !Equation(equation).isValid() && Equation(equation, {"x", "y", "z"}).isValid();
+}
+
+// Returns F at grid sample (x, y, z)
+float ImplicitSurface::sample(Equation& expression, unsigned int x, unsigned int y, unsigned int z) const {
+    return expression.value(coordinate(x), coordinate(y), coordinate(z));
+}
+
+// Returns the coordinate of grid sample i along an axis
+float ImplicitSurface::coordinate(float i) const {
+    return m_domainMin + (m_domainMax - m_domainMin)*i/(m_dimension - 1.0f);
+}
+
+// Returns the grid sample of lattice sample i along an axis
+unsigned int ImplicitSurface::latticeSample(unsigned int i) const {
+    return std::min(i*BLOCK_CELLS, m_dimension - 1);
+}
+
+// Samples F on the lattice and the steepest slope along the lattice edges of every block
+void ImplicitSurface::sampleLattice(unsigned int threadCount) {
+    unsigned int cells = m_dimension - 1;
+    m_blockDimension = (cells + BLOCK_CELLS - 1)/BLOCK_CELLS;
+    m_latticeDimension = m_blockDimension + 1;
+    unsigned int side = m_latticeDimension;
+    m_lattice.resize((size_t)side*side*side);
+    {
+        ThreadPool pool(threadCount);
+        for (unsigned int z = 0; z < side; z++) {
+            pool.submit([this, z, side]() {
+                Equation& expression = Equation::forThread(m_equation, {"x", "y", "z"});
+                for (unsigned int y = 0; y < side; y++) {
+                    for (unsigned int x = 0; x < side; x++) {
+                        m_lattice[((size_t)z*side + y)*side + x] = sample(expression, latticeSample(x), latticeSample(y), latticeSample(z));
+                    }
+                }
+            });
+        }
+        pool.wait();
+    }
+    m_sampleCount += m_lattice.size();
+
+    const CubeCases& cases = cubeCases();
+    unsigned int blocks = m_blockDimension;
+    m_blockSlopes.assign((size_t)blocks*blocks*blocks, 0.0f);
+    for (unsigned int z = 0; z < blocks; z++) {
+        for (unsigned int y = 0; y < blocks; y++) {
+            for (unsigned int x = 0; x < blocks; x++) {
+                float slope = 0.0f;
+                for (unsigned int edge = 0; edge < 12; edge++) {
+                    unsigned int corner = cases.edgeStart[edge];
+                    unsigned int axis = cases.edgeAxis[edge];
+                    unsigned int from[3] = {x + (corner & 1), y + (corner >> 1 & 1), z + (corner >> 2 & 1)};
+                    unsigned int to[3] = {from[0], from[1], from[2]};
+                    to[axis]++;
+                    float a = m_lattice[((size_t)from[2]*side + from[1])*side + from[0]];
+                    float b = m_lattice[((size_t)to[2]*side + to[1])*side + to[0]];
+                    float distance = coordinate(latticeSample(to[axis])) - coordinate(latticeSample(from[axis]));
+                    // An undefined end says nothing about the slope; blockMayCross samples such blocks anyway
+                    if (!std::isnan(a) && !std::isnan(b)) {
+                        slope = std::max(slope, std::fabs(b - a)/distance);
+                    }
+                }
+                m_blockSlopes[((size_t)z*blocks + y)*blocks + x] = slope;
+            }
+        }
+    }
+}
+
+// Returns true if the surface may pass through block (x, y, z)
+bool ImplicitSurface::blockMayCross(unsigned int x, unsigned int y, unsigned int z) const {
+    unsigned int side = m_latticeDimension;
+    float low = INFINITY;
+    float high = -INFINITY;
+    unsigned int defined = 0;
+    for (unsigned int corner = 0; corner < 8; corner++) {
+        float value = m_lattice[((size_t)(z + (corner >> 2 & 1))*side + y + (corner >> 1 & 1))*side + x + (corner & 1)];
+        if (!std::isnan(value)) {
+            low = std::min(low, value);
+            high = std::max(high, value);
+            defined++;
+        }
+    }
+    // Cells are only extracted where all their corners are defined
+    if (defined == 0) {
+        return false;
+    }
+    if (defined < 8 || (low < 0.0f) != (high < 0.0f)) {
+        return true;
+    }
+
+    // How far F could fall to 0 from the nearest corner at the steepest slope around the block
+    unsigned int blocks = m_blockDimension;
+    float slope = 0.0f;
+    for (unsigned int k = (z > 0 ? z - 1 : 0); k <= std::min(z + 1, blocks - 1); k++) {
+        for (unsigned int j = (y > 0 ? y - 1 : 0); j <= std::min(y + 1, blocks - 1); j++) {
+            for (unsigned int i = (x > 0 ? x - 1 : 0); i <= std::min(x + 1, blocks - 1); i++) {
+                slope = std::max(slope, m_blockSlopes[((size_t)k*blocks + j)*blocks + i]);
+            }
+        }
+    }
+    float extent[3];
+    unsigned int block[3] = {x, y, z};
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        extent[axis] = coordinate(latticeSample(block[axis] + 1)) - coordinate(latticeSample(block[axis]));
+    }
+    float halfDiagonal = 0.5f*std::sqrt(extent[0]*extent[0] + extent[1]*extent[1] + extent[2]*extent[2]);
+    float nearest = low >= 0.0f ? low : -high;
+    return nearest <= PRUNING_SAFETY*slope*halfDiagonal;
+}
+
+// Runs marching cubes over the blocks of brick (x, y, z) that the surface may pass through
+void ImplicitSurface::extractBrick(unsigned int x, unsigned int y, unsigned int z, BrickMesh& mesh) const {
+    mesh.sampleCount = 0;
+    unsigned int cells = m_dimension - 1;
+    const unsigned int blocksPerBrick = BRICK_CELLS/BLOCK_CELLS;
+    unsigned int brick[3] = {x, y, z};
+
+    // Blocks of the brick the surface may pass through
+    std::vector<unsigned int> blocks;
+    unsigned int blockEnd[3];
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        blockEnd[axis] = std::min((brick[axis] + 1)*blocksPerBrick, m_blockDimension);
+    }
+    for (unsigned int k = z*blocksPerBrick; k < blockEnd[2]; k++) {
+        for (unsigned int j = y*blocksPerBrick; j < blockEnd[1]; j++) {
+            for (unsigned int i = x*blocksPerBrick; i < blockEnd[0]; i++) {
+                if (blockMayCross(i, j, k)) {
+                    blocks.insert(blocks.end(), {i, j, k});
+                }
+            }
+        }
+    }
+    if (blocks.empty()) {
+        return;
+    }
+
+    // Samples of the brick, only taken where a block needs them
+    Equation& expression = Equation::forThread(m_equation, {"x", "y", "z"});
+    unsigned int first[3];
+    unsigned int size[3];
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        first[axis] = brick[axis]*BRICK_CELLS;
+        size[axis] = std::min(BRICK_CELLS, cells - first[axis]) + 1;
+    }
+    auto local = [&](unsigned int i, unsigned int j, unsigned int k) {
+        return ((size_t)k*size[1] + j)*size[0] + i;
+    };
+    std::vector<float> values((size_t)size[0]*size[1]*size[2], NAN);
+    std::vector<unsigned char> sampled(values.size(), 0);
+    for (size_t b = 0; b < blocks.size(); b += 3) {
+        unsigned int begin[3];
+        unsigned int end[3];
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            begin[axis] = blocks[b + axis]*BLOCK_CELLS - first[axis];
+            end[axis] = std::min(blocks[b + axis]*BLOCK_CELLS + BLOCK_CELLS, cells) - first[axis];
+        }
+        for (unsigned int k = begin[2]; k <= end[2]; k++) {
+            for (unsigned int j = begin[1]; j <= end[1]; j++) {
+                for (unsigned int i = begin[0]; i <= end[0]; i++) {
+                    size_t index = local(i, j, k);
+                    if (!sampled[index]) {
+                        values[index] = sample(expression, first[0] + i, first[1] + j, first[2] + k);
+                        sampled[index] = 1;
+                        mesh.sampleCount++;
+                    }
+                }
+            }
+        }
+    }
+
+    // Vertex on the edge leaving each sample along each axis
+    std::vector<unsigned int> edgeVertices(values.size()*3, NO_VERTEX);
+    float step = 0.5f*(m_domainMax - m_domainMin)/(m_dimension - 1.0f); // for the gradient
+    auto vertexOn = [&](unsigned int i, unsigned int j, unsigned int k, unsigned int axis) {
+        size_t from = local(i, j, k);
+        unsigned int& vertex = edgeVertices[from*3 + axis];
+        if (vertex != NO_VERTEX) {
+            return vertex;
+        }
+        unsigned int at[3] = {i, j, k};
+        unsigned int to[3] = {i, j, k};
+        to[axis]++;
+        float a = values[from];
+        float b = values[local(to[0], to[1], to[2])];
+        float t = a/(a - b);
+        float position[3];
+        for (unsigned int n = 0; n < 3; n++) {
+            position[n] = coordinate(first[n] + at[n] + (n == axis ? t : 0.0f));
+        }
+        float gradient[3];
+        for (unsigned int n = 0; n < 3; n++) {
+            float above[3] = {position[0], position[1], position[2]};
+            float below[3] = {position[0], position[1], position[2]};
+            above[n] += step;
+            below[n] -= step;
+            gradient[n] = (expression.value(above[0], above[1], above[2]) - expression.value(below[0], below[1], below[2]))/(2*step);
+        }
+        mesh.sampleCount += 6;
+        glm::vec3 normal(gradient[0], gradient[2], gradient[1]);
+        float length = glm::length(normal);
+        normal = std::isfinite(length) && length > 0.0f ? normal/length : glm::vec3(0.0f);
+
+        // Shaded like Graph::buildVertices, by height
+        float yellowTint = glm::clamp(Graph::toHeight(position[2])*8 - 3.8f, 0.0f, 1.0f);
+        float shade = 1.0f - yellowTint;
+        float data[12] = {position[0], position[2], position[1], normal.x, normal.y, normal.z,
+                          shade, shade, shade, 0.9f, 0.0f, 0.0f};
+        vertex = mesh.vertices.size()/12;
+        mesh.vertices.insert(mesh.vertices.end(), data, data + 12);
+
+        // Edges on a face of the brick are extracted by the neighbour too
+        bool shared = false;
+        for (unsigned int n = 0; n < 3; n++) {
+            if (n != axis && (at[n] == 0 || at[n] == size[n] - 1)) {
+                shared = true;
+            }
+        }
+        unsigned long long key = 0;
+        if (shared) {
+            unsigned long long global = ((unsigned long long)(first[2] + k)*m_dimension + first[1] + j)*m_dimension + first[0] + i;
+            key = global*3 + axis + 1;
+        }
+        mesh.keys.push_back(key);
+        return vertex;
+    };
+
+    const CubeCases& cases = cubeCases();
+    for (size_t b = 0; b < blocks.size(); b += 3) {
+        unsigned int begin[3];
+        unsigned int end[3];
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            begin[axis] = blocks[b + axis]*BLOCK_CELLS - first[axis];
+            end[axis] = std::min(blocks[b + axis]*BLOCK_CELLS + BLOCK_CELLS, cells) - first[axis];
+        }
+        for (unsigned int k = begin[2]; k < end[2]; k++) {
+            for (unsigned int j = begin[1]; j < end[1]; j++) {
+                for (unsigned int i = begin[0]; i < end[0]; i++) {
+                    unsigned int inside = 0;
+                    bool defined = true;
+                    for (unsigned int corner = 0; corner < 8; corner++) {
+                        float value = values[local(i + (corner & 1), j + (corner >> 1 & 1), k + (corner >> 2 & 1))];
+                        defined = defined && !std::isnan(value);
+                        inside |= (value < 0.0f ? 1u : 0u) << corner;
+                    }
+                    if (!defined) {
+                        continue;
+                    }
+                    for (unsigned char edge : cases.triangles[inside]) {
+                        unsigned int corner = cases.edgeStart[edge];
+                        mesh.indices.push_back(vertexOn(i + (corner & 1), j + (corner >> 1 & 1), k + (corner >> 2 & 1),
+                                                        cases.edgeAxis[edge]));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Appends the bricks to the buffers, welding the vertices they share
+void ImplicitSurface::weldBricks(std::vector<BrickMesh>& bricks) {
+    std::unordered_map<unsigned long long, unsigned int> shared; // edge key, vertex in m_VBO
+    for (BrickMesh& mesh : bricks) {
+        m_sampleCount += mesh.sampleCount;
+        if (mesh.indices.empty()) {
+            continue;
+        }
+        std::vector<unsigned int> remap(mesh.keys.size());
+        for (size_t v = 0; v < mesh.keys.size(); v++) {
+            if (mesh.keys[v] != 0) {
+                auto found = shared.find(mesh.keys[v]);
+                if (found != shared.end()) {
+                    remap[v] = found->second;
+                    continue;
+                }
+                shared.emplace(mesh.keys[v], (unsigned int)(m_VBO.size()/12));
+            }
+            remap[v] = m_VBO.size()/12;
+            m_VBO.insert(m_VBO.end(), mesh.vertices.begin() + v*12, mesh.vertices.begin() + v*12 + 12);
+        }
+
+        GraphChunk chunk;
+        chunk.firstIndex = m_IBO.size();
+        chunk.indexCount = mesh.indices.size();
+        chunk.min = glm::vec3(INFINITY);
+        chunk.max = glm::vec3(-INFINITY);
+        for (unsigned int index : mesh.indices) {
+            m_IBO.push_back(remap[index]);
+        }
+        for (unsigned int vertex : remap) {
+            glm::vec3 position(m_VBO[(size_t)vertex*12], m_VBO[(size_t)vertex*12 + 1], m_VBO[(size_t)vertex*12 + 2]);
+            chunk.min = glm::min(chunk.min, position);
+            chunk.max = glm::max(chunk.max, position);
+        }
+        m_chunks.push_back(chunk);
+        mesh = BrickMesh();
+    }
+}
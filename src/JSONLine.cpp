@@ -0,0 +1,181 @@
+/** @file JSONLine.cpp
+ * @brief Flat JSON object parsing and value formatting.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "JSONLine.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+// Moves p past whitespace
+static void skipSpace(const std::string& text, size_t& p) {
+    while (p < text.size() && (text[p] == ' ' || text[p] == '\t' || text[p] == '\r' || text[p] == '\n')) {
+        p++;
+    }
+}
+
+// Appends a code point as UTF-8
+static void appendUTF8(std::string& out, unsigned int codePoint) {
+    if (codePoint < 0x80) {
+        out += (char)codePoint;
+    } else if (codePoint < 0x800) {
+        out += (char)(0xC0 | (codePoint >> 6));
+        out += (char)(0x80 | (codePoint & 0x3F));
+    } else {
+        out += (char)(0xE0 | (codePoint >> 12));
+        out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Reads a quoted string starting at p into out. Returns false on malformed input.
+static bool readString(const std::string& text, size_t& p, std::string& out) {
+    if (p >= text.size() || text[p] != '"') {
+        return false;
+    }
+    p++;
+    out.clear();
+    while (p < text.size() && text[p] != '"') {
+        char c = text[p++];
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (p >= text.size()) {
+            return false;
+        }
+        char escape = text[p++];
+        switch (escape) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (p + 4 > text.size()) {
+                    return false;
+                }
+                unsigned int codePoint = 0;
+                if (std::sscanf(text.substr(p, 4).c_str(), "%4x", &codePoint) != 1) {
+                    return false;
+                }
+                appendUTF8(out, codePoint);
+                p += 4;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    if (p >= text.size()) {
+        return false;
+    }
+    p++; // closing quote
+    return true;
+}
+
+// Parses a flat JSON object. String values are unescaped, other values are kept as written
+// (e.g. "401", "true"). Returns false and sets error on malformed input or nested values.
+bool ParseJSONObject(const std::string& text, std::map<std::string, std::string>& fields, std::string& error) {
+    fields.clear();
+    size_t p = 0;
+    skipSpace(text, p);
+    if (p >= text.size() || text[p] != '{') {
+        error = "expected '{'";
+        return false;
+    }
+    p++;
+    skipSpace(text, p);
+    if (p < text.size() && text[p] == '}') {
+        return true;
+    }
+
+    while (true) {
+        std::string key;
+        skipSpace(text, p);
+        if (!readString(text, p, key)) {
+            error = "expected a quoted key at offset " + std::to_string(p);
+            return false;
+        }
+        skipSpace(text, p);
+        if (p >= text.size() || text[p] != ':') {
+            error = "expected ':' after \"" + key + "\"";
+            return false;
+        }
+        p++;
+        skipSpace(text, p);
+
+        std::string value;
+        if (p < text.size() && text[p] == '"') {
+            if (!readString(text, p, value)) {
+                error = "unterminated string for \"" + key + "\"";
+                return false;
+            }
+        } else if (p < text.size() && (text[p] == '{' || text[p] == '[')) {
+            error = "nested values are not supported (\"" + key + "\")";
+            return false;
+        } else {
+            size_t start = p;
+            while (p < text.size() && text[p] != ',' && text[p] != '}' && text[p] != ' ' && text[p] != '\t') {
+                p++;
+            }
+            value = text.substr(start, p - start);
+            if (value.empty()) {
+                error = "missing value for \"" + key + "\"";
+                return false;
+            }
+        }
+        fields[key] = value;
+
+        skipSpace(text, p);
+        if (p < text.size() && text[p] == ',') {
+            p++;
+            continue;
+        }
+        if (p < text.size() && text[p] == '}') {
+            return true;
+        }
+        error = "expected ',' or '}' at offset " + std::to_string(p);
+        return false;
+    }
+}
+
+// Returns text as a quoted, escaped JSON string
+std::string JSONString(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+// Returns a number as JSON text, null for NaN or infinity
+std::string JSONNumber(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    std::ostringstream out;
+    out.precision(9);
+    out << value;
+    return out.str();
+}
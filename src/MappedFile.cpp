@@ -0,0 +1,84 @@
+/** @file MappedFile.cpp
+ * @brief Class implementation for a read-only view of a whole file in memory.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "MappedFile.hpp"
+
+#if defined(MINGW)
+    #include <fstream>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Constructor maps the whole file read-only
+MappedFile::MappedFile(std::string filePath) : m_open(false), m_data(nullptr), m_size(0), m_mapped(false) {
+#if !defined(MINGW)
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0) {
+        m_open = true;
+        m_size = info.st_size;
+
+        // mmap refuses zero length mappings, an empty file is simply open with no data
+        if (m_size > 0) {
+            void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                madvise(mapping, m_size, MADV_SEQUENTIAL);
+                m_data = (const char*)mapping;
+                m_mapped = true;
+            } else {
+                m_open = false;
+                m_size = 0;
+            }
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+#else
+    std::ifstream inFile(filePath, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!inFile.is_open()) {
+        return;
+    }
+
+    m_size = inFile.tellg();
+    m_buffer.resize(m_size);
+    inFile.seekg(0);
+    inFile.read(m_buffer.data(), m_size);
+    m_data = m_buffer.data();
+    m_open = true;
+#endif
+}
+
+//Destructor unmaps the file
+MappedFile::~MappedFile() {
+#if !defined(MINGW)
+    if (m_mapped) {
+        munmap((void*)m_data, m_size);
+    }
+#endif
+}
+
+// Returns true if the file could be opened (an empty file is open with size 0)
+bool MappedFile::isOpen() const {
+    return m_open;
+}
+
+// Returns the first byte of the file
+const char* MappedFile::getData() const {
+    return m_data;
+}
+
+// Returns the size of the file in bytes
+size_t MappedFile::getSize() const {
+    return m_size;
+}
@@ -0,0 +1,216 @@
+/** @file MinMaxPyramid.cpp
+ * @brief Class implementation for tracing rays through a min-max pyramid of a graph's heights.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "MinMaxPyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Plotted z range, from Graph.cpp
+extern float z_bound;
+
+// Slack on the triangle edges, so a ray through the seam of two cells hits one of them
+const float EDGE_TOLERANCE = 1e-5f;
+
+// Returns true and sets t if origin + t*direction meets triangle abc at t >= 0 (Moller-Trumbore)
+static bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+                              const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& t) {
+    glm::vec3 edge1 = b - a;
+    glm::vec3 edge2 = c - a;
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (determinant == 0.0f) {
+        return false;
+    }
+    float inverse = 1.0f/determinant;
+    glm::vec3 s = origin - a;
+    float u = glm::dot(s, p)*inverse;
+    if (u < -EDGE_TOLERANCE || u > 1.0f + EDGE_TOLERANCE) {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q)*inverse;
+    if (v < -EDGE_TOLERANCE || u + v > 1.0f + EDGE_TOLERANCE) {
+        return false;
+    }
+    t = glm::dot(edge2, q)*inverse;
+    return t >= 0.0f;
+}
+
+// Constructor builds the pyramid over dimension*dimension normalized heights sampled over [domainMin, domainMax]^2
+MinMaxPyramid::MinMaxPyramid(const float* heights, unsigned int dimension, float domainMin, float domainMax) {
+    m_dimension = dimension;
+    m_domainMin = domainMin;
+    m_domainMax = domainMax;
+    if (dimension < 2) {
+        return;
+    }
+
+    // Heights as drawn (see Graph::buildVertices)
+    m_heights.resize((size_t)dimension*dimension);
+    for (size_t i = 0; i < m_heights.size(); i++) {
+        m_heights[i] = heights[i] < 0.0f ? NAN : std::clamp(heights[i]*(z_bound*2) - z_bound, -z_bound, z_bound);
+    }
+
+    // Level 0 is read from the heights, every level above from the one below
+    m_sizes.push_back(dimension - 1);
+    while (m_sizes.back() > 1) {
+        unsigned int below = m_sizes.back();
+        unsigned int size = (below + 1)/2;
+        std::vector<glm::vec2> level((size_t)size*size);
+        for (unsigned int row = 0; row < size; row++) {
+            for (unsigned int column = 0; column < size; column++) {
+                glm::vec2 range(INFINITY, -INFINITY);
+                for (unsigned int y = row*2; y < std::min(row*2 + 2, below); y++) {
+                    for (unsigned int x = column*2; x < std::min(column*2 + 2, below); x++) {
+                        glm::vec2 child = bounds((unsigned int)m_sizes.size() - 1, x, y);
+                        range = glm::vec2(std::min(range.x, child.x), std::max(range.y, child.y));
+                    }
+                }
+                level[(size_t)row*size + column] = range;
+            }
+        }
+        m_levels.push_back(std::move(level));
+        m_sizes.push_back(size);
+    }
+}
+
+// Returns the number of levels, the cells included
+unsigned int MinMaxPyramid::getLevelCount() const {
+    return m_sizes.size();
+}
+
+// Returns the model position of sample (column, row), whose height is NaN if it is undefined
+glm::vec3 MinMaxPyramid::vertex(unsigned int column, unsigned int row) const {
+    float span = m_domainMax - m_domainMin;
+    return glm::vec3(m_domainMin + span*column/(m_dimension - 1.0f),
+                     m_heights[(size_t)row*m_dimension + column],
+                     m_domainMin + span*row/(m_dimension - 1.0f));
+}
+
+// Returns the lowest and highest drawn height of a block as x and y, x > y if nothing is drawn in it
+glm::vec2 MinMaxPyramid::bounds(unsigned int level, unsigned int column, unsigned int row) const {
+    if (level > 0) {
+        return m_levels[level - 1][(size_t)row*m_sizes[level] + column];
+    }
+    // The corners of the cell's triangles that Graph draws, the ones with three defined heights
+    size_t curr = (size_t)row*m_dimension + column;
+    float corner00 = m_heights[curr];
+    float corner10 = m_heights[curr + 1];
+    float corner01 = m_heights[curr + m_dimension];
+    float corner11 = m_heights[curr + m_dimension + 1];
+    glm::vec2 range(INFINITY, -INFINITY);
+    if (!std::isnan(corner10) && !std::isnan(corner01)) {
+        if (!std::isnan(corner00)) {
+            range = glm::vec2(std::min({corner00, corner10, corner01}), std::max({corner00, corner10, corner01}));
+        }
+        if (!std::isnan(corner11)) {
+            range = glm::vec2(std::min({range.x, corner11, corner10, corner01}), std::max({range.y, corner11, corner10, corner01}));
+        }
+    }
+    return range;
+}
+
+// Returns true and sets enter if the ray meets the box of a block before maxDistance
+bool MinMaxPyramid::enterBlock(const Block& block, const glm::vec3& origin, const glm::vec3& inverseDirection,
+                               float maxDistance, float& enter) const {
+    glm::vec2 range = bounds(block.level, block.column, block.row);
+    if (range.x > range.y) {
+        return false;
+    }
+    // Cells [first, last) in x and y
+    unsigned int cells = m_dimension - 1;
+    glm::uvec2 first(block.column << block.level, block.row << block.level);
+    glm::uvec2 last(std::min((block.column + 1) << block.level, cells), std::min((block.row + 1) << block.level, cells));
+    float span = m_domainMax - m_domainMin;
+    glm::vec3 low(m_domainMin + span*first.x/cells, range.x, m_domainMin + span*first.y/cells);
+    glm::vec3 high(m_domainMin + span*last.x/cells, range.y, m_domainMin + span*last.y/cells);
+
+    // Slabs
+    glm::vec3 t0 = (low - origin)*inverseDirection;
+    glm::vec3 t1 = (high - origin)*inverseDirection;
+    glm::vec3 near = glm::min(t0, t1);
+    glm::vec3 far = glm::max(t0, t1);
+    float entry = std::max({near.x, near.y, near.z, 0.0f});
+    float exit = std::min({far.x, far.y, far.z});
+    if (entry > exit || entry >= maxDistance) {
+        return false;
+    }
+    enter = entry;
+    return true;
+}
+
+// Intersects the ray with the triangles of a cell, keeping the hit if it is nearer than hit.distance
+void MinMaxPyramid::intersectCell(unsigned int column, unsigned int row, const glm::vec3& origin,
+                                  const glm::vec3& direction, PyramidHit& hit) const {
+    glm::vec3 corner00 = vertex(column, row);
+    glm::vec3 corner10 = vertex(column + 1, row);
+    glm::vec3 corner01 = vertex(column, row + 1);
+    glm::vec3 corner11 = vertex(column + 1, row + 1);
+    if (std::isnan(corner10.y) || std::isnan(corner01.y)) {
+        return;
+    }
+    // The ray can pass through both triangles, the nearer one counts
+    float nearest = hit.distance;
+    float t = 0.0f;
+    if (!std::isnan(corner00.y) && intersectTriangle(origin, direction, corner00, corner10, corner01, t) && t < nearest) {
+        nearest = t;
+    }
+    if (!std::isnan(corner11.y) && intersectTriangle(origin, direction, corner10, corner11, corner01, t) && t < nearest) {
+        nearest = t;
+    }
+    if (nearest < hit.distance) {
+        hit.distance = nearest;
+        hit.position = origin + direction*nearest;
+        hit.column = column;
+        hit.row = row;
+    }
+}
+
+// Finds the nearest point at t >= 0 where origin + t*direction meets a triangle of the graph
+bool MinMaxPyramid::intersect(const glm::vec3& origin, const glm::vec3& direction, PyramidHit& hit) const {
+    hit.distance = INFINITY;
+    if (m_sizes.empty()) {
+        return false;
+    }
+    glm::vec3 inverseDirection = 1.0f/direction;
+
+    Block root = {(unsigned int)m_sizes.size() - 1, 0, 0, 0.0f};
+    if (!enterBlock(root, origin, inverseDirection, INFINITY, root.enter)) {
+        return false;
+    }
+    std::vector<Block> stack;
+    stack.reserve(m_sizes.size()*4);
+    stack.push_back(root);
+    while (!stack.empty()) {
+        Block block = stack.back();
+        stack.pop_back();
+        // Blocks entered behind the nearest hit can not hold a nearer one
+        if (block.enter >= hit.distance) {
+            continue;
+        }
+        if (block.level == 0) {
+            intersectCell(block.column, block.row, origin, direction, hit);
+            continue;
+        }
+
+        // The children the ray meets, pushed farthest first so the nearest is taken next
+        Block children[4];
+        unsigned int count = 0;
+        unsigned int size = m_sizes[block.level - 1];
+        for (unsigned int y = block.row*2; y < std::min(block.row*2 + 2, size); y++) {
+            for (unsigned int x = block.column*2; x < std::min(block.column*2 + 2, size); x++) {
+                Block child = {block.level - 1, x, y, 0.0f};
+                if (enterBlock(child, origin, inverseDirection, hit.distance, child.enter)) {
+                    children[count++] = child;
+                }
+            }
+        }
+        std::sort(children, children + count, [](const Block& a, const Block& b) { return a.enter > b.enter; });
+        stack.insert(stack.end(), children, children + count);
+    }
+    return hit.distance < INFINITY;
+}
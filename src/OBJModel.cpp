@@ -5,125 +5,122 @@
  */
 
 #include <OBJModel.hpp>
+#include <OBJParser.hpp>
+#include <MappedFile.hpp>
+#include <Hash.hpp>
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
 #include <fstream>
-
-// VertexData structure for filling VBO
-struct VertexData{
-	float x,y,z;
-	float s,t;
-
-	VertexData(float _x, float _y, float _z, float _s, float _t): x(_x),y(_y),z(_z),s(_s),t(_t) { }
-
-	// Tests if two VertexData are equal
-	bool operator== (const VertexData &rhs) const{
-		if( (x == rhs.x) && (y == rhs.y) && (z == rhs.z) && (s == rhs.s) && (t == rhs.t) ){
-			return true;
-		}
-		return false;
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+
+// Key of a unique vertex: the (position, texture coordinate, normal) indices of a face corner
+struct VertexKey{
+	unsigned int pos, text, norm;
+
+	// Tests if two VertexKey are equal
+	bool operator== (const VertexKey &rhs) const{
+		return pos == rhs.pos && text == rhs.text && norm == rhs.norm;
 	}
 };
 
-// Constructor loads a filename with the .obj extension
-OBJModel::OBJModel(std::string fileName) {
-    std::ifstream inFile;
-
-    inFile.open(fileName);
-
-    std::vector<float> Verts;
-    std::vector<float> VertNorms;
-    std::vector<float> VertTexts;
-
-    std::vector<unsigned int> Faces;
-
-    if (inFile.is_open()) {
-        std::string line;
-
-        while (getline(inFile, line)) {
-            int index = line.find('#');
-
-            if (index != std::string::npos) {
-                line = line.substr(0, index);
-            }
-
-            std::stringstream stream(line);
-
-            int lineType = -1;
-
-            std::string chunk;
-
-            while (stream >> chunk) {
-                if (lineType == -1) {
-                    if (chunk == "v") {
-                        lineType = 0;
-                    } else if (chunk == "vn") {
-                        lineType = 1;
-                    } else if (chunk == "f") {
-                        lineType = 2;
-                    } else if (chunk == "vt") {
-                        lineType = 3;
-                    } else if (chunk == "mtllib") {
-                        lineType = 4;
-                    } else {
-                        break;
-                    }
-                } else if (lineType == 0) {
-                    float value = stof(chunk);
-                    Verts.push_back(value);
-                } else if (lineType == 1) {
-                    float value = stof(chunk);
-                    VertNorms.push_back(value);
-                } else if (lineType == 2) {
-                    int slashesIndex = chunk.find("/");
-                    
-                    int vertIndex = stoi(chunk.substr(0, slashesIndex)) - 1;
-
-                    int slashesIndex2 = chunk.substr(slashesIndex + 1, chunk.length()).find("/");
-
-                    std::string part2 = chunk.substr(slashesIndex + 1, chunk.length());
+// Hash for VertexKey so unique vertices can be found in constant time
+struct VertexKeyHash{
+	size_t operator() (const VertexKey &key) const{
+		uint64_t h = key.pos;
+		h = h * 0x9E3779B97F4A7C15ull ^ key.text;
+		h = h * 0x9E3779B97F4A7C15ull ^ key.norm;
+		return (size_t)(h ^ (h >> 32));
+	}
+};
 
-                    int textureIndex = -1;
+// Bumped whenever the cache layout or the way buffers are built changes
+const uint32_t MESH_CACHE_VERSION = 1;
+
+// Header of a .meshcache file, followed by the VBO floats, the IBO indices and the two paths
+struct MeshCacheHeader {
+    char magic[4]; // "MESH"
+    uint32_t version; // MESH_CACHE_VERSION
+    FileStamp object; // the .obj the cache was built from
+    FileStamp material; // its .mtl (all zero if there is none)
+    uint64_t vertexFloats; // floats in the VBO
+    uint64_t indexCount; // indices in the IBO
+    uint32_t materialPathLength; // material file relative to the .obj
+    uint32_t texturePathLength; // texture file relative to the .obj
+};
 
-                    if (slashesIndex2 > 0) {
-                        textureIndex = stoi(part2.substr(0, slashesIndex2)) - 1;
-                    }
+// Reads the modification time and size of a file, and its hash if hashContents is set
+static bool stampFile(const std::string& filePath, FileStamp& stamp, bool hashContents) {
+    struct stat info;
+    if (stat(filePath.c_str(), &info) != 0) {
+        return false;
+    }
 
-                    int normIndex = stoi(part2.substr(slashesIndex2 + 1, chunk.length())) - 1;
+    stamp.modified = (int64_t)info.st_mtime;
+    stamp.size = (uint64_t)info.st_size;
+    stamp.hash = 0;
 
-                    Faces.push_back(vertIndex);
-                    Faces.push_back(textureIndex);
-                    Faces.push_back(normIndex);
-                } else if (lineType == 3) {
-                    float value =stof(chunk);
-                    VertTexts.push_back(value);
-                } else if (lineType == 4) {
-                    m_MaterialFile = chunk;
-                }
-            }
+    if (hashContents) {
+        MappedFile file(filePath);
+        if (!file.isOpen()) {
+            return false;
         }
+        stamp.hash = HashBytes(file.getData(), file.getSize());
     }
+    return true;
+}
 
-    inFile.close();
-
-    m_Verts = Verts;
-    m_VertTexts = VertTexts;
-    m_VertNorms = VertNorms;
-    m_Faces = Faces;
+// Tests if a file still matches a stamp; the contents are only hashed if time and size agree
+static bool stampMatches(const std::string& filePath, const FileStamp& expected) {
+    FileStamp stamp;
+    if (!stampFile(filePath, stamp, false) || stamp.modified != expected.modified || stamp.size != expected.size) {
+        return false;
+    }
+    return stampFile(filePath, stamp, true) && stamp.hash == expected.hash;
+}
 
-    int index = -1;
+// Constructor loads a filename with the .obj extension. The processed buffers are cached
+// next to it in <fileName>.meshcache and reused while the .obj and .mtl are unchanged.
+OBJModel::OBJModel(std::string fileName) {
+    int index = 0;
     for (int i = fileName.size() - 1; i >= 0; i--) {
         if (fileName.at(i) == *"/") {
             index = i + 1;
             break;
         }
     }
-
     m_ObjectPath = fileName.substr(0, index);
-    m_MaterialFile = fileName.substr(0, index) + m_MaterialFile;
+
+    std::string cacheFile = fileName + ".meshcache";
+    if (loadCache(fileName, cacheFile)) {
+        return;
+    }
+
+    OBJData data;
+    std::string error;
+
+    bool parsed = ParseOBJFile(fileName, data, error);
+    if (!parsed) {
+        std::cout << "Could not load " << fileName << ": " << error << std::endl;
+        data = OBJData();
+    }
+
+    m_Verts = std::move(data.verts);
+    m_VertTexts = std::move(data.texts);
+    m_VertNorms = std::move(data.norms);
+    m_Faces = std::move(data.faces);
+    m_MaterialFile = m_ObjectPath + data.materialFile;
 
     OBJModel::populateBuffers();
+    m_TextureFile = readTexture();
+
+    if (parsed) {
+        writeCache(fileName, cacheFile);
+    }
 }
 
 //Destructor clears any allocated memory
@@ -134,6 +131,11 @@ OBJModel::~OBJModel() {
 
 // Returns the string of the file of the texture (map_Kd)
 std::string OBJModel::getTexture() const {
+    return m_TextureFile;
+}
+
+// Reads the texture file (map_Kd) out of the material file
+std::string OBJModel::readTexture() const {
 
     std::ifstream inFile;
     
@@ -183,52 +185,168 @@ std::vector<unsigned int> OBJModel::getIBO() const {
     return m_IBO;
 }
 
+// Fills m_VBO with one vertex per unique (position, texture coordinate, normal) corner and m_IBO with their indices
 void OBJModel::populateBuffers() {
     std::vector<float> VBO;
     std::vector<unsigned int> IBO;
 
-    std::vector<VertexData> vertices;
-
-    for (int i = 0; i < m_Faces.size(); i = i + 3) {
-        unsigned int pos = m_Faces[i];
-        unsigned int text = m_Faces[i + 1];
-        unsigned int norm = m_Faces[i + 2];
-
-        float x = m_Verts[pos*3 + 0];
-        float y = m_Verts[pos*3 + 1];
-        float z = m_Verts[pos*3 + 2];
-
-        float s = m_VertTexts[text * 2 + 0];
-        float t = m_VertTexts[text * 2 + 1]; 
-        
-        VertexData vertex(x, y, z, s, t);
-
-        auto index = std::find(vertices.begin(), vertices.end(), vertex);
-
-        if (index == vertices.end()) {
-            VBO.push_back(x); // x
-            VBO.push_back(y); // y
-            VBO.push_back(z); // z
-            VBO.push_back(0); // xn
-            VBO.push_back(0); // yn
-            VBO.push_back(0); // zn
-            VBO.push_back(1); // r
-            VBO.push_back(1); // g
-            VBO.push_back(1); // b
-            VBO.push_back(1); // a
-            VBO.push_back(s); // s
-            VBO.push_back(t); // t
-            
-            IBO.push_back(vertices.size());
-
-            vertices.push_back(vertex);
-        } else {
-            int ind = index - vertices.begin();
-            IBO.push_back(ind);
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash> vertices;
+    vertices.reserve(m_Faces.size()/3);
+    IBO.reserve(m_Faces.size()/3);
+
+    for (size_t i = 0; i < m_Faces.size(); i = i + 3) {
+        VertexKey key = {m_Faces[i], m_Faces[i + 1], m_Faces[i + 2]};
+
+        auto index = vertices.find(key);
+
+        if (index != vertices.end()) {
+            IBO.push_back(index->second);
+            continue;
         }
 
+        float x = m_Verts[key.pos*3 + 0];
+        float y = m_Verts[key.pos*3 + 1];
+        float z = m_Verts[key.pos*3 + 2];
+
+        // Texture coordinates and normals are optional in a face (stored as -1)
+        float s = 0;
+        float t = 0;
+        if (key.text < m_VertTexts.size()/2) {
+            s = m_VertTexts[key.text * 2 + 0];
+            t = m_VertTexts[key.text * 2 + 1];
+        }
+
+        float xn = 0;
+        float yn = 0;
+        float zn = 0;
+        if (key.norm < m_VertNorms.size()/3) {
+            xn = m_VertNorms[key.norm * 3 + 0];
+            yn = m_VertNorms[key.norm * 3 + 1];
+            zn = m_VertNorms[key.norm * 3 + 2];
+        }
+
+        VBO.push_back(x); // x
+        VBO.push_back(y); // y
+        VBO.push_back(z); // z
+        VBO.push_back(xn); // xn
+        VBO.push_back(yn); // yn
+        VBO.push_back(zn); // zn
+        VBO.push_back(1); // r
+        VBO.push_back(1); // g
+        VBO.push_back(1); // b
+        VBO.push_back(1); // a
+        VBO.push_back(s); // s
+        VBO.push_back(t); // t
+
+        unsigned int newIndex = vertices.size();
+        vertices[key] = newIndex;
+        IBO.push_back(newIndex);
     }
 
     m_VBO = VBO;
     m_IBO = IBO;
 }
+
+// Loads m_VBO, m_IBO and the material paths from the cache if it matches the source files
+bool OBJModel::loadCache(const std::string& fileName, const std::string& cacheFile) {
+    MappedFile file(cacheFile);
+    if (!file.isOpen() || file.getSize() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    std::memcpy(&header, file.getData(), sizeof(MeshCacheHeader));
+    if (std::memcmp(header.magic, "MESH", 4) != 0 || header.version != MESH_CACHE_VERSION) {
+        return false;
+    }
+
+    // Bounded by the file before multiplying, so a corrupt count can not wrap around to the right size
+    size_t payloadSize = file.getSize() - sizeof(MeshCacheHeader);
+    if (header.vertexFloats > payloadSize/sizeof(float) || header.indexCount > payloadSize/sizeof(unsigned int)) {
+        return false;
+    }
+    size_t vertexBytes = header.vertexFloats*sizeof(float);
+    size_t indexBytes = header.indexCount*sizeof(unsigned int);
+    size_t expectedSize = sizeof(MeshCacheHeader) + vertexBytes + indexBytes + header.materialPathLength + header.texturePathLength;
+    if (file.getSize() != expectedSize) {
+        return false;
+    }
+    // Whole 12 float vertices and whole triangles only
+    if (header.vertexFloats % 12 != 0 || header.indexCount % 3 != 0) {
+        return false;
+    }
+
+    const char* data = file.getData() + sizeof(MeshCacheHeader);
+    const char* paths = data + vertexBytes + indexBytes;
+    std::string materialFile(paths, header.materialPathLength);
+    std::string textureFile(paths + header.materialPathLength, header.texturePathLength);
+
+    if (!stampMatches(fileName, header.object)) {
+        return false;
+    }
+    if (!materialFile.empty() && !stampMatches(m_ObjectPath + materialFile, header.material)) {
+        return false;
+    }
+
+    m_VBO.resize(header.vertexFloats);
+    m_IBO.resize(header.indexCount);
+    std::memcpy(m_VBO.data(), data, vertexBytes);
+    std::memcpy(m_IBO.data(), data + vertexBytes, indexBytes);
+    // An index past the vertices would be read out of bounds by every renderer
+    size_t vertexCount = header.vertexFloats/12;
+    for (unsigned int index : m_IBO) {
+        if (index >= vertexCount) {
+            m_VBO.clear();
+            m_IBO.clear();
+            return false;
+        }
+    }
+    m_MaterialFile = m_ObjectPath + materialFile;
+    m_TextureFile = textureFile.empty() ? "" : m_ObjectPath + textureFile;
+    return true;
+}
+
+// Writes m_VBO, m_IBO and the material paths to the cache
+void OBJModel::writeCache(const std::string& fileName, const std::string& cacheFile) const {
+    // Paths are stored relative to the .obj so the cache survives moving the folder
+    std::string materialFile = m_MaterialFile.substr(m_ObjectPath.size());
+    std::string textureFile = m_TextureFile.empty() ? "" : m_TextureFile.substr(m_ObjectPath.size());
+
+    MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(MeshCacheHeader));
+    std::memcpy(header.magic, "MESH", 4);
+    header.version = MESH_CACHE_VERSION;
+    header.vertexFloats = m_VBO.size();
+    header.indexCount = m_IBO.size();
+    header.materialPathLength = materialFile.size();
+    header.texturePathLength = textureFile.size();
+
+    if (!stampFile(fileName, header.object, true)) {
+        return;
+    }
+    if (!materialFile.empty() && !stampFile(m_MaterialFile, header.material, true)) {
+        return;
+    }
+
+    // Write next to the cache and rename so a reader never sees half a file
+    std::string tempFile = cacheFile + ".tmp";
+    std::ofstream outFile(tempFile, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) {
+        return;
+    }
+
+    outFile.write((const char*)&header, sizeof(MeshCacheHeader));
+    outFile.write((const char*)m_VBO.data(), m_VBO.size()*sizeof(float));
+    outFile.write((const char*)m_IBO.data(), m_IBO.size()*sizeof(unsigned int));
+    outFile.write(materialFile.data(), materialFile.size());
+    outFile.write(textureFile.data(), textureFile.size());
+    outFile.close();
+
+#if defined(MINGW)
+    // rename does not replace an existing file on Windows
+    std::remove(cacheFile.c_str());
+#endif
+    if (!outFile.good() || std::rename(tempFile.c_str(), cacheFile.c_str()) != 0) {
+        std::remove(tempFile.c_str());
+    }
+}
@@ -0,0 +1,392 @@
+/** @file OBJParser.cpp
+ * @brief Implementation of the in-place .obj parser.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "OBJParser.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Number of elements found in (or before) a range of lines
+struct OBJCounts {
+    size_t verts; // v lines
+    size_t texts; // vt lines
+    size_t norms; // vn lines
+    size_t faces; // f lines
+    size_t lines; // lines of text
+};
+
+// Returns the end of the line starting at p
+static inline const char* lineEnd(const char* p, const char* end) {
+    const char* newline = (const char*)std::memchr(p, '\n', end - p);
+    return newline == nullptr ? end : newline;
+}
+
+// Runs work(i) for every chunk i on its own thread and waits for all of them
+template <typename Work>
+static void runChunks(size_t chunkCount, Work work) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunkCount; i++) {
+        workers.push_back(std::thread(work, i));
+    }
+    work(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Returns true for the characters that separate tokens on a line
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Moves p past blanks, stopping at the end of the line
+static inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// Returns the end of the token starting at p
+static inline const char* tokenEnd(const char* p, const char* end) {
+    while (p < end && !isBlank(*p) && *p != '#') {
+        p++;
+    }
+    return p;
+}
+
+// Parses a float at p, moving p past it. Returns false if there is no number.
+static inline bool parseFloat(const char*& p, const char* end, float& value) {
+    if (p < end && *p == '+') {
+        p++;
+    }
+#if defined(__cpp_lib_to_chars)
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+#else
+    // Older standard libraries only have integer from_chars; strtof needs a terminated copy
+    char buffer[64];
+    size_t length = tokenEnd(p, end) - p;
+    if (length == 0 || length >= sizeof(buffer)) {
+        return false;
+    }
+    std::memcpy(buffer, p, length);
+    buffer[length] = '\0';
+    char* parsed = nullptr;
+    value = std::strtof(buffer, &parsed);
+    if (parsed == buffer) {
+        return false;
+    }
+    p += parsed - buffer;
+    return true;
+#endif
+}
+
+// Parses an integer at p, moving p past it. Returns false if there is no number.
+static inline bool parseInt(const char*& p, const char* end, long& value) {
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+// Reads up to count floats from a v, vt or vn line into values, padding missing ones with 0
+static bool parseFloats(const char* p, const char* end, int count, std::vector<float>& values) {
+    for (int i = 0; i < count; i++) {
+        p = skipBlanks(p, end);
+        float value = 0.0f;
+        if (p < end && *p != '#') {
+            if (!parseFloat(p, end, value)) {
+                return false;
+            }
+        }
+        values.push_back(value);
+    }
+    return true;
+}
+
+// Converts a 1 based (or negative, relative) .obj index to a 0 based one given the current count
+static inline bool resolveIndex(long index, size_t count, unsigned int& resolved) {
+    if (index > 0 && (size_t)index <= count) {
+        resolved = (unsigned int)(index - 1);
+        return true;
+    }
+    if (index < 0 && (size_t)(-index) <= count) {
+        resolved = (unsigned int)(count + index);
+        return true;
+    }
+    return false;
+}
+
+// Parses one corner of a face (v, v/t, v//n or v/t/n)
+static bool parseCorner(const char*& p, const char* end, const OBJCounts& available, unsigned int corner[3]) {
+    long index = 0;
+    corner[1] = OBJ_NO_INDEX;
+    corner[2] = OBJ_NO_INDEX;
+
+    if (!parseInt(p, end, index) || !resolveIndex(index, available.verts, corner[0])) {
+        return false;
+    }
+
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            if (!parseInt(p, end, index) || !resolveIndex(index, available.texts, corner[1])) {
+                return false;
+            }
+        }
+        if (p < end && *p == '/') {
+            p++;
+            if (!parseInt(p, end, index) || !resolveIndex(index, available.norms, corner[2])) {
+                return false;
+            }
+        }
+    }
+
+    // A corner must end at a blank, a comment or the end of the line
+    return p == end || isBlank(*p) || *p == '#';
+}
+
+// Parses an f line, fan triangulating polygons with more than three corners
+static bool parseFace(const char* p, const char* end, const OBJCounts& available, std::vector<unsigned int>& faces) {
+    unsigned int first[3];
+    unsigned int previous[3];
+    unsigned int corner[3];
+    int cornerCount = 0;
+
+    while (true) {
+        p = skipBlanks(p, end);
+        if (p == end || *p == '#') {
+            break;
+        }
+        if (!parseCorner(p, end, available, corner)) {
+            return false;
+        }
+
+        if (cornerCount == 0) {
+            std::memcpy(first, corner, sizeof(corner));
+        } else if (cornerCount >= 2) {
+            faces.insert(faces.end(), first, first + 3);
+            faces.insert(faces.end(), previous, previous + 3);
+            faces.insert(faces.end(), corner, corner + 3);
+        }
+        std::memcpy(previous, corner, sizeof(corner));
+        cornerCount++;
+    }
+
+    return cornerCount >= 3;
+}
+
+// Tests if the token [p, tokenEnd) is the given keyword
+static inline bool isKeyword(const char* p, const char* end, const char* keyword) {
+    size_t length = std::strlen(keyword);
+    return (size_t)(end - p) == length && std::memcmp(p, keyword, length) == 0;
+}
+
+// Counts v, vt, vn and f lines using the same keyword rules as parseRange
+static OBJCounts count(const char* begin, const char* end) {
+    OBJCounts counts = {0, 0, 0, 0, 0};
+
+    const char* p = begin;
+    while (p < end) {
+        const char* last = lineEnd(p, end);
+        const char* keyword = skipBlanks(p, last);
+        const char* keywordEnd = tokenEnd(keyword, last);
+
+        if (isKeyword(keyword, keywordEnd, "v")) {
+            counts.verts++;
+        } else if (isKeyword(keyword, keywordEnd, "vt")) {
+            counts.texts++;
+        } else if (isKeyword(keyword, keywordEnd, "vn")) {
+            counts.norms++;
+        } else if (isKeyword(keyword, keywordEnd, "f")) {
+            counts.faces++;
+        }
+        counts.lines++;
+
+        p = last + 1;
+    }
+
+    return counts;
+}
+
+// Parses the lines in [begin, end). base holds the elements and lines that come before begin in
+// the file, so relative indices and line numbers resolve the same as in one serial pass.
+static bool parseRange(const char* begin, const char* end, const OBJCounts& base, OBJData& data,
+                       bool& hasMaterial, std::string& error) {
+    size_t lineNumber = base.lines;
+    const char* p = begin;
+
+    while (p < end) {
+        const char* last = lineEnd(p, end);
+        lineNumber++;
+
+        const char* keyword = skipBlanks(p, last);
+        const char* keywordEnd = tokenEnd(keyword, last);
+
+        bool ok = true;
+        if (isKeyword(keyword, keywordEnd, "v")) {
+            ok = parseFloats(keywordEnd, last, 3, data.verts);
+        } else if (isKeyword(keyword, keywordEnd, "vt")) {
+            ok = parseFloats(keywordEnd, last, 2, data.texts);
+        } else if (isKeyword(keyword, keywordEnd, "vn")) {
+            ok = parseFloats(keywordEnd, last, 3, data.norms);
+        } else if (isKeyword(keyword, keywordEnd, "f")) {
+            OBJCounts available = {base.verts + data.verts.size()/3,
+                                   base.texts + data.texts.size()/2,
+                                   base.norms + data.norms.size()/3, 0, 0};
+            ok = parseFace(keywordEnd, last, available, data.faces);
+        } else if (isKeyword(keyword, keywordEnd, "mtllib")) {
+            // The rest of the line, so file names may contain spaces
+            const char* name = skipBlanks(keywordEnd, last);
+            const char* nameEnd = last;
+            while (nameEnd > name && isBlank(nameEnd[-1])) {
+                nameEnd--;
+            }
+            data.materialFile.assign(name, nameEnd);
+            hasMaterial = true;
+        }
+
+        if (!ok) {
+            error = "malformed line " + std::to_string(lineNumber) + ": " + std::string(p, last);
+            return false;
+        }
+
+        p = last + 1;
+    }
+
+    return true;
+}
+
+// Parses the .obj text in [begin, end) into data. Returns false and sets error on malformed input.
+bool ParseOBJ(const char* begin, const char* end, OBJData& data, std::string& error) {
+    OBJCounts counts = count(begin, end);
+    data.verts.reserve(data.verts.size() + counts.verts*3);
+    data.texts.reserve(data.texts.size() + counts.texts*2);
+    data.norms.reserve(data.norms.size() + counts.norms*3);
+    data.faces.reserve(data.faces.size() + counts.faces*9);
+
+    OBJCounts base = {data.verts.size()/3, data.texts.size()/2, data.norms.size()/3, 0, 0};
+    bool hasMaterial = false;
+    return parseRange(begin, end, base, data, hasMaterial, error);
+}
+
+// Parses the .obj text in [begin, end) on several threads. The text is split on line boundaries,
+// every chunk is counted, a prefix sum of the counts gives each worker the number of elements
+// before its chunk, then the workers parse into local arrays which are concatenated in order.
+// The result is identical to ParseOBJ.
+bool ParseOBJParallel(const char* begin, const char* end, OBJData& data, std::string& error, unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Split on line boundaries, keeping chunks large enough to be worth a thread
+    const size_t MIN_CHUNK_BYTES = 1 << 20;
+    size_t size = end - begin;
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, size/MIN_CHUNK_BYTES));
+    if (chunkCount == 1) {
+        return ParseOBJ(begin, end, data, error);
+    }
+
+    std::vector<const char*> bounds;
+    bounds.push_back(begin);
+    for (size_t i = 1; i < chunkCount; i++) {
+        const char* split = std::max(bounds.back(), begin + size*i/chunkCount);
+        split = lineEnd(split, end);
+        bounds.push_back(split < end ? split + 1 : end);
+    }
+    bounds.push_back(end);
+
+    // Count every chunk, then prefix sum the counts
+    std::vector<OBJCounts> counts(chunkCount);
+    runChunks(chunkCount, [&](size_t i) {
+        counts[i] = count(bounds[i], bounds[i + 1]);
+    });
+
+    std::vector<OBJCounts> bases(chunkCount);
+    OBJCounts total = {data.verts.size()/3, data.texts.size()/2, data.norms.size()/3, 0, 0};
+    for (size_t i = 0; i < chunkCount; i++) {
+        bases[i] = total;
+        total.verts += counts[i].verts;
+        total.texts += counts[i].texts;
+        total.norms += counts[i].norms;
+        total.faces += counts[i].faces;
+        total.lines += counts[i].lines;
+    }
+
+    // Parse every chunk into its own arrays
+    std::vector<OBJData> chunks(chunkCount);
+    std::vector<std::string> errors(chunkCount);
+    std::vector<char> results(chunkCount);
+    std::vector<char> materials(chunkCount);
+    runChunks(chunkCount, [&](size_t i) {
+        chunks[i].verts.reserve(counts[i].verts*3);
+        chunks[i].texts.reserve(counts[i].texts*2);
+        chunks[i].norms.reserve(counts[i].norms*3);
+        chunks[i].faces.reserve(counts[i].faces*9);
+        bool hasMaterial = false;
+        results[i] = parseRange(bounds[i], bounds[i + 1], bases[i], chunks[i], hasMaterial, errors[i]);
+        materials[i] = hasMaterial;
+    });
+
+    // The first failing chunk holds the error a serial parse would have stopped at
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (!results[i]) {
+            error = errors[i];
+            return false;
+        }
+        if (materials[i]) {
+            data.materialFile = chunks[i].materialFile;
+        }
+    }
+
+    // Prefix sum the chunk sizes and copy every chunk into place
+    std::vector<size_t> vertOffsets(chunkCount), textOffsets(chunkCount), normOffsets(chunkCount), faceOffsets(chunkCount);
+    size_t verts = data.verts.size(), texts = data.texts.size(), norms = data.norms.size(), faces = data.faces.size();
+    for (size_t i = 0; i < chunkCount; i++) {
+        vertOffsets[i] = verts;
+        textOffsets[i] = texts;
+        normOffsets[i] = norms;
+        faceOffsets[i] = faces;
+        verts += chunks[i].verts.size();
+        texts += chunks[i].texts.size();
+        norms += chunks[i].norms.size();
+        faces += chunks[i].faces.size();
+    }
+    data.verts.resize(verts);
+    data.texts.resize(texts);
+    data.norms.resize(norms);
+    data.faces.resize(faces);
+
+    runChunks(chunkCount, [&](size_t i) {
+        std::copy(chunks[i].verts.begin(), chunks[i].verts.end(), data.verts.begin() + vertOffsets[i]);
+        std::copy(chunks[i].texts.begin(), chunks[i].texts.end(), data.texts.begin() + textOffsets[i]);
+        std::copy(chunks[i].norms.begin(), chunks[i].norms.end(), data.norms.begin() + normOffsets[i]);
+        std::copy(chunks[i].faces.begin(), chunks[i].faces.end(), data.faces.begin() + faceOffsets[i]);
+    });
+
+    return true;
+}
+
+// Memory maps an .obj file and parses it. Returns false and sets error if it can not be read or parsed.
+bool ParseOBJFile(const std::string& fileName, OBJData& data, std::string& error) {
+    MappedFile file(fileName);
+    if (!file.isOpen()) {
+        error = "could not open " + fileName;
+        return false;
+    }
+    return ParseOBJParallel(file.getData(), file.getData() + file.getSize(), data, error);
+}
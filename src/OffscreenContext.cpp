@@ -0,0 +1,125 @@
+/** @file OffscreenContext.cpp
+ *  @brief Class implementation for a surfaceless EGL context.
+ *
+ *  @author Antoine Assaf
+ */
+#include "OffscreenContext.hpp"
+#include "ShaderProgram.hpp"
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+
+#if defined(LINUX)
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
+
+// Constructor
+OffscreenContext::OffscreenContext(){
+	m_display = nullptr;
+	m_context = nullptr;
+}
+
+// Destructor releases the context
+OffscreenContext::~OffscreenContext(){
+	Destroy();
+}
+
+#if defined(LINUX)
+
+// Creates an OpenGL 4.1 core context, makes it current and loads the OpenGL functions.
+// Returns false (after printing why) if that is not possible.
+bool OffscreenContext::Create(){
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(getPlatformDisplay != nullptr){
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+	if(display == EGL_NO_DISPLAY){
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)){
+		std::cout << "Could not initialize an EGL display" << std::endl;
+		return false;
+	}
+	m_display = display;
+
+	if(!eglBindAPI(EGL_OPENGL_API)){
+		std::cout << "EGL does not support desktop OpenGL" << std::endl;
+		return false;
+	}
+
+	// A config is only needed by displays without EGL_KHR_no_config_context
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	std::string extensionList = extensions != nullptr ? extensions : "";
+	if(extensionList.find("EGL_KHR_no_config_context") == std::string::npos){
+		const EGLint configAttributes[] = {
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLint configCount = 0;
+		if(!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0){
+			std::cout << "No EGL config supports OpenGL" << std::endl;
+			return false;
+		}
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 1,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if(context == EGL_NO_CONTEXT){
+		std::cout << "Could not create an OpenGL 4.1 core context (EGL error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+		return false;
+	}
+	m_context = context;
+
+	// Surfaceless: all drawing goes to framebuffer objects
+	if(!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)){
+		std::cout << "Could not make the context current without a surface" << std::endl;
+		return false;
+	}
+
+	if(!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)){
+		std::cout << "glad did not initialize" << std::endl;
+		return false;
+	}
+	ShaderProgram::LoadBinaryFunctions((GLADloadproc)eglGetProcAddress);
+	return true;
+}
+
+// Releases the context
+void OffscreenContext::Destroy(){
+	if(m_display == nullptr){
+		return;
+	}
+	eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if(m_context != nullptr){
+		eglDestroyContext(m_display, m_context);
+	}
+	eglTerminate(m_display);
+	m_display = nullptr;
+	m_context = nullptr;
+}
+
+#else
+
+// Creates an OpenGL 4.1 core context, makes it current and loads the OpenGL functions.
+// Returns false (after printing why) if that is not possible.
+bool OffscreenContext::Create(){
+	std::cout << "Headless rendering needs EGL and is only supported on Linux" << std::endl;
+	return false;
+}
+
+// Releases the context
+void OffscreenContext::Destroy(){
+}
+
+#endif
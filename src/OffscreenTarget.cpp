@@ -0,0 +1,154 @@
+/** @file OffscreenTarget.cpp
+ *  @brief Class implementation for an offscreen framebuffer with asynchronous readback.
+ *
+ *  @author Antoine Assaf
+ */
+#include "OffscreenTarget.hpp"
+
+#include <iostream>
+
+// Constructor
+OffscreenTarget::OffscreenTarget(){
+	m_framebuffer = 0;
+	m_colorBuffer = 0;
+	m_depthBuffer = 0;
+	m_nextBuffer = 0;
+	m_pending = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+// Destructor deletes the OpenGL objects
+OffscreenTarget::~OffscreenTarget(){
+	Destroy();
+}
+
+// Creates a width*height RGBA8 + 24 bit depth framebuffer and bufferCount pixel buffers.
+// Returns false if the framebuffer is incomplete.
+bool OffscreenTarget::Create(GLsizei width, GLsizei height, unsigned int bufferCount){
+	m_width = width;
+	m_height = height;
+
+	glGenRenderbuffers(1, &m_colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE){
+		std::cout << "Offscreen framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ")" << std::endl;
+		return false;
+	}
+
+	m_pixelBuffers.resize(bufferCount);
+	glGenBuffers(bufferCount, m_pixelBuffers.data());
+	for(unsigned int i = 0; i < bufferCount; i++){
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width*height*4, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
+
+// Deletes the OpenGL objects (while the context still exists)
+void OffscreenTarget::Destroy(){
+	if(!m_pixelBuffers.empty()){
+		glDeleteBuffers((GLsizei)m_pixelBuffers.size(), m_pixelBuffers.data());
+		m_pixelBuffers.clear();
+	}
+	if(m_framebuffer != 0){
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if(m_colorBuffer != 0){
+		glDeleteRenderbuffers(1, &m_colorBuffer);
+		m_colorBuffer = 0;
+	}
+	if(m_depthBuffer != 0){
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_depthBuffer = 0;
+	}
+	m_pending = 0;
+}
+
+// Makes the framebuffer the draw and read target
+void OffscreenTarget::Bind(){
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+}
+
+// Returns true if every pixel buffer holds a readback that was not finished yet
+bool OffscreenTarget::ReadbackQueueFull() const{
+	return m_pending == m_pixelBuffers.size();
+}
+
+// Returns true if a readback was started and not finished yet
+bool OffscreenTarget::ReadbackPending() const{
+	return m_pending > 0;
+}
+
+// Copies the framebuffer into the next free pixel buffer without waiting for it
+void OffscreenTarget::StartReadback(){
+	if(ReadbackQueueFull()){
+		std::cout << "OffscreenTarget: readback queue is full, finish a readback first" << std::endl;
+		return;
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[m_nextBuffer]);
+	// With a pack buffer bound the last argument is an offset, and the call returns at once
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_nextBuffer = (m_nextBuffer + 1) % m_pixelBuffers.size();
+	m_pending++;
+}
+
+// Maps the oldest pending pixel buffer and copies it into pixels as RGB, top row first.
+// Returns false if no readback is pending.
+bool OffscreenTarget::FinishReadback(std::vector<uint8_t>& pixels){
+	if(m_pending == 0){
+		return false;
+	}
+	unsigned int oldest = (m_nextBuffer + m_pixelBuffers.size() - m_pending) % m_pixelBuffers.size();
+	m_pending--;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[oldest]);
+	const uint8_t* mapped = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)m_width*m_height*4, GL_MAP_READ_BIT);
+	if(mapped == nullptr){
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		std::cout << "OffscreenTarget: could not map the pixel buffer" << std::endl;
+		return false;
+	}
+
+	// OpenGL rows start at the bottom
+	pixels.resize((size_t)m_width*m_height*3);
+	for(GLsizei y = 0; y < m_height; y++){
+		const uint8_t* source = mapped + (size_t)(m_height - 1 - y)*m_width*4;
+		uint8_t* destination = pixels.data() + (size_t)y*m_width*3;
+		for(GLsizei x = 0; x < m_width; x++){
+			destination[x*3 + 0] = source[x*4 + 0];
+			destination[x*3 + 1] = source[x*4 + 1];
+			destination[x*3 + 2] = source[x*4 + 2];
+		}
+	}
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
+
+// Returns the size of the framebuffer
+GLsizei OffscreenTarget::GetWidth() const{
+	return m_width;
+}
+
+// Returns the size of the framebuffer
+GLsizei OffscreenTarget::GetHeight() const{
+	return m_height;
+}
@@ -0,0 +1,197 @@
+/** @file ParametricSurface.cpp
+ * @brief Class implementation for sampling a parametric surface (u,v) -> (x,y,z).
+ *
+ * @author Antoine Assaf
+ */
+
+#include "ParametricSurface.hpp"
+#include "Equation.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Constructor samples the surface dimension*dimension times over [uMin, uMax]x[vMin, vMax]
+ParametricSurface::ParametricSurface(std::string equation, unsigned int dimension, float uMin, float uMax,
+                                     float vMin, float vMax, unsigned int threadCount) {
+    m_dimension = std::max(dimension, 2u);
+    m_uMin = uMin;
+    m_uMax = uMax;
+    m_vMin = vMin;
+    m_vMax = vMax;
+    m_positions.resize((size_t)m_dimension*m_dimension);
+    m_VBO.resize(m_positions.size()*12);
+
+    std::string program;
+    toProgram(equation, program);
+    {
+        // Normals need the rows on both sides of a band, so all positions come first
+        ThreadPool pool(threadCount);
+        for (unsigned int row = 0; row < m_dimension; row += Graph::CHUNK_CELLS) {
+            unsigned int end = std::min(row + Graph::CHUNK_CELLS, m_dimension);
+            pool.submit([this, program, row, end]() { sampleRows(program, row, end); });
+        }
+        pool.wait();
+        for (unsigned int row = 0; row < m_dimension; row += Graph::CHUNK_CELLS) {
+            unsigned int end = std::min(row + Graph::CHUNK_CELLS, m_dimension);
+            pool.submit([this, row, end]() { buildRows(row, end); });
+        }
+        pool.wait();
+    }
+    buildIndices();
+}
+
+// Returns the 12 float vertices, row by row
+const std::vector<float>& ParametricSurface::getVBO() const {
+    return m_VBO;
+}
+
+// Returns the triangle indices, tile by tile
+const std::vector<unsigned int>& ParametricSurface::getIBO() const {
+    return m_IBO;
+}
+
+// Returns the tiles that have triangles, in the order of their indices in getIBO, each with its bounding box
+const std::vector<GraphChunk>& ParametricSurface::getChunks() const {
+    return m_chunks;
+}
+
+// Turns "x(u,v), y(u,v), z(u,v)" (after any statements) into the program that assigns x, y and z
+bool ParametricSurface::toProgram(const std::string& equation, std::string& program) {
+    // Commas inside brackets separate function arguments, not components
+    int depth = 0;
+    size_t lastStatement = 0;
+    std::vector<size_t> commas;
+    for (size_t i = 0; i < equation.size(); i++) {
+        char c = equation[i];
+        if (c == '(' || c == '[' || c == '{') {
+            depth++;
+        } else if (c == ')' || c == ']' || c == '}') {
+            depth--;
+        } else if (depth == 0 && c == ';') {
+            lastStatement = i + 1;
+            commas.clear();
+        } else if (depth == 0 && c == ',') {
+            commas.push_back(i);
+        }
+    }
+    if (commas.size() != 2) {
+        return false;
+    }
+    program = equation.substr(0, lastStatement) +
+              " x := (" + equation.substr(lastStatement, commas[0] - lastStatement) + ");" +
+              " y := (" + equation.substr(commas[0] + 1, commas[1] - commas[0] - 1) + ");" +
+              " z := (" + equation.substr(commas[1] + 1) + ");";
+    return true;
+}
+
+// Returns true if equation is three components in u and v that compile
+bool ParametricSurface::isParametric(const std::string& equation) {
+    std::string program;
+    return toProgram(equation, program) && Equation(program, {"u", "v", "x", "y", "z"}).isValid();
+}
+
+// Samples the positions of rows [rowBegin, rowEnd), NaN where a component is undefined
+void ParametricSurface::sampleRows(const std::string& program, unsigned int rowBegin, unsigned int rowEnd) {
+    Equation& expression = Equation::forThread(program, {"u", "v", "x", "y", "z"});
+    for (unsigned int row = rowBegin; row < rowEnd; row++) {
+        float v = m_vMin + (m_vMax - m_vMin)*row/(m_dimension - 1.0f);
+        for (unsigned int column = 0; column < m_dimension; column++) {
+            float u = m_uMin + (m_uMax - m_uMin)*column/(m_dimension - 1.0f);
+            expression.value(u, v);
+            glm::vec3 position(expression.getVariable(2), expression.getVariable(3), expression.getVariable(4));
+            if (!std::isfinite(position.x) || !std::isfinite(position.y) || !std::isfinite(position.z)) {
+                position = glm::vec3(NAN);
+            }
+            m_positions[(size_t)row*m_dimension + column] = position;
+        }
+    }
+}
+
+// Writes the vertices of rows [rowBegin, rowEnd) from the positions
+void ParametricSurface::buildRows(unsigned int rowBegin, unsigned int rowEnd) {
+    unsigned int last = m_dimension - 1;
+    for (unsigned int row = rowBegin; row < rowEnd; row++) {
+        for (unsigned int column = 0; column < m_dimension; column++) {
+            size_t curr = (size_t)row*m_dimension + column;
+            glm::vec3 position = m_positions[curr];
+            float* vertex = m_VBO.data() + curr*12;
+
+            vertex[0] = position.x;
+            vertex[1] = position.z;
+            vertex[2] = position.y;
+
+            // Partial derivatives from the neighbors on both sides, or on one side on the border,
+            // zero next to undefined samples and where the surface pinches to a point
+            size_t left = row*(size_t)m_dimension + (column > 0 ? column - 1 : column);
+            size_t right = row*(size_t)m_dimension + (column < last ? column + 1 : column);
+            size_t down = (row > 0 ? row - 1 : row)*(size_t)m_dimension + column;
+            size_t up = (row < last ? row + 1 : row)*(size_t)m_dimension + column;
+            glm::vec3 normal = glm::cross(m_positions[right] - m_positions[left], m_positions[up] - m_positions[down]);
+            float length = glm::length(normal);
+            normal = std::isfinite(length) && length > 0.0f ? normal/length : glm::vec3(0.0f);
+            vertex[3] = normal.x;
+            vertex[4] = normal.z;
+            vertex[5] = normal.y;
+
+            // Shaded like Graph::buildVertices, by height
+            float yellowTint = glm::clamp(Graph::toHeight(position.z)*8 - 3.8f, 0.0f, 1.0f);
+            vertex[6] = 1.0f - yellowTint;
+            vertex[7] = 1.0f - yellowTint;
+            vertex[8] = 1.0f - yellowTint;
+            vertex[9] = 0.9f;
+
+            vertex[10] = 0;
+            vertex[11] = 0;
+        }
+    }
+}
+
+// Sets up m_IBO tile by tile, leaving out triangles that touch an undefined sample, and the bounding
+// box of every tile in m_chunks (see Graph::updateBuffers)
+void ParametricSurface::buildIndices() {
+    m_IBO.clear();
+    m_chunks.clear();
+    auto defined = [this](unsigned int i) { return !std::isnan(m_positions[i].x); };
+
+    unsigned int cells = m_dimension - 1;
+    for (unsigned int tileY = 0; tileY < cells; tileY += Graph::CHUNK_CELLS) {
+        for (unsigned int tileX = 0; tileX < cells; tileX += Graph::CHUNK_CELLS) {
+            unsigned int endY = std::min(tileY + Graph::CHUNK_CELLS, cells);
+            unsigned int endX = std::min(tileX + Graph::CHUNK_CELLS, cells);
+            GraphChunk chunk;
+            chunk.firstIndex = m_IBO.size();
+
+            for (unsigned int y = tileY; y < endY; y++) {
+                for (unsigned int x = tileX; x < endX; x++) {
+                    unsigned int curr = x + y*m_dimension;
+                    if (defined(curr) && defined(curr + 1) && defined(curr + m_dimension)) {
+                        m_IBO.insert(m_IBO.end(), {curr, curr + 1, curr + m_dimension});
+                    }
+                    if (defined(curr + m_dimension + 1) && defined(curr + 1) && defined(curr + m_dimension)) {
+                        m_IBO.insert(m_IBO.end(), {curr + 1, curr + m_dimension + 1, curr + m_dimension});
+                    }
+                }
+            }
+
+            chunk.indexCount = m_IBO.size() - chunk.firstIndex;
+            if (chunk.indexCount == 0) {
+                continue;
+            }
+            chunk.min = glm::vec3(INFINITY);
+            chunk.max = glm::vec3(-INFINITY);
+            for (unsigned int y = tileY; y <= endY; y++) {
+                for (unsigned int x = tileX; x <= endX; x++) {
+                    unsigned int curr = x + y*m_dimension;
+                    if (defined(curr)) {
+                        const float* vertex = m_VBO.data() + (size_t)curr*12;
+                        glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+                        chunk.min = glm::min(chunk.min, position);
+                        chunk.max = glm::max(chunk.max, position);
+                    }
+                }
+            }
+            m_chunks.push_back(chunk);
+        }
+    }
+}
@@ -0,0 +1,110 @@
+/** @file RenderScheduler.cpp
+ *  @brief Class implementation for event-driven rendering.
+ *
+ *  @author Antoine Assaf
+ */
+#include "RenderScheduler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// Longest time WaitEvent blocks while idle. Redraws requested from other threads are picked up
+// at least this often.
+const int IDLE_TIMEOUT_MS = 250;
+
+// Constructor, starts dirty so the first frame is always drawn
+RenderScheduler::RenderScheduler()
+	: m_dirty(true), m_frameInterval(std::chrono::steady_clock::duration::zero()), m_lastFrame(),
+	  m_wakeDeadline(), m_hasWakeDeadline(false){
+}
+
+// Limits drawing to framesPerSecond (0 for no cap)
+void RenderScheduler::SetFrameCap(unsigned int framesPerSecond){
+	if(framesPerSecond == 0){
+		m_frameInterval = std::chrono::steady_clock::duration::zero();
+	}else{
+		m_frameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(1.0/framesPerSecond));
+	}
+}
+
+// Sets the swap interval of the current context. Adaptive vsync falls back to vsync
+// when the driver does not support it. Returns the mode that was applied.
+VSyncMode RenderScheduler::SetVSync(VSyncMode mode){
+	if(SDL_GL_SetSwapInterval(mode) == 0){
+		return mode;
+	}
+	if(mode == VSYNC_ADAPTIVE && SDL_GL_SetSwapInterval(VSYNC_ON) == 0){
+		return VSYNC_ON;
+	}
+	std::cout << "Could not set the swap interval: " << SDL_GetError() << std::endl;
+	return VSYNC_OFF;
+}
+
+// Requests a redraw. Safe to call from any thread.
+void RenderScheduler::MarkDirty(){
+	m_dirty = true;
+}
+
+// Wakes a WaitEvent that is blocked on another thread, e.g. when background work finished
+void RenderScheduler::Wake(){
+	// SDL_PushEvent is thread safe; the event itself is ignored by the input handler
+	SDL_Event event;
+	SDL_zero(event);
+	event.type = SDL_USEREVENT;
+	SDL_PushEvent(&event);
+}
+
+// Makes the next WaitEvent return by deadline at the latest, e.g. for the next animation step
+void RenderScheduler::WakeBy(std::chrono::steady_clock::time_point deadline){
+	if(!m_hasWakeDeadline || deadline < m_wakeDeadline){
+		m_wakeDeadline = deadline;
+		m_hasWakeDeadline = true;
+	}
+}
+
+// Returns true if something changed since the last frame
+bool RenderScheduler::IsDirty() const{
+	return m_dirty;
+}
+
+// Returns true if a frame should be drawn now (dirty, and the frame cap allows it)
+bool RenderScheduler::FrameDue() const{
+	return m_dirty && std::chrono::steady_clock::now() - m_lastFrame >= m_frameInterval;
+}
+
+// Returns the next event. Does not block when a frame is due, otherwise blocks until an
+// event arrives, the next capped frame is due or the idle timeout passes.
+// Returns false if no event arrived.
+bool RenderScheduler::WaitEvent(SDL_Event& event){
+	bool hasWakeDeadline = m_hasWakeDeadline;
+	m_hasWakeDeadline = false;
+	if(FrameDue()){
+		return SDL_PollEvent(&event) != 0;
+	}
+
+	int timeout = IDLE_TIMEOUT_MS;
+	if(m_dirty){
+		// Dirty but capped: sleep until the next frame is allowed
+		auto remaining = m_lastFrame + m_frameInterval - std::chrono::steady_clock::now();
+		timeout = (int)std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
+		if(timeout < 1){
+			timeout = 1;
+		}
+	}
+	if(hasWakeDeadline){
+		auto remaining = m_wakeDeadline - std::chrono::steady_clock::now();
+		int untilDeadline = (int)std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
+		timeout = std::max(0, std::min(timeout, untilDeadline));
+	}
+	if(timeout == 0){
+		return SDL_PollEvent(&event) != 0;
+	}
+	return SDL_WaitEventTimeout(&event, timeout) != 0;
+}
+
+// Called right before a frame is drawn. Changes made while it draws mark the next frame dirty.
+void RenderScheduler::BeginFrame(){
+	m_dirty = false;
+	m_lastFrame = std::chrono::steady_clock::now();
+}
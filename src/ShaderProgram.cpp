@@ -0,0 +1,370 @@
+/** @file ShaderProgram.cpp
+ *  @brief Class implementation for compiling, linking and setting uniforms of a shader program.
+ *
+ *  @author Antoine Assaf
+ */
+#include "ShaderProgram.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// OpenGL 4.1 program binaries (ARB_get_program_binary), which glad does not load
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP GetProgramBinaryFunction)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryFunction)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriFunction)(GLuint program, GLenum pname, GLint value);
+
+static GetProgramBinaryFunction sGetProgramBinary = nullptr;
+static ProgramBinaryFunction sProgramBinary = nullptr;
+static ProgramParameteriFunction sProgramParameteri = nullptr;
+// Where binaries are cached, empty if they are not
+static std::string sCacheDirectory;
+
+// Bumped whenever the layout of a cache file changes
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// Header of a .programcache file, followed by the binary
+struct ProgramCacheHeader {
+    char magic[4]; // "PROG"
+    uint32_t version; // PROGRAM_CACHE_VERSION
+    uint64_t key; // hash of the sources and the driver strings
+    uint32_t format; // binary format reported by glGetProgramBinary
+    uint32_t length; // bytes in the binary
+};
+
+/**
+* CompileShader will compile any valid vertex, fragment, geometry, tesselation, or compute shader.
+*
+* @param type We use the 'type' field to determine which shader we are going to compile.
+* @param source : The shader source code.
+* @return id of the shaderObject, or 0 if it did not compile
+*/
+static GLuint CompileShader(GLuint type, const std::string& source){
+	GLuint shaderObject = glCreateShader(type);
+
+	const char* src = source.c_str();
+	// The source of our shader
+	glShaderSource(shaderObject, 1, &src, nullptr);
+	// Now compile our shader
+	glCompileShader(shaderObject);
+
+	// Retrieve the result of our compilation
+	int result;
+	glGetShaderiv(shaderObject, GL_COMPILE_STATUS, &result);
+
+	if(result == GL_FALSE){
+		int length;
+		glGetShaderiv(shaderObject, GL_INFO_LOG_LENGTH, &length);
+		std::vector<char> errorMessages(length + 1);
+		glGetShaderInfoLog(shaderObject, length, &length, errorMessages.data());
+
+		if(type == GL_VERTEX_SHADER){
+			std::cout << "ERROR: GL_VERTEX_SHADER compilation failed!\n" << errorMessages.data() << "\n";
+		}else if(type == GL_FRAGMENT_SHADER){
+			std::cout << "ERROR: GL_FRAGMENT_SHADER compilation failed!\n" << errorMessages.data() << "\n";
+		}else if(type == GL_GEOMETRY_SHADER){
+			std::cout << "ERROR: GL_GEOMETRY_SHADER compilation failed!\n" << errorMessages.data() << "\n";
+		}
+
+		// Delete our broken shader
+		glDeleteShader(shaderObject);
+		return 0;
+	}
+
+	return shaderObject;
+}
+
+// Constructor
+ShaderProgram::ShaderProgram() : m_programID(0){
+
+}
+
+// Destructor deletes the program
+ShaderProgram::~ShaderProgram(){
+	Destroy();
+}
+
+// Deletes the program (while the context still exists)
+void ShaderProgram::Destroy(){
+	if(m_programID != 0){
+		glDeleteProgram(m_programID);
+		m_programID = 0;
+	}
+	m_locations.clear();
+	m_intValues.clear();
+	m_floatValues.clear();
+}
+
+// Loads glGetProgramBinary and glProgramBinary from the current context
+void ShaderProgram::LoadBinaryFunctions(GLADloadproc loader){
+	sGetProgramBinary = (GetProgramBinaryFunction)loader("glGetProgramBinary");
+	sProgramBinary = (ProgramBinaryFunction)loader("glProgramBinary");
+	sProgramParameteri = (ProgramParameteriFunction)loader("glProgramParameteri");
+
+	// A driver may expose the functions without supporting a single binary format
+	GLint formatCount = 0;
+	if(sGetProgramBinary != nullptr){
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	}
+	if(sProgramBinary == nullptr || sProgramParameteri == nullptr || formatCount <= 0){
+		sGetProgramBinary = nullptr;
+		sProgramBinary = nullptr;
+		sProgramParameteri = nullptr;
+	}
+}
+
+// Sets the directory program binaries are cached in, or turns caching off if it is empty
+void ShaderProgram::SetBinaryCacheDirectory(const std::string& directory){
+	sCacheDirectory = directory;
+	if(!sCacheDirectory.empty() && sCacheDirectory.back() != '/'){
+		sCacheDirectory += '/';
+	}
+}
+
+// Compiles and links the program, with a geometry shader if geometrySource is not empty,
+// or loads it from the binary cache. Returns false (after printing the log) on failure.
+bool ShaderProgram::Create(const std::string& vertexSource, const std::string& fragmentSource, const std::string& geometrySource){
+	if(sCacheDirectory.empty() || sGetProgramBinary == nullptr){
+		return Build(vertexSource, fragmentSource, geometrySource);
+	}
+
+	// A binary is only valid for the exact sources on the exact driver that produced it.
+	// The lengths keep "ab"+"c" and "a"+"bc" apart.
+	uint64_t key = 0xcbf29ce484222325ull;
+	for(const std::string* source : {&vertexSource, &fragmentSource, &geometrySource}){
+		uint64_t length = source->size();
+		key = HashBytes(&length, sizeof(length), key);
+		key = HashString(*source, key);
+	}
+	for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}){
+		const char* text = (const char*)glGetString(name);
+		key = HashString(text != nullptr ? text : "", key);
+	}
+	char fileName[48];
+	std::snprintf(fileName, sizeof(fileName), "%016llx.programcache", (unsigned long long)key);
+	std::string cacheFile = sCacheDirectory + fileName;
+
+	if(LoadBinary(cacheFile, key)){
+		return true;
+	}
+	if(!Build(vertexSource, fragmentSource, geometrySource)){
+		return false;
+	}
+	SaveBinary(cacheFile, key);
+	return true;
+}
+
+// Creates the program from a cached binary. Returns false if there is none or the driver rejects it.
+bool ShaderProgram::LoadBinary(const std::string& cacheFile, uint64_t key){
+	bool rejected = false;
+	{
+		MappedFile file(cacheFile);
+		if(!file.isOpen()){
+			return false;
+		}
+		ProgramCacheHeader header;
+		if(file.getSize() >= sizeof(ProgramCacheHeader)){
+			std::memcpy(&header, file.getData(), sizeof(ProgramCacheHeader));
+		}
+		if(file.getSize() < sizeof(ProgramCacheHeader) || std::memcmp(header.magic, "PROG", 4) != 0 ||
+		   header.version != PROGRAM_CACHE_VERSION || header.key != key ||
+		   file.getSize() != sizeof(ProgramCacheHeader) + header.length){
+			rejected = true;
+		}else{
+			m_programID = glCreateProgram();
+			sProgramBinary(m_programID, header.format, file.getData() + sizeof(ProgramCacheHeader), header.length);
+
+			// Drivers may refuse binaries from before an update even if the strings did not change
+			int result;
+			glGetProgramiv(m_programID, GL_LINK_STATUS, &result);
+			if(result == GL_FALSE){
+				glDeleteProgram(m_programID);
+				m_programID = 0;
+				rejected = true;
+				// An unknown format also raises GL_INVALID_ENUM, which is expected here
+				while(glGetError() != GL_NO_ERROR){
+				}
+			}
+		}
+	}
+	if(rejected){
+		// Compiled and saved again by the caller
+		std::remove(cacheFile.c_str());
+		return false;
+	}
+
+	CacheUniformLocations();
+	return true;
+}
+
+// Saves the linked program to the binary cache
+void ShaderProgram::SaveBinary(const std::string& cacheFile, uint64_t key) const{
+	GLint length = 0;
+	glGetProgramiv(m_programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0){
+		return;
+	}
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	sGetProgramBinary(m_programID, length, &length, &format, binary.data());
+
+	ProgramCacheHeader header;
+	std::memset(&header, 0, sizeof(ProgramCacheHeader));
+	std::memcpy(header.magic, "PROG", 4);
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.format = format;
+	header.length = length;
+
+	// Write next to the cache and rename so a reader never sees half a file
+	std::string tempFile = cacheFile + ".tmp";
+	std::ofstream outFile(tempFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!outFile.is_open()){
+		return;
+	}
+	outFile.write((const char*)&header, sizeof(ProgramCacheHeader));
+	outFile.write(binary.data(), length);
+	outFile.close();
+
+#if defined(MINGW)
+	// rename does not replace an existing file on Windows
+	std::remove(cacheFile.c_str());
+#endif
+	if(!outFile.good() || std::rename(tempFile.c_str(), cacheFile.c_str()) != 0){
+		std::remove(tempFile.c_str());
+	}
+}
+
+// Compiles and links the program from source. Returns false (after printing the log) on failure.
+bool ShaderProgram::Build(const std::string& vertexSource, const std::string& fragmentSource, const std::string& geometrySource){
+	GLuint vertexShader   = CompileShader(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	GLuint geometryShader = geometrySource.empty() ? 0 : CompileShader(GL_GEOMETRY_SHADER, geometrySource);
+	if(vertexShader == 0 || fragmentShader == 0 || (!geometrySource.empty() && geometryShader == 0)){
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		glDeleteShader(geometryShader);
+		return false;
+	}
+
+	m_programID = glCreateProgram();
+
+	// Link our shader programs together.
+	glAttachShader(m_programID, vertexShader);
+	glAttachShader(m_programID, fragmentShader);
+	if(geometryShader != 0){
+		glAttachShader(m_programID, geometryShader);
+	}
+	if(sProgramParameteri != nullptr && !sCacheDirectory.empty()){
+		// Lets the driver keep what glGetProgramBinary needs
+		sProgramParameteri(m_programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(m_programID);
+
+	// Once our final program Object has been created, we can
+	// detach and then delete our individual shaders.
+	glDetachShader(m_programID, vertexShader);
+	glDetachShader(m_programID, fragmentShader);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	if(geometryShader != 0){
+		glDetachShader(m_programID, geometryShader);
+		glDeleteShader(geometryShader);
+	}
+
+	int result;
+	glGetProgramiv(m_programID, GL_LINK_STATUS, &result);
+	if(result == GL_FALSE){
+		int length;
+		glGetProgramiv(m_programID, GL_INFO_LOG_LENGTH, &length);
+		std::vector<char> errorMessages(length + 1);
+		glGetProgramInfoLog(m_programID, length, &length, errorMessages.data());
+		std::cout << "ERROR: shader program link failed!\n" << errorMessages.data() << "\n";
+
+		glDeleteProgram(m_programID);
+		m_programID = 0;
+		return false;
+	}
+
+	CacheUniformLocations();
+	return true;
+}
+
+// Looks up every active uniform once after linking
+void ShaderProgram::CacheUniformLocations(){
+	m_locations.clear();
+	m_intValues.clear();
+	m_floatValues.clear();
+
+	GLint uniformCount = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(m_programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(m_programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<char> name(maxLength + 1);
+	for(GLint i = 0; i < uniformCount; i++){
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_programID, i, name.size(), &length, &size, &type, name.data());
+
+		// Members of uniform blocks have no location and are set through their buffer
+		GLint location = glGetUniformLocation(m_programID, name.data());
+		if(location >= 0){
+			m_locations[std::string(name.data(), length)] = location;
+		}
+	}
+}
+
+// Returns the OpenGL id of the program
+GLuint ShaderProgram::GetID() const{
+	return m_programID;
+}
+
+// Returns the cached location of a uniform, or -1 if the program does not use it
+GLint ShaderProgram::GetUniformLocation(const std::string& name) const{
+	auto location = m_locations.find(name);
+	if(location == m_locations.end()){
+		return -1;
+	}
+	return location->second;
+}
+
+// Sets an int (or sampler) uniform if it differs from the last value set
+// Note: the program must be in use.
+void ShaderProgram::SetInt(GLint location, int value){
+	auto last = m_intValues.find(location);
+	if(location < 0 || (last != m_intValues.end() && last->second == value)){
+		return;
+	}
+	glUniform1i(location, value);
+	m_intValues[location] = value;
+}
+
+// Sets a float uniform if it differs from the last value set
+// Note: the program must be in use.
+void ShaderProgram::SetFloat(GLint location, float value){
+	auto last = m_floatValues.find(location);
+	if(location < 0 || (last != m_floatValues.end() && last->second == value)){
+		return;
+	}
+	glUniform1f(location, value);
+	m_floatValues[location] = value;
+}
+
+// Connects a uniform block to a binding point. Returns false if the block does not exist.
+bool ShaderProgram::BindUniformBlock(const std::string& name, GLuint bindingPoint){
+	GLuint blockIndex = glGetUniformBlockIndex(m_programID, name.c_str());
+	if(blockIndex == GL_INVALID_INDEX){
+		return false;
+	}
+	glUniformBlockBinding(m_programID, blockIndex, bindingPoint);
+	return true;
+}
@@ -0,0 +1,439 @@
+/** @file SoftwareRasterizer.cpp
+ *  @brief Class implementation for the tile binned CPU renderer.
+ *
+ *  @author Antoine Assaf
+ */
+#include "SoftwareRasterizer.hpp"
+
+#include "Image.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+// Pixels per tile side
+const unsigned int TILE_SIZE = 64;
+
+// Constants of shaders/frag.glsl
+const glm::vec3 GRAPH_SHADE = glm::vec3(218.0f, 118.0f, 119.0f)/255.0f;
+const float HIGHLIGHT_WIDTH = 0.02f;
+
+// How much of a pixel the lines at whole x and y cover, anti-aliased over the pixel's
+// size in model units. Mirrors gridCoverage in shaders/frag.glsl.
+static float gridCoverage(glm::vec2 coordinate, glm::vec2 pixelSize){
+    float coverage = 0.0f;
+    for (int i = 0; i < 2; i++) {
+        // A pixel reaching past the horizon has no size to speak of
+        if (!std::isfinite(pixelSize[i])) {
+            continue;
+        }
+        float pixel = std::max(pixelSize[i], 1e-6f);
+        float distance = std::abs(coordinate[i] - std::round(coordinate[i]));
+        float width = std::max(HIGHLIGHT_WIDTH, pixel);
+        coverage = std::max(coverage, std::clamp((width*0.5f - distance)/pixel + 0.5f, 0.0f, 1.0f));
+    }
+    return coverage;
+}
+
+// Samples an RGB image bilinearly with clamp to edge, like GL_LINEAR on the diffuse texture
+static glm::vec3 sampleBilinear(Image* image, float s, float t){
+    if (image == nullptr || image->GetPixelDataPtr() == nullptr) {
+        return glm::vec3(1.0f);
+    }
+    int width = image->GetWidth();
+    int height = image->GetHeight();
+    const uint8_t* data = image->GetPixelDataPtr();
+
+    float u = s*width - 0.5f;
+    float v = t*height - 0.5f;
+    int x0 = (int)std::floor(u);
+    int y0 = (int)std::floor(v);
+    float fx = u - x0;
+    float fy = v - y0;
+    int x1 = std::clamp(x0 + 1, 0, width - 1);
+    int y1 = std::clamp(y0 + 1, 0, height - 1);
+    x0 = std::clamp(x0, 0, width - 1);
+    y0 = std::clamp(y0, 0, height - 1);
+
+    const uint8_t* p00 = data + (y0*width + x0)*3;
+    const uint8_t* p10 = data + (y0*width + x1)*3;
+    const uint8_t* p01 = data + (y1*width + x0)*3;
+    const uint8_t* p11 = data + (y1*width + x1)*3;
+    glm::vec3 color;
+    for (int c = 0; c < 3; c++) {
+        float top = p00[c] + (p10[c] - p00[c])*fx;
+        float bottom = p01[c] + (p11[c] - p01[c])*fx;
+        color[c] = (top + (bottom - top)*fy)/255.0f;
+    }
+    return color;
+}
+
+// Constructor creates a width*height color and depth buffer. threadCount 0 uses one thread per core.
+SoftwareRasterizer::SoftwareRasterizer(unsigned int width, unsigned int height, unsigned int threadCount){
+    m_width = width;
+    m_height = height;
+    m_threadCount = threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    if (m_threadCount > 1) {
+        m_pool.reset(new ThreadPool(m_threadCount - 1));
+    }
+    m_tilesX = (width + TILE_SIZE - 1)/TILE_SIZE;
+    m_tilesY = (height + TILE_SIZE - 1)/TILE_SIZE;
+    m_color.resize((size_t)width*height*3);
+    m_depth.resize((size_t)width*height);
+    m_triangles.resize(m_threadCount);
+    m_bins.resize(m_threadCount, std::vector<std::vector<uint32_t>>(m_tilesX*m_tilesY));
+    Clear(0.0f, 0.0f, 0.0f);
+}
+
+// Clears the color buffer to a color and the depth buffer to 1
+void SoftwareRasterizer::Clear(float r, float g, float b){
+    for (size_t i = 0; i < m_depth.size(); i++) {
+        m_color[i*3 + 0] = r;
+        m_color[i*3 + 1] = g;
+        m_color[i*3 + 2] = b;
+        m_depth[i] = 1.0f;
+    }
+}
+
+// Runs work(i) for every chunk i < m_threadCount, chunk 0 on the calling thread, and waits for all of them
+template <typename Work>
+void SoftwareRasterizer::runChunks(Work work){
+    for (size_t i = 1; i < m_threadCount; i++) {
+        m_pool->submit([&work, i]() { work(i); });
+    }
+    work(0);
+    if (m_pool) {
+        m_pool->wait();
+    }
+}
+
+// Draws indices.size()/3 triangles (like glDrawElements with GL_TRIANGLES), depth tested
+// with GL_LESS and blended with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+void SoftwareRasterizer::DrawElements(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                                      const SoftwareUniforms& uniforms){
+    // 1. Vertex shader
+    size_t vertexCount = vertices.size()/12;
+    std::vector<ShadedVertex> shaded(vertexCount);
+    runChunks([&](size_t i) {
+        shadeVertices(vertices, vertexCount*i/m_threadCount, vertexCount*(i + 1)/m_threadCount, uniforms, shaded);
+    });
+
+    // 2. Clip, set up and bin contiguous ranges of triangles
+    size_t triangleCount = indices.size()/3;
+    runChunks([&](size_t i) {
+        m_triangles[i].clear();
+        for (std::vector<uint32_t>& bin : m_bins[i]) {
+            bin.clear();
+        }
+        size_t end = triangleCount*(i + 1)/m_threadCount;
+        for (size_t triangle = triangleCount*i/m_threadCount; triangle < end; triangle++) {
+            setupTriangle(shaded[indices[triangle*3 + 0]], shaded[indices[triangle*3 + 1]],
+                          shaded[indices[triangle*3 + 2]], (unsigned int)i);
+        }
+    });
+
+    // 3. Rasterize tiles, handing them out to threads as they finish
+    std::atomic<unsigned int> nextTile(0);
+    unsigned int tileCount = m_tilesX*m_tilesY;
+    runChunks([&](size_t) {
+        for (unsigned int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+            rasterizeTile(tile, uniforms);
+        }
+    });
+}
+
+// Copies the color buffer into pixels as 8 bit RGB, top row first
+void SoftwareRasterizer::ReadPixels(std::vector<uint8_t>& pixels) const{
+    pixels.resize(m_color.size());
+    for (size_t i = 0; i < m_color.size(); i++) {
+        pixels[i] = (uint8_t)(std::clamp(m_color[i], 0.0f, 1.0f)*255.0f + 0.5f);
+    }
+}
+
+// Returns the size of the buffers
+unsigned int SoftwareRasterizer::GetWidth() const{
+    return m_width;
+}
+
+// Returns the size of the buffers
+unsigned int SoftwareRasterizer::GetHeight() const{
+    return m_height;
+}
+
+// Runs the vertex shader on vertices [begin, end). Mirrors shaders/vert.glsl.
+void SoftwareRasterizer::shadeVertices(const std::vector<float>& vertices, size_t begin, size_t end,
+                                       const SoftwareUniforms& uniforms, std::vector<ShadedVertex>& shaded) const{
+    glm::mat4 transform = uniforms.projection*uniforms.view*uniforms.model;
+    for (size_t i = begin; i < end; i++) {
+        const float* vertex = &vertices[i*12];
+        glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+        glm::vec3 normal(vertex[3], vertex[4], vertex[5]);
+        float s = vertex[10];
+        float t = vertex[11];
+
+        // Graphs have no texture coordinates, only the grid .obj does
+        bool textured = s > 0.01f || t > 0.01f;
+        glm::vec3 coloring(-1.0f);
+        if (uniforms.coloring == 1 && !textured) {
+            coloring = glm::vec3(std::abs(normal.x), std::abs(normal.z), std::abs(normal.y));
+        }
+
+        ShadedVertex& out = shaded[i];
+        out.clip = transform*glm::vec4(position, 1.0f);
+        out.varyings[0] = vertex[6];
+        out.varyings[1] = vertex[7];
+        out.varyings[2] = vertex[8];
+        out.varyings[3] = vertex[9];
+        out.varyings[4] = s;
+        out.varyings[5] = t;
+        out.varyings[6] = position.x;
+        out.varyings[7] = position.z;
+        out.varyings[8] = textured ? 1.0f : 0.0f;
+        out.varyings[9] = coloring.x;
+        out.varyings[10] = coloring.y;
+        out.varyings[11] = coloring.z;
+    }
+}
+
+// Clips one triangle against the near plane, sets it up and appends it to a thread's bins
+void SoftwareRasterizer::setupTriangle(const ShadedVertex& v0, const ShadedVertex& v1, const ShadedVertex& v2,
+                                       unsigned int thread){
+    const ShadedVertex* input[3] = {&v0, &v1, &v2};
+    // Signed distance to the near plane (z = -w in clip space), inside when >= 0
+    float distance[3];
+    int insideCount = 0;
+    for (int i = 0; i < 3; i++) {
+        distance[i] = input[i]->clip.z + input[i]->clip.w;
+        insideCount += distance[i] >= 0.0f;
+    }
+    if (insideCount == 3) {
+        binTriangle(input, thread);
+        return;
+    }
+    if (insideCount == 0) {
+        return;
+    }
+
+    // Sutherland-Hodgman against the near plane gives a triangle or a quad
+    ShadedVertex clipped[4];
+    int clippedCount = 0;
+    for (int i = 0; i < 3; i++) {
+        int next = (i + 1) % 3;
+        if (distance[i] >= 0.0f) {
+            clipped[clippedCount++] = *input[i];
+        }
+        if ((distance[i] >= 0.0f) != (distance[next] >= 0.0f)) {
+            float t = distance[i]/(distance[i] - distance[next]);
+            ShadedVertex& crossing = clipped[clippedCount++];
+            crossing.clip = input[i]->clip + (input[next]->clip - input[i]->clip)*t;
+            for (unsigned int k = 0; k < SOFTWARE_VARYING_COUNT; k++) {
+                crossing.varyings[k] = input[i]->varyings[k] + (input[next]->varyings[k] - input[i]->varyings[k])*t;
+            }
+        }
+    }
+    for (int i = 1; i + 1 < clippedCount; i++) {
+        const ShadedVertex* corners[3] = {&clipped[0], &clipped[i], &clipped[i + 1]};
+        binTriangle(corners, thread);
+    }
+}
+
+// Adds a clipped triangle in clip space to a thread's triangles and bins
+void SoftwareRasterizer::binTriangle(const ShadedVertex* corners[3], unsigned int thread){
+    ScreenTriangle triangle;
+    float x[3];
+    float y[3];
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& clip = corners[i]->clip;
+        float inverseW = 1.0f/clip.w;
+        x[i] = (clip.x*inverseW*0.5f + 0.5f)*m_width;
+        y[i] = (0.5f - clip.y*inverseW*0.5f)*m_height;
+        if (!std::isfinite(x[i]) || !std::isfinite(y[i])) {
+            return;
+        }
+        triangle.depth[i] = clip.z*inverseW*0.5f + 0.5f;
+        triangle.inverseW[i] = inverseW;
+        for (unsigned int k = 0; k < SOFTWARE_VARYING_COUNT; k++) {
+            triangle.varyings[i][k] = corners[i]->varyings[k]*inverseW;
+        }
+    }
+
+    // Edge i runs between the two other vertices: E(p) = A*p.x + B*p.y + C
+    for (int i = 0; i < 3; i++) {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        triangle.edgeA[i] = y[a] - y[b];
+        triangle.edgeB[i] = x[b] - x[a];
+        triangle.edgeC[i] = (y[b] - y[a])*x[a] - (x[b] - x[a])*y[a];
+    }
+    float area = triangle.edgeA[0]*x[0] + triangle.edgeB[0]*y[0] + triangle.edgeC[0];
+    if (!(std::abs(area) > 0.0f) || !std::isfinite(area)) {
+        return;
+    }
+    // Both windings are drawn (no culling): flip the edges so the inside is positive
+    if (area < 0.0f) {
+        area = -area;
+        for (int i = 0; i < 3; i++) {
+            triangle.edgeA[i] = -triangle.edgeA[i];
+            triangle.edgeB[i] = -triangle.edgeB[i];
+            triangle.edgeC[i] = -triangle.edgeC[i];
+        }
+    }
+    // Tie break for pixels exactly on an edge: a shared edge has opposite A and B in its two
+    // triangles, so exactly one of them takes the pixel
+    for (int i = 0; i < 3; i++) {
+        triangle.edgeInclusive[i] = triangle.edgeA[i] > 0.0f || (triangle.edgeA[i] == 0.0f && triangle.edgeB[i] > 0.0f);
+    }
+    triangle.inverseArea = 1.0f/area;
+
+    float minX = std::min({x[0], x[1], x[2]});
+    float maxX = std::max({x[0], x[1], x[2]});
+    float minY = std::min({y[0], y[1], y[2]});
+    float maxY = std::max({y[0], y[1], y[2]});
+    if (maxX < 0.0f || maxY < 0.0f || minX > m_width || minY > m_height) {
+        return;
+    }
+    // Clamped while still floats: a vertex close to w = 0 lands far outside the range of int
+    triangle.minX = (int)std::floor(std::clamp(minX, 0.0f, m_width - 1.0f));
+    triangle.minY = (int)std::floor(std::clamp(minY, 0.0f, m_height - 1.0f));
+    triangle.maxX = (int)std::ceil(std::clamp(maxX, 0.0f, m_width - 1.0f));
+    triangle.maxY = (int)std::ceil(std::clamp(maxY, 0.0f, m_height - 1.0f));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+        return;
+    }
+
+    uint32_t index = (uint32_t)m_triangles[thread].size();
+    m_triangles[thread].push_back(triangle);
+    for (int tileY = triangle.minY/TILE_SIZE; tileY <= triangle.maxY/(int)TILE_SIZE; tileY++) {
+        for (int tileX = triangle.minX/TILE_SIZE; tileX <= triangle.maxX/(int)TILE_SIZE; tileX++) {
+            m_bins[thread][tileY*m_tilesX + tileX].push_back(index);
+        }
+    }
+}
+
+// Rasterizes every binned triangle overlapping a tile
+void SoftwareRasterizer::rasterizeTile(unsigned int tile, const SoftwareUniforms& uniforms){
+    int tileMinX = (tile % m_tilesX)*TILE_SIZE;
+    int tileMinY = (tile / m_tilesX)*TILE_SIZE;
+    int tileMaxX = std::min(tileMinX + (int)TILE_SIZE, (int)m_width) - 1;
+    int tileMaxY = std::min(tileMinY + (int)TILE_SIZE, (int)m_height) - 1;
+
+    // Threads binned consecutive ranges of triangles, so this is submission order
+    for (unsigned int thread = 0; thread < m_threadCount; thread++) {
+        for (uint32_t index : m_bins[thread][tile]) {
+            const ScreenTriangle& triangle = m_triangles[thread][index];
+            int minX = std::max(triangle.minX, tileMinX);
+            int maxX = std::min(triangle.maxX, tileMaxX);
+            int minY = std::max(triangle.minY, tileMinY);
+            int maxY = std::min(triangle.maxY, tileMaxY);
+
+            for (int y = minY; y <= maxY; y++) {
+                float centerY = y + 0.5f;
+                float row[3];
+                for (int i = 0; i < 3; i++) {
+                    row[i] = triangle.edgeB[i]*centerY + triangle.edgeC[i];
+                }
+                // Four pixels per step
+                for (int x = minX; x <= maxX; x += 4) {
+                    float weights[3][4];
+                    int covered = 0;
+#if defined(__SSE2__)
+                    __m128 centerX = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+                    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int i = 0; i < 3; i++) {
+                        __m128 weight = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[i]), centerX), _mm_set1_ps(row[i]));
+                        __m128 edgeInside = _mm_cmpgt_ps(weight, _mm_setzero_ps());
+                        if (triangle.edgeInclusive[i]) {
+                            edgeInside = _mm_or_ps(edgeInside, _mm_cmpeq_ps(weight, _mm_setzero_ps()));
+                        }
+                        inside = _mm_and_ps(inside, edgeInside);
+                        _mm_storeu_ps(weights[i], weight);
+                    }
+                    covered = _mm_movemask_ps(inside);
+#else
+                    for (int lane = 0; lane < 4; lane++) {
+                        float centerX = x + lane + 0.5f;
+                        bool inside = true;
+                        for (int i = 0; i < 3; i++) {
+                            float weight = triangle.edgeA[i]*centerX + row[i];
+                            weights[i][lane] = weight;
+                            inside = inside && (weight > 0.0f || (weight == 0.0f && triangle.edgeInclusive[i]));
+                        }
+                        covered |= inside << lane;
+                    }
+#endif
+                    if (covered == 0) {
+                        continue;
+                    }
+                    for (int lane = 0; lane < 4 && x + lane <= maxX; lane++) {
+                        if (covered & (1 << lane)) {
+                            shadePixel(triangle,
+                                       weights[0][lane]*triangle.inverseArea,
+                                       weights[1][lane]*triangle.inverseArea,
+                                       weights[2][lane]*triangle.inverseArea,
+                                       y*m_width + x + lane, uniforms);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Shades and blends one covered pixel. Mirrors shaders/frag.glsl.
+void SoftwareRasterizer::shadePixel(const ScreenTriangle& triangle, float b0, float b1, float b2, unsigned int pixel,
+                                    const SoftwareUniforms& uniforms){
+    float depth = b0*triangle.depth[0] + b1*triangle.depth[1] + b2*triangle.depth[2];
+    if (depth < 0.0f || depth > 1.0f || !(depth < m_depth[pixel])) {
+        return;
+    }
+
+    // Perspective correct interpolation
+    float w = 1.0f/(b0*triangle.inverseW[0] + b1*triangle.inverseW[1] + b2*triangle.inverseW[2]);
+    float varyings[SOFTWARE_VARYING_COUNT];
+    for (unsigned int k = 0; k < SOFTWARE_VARYING_COUNT; k++) {
+        varyings[k] = (b0*triangle.varyings[0][k] + b1*triangle.varyings[1][k] + b2*triangle.varyings[2][k])*w;
+    }
+    glm::vec4 vertexColor(varyings[0], varyings[1], varyings[2], varyings[3]);
+    glm::vec2 position(varyings[6], varyings[7]);
+    glm::vec3 coloring(varyings[9], varyings[10], varyings[11]);
+
+    glm::vec4 color;
+    if (varyings[8] > 0.5f) {
+        glm::vec3 diffuse = sampleBilinear(uniforms.diffuse, varyings[4], varyings[5]);
+        color = glm::vec4(diffuse, 1.0f)*vertexColor;
+    } else {
+        // Per pixel, so the highlights are as sharp on a coarse graph as on a fine one.
+        // fwidth is the change of the position to the next pixel across and down.
+        float highlight = 1.0f;
+        if (uniforms.highlight != 0) {
+            auto positionAt = [&](float c0, float c1, float c2) {
+                float inverseW = c0*triangle.inverseW[0] + c1*triangle.inverseW[1] + c2*triangle.inverseW[2];
+                return glm::vec2(c0*triangle.varyings[0][6] + c1*triangle.varyings[1][6] + c2*triangle.varyings[2][6],
+                                 c0*triangle.varyings[0][7] + c1*triangle.varyings[1][7] + c2*triangle.varyings[2][7])/inverseW;
+            };
+            float a = triangle.inverseArea;
+            glm::vec2 across = positionAt(b0 + triangle.edgeA[0]*a, b1 + triangle.edgeA[1]*a, b2 + triangle.edgeA[2]*a);
+            glm::vec2 down = positionAt(b0 + triangle.edgeB[0]*a, b1 + triangle.edgeB[1]*a, b2 + triangle.edgeB[2]*a);
+            glm::vec2 pixelSize = glm::abs(across - position) + glm::abs(down - position);
+            highlight = 1.0f + 0.2f*gridCoverage(position, pixelSize);
+        }
+
+        if (coloring.x < 0 && coloring.y < 0 && coloring.z < 0) {
+            color = glm::vec4(GRAPH_SHADE, 1.0f)*vertexColor*highlight;
+        } else {
+            color = glm::vec4(coloring, 1.0f)*highlight;
+        }
+    }
+    color = glm::clamp(color, 0.0f, 1.0f);
+
+    float* destination = &m_color[(size_t)pixel*3];
+    for (int c = 0; c < 3; c++) {
+        destination[c] = color[c]*color.a + destination[c]*(1.0f - color.a);
+    }
+    m_depth[pixel] = depth;
+}
@@ -0,0 +1,141 @@
+/** @file SurfaceIntersection.cpp
+ * @brief Class implementation for finding where two graphs meet.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "SurfaceIntersection.hpp"
+#include "ContourSet.hpp"
+#include "Equation.hpp"
+#include "Graph.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Points refined per task
+const size_t POINTS_PER_TASK = 4096;
+
+// Constructor finds where z = first(x,y) and z = second(x,y) meet
+SurfaceIntersection::SurfaceIntersection(const std::string& first, const std::string& second, const float* firstHeights,
+                                         const float* secondHeights, unsigned int dimension, float domainMin,
+                                         float domainMax, unsigned int threadCount) {
+    m_first = first;
+    m_second = second;
+    m_dimension = dimension;
+    m_domainMin = domainMin;
+    m_domainMax = domainMax;
+
+    std::vector<ContourLine> lines;
+    {
+        // f - g, NaN where either graph is undefined or out of bounds
+        std::vector<float> difference((size_t)dimension*dimension);
+        ThreadPool pool(threadCount);
+        for (unsigned int row = 0; row < dimension; row += Graph::CHUNK_CELLS) {
+            size_t begin = (size_t)row*dimension;
+            size_t end = (size_t)std::min(row + Graph::CHUNK_CELLS, dimension)*dimension;
+            pool.submit([begin, end, firstHeights, secondHeights, &difference]() {
+                for (size_t i = begin; i < end; i++) {
+                    difference[i] = Graph::fromHeight(firstHeights[i]) - Graph::fromHeight(secondHeights[i]);
+                }
+            });
+        }
+        pool.wait();
+
+        ContourSet zeroSet(std::move(difference), dimension, domainMin, domainMax);
+        zeroSet.setLevels({0.0f}, threadCount);
+        if (!zeroSet.getLevels().empty()) {
+            lines = zeroSet.getLevels().begin()->second;
+        }
+    }
+
+    // Curves in tasks of about POINTS_PER_TASK points
+    m_curves.resize(lines.size());
+    std::vector<std::vector<unsigned long long>> edges(lines.size());
+    for (size_t i = 0; i < lines.size(); i++) {
+        m_curves[i].closed = lines[i].closed;
+        m_curves[i].points.reserve(lines[i].points.size());
+        for (const glm::vec2& point : lines[i].points) {
+            m_curves[i].points.push_back(glm::vec3(point, NAN));
+        }
+        edges[i].swap(lines[i].edges);
+    }
+    ThreadPool pool(threadCount);
+    size_t begin = 0;
+    size_t points = 0;
+    for (size_t i = 0; i < m_curves.size(); i++) {
+        points += m_curves[i].points.size();
+        if (points >= POINTS_PER_TASK || i + 1 == m_curves.size()) {
+            size_t end = i + 1;
+            pool.submit([this, &edges, begin, end]() { refineCurves(edges, begin, end); });
+            begin = end;
+            points = 0;
+        }
+    }
+    pool.wait();
+}
+
+// Returns the curves, in no particular order
+const std::vector<IntersectionCurve>& SurfaceIntersection::getCurves() const {
+    return m_curves;
+}
+
+// Refines the points of curves [begin, end) on the grid edges they were found on
+void SurfaceIntersection::refineCurves(const std::vector<std::vector<unsigned long long>>& edges, size_t begin,
+                                       size_t end) {
+    // Compiled here rather than with Equation::forThread, whose cache may drop one while the other is used
+    Equation first(m_first);
+    Equation second(m_second);
+    float spacing = (m_domainMax - m_domainMin)/(m_dimension - 1.0f);
+
+    for (size_t c = begin; c < end; c++) {
+        IntersectionCurve& curve = m_curves[c];
+        for (size_t p = 0; p < curve.points.size(); p++) {
+            // The edge runs from sample a along x or y to its neighbour
+            unsigned long long edge = edges[c][p];
+            size_t sample = edge/2;
+            glm::vec2 a(m_domainMin + spacing*(sample % m_dimension), m_domainMin + spacing*(sample / m_dimension));
+            glm::vec2 step = (edge & 1) == 0 ? glm::vec2(spacing, 0.0f) : glm::vec2(0.0f, spacing);
+            auto difference = [&](float t) {
+                glm::vec2 at = a + t*step;
+                return first.value(at.x, at.y) - second.value(at.x, at.y);
+            };
+
+            // False position from the grid's estimate of the crossing, halving the value kept
+            // on one side when that side is kept twice in a row (Illinois)
+            glm::vec3& point = curve.points[p];
+            float t = glm::clamp(glm::dot(glm::vec2(point) - a, step)/(spacing*spacing), 0.0f, 1.0f);
+            float low = 0.0f;
+            float high = 1.0f;
+            float lowValue = difference(low);
+            float highValue = difference(high);
+            if (std::isfinite(lowValue) && std::isfinite(highValue) && (lowValue < 0.0f) != (highValue < 0.0f)) {
+                int kept = 0;
+                for (unsigned int i = 0; i < REFINE_STEPS; i++) {
+                    t = (low*highValue - high*lowValue)/(highValue - lowValue);
+                    float value = difference(t);
+                    if (value == 0.0f || !std::isfinite(value)) {
+                        break;
+                    }
+                    if ((value < 0.0f) == (lowValue < 0.0f)) {
+                        low = t;
+                        lowValue = value;
+                        if (kept == -1) {
+                            highValue *= 0.5f;
+                        }
+                        kept = -1;
+                    } else {
+                        high = t;
+                        highValue = value;
+                        if (kept == 1) {
+                            lowValue *= 0.5f;
+                        }
+                        kept = 1;
+                    }
+                }
+            }
+            glm::vec2 at = a + t*step;
+            point = glm::vec3(at, first.value(at.x, at.y));
+        }
+    }
+}
@@ -16,15 +16,17 @@
 #include <memory>
 
 // Default Constructor
-Texture::Texture(){
+Texture::Texture() : m_textureID(0), m_image(nullptr){
 
 }
 
 
 // Default Destructor
 Texture::~Texture(){
-	// Delete our texture from the GPU
-	glDeleteTextures(1,&m_textureID);
+	// Delete our texture from the GPU (modes without a window never create one)
+	if(m_textureID != 0){
+		glDeleteTextures(1,&m_textureID);
+	}
 
     // Delete our image
     if(m_image != nullptr){
@@ -40,7 +42,6 @@ void Texture::LoadTexture(const std::string filepath){
     // This method loads .ppm files of pixel data
     m_image = new Image(filepath);
     m_image->LoadPPM(true);
-    glEnable(GL_TEXTURE_2D); 
     // Generate a buffer for our texture    
     glGenTextures(1,&m_textureID);
     // Similar to our vertex buffers, we now 'select'
@@ -84,11 +85,15 @@ void Texture::Bind(unsigned int slot) const{
 	// be multiple at once.
 	// At the time of writing, OpenGL supports 8-32 depending
 	// on your hardware.
-  glEnable(GL_TEXTURE_2D);
 	glActiveTexture(GL_TEXTURE0+slot);
 	glBindTexture(GL_TEXTURE_2D, m_textureID);
 }
 
+// Returns the OpenGL id of the texture
+GLuint Texture::GetID() const{
+	return m_textureID;
+}
+
 void Texture::Unbind(){
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -0,0 +1,76 @@
+/** @file ThreadPool.cpp
+ * @brief Class implementation for a fixed set of worker threads.
+ *
+ * @author Antoine Assaf
+ */
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+// Constructor starts threadCount workers (0 for one per core)
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    m_running = 0;
+    m_stopping = false;
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned int i = 0; i < threadCount; i++) {
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+// Destructor finishes the queued tasks and joins the workers
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_taskReady.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+// Queues a task. Tasks start in the order they were submitted.
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_taskReady.notify_one();
+}
+
+// Blocks until every submitted task has finished
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_tasks.empty() && m_running == 0; });
+}
+
+// Returns the number of workers
+unsigned int ThreadPool::size() const {
+    return (unsigned int)m_workers.size();
+}
+
+// Runs tasks until the pool is destroyed
+void ThreadPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_taskReady.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+        if (m_tasks.empty()) {
+            return; // stopping and nothing left to run
+        }
+        std::function<void()> task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+        m_running++;
+
+        lock.unlock();
+        task();
+        lock.lock();
+
+        m_running--;
+        if (m_running == 0 && m_tasks.empty()) {
+            m_idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,254 @@
+/** @file TransparencyTarget.cpp
+ *  @brief Class implementation for weighted blended transparency and depth peeling.
+ *
+ *  @author Antoine Assaf
+ */
+#include "TransparencyTarget.hpp"
+
+#include <iostream>
+
+// Constructor
+TransparencyTarget::TransparencyTarget(){
+	m_resolveLocation = -1;
+	m_vertexArray = 0;
+	m_query = 0;
+	m_width = 0;
+	m_height = 0;
+	m_destination = 0;
+	m_opaqueFramebuffer = 0;
+	m_opaqueColor = 0;
+	m_opaqueDepth = 0;
+	m_blendedFramebuffer = 0;
+	m_accumulation = 0;
+	m_weights = 0;
+	m_peeledFramebuffer = 0;
+	m_layerFramebuffers[0] = m_layerFramebuffers[1] = 0;
+	m_layerColor = 0;
+	m_layerDepth[0] = m_layerDepth[1] = 0;
+	m_mode = TRANSPARENCY_OFF;
+}
+
+// Destructor deletes the OpenGL objects
+TransparencyTarget::~TransparencyTarget(){
+	Destroy();
+}
+
+// Compiles the program that composites the layers. Returns false if it does not compile.
+bool TransparencyTarget::Create(const std::string& vertexSource, const std::string& fragmentSource, GLState& state){
+	if(!m_compositeProgram.Create(vertexSource, fragmentSource)){
+		return false;
+	}
+	m_resolveLocation = m_compositeProgram.GetUniformLocation("u_Resolve");
+	state.UseProgram(m_compositeProgram.GetID());
+	m_compositeProgram.SetInt(m_compositeProgram.GetUniformLocation("u_Layer"), 0);
+	m_compositeProgram.SetInt(m_compositeProgram.GetUniformLocation("u_Weights"), 1);
+
+	// A core profile draws nothing without a vertex array, even one without attributes
+	glGenVertexArrays(1, &m_vertexArray);
+	glGenQueries(1, &m_query);
+	return true;
+}
+
+// Deletes the program, buffers and queries (while the context still exists)
+void TransparencyTarget::Destroy(){
+	DeleteBuffers();
+	m_compositeProgram.Destroy();
+	if(m_vertexArray != 0){
+		glDeleteVertexArrays(1, &m_vertexArray);
+		m_vertexArray = 0;
+	}
+	if(m_query != 0){
+		glDeleteQueries(1, &m_query);
+		m_query = 0;
+	}
+}
+
+// Creates a width*height texture sampled with texelFetch
+GLuint TransparencyTarget::CreateTexture(GLint internalFormat, GLenum format, GLenum type, GLState& state){
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	state.BindTexture(0, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_width, m_height, 0, format, type, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+// Deletes the textures and framebuffers
+void TransparencyTarget::DeleteBuffers(){
+	GLuint framebuffers[5] = {m_opaqueFramebuffer, m_blendedFramebuffer, m_peeledFramebuffer,
+	                          m_layerFramebuffers[0], m_layerFramebuffers[1]};
+	GLuint textures[7] = {m_opaqueColor, m_opaqueDepth, m_accumulation, m_weights,
+	                      m_layerColor, m_layerDepth[0], m_layerDepth[1]};
+	if(m_opaqueFramebuffer != 0){
+		glDeleteFramebuffers(5, framebuffers);
+		glDeleteTextures(7, textures);
+	}
+	m_opaqueFramebuffer = m_blendedFramebuffer = m_peeledFramebuffer = 0;
+	m_layerFramebuffers[0] = m_layerFramebuffers[1] = 0;
+	m_opaqueColor = m_opaqueDepth = m_accumulation = m_weights = m_layerColor = 0;
+	m_layerDepth[0] = m_layerDepth[1] = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+// Makes the opaque buffers the draw target, (re)allocating them for width*height.
+// The framebuffer bound before is where End() puts the picture.
+// Returns false (after printing why) if a framebuffer is incomplete.
+bool TransparencyTarget::BeginOpaque(GLsizei width, GLsizei height, GLState& state){
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_destination);
+	m_mode = TRANSPARENCY_OFF;
+
+	if(width != m_width || height != m_height){
+		DeleteBuffers();
+		m_width = width;
+		m_height = height;
+		m_opaqueColor = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, state);
+		m_opaqueDepth = CreateTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, state);
+		m_accumulation = CreateTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, state);
+		m_weights = CreateTexture(GL_R16F, GL_RED, GL_HALF_FLOAT, state);
+		m_layerColor = CreateTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, state);
+		m_layerDepth[0] = CreateTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, state);
+		m_layerDepth[1] = CreateTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, state);
+
+		GLuint framebuffers[5];
+		glGenFramebuffers(5, framebuffers);
+		m_opaqueFramebuffer = framebuffers[0];
+		m_blendedFramebuffer = framebuffers[1];
+		m_peeledFramebuffer = framebuffers[2];
+		m_layerFramebuffers[0] = framebuffers[3];
+		m_layerFramebuffers[1] = framebuffers[4];
+
+		const GLenum both[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+		for(unsigned int i = 0; i < 5; i++){
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+			if(framebuffers[i] == m_opaqueFramebuffer){
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_opaqueColor, 0);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_opaqueDepth, 0);
+			}else if(framebuffers[i] == m_blendedFramebuffer){
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumulation, 0);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_weights, 0);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_opaqueDepth, 0);
+				glDrawBuffers(2, both);
+			}else if(framebuffers[i] == m_peeledFramebuffer){
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumulation, 0);
+			}else{
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_layerColor, 0);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_layerDepth[i - 3], 0);
+			}
+			GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+			if(status != GL_FRAMEBUFFER_COMPLETE){
+				std::cout << "Transparency framebuffer " << i << " is incomplete (status 0x" << std::hex << status << std::dec << ")" << std::endl;
+				glBindFramebuffer(GL_FRAMEBUFFER, m_destination);
+				DeleteBuffers();
+				return false;
+			}
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_opaqueFramebuffer);
+	return true;
+}
+
+// Makes the weighted blended buffers the draw target, with depth writes off
+void TransparencyTarget::BeginBlended(GLState& state){
+	m_mode = TRANSPARENCY_BLENDED;
+	glBindFramebuffer(GL_FRAMEBUFFER, m_blendedFramebuffer);
+	// Nothing added yet, and all of the background visible
+	const GLfloat accumulation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+	const GLfloat weights[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	glClearBufferfv(GL_COLOR, 0, accumulation);
+	glClearBufferfv(GL_COLOR, 1, weights);
+
+	// Colors and weights add up, the alpha of buffer 0 multiplies by 1 - alpha
+	state.SetEnabled(GL_BLEND, true);
+	state.BlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+	state.DepthMask(false);
+}
+
+// Starts depth peeling layer number layer (0 first). Binds the previous layer's depth at PEEL_DEPTH_SLOT.
+void TransparencyTarget::BeginLayer(unsigned int layer, GLState& state){
+	GLuint current = m_layerFramebuffers[layer % 2];
+	GLuint previous = m_layerFramebuffers[(layer + 1) % 2];
+	// Depth clears are masked too
+	state.DepthMask(true);
+	if(layer == 0){
+		m_mode = TRANSPARENCY_PEELED;
+		glBindFramebuffer(GL_FRAMEBUFFER, m_peeledFramebuffer);
+		const GLfloat accumulation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+		glClearBufferfv(GL_COLOR, 0, accumulation);
+		// No fragment is in front of the first layer
+		glBindFramebuffer(GL_FRAMEBUFFER, previous);
+		const GLfloat nearest = 0.0f;
+		glClearBufferfv(GL_DEPTH, 0, &nearest);
+	}
+
+	// Starting from the opaque depth hides what is behind opaque things
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_opaqueFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, current);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, current);
+	const GLfloat empty[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	glClearBufferfv(GL_COLOR, 0, empty);
+
+	// Only the nearest fragment behind the previous layer is kept
+	state.SetEnabled(GL_BLEND, false);
+	state.BindTexture(PEEL_DEPTH_SLOT, m_layerDepth[(layer + 1) % 2]);
+	glBeginQuery(GL_ANY_SAMPLES_PASSED, m_query);
+}
+
+// Adds the layer under the ones before it. Waits for the layer's occlusion query and
+// returns false if nothing was drawn, when no more layers are needed.
+bool TransparencyTarget::EndLayer(GLState& state){
+	glEndQuery(GL_ANY_SAMPLES_PASSED);
+	GLuint drawn = 0;
+	glGetQueryObjectuiv(m_query, GL_QUERY_RESULT, &drawn);
+	if(drawn == 0){
+		return false;
+	}
+
+	// Under: what earlier layers let through of this one
+	glBindFramebuffer(GL_FRAMEBUFFER, m_peeledFramebuffer);
+	state.SetEnabled(GL_BLEND, true);
+	state.BlendFuncSeparate(GL_DST_ALPHA, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+	state.BindTexture(0, m_layerColor);
+	DrawFullscreen(false, state);
+	return true;
+}
+
+// Composites the translucent graphs (if any were drawn) over the opaque buffers, copies
+// them to the framebuffer bound at BeginOpaque and restores the state drawing starts from
+void TransparencyTarget::End(GLState& state){
+	glBindFramebuffer(GL_FRAMEBUFFER, m_opaqueFramebuffer);
+	if(m_mode != TRANSPARENCY_OFF){
+		// The layers hold premultiplied color and how much of the background they let through
+		state.SetEnabled(GL_BLEND, true);
+		state.BlendFuncSeparate(GL_ONE, GL_SRC_ALPHA, GL_ZERO, GL_ONE);
+		state.BindTexture(0, m_accumulation);
+		state.BindTexture(1, m_weights);
+		DrawFullscreen(m_mode == TRANSPARENCY_BLENDED, state);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_opaqueFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_destination);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_destination);
+
+	state.SetEnabled(GL_DEPTH_TEST, true);
+	state.DepthMask(true);
+	state.SetEnabled(GL_BLEND, true);
+	state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// Draws a triangle over the viewport that copies (or resolves) the textures at slots 0 and 1
+void TransparencyTarget::DrawFullscreen(bool resolve, GLState& state){
+	state.SetEnabled(GL_DEPTH_TEST, false);
+	state.PolygonMode(GL_FILL);
+	state.UseProgram(m_compositeProgram.GetID());
+	m_compositeProgram.SetInt(m_resolveLocation, resolve ? 1 : 0);
+	state.BindVertexArray(m_vertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	state.SetEnabled(GL_DEPTH_TEST, true);
+}
@@ -23,10 +23,47 @@
 #include <iostream>
 #include <vector>
 #include <OBJModel.hpp>
+#include <OBJParser.hpp>
 #include <Camera.hpp>
-#include <Texture.hpp>
+#include <ShaderProgram.hpp>
+#include <GLState.hpp>
+#include <RenderScheduler.hpp>
+#include <FrameProfiler.hpp>
+#include <OffscreenContext.hpp>
+#include <OffscreenTarget.hpp>
+#include <ImageWriter.hpp>
+#include <SoftwareRasterizer.hpp>
+#include <Image.hpp>
+#include <Equation.hpp>
+#include <ThreadPool.hpp>
+#include <JSONLine.hpp>
+#include <GraphServer.hpp>
+#include <AnimatedGraph.hpp>
+#include <AxesGrid.hpp>
+#include <TransparencyTarget.hpp>
+#include <GLSLExpression.hpp>
+#include <mutex>
 #include <Graph.hpp>
+#include <HeightPyramid.hpp>
+#include <MinMaxPyramid.hpp>
+#include <ImplicitSurface.hpp>
+#include <ParametricSurface.hpp>
+#include <ContourSet.hpp>
+#include <SurfaceIntersection.hpp>
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <cctype>
+#include <exception>
+#include <algorithm>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <map>
 
 // vvvvvvvvvvvvvvvvvvvvvvvvvv Globals vvvvvvvvvvvvvvvvvvvvvvvvvv
 // Globals generally are prefixed with 'g' in this application.
@@ -40,10 +77,59 @@ SDL_GLContext gOpenGLContext			= nullptr;
 // Main loop flag
 bool gQuit = false; // If this is quit = 'true' then the program terminates.
 
+// Render scheduling
+// Frames are only drawn when something on screen changed, optionally capped to
+// gFrameCap frames per second (0 = no cap). Set with --max-fps and --vsync.
+RenderScheduler gScheduler;
+unsigned int gFrameCap = 0;
+const unsigned int MAX_FRAME_CAP = 1000; // highest --max-fps
+VSyncMode gVSync = VSYNC_ADAPTIVE;
+
+// Profiling
+// --profile shows rolling frame time percentiles in the window title, and
+// --profile-csv <file> also writes every frame to a CSV file.
+FrameProfiler gProfiler;
+bool gProfile = false;
+std::string gProfileCSV = "";
+
 // shader
-// The following stores the a unique id for the graphics pipeline
-// program object that will be used for our OpenGL draw calls.
-GLuint gGraphicsPipelineShaderProgram	= 0;
+// The following stores the graphics pipeline program object that will be used
+// for our OpenGL draw calls, along with its uniform locations.
+ShaderProgram gGraphicsPipeline;
+GLint gColoringLocation                 = -1;
+GLint gHighlightLocation                = -1;
+GLint gTransparencyLocation             = -1;
+GLint gPeelDepthLocation                = -1;
+// The x-y grid and the axes, drawn by their own shaders before the graphs
+AxesGrid gAxesGrid;
+
+// Translucent graphs
+// Overlapping graphs are drawn in any order with weighted blended order-independent transparency,
+// or with exact depth peeling (at most MAX_PEEL_LAYERS layers) for screenshots, picked with
+// --transparency blended|peel|off. Off blends them in draw order, straight into the window.
+// Normal coloring (N) is opaque, so it is always drawn like off.
+TransparencyTarget gTransparency;
+TransparencyMode gTransparencyMode      = TRANSPARENCY_BLENDED;
+const unsigned int MAX_PEEL_LAYERS      = 16;
+
+// Uniform Buffer Object (UBO)
+// Holds the model, view and projection matrices in std140 layout. It is bound to
+// FRAME_MATRICES_BINDING and only re-uploaded when one of the matrices changes.
+const GLuint FRAME_MATRICES_BINDING     = 0;
+GLuint gFrameUniformBuffer              = 0;
+struct FrameMatrices {
+    glm::mat4 model;
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+FrameMatrices gFrameMatrices;
+bool gFrameMatricesUploaded             = false;
+// Size the projection matrix was last built for
+int gProjectionWidth                    = 0;
+int gProjectionHeight                   = 0;
+
+// Shadow of the OpenGL state so redundant calls are skipped
+GLState gState;
 
 // OpenGL Objects
 // Vertex Array Object (VAO)
@@ -57,13 +143,167 @@ GLuint gVertexArrayObject					= 0;
 // VBOs are our mechanism for arranging geometry on the GPU.
 GLuint 	gVertexBufferObject					= 0;
 GLuint  gIndexBufferObject                  = 0;
+// Index of the graph each vertex belongs to (attribute 4), used to look up its color
+GLuint  gGraphIndexBufferObject             = 0;
+
+// Shared vertex/index arena
+// Every graph lives in the buffers above, with indices local to its own vertices.
+// One glMultiDrawElementsBaseVertex call draws all of them.
+struct ArenaRange {
+    GLsizei indexCount; // indices of this grid or graph
+    GLuint firstIndex; // offset of its first index in gIndexBufferObject
+    GLint baseVertex; // offset of its first vertex in gVertexBufferObject
+    GLsizei vertexCount; // vertices of this grid or graph
+};
+// The grid .obj first (only filled for the software renderer, see gAxesGrid), then gGraphs in order
+std::vector<ArenaRange> gArenaRanges;
+// Arguments of the multi-draw, rebuilt by CullDrawCommands
+std::vector<GLsizei> gDrawCounts;
+std::vector<const void*> gDrawOffsets;
+std::vector<GLint> gDrawBaseVertices;
+GLsizei gDrawIndexCount = 0;
+
+// Frustum culling
+// Graphs are drawn tile by tile (see Graph::getChunks), and only the tiles whose bounding box
+// is inside the view frustum go into the multi-draw. The commands are rebuilt when the matrices,
+// the arena or the visible graphs change. --no-cull draws every tile.
+bool gCullChunks = true;
+bool gDrawCommandsDirty = true; // set by UpdateDrawCommands
+glm::mat4 gCulledMatrix(0.0f); // projection * view * model the commands were culled with
+
+// Uniform Buffer Object (UBO) with one color per arena range, indexed by attribute 4
+// (entry 0, the grid's, stays white). Bound to GRAPH_COLORS_BINDING.
+const GLuint GRAPH_COLORS_BINDING       = 1;
+const unsigned int MAX_GRAPH_COLORS     = 1024; // vec4s in 16 KB, the smallest GL_MAX_UNIFORM_BLOCK_SIZE
+GLuint gGraphColorBuffer                = 0;
 
 unsigned int equationCount = 0;
 
 
-std::vector<std::string> gEquations;
+// Graphs
+// Every graph of the scene, from the command line and --scene files
+struct SceneGraph {
+    std::string equation;
+    glm::vec3 color;
+    bool visible;
+    unsigned int resolution;
+    bool animated; // the equation uses t, see gAnimations
+    bool implicit; // the equation uses z and is drawn where it is 0, see ImplicitSurface
+    bool parametric; // the equation is x, y and z in u and v, see ParametricSurface
+    std::string glsl; // f(x,y) in GLSL when the graph is evaluated on the GPU (--gpu), empty otherwise
+    float opacity = 1.0f; // multiplies the alpha of the graph's vertices
+    glm::vec4 parameterRange = glm::vec4(0.0f, 2*glm::pi<float>(), 0.0f, 2*glm::pi<float>()); // u and v of parametric surfaces
+};
+std::vector<SceneGraph> gGraphs;
+
+// Animated graphs
+// Graphs of f(x,y,t) are not in the arena. Each has an AnimatedGraph (in gGraphs order)
+// whose frames are computed on gProducers while the current frame is drawn.
+std::vector<std::unique_ptr<AnimatedGraph>> gAnimations;
+std::unique_ptr<ThreadPool> gProducers;
+const unsigned int DEFAULT_ANIMATION_FPS = 60; // frames of animation per second without --max-fps
+
+// Progressive building
+// With gProgressive (the default for the window, off with --no-progressive) graphs are first
+// built COARSEST_LEVEL samples wide and then refined on gBuilders, doubling the sampling rate
+// each level and reusing the samples already taken, until they reach their resolution. A
+// resolution doubling does not reach is sampled afresh once the level below it is shown.
+// Finished levels wait in gRefinedMeshes until the main loop swaps them into the arena.
+struct GraphMesh {
+    unsigned int dimension; // samples per side
+    std::vector<float> heights; // normalized heights, for the next level and contour lines (empty for surfaces)
+    std::vector<float> VBO;
+    std::vector<unsigned int> IBO;
+    std::vector<GraphChunk> chunks; // tiles of IBO with their bounding boxes
+    std::unique_ptr<const MinMaxPyramid> pyramid; // for picking, with gPicking only
+};
+const unsigned int COARSEST_LEVEL = 51;
+bool gProgressive = false;
+std::vector<std::shared_ptr<const GraphMesh>> gGraphMeshes; // mesh in the arena for each of gGraphs
+std::unique_ptr<ThreadPool> gBuilders;
+std::mutex gRefinedMutex; // guards gRefinedMeshes
+std::vector<std::pair<size_t, std::shared_ptr<const GraphMesh>>> gRefinedMeshes; // graph index, finer mesh
+std::atomic<bool> gStopRefining(false); // set on exit so queued levels are skipped
+
+// GPU evaluated graphs
+// With --gpu, graphs whose equation translates to GLSL (see GLSLExpression) are not sampled
+// on the CPU. shaders/graph_vert.glsl evaluates them over a flat grid of sample indices, with
+// the equation appended as f(x, y). Programs are cached by their GLSL and grids by resolution,
+// so a new resolution or domain costs no CPU work beyond a grid that is built once.
+struct EquationProgram {
+    ShaderProgram program;
+    GLint coloringLocation;
+    GLint highlightLocation;
+    GLint transparencyLocation;
+    GLint graphIndexLocation;
+    GLint dimensionLocation;
+    GLint domainMinLocation;
+    GLint domainMaxLocation;
+};
+struct SampleGrid {
+    GLuint vertexArray;
+    GLuint vertexBuffer; // column and row of every sample
+    GLuint indexBuffer; // two triangles per cell
+    GLsizei indexCount;
+};
+bool gGPUEvaluate = false;
+std::map<std::string, std::unique_ptr<EquationProgram>> gEquationPrograms; // by GLSL of f
+std::map<unsigned int, SampleGrid> gSampleGrids; // by samples per side
+
+// Picking
+// In the window, the graph under the mouse and f(x,y) there are shown in the title. Every graph
+// in the arena gets a MinMaxPyramid of its heights, so the ray through the cursor costs a few
+// blocks per level of the pyramid instead of every cell under it. Animated and GPU evaluated
+// graphs have no heights on the CPU and are not picked.
+bool gPicking = false;
+int gMouseX = -1; // cursor in window pixels, -1 while it is outside the window
+int gMouseY = -1;
+bool gPickDirty = false; // the cursor or the picture changed since the last pick
+std::string gPickSummary; // last pick, for the title
+
+// Contour lines
+// With gContours (--contours <interval>, toggled with C) every graph in the arena gets a ContourSet
+// of its heights at the multiples of gContourInterval, which [ and ] halve and double. The lines are
+// drawn as line strips on the graph and again flat on the grid. Each set is kept with the mesh it
+// was made from, so a new interval only extracts the levels it adds and a finer level of a graph
+// only rebuilds that graph's set. Implicit, parametric, animated and GPU evaluated graphs have none.
+struct GraphContours {
+    std::shared_ptr<const GraphMesh> mesh; // the mesh set was made from
+    std::unique_ptr<ContourSet> set;
+    float tooFineInterval = 0.0f; // the last interval set refused, so it is reported once
+};
+const float MIN_CONTOUR_INTERVAL = 0.125f; // keeps the plotted z range under ContourSet::MAX_LEVELS levels
+bool gContours = false;
+float gContourInterval = 1.0f;
+bool gContoursDirty = true; // the sets or the visible graphs changed since the lines were uploaded
+std::vector<GraphContours> gGraphContours; // in gGraphs order
+ShaderProgram gContourProgram;
+GLint gContourModeLocation = -1;
+GLint gContourFloorHeightLocation = -1;
+GLuint gContourVertexArray = 0;
+GLuint gContourVertexBuffer = 0; // position (x, height, y) and color of every point
+std::vector<GLint> gContourFirsts; // first point of every line strip
+std::vector<GLsizei> gContourCounts; // points of every line strip
+
+// Intersection curves
+// With gIntersections (--intersections, toggled with I) the curves where two visible graphs of the
+// arena meet are found with SurfaceIntersection and drawn in INTERSECTION_COLOR by the contour line
+// program. Only graphs sampled on the same grid, at the same resolution, are compared. Each pair
+// keeps the meshes its curves were found on, so a finer level of a graph only searches its pairs again.
+struct GraphIntersection {
+    std::shared_ptr<const GraphMesh> first; // the meshes the curves were found on
+    std::shared_ptr<const GraphMesh> second;
+    std::unique_ptr<SurfaceIntersection> curves;
+};
+const glm::vec3 INTERSECTION_COLOR(1.0f, 0.85f, 0.0f);
+bool gIntersections = false;
+bool gIntersectionsDirty = true; // the meshes or the visible graphs changed since the curves were uploaded
+std::map<std::pair<size_t, size_t>, GraphIntersection> gGraphIntersections; // by the indices of both graphs
+GLuint gIntersectionVertexArray = 0;
+GLuint gIntersectionVertexBuffer = 0; // position (x, height, y) and color of every point
+std::vector<GLint> gIntersectionFirsts; // first point of every line strip
+std::vector<GLsizei> gIntersectionCounts; // points of every line strip
 
-int gFaceCount = 0;
 int gDrawMode = 0;
 int gRESOLUTION = 401; // 401x401
 
@@ -79,8 +319,6 @@ int u_coloring = 0;
 int u_highlight = 0;
 
 Camera gCamera;
-
-Texture gTexture;
 // ^^^^^^^^^^^^^^^^^^^^^^^^ Globals ^^^^^^^^^^^^^^^^^^^^^^^^^^^
 
 
@@ -123,98 +361,65 @@ std::string ShaderToString(const std::string& filename) {
 
 
 /**
-* CompileShader will compile any valid vertex, fragment, geometry, tesselation, or compute shader.
-* e.g.
-*	    Compile a vertex shader: 	CompileShader(GL_VERTEX_SHADER, vertexShaderSource);
-*       Compile a fragment shader: 	CompileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+* Compiles the contour line program and makes the vertex arrays of the contour lines
+* and the intersection curves (the buffers are filled by UpdateContours and UpdateIntersections)
 *
-* @param type We use the 'type' field to determine which shader we are going to compile.
-* @param source : The shader source code.
-* @return id of the shaderObject
+* @return void
 */
-GLuint CompileShader(GLuint type, const std::string& source){
-	// Compile our shaders
-	GLuint shaderObject;
-
-	// Based on the type passed in, we create a shader object specifically for that
-	// type.
-	if(type == GL_VERTEX_SHADER){
-		shaderObject = glCreateShader(GL_VERTEX_SHADER);
-	}else if(type == GL_FRAGMENT_SHADER){
-		shaderObject = glCreateShader(GL_FRAGMENT_SHADER);
-	}
-
-	const char* src = source.c_str();
-	// The source of our shader
-	glShaderSource(shaderObject, 1, &src, nullptr);
-	// Now compile our shader
-	glCompileShader(shaderObject);
-
-	// Retrieve the result of our compilation
-	int result;
-	// Our goal with glGetShaderiv is to retrieve the compilation status
-	glGetShaderiv(shaderObject, GL_COMPILE_STATUS, &result);
-
-	if(result == GL_FALSE){
-		int length;
-		glGetShaderiv(shaderObject, GL_INFO_LOG_LENGTH, &length);
-		char* errorMessages = new char[length]; // Could also use alloca here.
-		glGetShaderInfoLog(shaderObject, length, &length, errorMessages);
-
-		if(type == GL_VERTEX_SHADER){
-			std::cout << "ERROR: GL_VERTEX_SHADER compilation failed!\n" << errorMessages << "\n";
-		}else if(type == GL_FRAGMENT_SHADER){
-			std::cout << "ERROR: GL_FRAGMENT_SHADER compilation failed!\n" << errorMessages << "\n";
-		}
-		// Reclaim our memory
-		delete[] errorMessages;
-
-		// Delete our broken shader
-		glDeleteShader(shaderObject);
-
-		return 0;
-	}
+void CreateContourPipeline(){
+    if(!gContourProgram.Create(ShaderToString("./shaders/contour_vert.glsl"), ShaderToString("./shaders/contour_frag.glsl"))){
+        exit(EXIT_FAILURE);
+    }
+    gContourModeLocation = gContourProgram.GetUniformLocation("u_Mode");
+    gContourFloorHeightLocation = gContourProgram.GetUniformLocation("u_FloorHeight");
+    if(gContourModeLocation < 0 || gContourFloorHeightLocation < 0){
+        std::cout << "Could not find u_Mode or u_FloorHeight, maybe a misspelling?" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if(!gContourProgram.BindUniformBlock("FrameMatrices", FRAME_MATRICES_BINDING)){
+        std::cout << "Could not find uniform block FrameMatrices in the contour shaders, maybe a misspelling?" << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-  return shaderObject;
+    // Both are 6 floats per point: position, then color
+    auto createLines = [](GLuint& vertexArray, GLuint& vertexBuffer) {
+        glGenVertexArrays(1, &vertexArray);
+        gState.BindVertexArray(vertexArray);
+        glGenBuffers(1, &vertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat)*6, (GLvoid*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat)*6, (GLvoid*)(sizeof(GLfloat)*3));
+    };
+    createLines(gContourVertexArray, gContourVertexBuffer);
+    createLines(gIntersectionVertexArray, gIntersectionVertexBuffer);
+    gState.BindVertexArray(0);
 }
 
 
-
 /**
-* Creates a graphics program object (i.e. graphics pipeline) with a Vertex Shader and a Fragment Shader
+* Deletes the contour line program, its buffers, the sets of the graphs and the
+* intersection curves
 *
-* @param vertexShaderSource Vertex source code as a string
-* @param fragmentShaderSource Fragment shader source code as a string
-* @return id of the program Object
+* @return void
 */
-GLuint CreateShaderProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource){
-
-    // Create a new program object
-    GLuint programObject = glCreateProgram();
-
-    // Compile our shaders
-    GLuint myVertexShader   = CompileShader(GL_VERTEX_SHADER, vertexShaderSource);
-    GLuint myFragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
-
-    // Link our two shader programs together.
-	// Consider this the equivalent of taking two .cpp files, and linking them into
-	// one executable file.
-    glAttachShader(programObject,myVertexShader);
-    glAttachShader(programObject,myFragmentShader);
-    glLinkProgram(programObject);
-
-    // Validate our program
-    glValidateProgram(programObject);
-
-    // Once our final program Object has been created, we can
-	// detach and then delete our individual shaders.
-    glDetachShader(programObject,myVertexShader);
-    glDetachShader(programObject,myFragmentShader);
-	// Delete the individual shaders once we are done
-    glDeleteShader(myVertexShader);
-    glDeleteShader(myFragmentShader);
-
-    return programObject;
+void DeleteContours(){
+    gContourProgram.Destroy();
+    glDeleteBuffers(1, &gContourVertexBuffer);
+    glDeleteVertexArrays(1, &gContourVertexArray);
+    glDeleteBuffers(1, &gIntersectionVertexBuffer);
+    glDeleteVertexArrays(1, &gIntersectionVertexArray);
+    gContourVertexBuffer = 0;
+    gContourVertexArray = 0;
+    gIntersectionVertexBuffer = 0;
+    gIntersectionVertexArray = 0;
+    gGraphContours.clear();
+    gContourFirsts.clear();
+    gContourCounts.clear();
+    gGraphIntersections.clear();
+    gIntersectionFirsts.clear();
+    gIntersectionCounts.clear();
 }
 
 
@@ -227,9 +432,60 @@ void CreateGraphicsPipeline(){
 	
     std::string vertexShaderSource = ShaderToString("./shaders/vert.glsl");
     std::string fragmentShaderSource = ShaderToString("./shaders/frag.glsl");
-    gGraphicsPipelineShaderProgram = CreateShaderProgram(vertexShaderSource,fragmentShaderSource);
+    if(!gGraphicsPipeline.Create(vertexShaderSource,fragmentShaderSource)){
+        exit(EXIT_FAILURE);
+    }
 
+    // Resolve every uniform once, here, instead of every frame
+    gColoringLocation = gGraphicsPipeline.GetUniformLocation("u_coloring");
+    if(gColoringLocation < 0){
+        std::cout << "Could not find u_coloring, maybe a misspelling?" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    gHighlightLocation = gGraphicsPipeline.GetUniformLocation("u_highlight");
+    if(gHighlightLocation < 0){
+        std::cout << "Could not find u_highlight, maybe a misspelling?" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    gTransparencyLocation = gGraphicsPipeline.GetUniformLocation("u_Transparency");
+    gPeelDepthLocation = gGraphicsPipeline.GetUniformLocation("u_PeelDepth");
+    if(gTransparencyLocation < 0 || gPeelDepthLocation < 0){
+        std::cout << "Could not find u_Transparency or u_PeelDepth, maybe a misspelling?" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    gState.UseProgram(gGraphicsPipeline.GetID());
+    gGraphicsPipeline.SetInt(gPeelDepthLocation, TransparencyTarget::PEEL_DEPTH_SLOT);
+    if(!gGraphicsPipeline.BindUniformBlock("FrameMatrices", FRAME_MATRICES_BINDING)){
+        std::cout << "Could not find uniform block FrameMatrices, maybe a misspelling?" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if(!gGraphicsPipeline.BindUniformBlock("GraphColors", GRAPH_COLORS_BINDING)){
+        std::cout << "Could not find uniform block GraphColors, maybe a misspelling?" << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
+    if(!gAxesGrid.Create(ShaderToString("./shaders/grid_vert.glsl"), ShaderToString("./shaders/grid_frag.glsl"),
+                         ShaderToString("./shaders/axes_vert.glsl"), ShaderToString("./shaders/axes_frag.glsl"),
+                         FRAME_MATRICES_BINDING, gState)){
+        exit(EXIT_FAILURE);
+    }
+    if(!gTransparency.Create(ShaderToString("./shaders/composite_vert.glsl"), ShaderToString("./shaders/composite_frag.glsl"), gState)){
+        exit(EXIT_FAILURE);
+    }
+    CreateContourPipeline();
+
+    glGenBuffers(1, &gFrameUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, gFrameUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameMatrices), nullptr, GL_DYNAMIC_DRAW);
+    gState.BindUniformBuffer(FRAME_MATRICES_BINDING, gFrameUniformBuffer);
+
+    // State that never changes while drawing is set once
+    gState.SetEnabled(GL_DEPTH_TEST, true);
+    gState.SetEnabled(GL_CULL_FACE, false);
+    gState.SetEnabled(GL_BLEND, true);
+    gState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // This is the background of the screen.
+    gState.ClearColor(0.1f, 0.1f, 0.1f, 1.f);
 }
 
 
@@ -281,367 +537,2545 @@ void InitializeProgram(){
 		std::cout << "glad did not initialize" << std::endl;
 		exit(1);
 	}
-	
+	ShaderProgram::LoadBinaryFunctions(SDL_GL_GetProcAddress);
+
+	// Adaptive vsync tears instead of stalling when a frame runs late
+	gVSync = gScheduler.SetVSync(gVSync);
+	gScheduler.SetFrameCap(gFrameCap);
+
+	if(gProfile && !gProfiler.Enable(gProfileCSV)){
+		exit(1);
+	}
 }
 
 /**
-* Create the geometry of the .obj (OBJModel) based on gFilePath
-* Assumes there is a texture and mtl file
-* @return void
+* Returns the resolution a graph is first built at: the coarsest level, at least
+* COARSEST_LEVEL samples wide, from which doubling the sampling rate reaches resolution,
+* or COARSEST_LEVEL if doubling never reaches it (see NextLevel)
+*
+* @param resolution samples per side of the finished graph
+* @return samples per side of the first level
 */
-void VertexSpecification(){
-
-    OBJModel commandObject("./objects/grid/grid.obj");
-    
-    std::string diffuse = commandObject.getTexture();
-    
-    gTexture.LoadTexture(diffuse);
-    
-    std::vector<std::vector<float>> VBOs;
-    std::vector<std::vector<unsigned int>> IBOs;
-
-    for (int i = 0; i < gEquations.size(); i++) {
-        Graph g(gEquations[i], gRESOLUTION, i + 1);
-        VBOs.push_back(g.getVBO());
-        IBOs.push_back(g.getIBO());
+unsigned int FirstLevel(unsigned int resolution){
+    unsigned int level = resolution;
+    while ((level - 1) % 2 == 0 && (level - 1)/2 + 1 >= COARSEST_LEVEL) {
+        level = (level - 1)/2 + 1;
     }
-    
-    gFaceCount = commandObject.getIBO().size();
+    // Any level twice COARSEST_LEVEL wide or more could have been halved again
+    return level >= 2*(COARSEST_LEVEL - 1) + 1 ? COARSEST_LEVEL : level;
+}
 
-    for (int i = 0; i < gEquations.size(); i++) {
-        gFaceCount += IBOs[i].size();
-    }
 
-    gFaceCount = gFaceCount/3;
+/**
+* Returns the level after one of a graph: the doubled sampling rate, or resolution
+* itself once doubling would pass it
+*
+* @param dimension samples per side of the current level
+* @param resolution samples per side of the finished graph
+* @return samples per side of the next level
+*/
+unsigned int NextLevel(unsigned int dimension, unsigned int resolution){
+    unsigned int doubled = 2*(dimension - 1) + 1;
+    return doubled <= resolution ? doubled : resolution;
+}
 
-    std::vector<GLfloat> vertexData = commandObject.getVBO();
-    
-    for (int i = 0; i < gEquations.size(); i++) {
-        std::vector<GLfloat> vertexDataGraph = VBOs[i];
-        vertexData.insert(vertexData.end(), vertexDataGraph.begin(), vertexDataGraph.end());
+
+/**
+* Copies what the arena needs out of a graph. Its heights are kept so the next
+* level can reuse them and contour lines can be drawn.
+*
+* @param graph graph of one level
+* @param dimension samples per side of graph
+* @return mesh for gGraphMeshes
+*/
+std::shared_ptr<const GraphMesh> MakeGraphMesh(const Graph& graph, unsigned int dimension){
+    std::shared_ptr<GraphMesh> mesh = std::make_shared<GraphMesh>();
+    mesh->dimension = dimension;
+    mesh->heights.assign(graph.getHeights(), graph.getHeights() + (size_t)dimension*dimension);
+    mesh->VBO = graph.getVBO();
+    mesh->IBO = graph.getIBO();
+    mesh->chunks = graph.getChunks();
+    if (gPicking) {
+        mesh->pyramid.reset(new MinMaxPyramid(graph.getHeights(), dimension));
     }
+    return mesh;
+}
 
-	glGenVertexArrays(1, &gVertexArrayObject);
-	glBindVertexArray(gVertexArrayObject);
 
-	glGenBuffers(1, &gVertexBufferObject);
-	glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, 								// Kind of buffer we are working with 
-																// (e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER)
-				 vertexData.size() * sizeof(GL_FLOAT), 	// Size of data in bytes
-				 vertexData.data(), 						// Raw array of data
-				 GL_STATIC_DRAW);								// How we intend to use the data
+/**
+* Makes the GraphMesh of an implicit or parametric surface. Surfaces are built once at
+* their resolution, so there is nothing to refine and no heights to keep.
+*
+* @param VBO 12 float vertices of the surface
+* @param IBO its triangle indices
+* @param chunks its tiles or bricks
+* @param resolution samples per side it was built with
+* @return mesh for gGraphMeshes
+*/
+std::shared_ptr<const GraphMesh> MakeSurfaceMesh(const std::vector<float>& VBO, const std::vector<unsigned int>& IBO,
+                                                 const std::vector<GraphChunk>& chunks, unsigned int resolution){
+    std::shared_ptr<GraphMesh> mesh = std::make_shared<GraphMesh>();
+    mesh->dimension = resolution;
+    mesh->VBO = VBO;
+    mesh->IBO = IBO;
+    mesh->chunks = chunks;
+    return mesh;
+}
 
 
-    std::vector<GLuint> indexBufferData = commandObject.getIBO();
-    
-    int offset = commandObject.getVBO().size()/12;
-    
-    for (int j = 0; j < gEquations.size(); j++) {
-        std::vector<GLuint> IBOGraph = IBOs[j];
-        for (int i = 0; i < IBOGraph.size(); i++) {
-            IBOGraph[i] = IBOGraph[i] + offset;
+/**
+* Builds the vertex and index data of the grid .obj (OBJModel), if one is given, and
+* of every graph in gGraphs, without touching OpenGL. Graphs that are not in gGraphMeshes
+* yet are built in parallel, at their first level if gProgressive is set (implicit and
+* parametric surfaces are always built at their resolution, in parallel parts).
+* Animated and GPU evaluated graphs get an empty range, and so does the grid without grid.
+*
+* @param vertexData receives the 12 float vertices of the grid, then of each graph
+* @param indexBufferData receives the triangle indices, local to each grid or graph
+* @param ranges receives where the grid and each graph are in vertexData and indexBufferData
+* @param grid the grid .obj, or nullptr when gAxesGrid draws it
+* @return void
+*/
+void BuildGeometry(std::vector<GLfloat>& vertexData, std::vector<GLuint>& indexBufferData,
+                   std::vector<ArenaRange>& ranges, const OBJModel* grid){
+
+    gGraphMeshes.resize(gGraphs.size());
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < gGraphs.size(); i++) {
+        // Animated and GPU evaluated graphs are drawn on their own and left as an empty range
+        if (!gGraphs[i].animated && gGraphs[i].glsl.empty() && !gGraphMeshes[i]) {
+            missing.push_back(i);
         }
-        offset += VBOs[j].size()/12;
-        indexBufferData.insert(indexBufferData.end(), IBOGraph.begin(), IBOGraph.end());
     }
-    
-    glGenBuffers(1, &gIndexBufferObject);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIndexBufferObject);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 indexBufferData.size() * sizeof(GLuint),
-                 indexBufferData.data(),
-                 GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0,  		// Attribute 0 corresponds to the enabled glEnableVertexAttribArray
-							  		// In the future, you'll see in our vertex shader this also correspond
-							  		// to (layout=0) which selects these attributes.
-                          3,  		// The number of components (e.g. x,y,z = 3 components)
-                          GL_FLOAT, // Type
-                          GL_FALSE, // Is the data normalized
-                          sizeof(GL_FLOAT)*12, 		// Stride
-                          (void*)0	// Offset
-    );
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1,
-                          3, // xn,yx,zn
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(GL_FLOAT)*12,
-                          (GLvoid*)(sizeof(GL_FLOAT)*3));
+    if (!missing.empty()) {
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        ThreadPool pool((unsigned int)std::min<size_t>(missing.size(), cores));
+        for (size_t i : missing) {
+            pool.submit([i]() {
+                unsigned int resolution = gGraphs[i].resolution;
+                if (gGraphs[i].implicit) {
+                    ImplicitSurface surface(gGraphs[i].equation, resolution);
+                    gGraphMeshes[i] = MakeSurfaceMesh(surface.getVBO(), surface.getIBO(), surface.getChunks(), resolution);
+                    return;
+                }
+                if (gGraphs[i].parametric) {
+                    const glm::vec4& range = gGraphs[i].parameterRange;
+                    ParametricSurface surface(gGraphs[i].equation, resolution, range[0], range[1], range[2], range[3]);
+                    gGraphMeshes[i] = MakeSurfaceMesh(surface.getVBO(), surface.getIBO(), surface.getChunks(), resolution);
+                    return;
+                }
+                unsigned int dimension = gProgressive ? FirstLevel(resolution) : resolution;
+                // The height map is only written for the finished graph
+                Graph g(gGraphs[i].equation, dimension, i + 1, -5.0f, 5.0f, dimension == resolution);
+                gGraphMeshes[i] = MakeGraphMesh(g, dimension);
+            });
+        }
+        pool.wait();
+    }
 
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2,
-                          4, // r,g,b,a
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(GL_FLOAT)*12,
-                          (GLvoid*)(sizeof(GL_FLOAT)*6));
+    vertexData.clear();
+    indexBufferData.clear();
+    if (grid != nullptr) {
+        vertexData = grid->getVBO();
+        indexBufferData = grid->getIBO();
+    }
+    ranges.assign(1, ArenaRange{(GLsizei)indexBufferData.size(), 0, 0, (GLsizei)(vertexData.size()/12)});
+    
+    for (size_t i = 0; i < gGraphs.size(); i++) {
+        if (!gGraphMeshes[i]) {
+            ranges.push_back(ArenaRange{0, (GLuint)indexBufferData.size(), (GLint)(vertexData.size()/12), 0});
+            continue;
+        }
+        const GraphMesh& mesh = *gGraphMeshes[i];
+        ranges.push_back(ArenaRange{(GLsizei)mesh.IBO.size(), (GLuint)indexBufferData.size(),
+                                    (GLint)(vertexData.size()/12), (GLsizei)(mesh.VBO.size()/12)});
+        vertexData.insert(vertexData.end(), mesh.VBO.begin(), mesh.VBO.end());
+        indexBufferData.insert(indexBufferData.end(), mesh.IBO.begin(), mesh.IBO.end());
+    }
+}
 
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3,
-                          2, // s,t
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(GL_FLOAT)*12,
-                          (GLvoid*)(sizeof(GL_FLOAT)*10));
 
-	glBindVertexArray(0);
-	glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(3);
+/**
+* Turns the arena made by BuildGeometry into one plain triangle list, as drawn by the
+* shaders: graph colors are multiplied into the vertices, indices are made absolute
+* and hidden graphs are left out. Used by the software rasterizer.
+*
+* @param vertexData 12 float vertices from BuildGeometry
+* @param indexBufferData local indices from BuildGeometry, replaced by absolute ones
+* @param ranges ranges from BuildGeometry
+* @return void
+*/
+void FlattenGeometry(std::vector<GLfloat>& vertexData, std::vector<GLuint>& indexBufferData,
+                     const std::vector<ArenaRange>& ranges){
+    std::vector<GLuint> indices;
+    for (size_t r = 0; r < ranges.size(); r++) {
+        const ArenaRange& range = ranges[r];
+        if (r > 0) {
+            const SceneGraph& graph = gGraphs[r - 1];
+            if (!graph.visible) {
+                continue;
+            }
+            Graph::tintVertices(vertexData.data() + (size_t)range.baseVertex*12, range.vertexCount, graph.color);
+            for (GLsizei v = 0; v < range.vertexCount; v++) {
+                vertexData[((size_t)range.baseVertex + v)*12 + 9] *= graph.opacity;
+            }
+        }
+        for (GLsizei i = 0; i < range.indexCount; i++) {
+            indices.push_back(indexBufferData[range.firstIndex + i] + range.baseVertex);
+        }
+    }
+    indexBufferData.swap(indices);
 }
 
 
 /**
-* PreDraw
-* Typically we will use this for setting some sort of 'state'
-* Note: some of the calls may take place at different stages (post-processing) of the
-* 		 pipeline.
+* Uploads the graph colors and has PreDraw rebuild the arguments of the multi-draw.
+* Called after VertexSpecification and whenever the arena changes or a graph is
+* shown, hidden or recolored.
+*
 * @return void
 */
-void PreDraw(){
-	// Disable depth test and face culling.
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
-		// Enable texture mapping
-	glEnable(GL_TEXTURE_2D);
-    glCullFace(GL_FRONT_AND_BACK);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    // Initialize clear color
-    // This is the background of the screen.
-    glViewport(0, 0, gScreenWidth, gScreenHeight);
-    glClearColor( 0.1f, 0.1f, 0.1f, 1.f );
-
-    //Clear color buffer and Depth Buffer
-  	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+void UpdateDrawCommands(){
+    std::vector<glm::vec4> colors(gArenaRanges.size(), glm::vec4(1.0f));
+    for (size_t r = 1; r < gArenaRanges.size(); r++) {
+        colors[r] = glm::vec4(gGraphs[r - 1].color, gGraphs[r - 1].opacity);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, gGraphColorBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, colors.size()*sizeof(glm::vec4), colors.data());
+    gDrawCommandsDirty = true;
+    gContoursDirty = true;
+    gIntersectionsDirty = true;
+}
 
-   	glUseProgram(gGraphicsPipelineShaderProgram);
 
-    // Spherical Coordinates
-    float x = g_CameraRadius * glm::sin(glm::radians(g_RotatePhi)) * glm::cos(glm::radians(g_RotateTheta));
-    float z = g_CameraRadius * glm::sin(glm::radians(g_RotatePhi)) * glm::sin(glm::radians(g_RotateTheta));
-    float y = g_CameraRadius * glm::cos(glm::radians(g_RotatePhi));
+/**
+* Returns true unless the box is entirely behind one of the planes. Boxes that
+* only straddle the frustum's corners may pass, which costs nothing but a draw.
+*
+* @param planes frustum planes as (normal, distance), normals pointing inwards
+* @param min smallest corner of the box
+* @param max largest corner of the box
+* @return whether the box may be visible
+*/
+bool BoxInFrustum(const glm::vec4 planes[6], const glm::vec3& min, const glm::vec3& max){
+    for (int p = 0; p < 6; p++) {
+        // The corner furthest along the normal
+        glm::vec3 corner(planes[p].x >= 0.0f ? max.x : min.x,
+                         planes[p].y >= 0.0f ? max.y : min.y,
+                         planes[p].z >= 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    glm::mat4 model = glm::lookAt(glm::vec3(x,y,z),glm::vec3(0,0,0),glm::vec3(0,1,0));
 
-    model = glm::translate(model, glm::vec3(g_CenterX, g_CenterY, g_CenterZ));
-    // Retrieve our location of our Model Matrix
-    GLint u_ModelMatrixLocation = glGetUniformLocation( gGraphicsPipelineShaderProgram,"u_ModelMatrix");
-    if(u_ModelMatrixLocation >=0){
-        glUniformMatrix4fv(u_ModelMatrixLocation,1,GL_FALSE,&model[0][0]);
-    }else{
-        std::cout << "Could not find u_ModelMatrix, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+/**
+* Rebuilds the arguments of the multi-draw from gArenaRanges: the chunks of every
+* visible graph that are inside the frustum of clip. Chunks next
+* to each other in the index buffer are merged into one command.
+*
+* @param clip projection * view * model
+* @return void
+*/
+void CullDrawCommands(const glm::mat4& clip){
+    gDrawCounts.clear();
+    gDrawOffsets.clear();
+    gDrawBaseVertices.clear();
+    gDrawIndexCount = 0;
+
+    // Frustum planes from the rows of clip (Gribb and Hartmann), w + row and w - row per axis
+    glm::vec4 planes[6];
+    glm::vec4 w(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+    for (int axis = 0; axis < 3; axis++) {
+        glm::vec4 row(clip[0][axis], clip[1][axis], clip[2][axis], clip[3][axis]);
+        planes[axis*2] = w + row;
+        planes[axis*2 + 1] = w - row;
     }
 
-    // Update the View Matrix
-    GLint u_ViewMatrixLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram,"u_ViewMatrix");
-    if(u_ViewMatrixLocation>=0){
-        glm::mat4 viewMatrix = gCamera.GetViewMatrix();
-        glUniformMatrix4fv(u_ViewMatrixLocation,1,GL_FALSE,&viewMatrix[0][0]);
-    }else{
-        std::cout << "Could not find u_ModelMatrix, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+    auto addCommand = [](GLsizei count, GLuint firstIndex, GLint baseVertex) {
+        gDrawIndexCount += count;
+        const void* offset = (const void*)(firstIndex*sizeof(GLuint));
+        if (!gDrawCounts.empty() && gDrawBaseVertices.back() == baseVertex &&
+            (const char*)gDrawOffsets.back() + gDrawCounts.back()*sizeof(GLuint) == (const char*)offset) {
+            gDrawCounts.back() += count;
+            return;
+        }
+        gDrawCounts.push_back(count);
+        gDrawOffsets.push_back(offset);
+        gDrawBaseVertices.push_back(baseVertex);
+    };
+
+    for (size_t r = 0; r < gArenaRanges.size(); r++) {
+        const ArenaRange& range = gArenaRanges[r];
+        if (range.indexCount == 0 || (r > 0 && !gGraphs[r - 1].visible)) {
+            continue;
+        }
+        // The grid .obj (software renderer only) is always in view
+        if (r == 0 || !gCullChunks) {
+            addCommand(range.indexCount, range.firstIndex, range.baseVertex);
+            continue;
+        }
+        for (const GraphChunk& chunk : gGraphMeshes[r - 1]->chunks) {
+            if (BoxInFrustum(planes, chunk.min, chunk.max)) {
+                addCommand(chunk.indexCount, range.firstIndex + chunk.firstIndex, range.baseVertex);
+            }
+        }
     }
 
+    gCulledMatrix = clip;
+    gDrawCommandsDirty = false;
+}
 
-    // Projection matrix (in perspective) 
-    glm::mat4 perspective = glm::perspective(glm::radians(45.0f),
-                                             (float)gScreenWidth/(float)gScreenHeight,
-                                             0.1f,
-                                             30.0f);
 
-    // Retrieve our location of our perspective matrix uniform 
-    GLint u_ProjectionLocation= glGetUniformLocation( gGraphicsPipelineShaderProgram,"u_Projection");
-    if(u_ProjectionLocation>=0){
-        glUniformMatrix4fv(u_ProjectionLocation,1,GL_FALSE,&perspective[0][0]);
-    }else{
-        std::cout << "Could not find u_Perspective, maybe a mispelling?\n";
-        exit(EXIT_FAILURE);
+/**
+* Fills the arena buffers (which must exist) with the output of BuildGeometry and
+* the range index of every vertex. The vertex array keeps pointing at the same
+* buffers, so this also swaps in new geometry after the first upload.
+*
+* @param vertexData 12 float vertices from BuildGeometry
+* @param indexBufferData local indices from BuildGeometry
+* @return void
+*/
+void UploadArena(const std::vector<GLfloat>& vertexData, const std::vector<GLuint>& indexBufferData){
+    // Which range every vertex belongs to, for the color lookup
+    std::vector<GLushort> graphIndexData(vertexData.size()/12);
+    for (size_t r = 0; r < gArenaRanges.size(); r++) {
+        std::fill(graphIndexData.begin() + gArenaRanges[r].baseVertex,
+                  graphIndexData.begin() + gArenaRanges[r].baseVertex + gArenaRanges[r].vertexCount, (GLushort)r);
     }
 
-    
-    // Bind our texture to slot number 0
-    gTexture.Bind(0);
-
-    // Setup our uniform for our texture
-    GLint u_textureLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram,"u_DiffuseTexture");
-    //std::cout << u_textureLocation << std::endl;
-	if(u_textureLocation>=0){
-		// Setup the slot for the texture
-		glUniform1i(u_textureLocation,0);
-	}else{
-		std::cout << "Could not find u_DiffuseTexture, maybe a misspelling?" << std::endl;
-    	exit(EXIT_FAILURE);
-	}
+	glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, 								// Kind of buffer we are working with 
+																// (e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER)
+				 vertexData.size() * sizeof(GL_FLOAT), 	// Size of data in bytes
+				 vertexData.data(), 						// Raw array of data
+				 GL_STATIC_DRAW);								// How we intend to use the data
 
-    GLint u_colorLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_coloring");
+    // Bound through GL_ARRAY_BUFFER so no vertex array's element buffer changes
+    glBindBuffer(GL_ARRAY_BUFFER, gIndexBufferObject);
+    glBufferData(GL_ARRAY_BUFFER,
+                 indexBufferData.size() * sizeof(GLuint),
+                 indexBufferData.data(),
+                 GL_STATIC_DRAW);
 
-    if (u_colorLocation >= 0) {
-        glUniform1i(u_colorLocation, u_coloring);
-    } else {
-        std::cout << "Could not find u_coloring, maybe a misspelling?" << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    glBindBuffer(GL_ARRAY_BUFFER, gGraphIndexBufferObject);
+    glBufferData(GL_ARRAY_BUFFER,
+                 graphIndexData.size() * sizeof(GLushort),
+                 graphIndexData.data(),
+                 GL_STATIC_DRAW);
+}
 
-    GLint u_highlightLocation = glGetUniformLocation(gGraphicsPipelineShaderProgram, "u_highlight");
 
-    if (u_highlightLocation >= 0) {
-        glUniform1i(u_highlightLocation, u_highlight);
+/**
+* Refines graph i from mesh to the next level (see NextLevel) on a builder thread, hands the result
+* to the main loop and queues the level after it until the graph's resolution is reached.
+*
+* @param i index in gGraphs
+* @param equation z = f(x,y) of the graph
+* @param resolution samples per side of the finished graph
+* @param mesh current level, with its heights
+* @return void
+*/
+void RefineGraph(size_t i, std::string equation, unsigned int resolution, std::shared_ptr<const GraphMesh> mesh){
+    if (gStopRefining) {
+        return;
+    }
+    unsigned int dimension = NextLevel(mesh->dimension, resolution);
+    std::vector<float> heights((size_t)dimension*dimension);
+    if (dimension == 2*(mesh->dimension - 1) + 1) {
+        Graph::refineHeights(Equation::forThread(equation), mesh->heights.data(), dimension, heights.data());
     } else {
-        std::cout << "Could not find u_highlight, maybe a misspelling?" << std::endl;
-        exit(EXIT_FAILURE);
+        // Off the doubled grid, so no sample can be reused
+        Graph::sampleHeights(Equation::forThread(equation), dimension, heights.data());
     }
+    Graph g(equation, dimension, i + 1, std::move(heights), -5.0f, 5.0f, dimension == resolution);
+    std::shared_ptr<const GraphMesh> finer = MakeGraphMesh(g, dimension);
+    {
+        std::lock_guard<std::mutex> lock(gRefinedMutex);
+        gRefinedMeshes.emplace_back(i, finer);
+    }
+    gScheduler.Wake();
+    if (dimension < resolution) {
+        gBuilders->submit([i, equation, resolution, finer]() { RefineGraph(i, equation, resolution, finer); });
+    }
+}
 
 
+/**
+* Starts refining every graph of gGraphMeshes that is below its resolution,
+* one builder task per graph and level.
+*
+* @return void
+*/
+void StartRefinement(){
+    for (size_t i = 0; i < gGraphMeshes.size(); i++) {
+        std::shared_ptr<const GraphMesh> mesh = gGraphMeshes[i];
+        if (!mesh || mesh->dimension >= gGraphs[i].resolution) {
+            continue;
+        }
+        if (!gBuilders) {
+            unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+            gBuilders.reset(new ThreadPool(std::max(1u, cores - 1)));
+        }
+        std::string equation = gGraphs[i].equation;
+        unsigned int resolution = gGraphs[i].resolution;
+        gBuilders->submit([i, equation, resolution, mesh]() { RefineGraph(i, equation, resolution, mesh); });
+    }
 }
 
 
-
 /**
-* Draw
-* The render function gets called once per loop.
-* Typically this includes 'glDraw' related calls, and the relevant setup of buffers
-* for those calls.
+* Swaps the levels finished by the builders into the arena. The arena is rebuilt
+* once however many graphs were refined since the last call.
 *
 * @return void
 */
-void Draw(){
-    // Enable our attributes
-	glBindVertexArray(gVertexArrayObject);
+void ApplyRefinements(){
+    std::vector<std::pair<size_t, std::shared_ptr<const GraphMesh>>> refined;
+    {
+        std::lock_guard<std::mutex> lock(gRefinedMutex);
+        refined.swap(gRefinedMeshes);
+    }
+    if (refined.empty()) {
+        return;
+    }
+    for (auto& entry : refined) {
+        if (entry.second->dimension > gGraphMeshes[entry.first]->dimension) {
+            gGraphMeshes[entry.first] = entry.second;
+        }
+    }
+    std::vector<GLfloat> vertexData;
+    std::vector<GLuint> indexBufferData;
+    BuildGeometry(vertexData, indexBufferData, gArenaRanges, nullptr);
+    UploadArena(vertexData, indexBufferData);
+    UpdateDrawCommands();
+    gScheduler.MarkDirty();
+}
 
-	// Select the vertex buffer object we want to enable
-    glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObject);
 
-    if (gDrawMode == 0) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    } else {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+/**
+* With --gpu, translates the equation of every graph to GLSL so it is evaluated on
+* the GPU. Animated graphs, invalid equations and equations that use something
+* GLSLExpression can not translate stay on the CPU.
+*
+* @return void
+*/
+void PrepareGPUEvaluation(){
+    if (!gGPUEvaluate) {
+        return;
+    }
+    for (SceneGraph& graph : gGraphs) {
+        if (graph.animated || !Equation(graph.equation).isValid()) {
+            continue;
+        }
+        std::string error;
+        if (!EquationToGLSL(graph.equation, graph.glsl, error)) {
+            graph.glsl.clear();
+            std::cout << "z = " << graph.equation << " is evaluated on the CPU: " << error << std::endl;
+        }
     }
-    //Render data
-    glDrawElements(GL_TRIANGLES, gFaceCount*3, GL_UNSIGNED_INT, 0);
-
-	// Stop using our current graphics pipeline
-	// Note: This is not necessary if we only have one graphics pipeline.
-    glUseProgram(0);
 }
 
 
 /**
-* Helper Function to get OpenGL Version Information
+* Returns the program that evaluates f given as GLSL, compiling it the first time
+* this GLSL is seen. Uses the uniform blocks and texture slot of gGraphicsPipeline.
 *
-* @return void
+* @param glsl body of f(x, y) from EquationToGLSL
+* @return the program, or nullptr if it did not compile
 */
-void getOpenGLVersionInfo(){
-  std::cout << "Vendor: " << glGetString(GL_VENDOR) << "\n";
-  std::cout << "Renderer: " << glGetString(GL_RENDERER) << "\n";
-  std::cout << "Version: " << glGetString(GL_VERSION) << "\n";
-  std::cout << "Shading language: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << "\n";
+EquationProgram* GetEquationProgram(const std::string& glsl){
+    auto cached = gEquationPrograms.find(glsl);
+    if (cached != gEquationPrograms.end()) {
+        return cached->second.get();
+    }
+    std::string vertexShaderSource = ShaderToString("./shaders/graph_vert.glsl") +
+                                     "\nfloat f(float x, float y) {\n    return " + glsl + ";\n}\n";
+    std::unique_ptr<EquationProgram> equationProgram(new EquationProgram());
+    ShaderProgram& program = equationProgram->program;
+    if (!program.Create(vertexShaderSource, ShaderToString("./shaders/frag.glsl"), ShaderToString("./shaders/graph_geom.glsl")) ||
+        !program.BindUniformBlock("FrameMatrices", FRAME_MATRICES_BINDING) ||
+        !program.BindUniformBlock("GraphColors", GRAPH_COLORS_BINDING)) {
+        return nullptr;
+    }
+    equationProgram->coloringLocation = program.GetUniformLocation("u_coloring");
+    equationProgram->highlightLocation = program.GetUniformLocation("u_highlight");
+    equationProgram->transparencyLocation = program.GetUniformLocation("u_Transparency");
+    equationProgram->graphIndexLocation = program.GetUniformLocation("u_GraphIndex");
+    equationProgram->dimensionLocation = program.GetUniformLocation("u_Dimension");
+    equationProgram->domainMinLocation = program.GetUniformLocation("u_DomainMin");
+    equationProgram->domainMaxLocation = program.GetUniformLocation("u_DomainMax");
+    gState.UseProgram(program.GetID());
+    program.SetInt(program.GetUniformLocation("u_PeelDepth"), TransparencyTarget::PEEL_DEPTH_SLOT);
+    EquationProgram* result = equationProgram.get();
+    gEquationPrograms[glsl] = std::move(equationProgram);
+    return result;
 }
 
 
 /**
-* Function called in the main application loop to handle user input
+* Returns the flat grid of sample indices drawn by GPU evaluated graphs with the
+* given resolution, building it the first time
 *
-* The user can press 
-*   use the arrow keys to move the camera around origin
-*   H to add highlights to graphs
-*   N to visualize normals of graphs
-* @return void
+* @param dimension samples per side
+* @return the grid
 */
-void Input(){
-	// Event handler that handles various events in SDL
-	// that are related to input and output
-	SDL_Event e;
-	//Handle events on queue
-	while(SDL_PollEvent( &e ) != 0){
+const SampleGrid& GetSampleGrid(unsigned int dimension){
+    auto cached = gSampleGrids.find(dimension);
+    if (cached != gSampleGrids.end()) {
+        return cached->second;
+    }
+    std::vector<GLfloat> samples((size_t)dimension*dimension*2);
+    for (unsigned int row = 0; row < dimension; row++) {
+        for (unsigned int column = 0; column < dimension; column++) {
+            samples[((size_t)row*dimension + column)*2] = (GLfloat)column;
+            samples[((size_t)row*dimension + column)*2 + 1] = (GLfloat)row;
+        }
+    }
+    // Every height defined gives the full grid; holes are cut by graph_geom.glsl
+    std::vector<float> heights((size_t)dimension*dimension, 0.0f);
+    std::vector<GLuint> indices((size_t)6*(dimension - 1)*(dimension - 1));
+    Graph::buildGridIndices(heights.data(), dimension, 0, dimension - 1, indices.data());
+
+    SampleGrid grid;
+    grid.indexCount = (GLsizei)indices.size();
+    glGenVertexArrays(1, &grid.vertexArray);
+    gState.BindVertexArray(grid.vertexArray);
+    glGenBuffers(1, &grid.vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, grid.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, samples.size()*sizeof(GLfloat), samples.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &grid.indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat)*2, (GLvoid*)0);
+    gState.BindVertexArray(0);
+
+    gSampleGrids[dimension] = grid;
+    return gSampleGrids[dimension];
+}
+
+
+/**
+* Compiles the programs and builds the grids of the GPU evaluated graphs ahead of
+* the first frame. Graphs whose program does not compile go back to the CPU.
+*
+* @return void
+*/
+void CreateGPUGraphs(){
+    for (SceneGraph& graph : gGraphs) {
+        if (graph.glsl.empty()) {
+            continue;
+        }
+        if (GetEquationProgram(graph.glsl) == nullptr) {
+            std::cout << "z = " << graph.equation << " is evaluated on the CPU: its shader did not compile" << std::endl;
+            graph.glsl.clear();
+            continue;
+        }
+        GetSampleGrid(graph.resolution);
+    }
+}
+
+
+/**
+* Draws the visible GPU evaluated graphs. Leaves their program in use; PreDraw
+* switches back to gGraphicsPipeline.
+*
+* @param transparency what the pass writes for translucent graphs (u_Transparency)
+* @return void
+*/
+void DrawGPUGraphs(TransparencyMode transparency){
+    for (size_t i = 0; i < gGraphs.size(); i++) {
+        const SceneGraph& graph = gGraphs[i];
+        if (graph.glsl.empty() || !graph.visible) {
+            continue;
+        }
+        EquationProgram& equationProgram = *gEquationPrograms[graph.glsl];
+        ShaderProgram& program = equationProgram.program;
+        const SampleGrid& grid = GetSampleGrid(graph.resolution);
+        gState.UseProgram(program.GetID());
+        program.SetInt(equationProgram.coloringLocation, u_coloring);
+        program.SetInt(equationProgram.highlightLocation, u_highlight);
+        program.SetInt(equationProgram.transparencyLocation, (int)transparency);
+        program.SetInt(equationProgram.graphIndexLocation, (int)(i + 1));
+        program.SetInt(equationProgram.dimensionLocation, (int)graph.resolution);
+        program.SetFloat(equationProgram.domainMinLocation, -5.0f);
+        program.SetFloat(equationProgram.domainMaxLocation, 5.0f);
+        gState.BindVertexArray(grid.vertexArray);
+        glDrawElements(GL_TRIANGLES, grid.indexCount, GL_UNSIGNED_INT, (void*)0);
+        gProfiler.CountDraw(grid.indexCount);
+    }
+}
+
+
+/**
+* Deletes the cached programs and grids of the GPU evaluated graphs
+*
+* @return void
+*/
+void DeleteGPUGraphs(){
+    gState.BindVertexArray(0);
+    for (auto& entry : gSampleGrids) {
+        glDeleteBuffers(1, &entry.second.vertexBuffer);
+        glDeleteBuffers(1, &entry.second.indexBuffer);
+        glDeleteVertexArrays(1, &entry.second.vertexArray);
+    }
+    gSampleGrids.clear();
+    gEquationPrograms.clear();
+}
+
+
+/**
+* Creates an AnimatedGraph for every animated graph in gGraphs, and the producer
+* threads that compute their frames. Finished frames wake the main loop.
+*
+* @return void
+*/
+void CreateAnimations(){
+    gAnimations.clear();
+    gAnimations.resize(gGraphs.size());
+    for (size_t i = 0; i < gGraphs.size(); i++) {
+        if (!gGraphs[i].animated) {
+            continue;
+        }
+        if (!gProducers) {
+            // One core is left to the render thread
+            unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+            gProducers.reset(new ThreadPool(std::max(1u, cores - 1)));
+        }
+        gAnimations[i].reset(new AnimatedGraph());
+        gAnimations[i]->Create(gGraphs[i].equation, gGraphs[i].resolution, (GLuint)(i + 1), *gProducers,
+                               gFrameCap > 0 ? gFrameCap : DEFAULT_ANIMATION_FPS, [](){ gScheduler.Wake(); }, gState);
+    }
+}
+
+
+/**
+* Create the geometry of the graphs in the arena; the grid and axes are gAxesGrid's
+* Can be called again (after DeleteGeometry) to show other equations.
+* @return void
+*/
+void VertexSpecification(){
+
+    // First, so graphs whose shader fails are built on the CPU below
+    CreateGPUGraphs();
+
+    std::vector<GLfloat> vertexData;
+    std::vector<GLuint> indexBufferData;
+    BuildGeometry(vertexData, indexBufferData, gArenaRanges, nullptr);
+
+	glGenVertexArrays(1, &gVertexArrayObject);
+	gState.BindVertexArray(gVertexArrayObject);
+
+	glGenBuffers(1, &gVertexBufferObject);
+    glGenBuffers(1, &gIndexBufferObject);
+    glGenBuffers(1, &gGraphIndexBufferObject);
+    UploadArena(vertexData, indexBufferData);
+
+	glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObject);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIndexBufferObject);
+
+	glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0,  		// Attribute 0 corresponds to the enabled glEnableVertexAttribArray
+							  		// In the future, you'll see in our vertex shader this also correspond
+							  		// to (layout=0) which selects these attributes.
+                          3,  		// The number of components (e.g. x,y,z = 3 components)
+                          GL_FLOAT, // Type
+                          GL_FALSE, // Is the data normalized
+                          sizeof(GL_FLOAT)*12, 		// Stride
+                          (void*)0	// Offset
+    );
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1,
+                          3, // xn,yx,zn
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(GL_FLOAT)*12,
+                          (GLvoid*)(sizeof(GL_FLOAT)*3));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2,
+                          4, // r,g,b,a
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(GL_FLOAT)*12,
+                          (GLvoid*)(sizeof(GL_FLOAT)*6));
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3,
+                          2, // s,t
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(GL_FLOAT)*12,
+                          (GLvoid*)(sizeof(GL_FLOAT)*10));
+
+    glBindBuffer(GL_ARRAY_BUFFER, gGraphIndexBufferObject);
+    glEnableVertexAttribArray(4);
+    glVertexAttribIPointer(4,
+                           1, // index into GraphColors
+                           GL_UNSIGNED_SHORT,
+                           sizeof(GLushort),
+                           (GLvoid*)0);
+
+	gState.BindVertexArray(0);
+
+    // The block is declared with MAX_GRAPH_COLORS entries, so the buffer must be that large
+    glGenBuffers(1, &gGraphColorBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, gGraphColorBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, MAX_GRAPH_COLORS*sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    UpdateDrawCommands();
+
+    CreateAnimations();
+
+	// Loading textures (ours and the graphs' height maps) binds them behind gState's back
+	gState.Reset();
+    gState.BindUniformBuffer(GRAPH_COLORS_BINDING, gGraphColorBuffer);
+}
+
+
+/**
+* Deletes the buffers made by VertexSpecification
+*
+* @return void
+*/
+void DeleteGeometry(){
+    // Deleting a bound vertex array unbinds it, keep gState in sync
+    gState.BindVertexArray(0);
+    for (std::unique_ptr<AnimatedGraph>& animation : gAnimations) {
+        if (animation) {
+            animation->Destroy();
+        }
+    }
+    gAnimations.clear();
+    glDeleteBuffers(1, &gVertexBufferObject);
+    glDeleteBuffers(1, &gIndexBufferObject);
+    glDeleteBuffers(1, &gGraphIndexBufferObject);
+    glDeleteBuffers(1, &gGraphColorBuffer);
+    glDeleteVertexArrays(1, &gVertexArrayObject);
+    gVertexBufferObject = 0;
+    gIndexBufferObject = 0;
+    gGraphIndexBufferObject = 0;
+    gGraphColorBuffer = 0;
+    gVertexArrayObject = 0;
+}
+
+
+/**
+* Returns the model matrix that orbits the scene around g_Center* from the
+* spherical coordinates g_CameraRadius, g_RotateTheta and g_RotatePhi
+*
+* @return model matrix
+*/
+glm::mat4 OrbitModelMatrix(){
+    // Spherical Coordinates
+    float x = g_CameraRadius * glm::sin(glm::radians(g_RotatePhi)) * glm::cos(glm::radians(g_RotateTheta));
+    float z = g_CameraRadius * glm::sin(glm::radians(g_RotatePhi)) * glm::sin(glm::radians(g_RotateTheta));
+    float y = g_CameraRadius * glm::cos(glm::radians(g_RotatePhi));
+
+    glm::mat4 model = glm::lookAt(glm::vec3(x,y,z),glm::vec3(0,0,0),glm::vec3(0,1,0));
+    return glm::translate(model, glm::vec3(g_CenterX, g_CenterY, g_CenterZ));
+}
+
+
+/**
+* Returns the perspective projection for the current screen size
+*
+* @return projection matrix
+*/
+glm::mat4 ProjectionMatrix(){
+    return glm::perspective(glm::radians(45.0f),
+                            (float)gScreenWidth/(float)gScreenHeight,
+                            0.1f,
+                            30.0f);
+}
+
+
+/**
+* Closes a line strip by appending a copy of its first vertex
+*
+* @param lineData vertices of 6 floats (x, y, z, r, g, b)
+* @param first index of the strip's first vertex in lineData
+* @return void
+*/
+void CloseLineStrip(std::vector<GLfloat>& lineData, GLint first){
+    // Copied out first: inserting a range of lineData into itself is undefined if it reallocates
+    GLfloat vertex[6];
+    std::copy(lineData.begin() + (size_t)first*6, lineData.begin() + (size_t)first*6 + 6, vertex);
+    lineData.insert(lineData.end(), vertex, vertex + 6);
+}
+
+
+/**
+* Brings the ContourSet of every visible graph up to date with its mesh and
+* gContourInterval, and uploads their lines as line strips in their graph's color
+*
+* @return void
+*/
+void UpdateContours(){
+    gContoursDirty = false;
+    gGraphContours.resize(gGraphs.size());
+    std::vector<GLfloat> lineData;
+    gContourFirsts.clear();
+    gContourCounts.clear();
+    for (size_t i = 0; i < gGraphs.size(); i++) {
+        // Hidden graphs keep their sets, so showing them again costs nothing
+        GraphContours& contours = gGraphContours[i];
+        std::shared_ptr<const GraphMesh> mesh = i < gGraphMeshes.size() ? gGraphMeshes[i] : nullptr;
+        if (!gGraphs[i].visible || !mesh || mesh->heights.empty()) {
+            continue;
+        }
+        if (contours.mesh != mesh) {
+            std::vector<float> values(mesh->heights.size());
+            std::transform(mesh->heights.begin(), mesh->heights.end(), values.begin(), Graph::fromHeight);
+            contours.set.reset(new ContourSet(std::move(values), mesh->dimension));
+            contours.mesh = mesh;
+        }
+        // Only the levels the set does not have yet are extracted
+        if (contours.set->getInterval() != gContourInterval && !contours.set->setInterval(gContourInterval)) {
+            if (contours.tooFineInterval != gContourInterval) {
+                contours.tooFineInterval = gContourInterval;
+                std::cout << "Contour interval " << gContourInterval << " is too fine for the z range of " << gGraphs[i].equation
+                          << " (more than " << ContourSet::MAX_LEVELS << " levels), so it has no contour lines" << std::endl;
+            }
+            continue;
+        }
+
+        glm::vec3 color = gGraphs[i].color;
+        for (const auto& level : contours.set->getLevels()) {
+            for (const ContourLine& line : level.second) {
+                GLint first = (GLint)(lineData.size()/6);
+                for (const glm::vec2& point : line.points) {
+                    lineData.insert(lineData.end(), {point.x, level.first, point.y, color.r, color.g, color.b});
+                }
+                if (line.closed) {
+                    CloseLineStrip(lineData, first);
+                }
+                gContourFirsts.push_back(first);
+                gContourCounts.push_back((GLsizei)(lineData.size()/6 - first));
+            }
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, gContourVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, lineData.size()*sizeof(GLfloat), lineData.data(), GL_STATIC_DRAW);
+}
+
+
+/**
+* Draws the contour lines of the visible graphs on the grid, then on the graphs
+*
+* @return void
+*/
+void DrawContours(){
+    if (!gContours || gContourCounts.empty()) {
+        return;
+    }
+    gState.UseProgram(gContourProgram.GetID());
+    gState.BindVertexArray(gContourVertexArray);
+
+    // Just above the grid's lines, on the side of the grid the camera is on
+    glm::vec3 eye = glm::vec3(glm::inverse(gFrameMatrices.view * gFrameMatrices.model)[3]);
+    gContourProgram.SetInt(gContourModeLocation, 1);
+    gContourProgram.SetFloat(gContourFloorHeightLocation, eye.y >= 0.0f ? 0.02f : -0.02f);
+    glMultiDrawArrays(GL_LINE_STRIP, gContourFirsts.data(), gContourCounts.data(), (GLsizei)gContourCounts.size());
+
+    gContourProgram.SetInt(gContourModeLocation, 0);
+    glMultiDrawArrays(GL_LINE_STRIP, gContourFirsts.data(), gContourCounts.data(), (GLsizei)gContourCounts.size());
+}
+
+
+/**
+* Finds where every two visible graphs on the same grid meet, unless their meshes are
+* those the curves were last found on, and uploads the curves as line strips
+*
+* @return void
+*/
+void UpdateIntersections(){
+    gIntersectionsDirty = false;
+    std::vector<GLfloat> lineData;
+    gIntersectionFirsts.clear();
+    gIntersectionCounts.clear();
+    auto comparable = [](size_t i) {
+        return gGraphs[i].visible && i < gGraphMeshes.size() && gGraphMeshes[i] && !gGraphMeshes[i]->heights.empty();
+    };
+    for (size_t i = 0; i < gGraphs.size(); i++) {
+        for (size_t j = i + 1; j < gGraphs.size(); j++) {
+            if (!comparable(i) || !comparable(j) || gGraphMeshes[i]->dimension != gGraphMeshes[j]->dimension) {
+                continue;
+            }
+            // Pairs of hidden graphs keep their curves, so showing them again costs nothing
+            GraphIntersection& pair = gGraphIntersections[std::make_pair(i, j)];
+            if (pair.first != gGraphMeshes[i] || pair.second != gGraphMeshes[j]) {
+                pair.first = gGraphMeshes[i];
+                pair.second = gGraphMeshes[j];
+                pair.curves.reset(new SurfaceIntersection(gGraphs[i].equation, gGraphs[j].equation, pair.first->heights.data(),
+                                                          pair.second->heights.data(), pair.first->dimension));
+            }
+
+            for (const IntersectionCurve& curve : pair.curves->getCurves()) {
+                GLint first = (GLint)(lineData.size()/6);
+                for (const glm::vec3& point : curve.points) {
+                    lineData.insert(lineData.end(), {point.x, point.z, point.y,
+                                                     INTERSECTION_COLOR.r, INTERSECTION_COLOR.g, INTERSECTION_COLOR.b});
+                }
+                if (curve.closed) {
+                    CloseLineStrip(lineData, first);
+                }
+                gIntersectionFirsts.push_back(first);
+                gIntersectionCounts.push_back((GLsizei)(lineData.size()/6 - first));
+            }
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, gIntersectionVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, lineData.size()*sizeof(GLfloat), lineData.data(), GL_STATIC_DRAW);
+}
+
+
+/**
+* Draws the curves where the visible graphs meet
+*
+* @return void
+*/
+void DrawIntersections(){
+    if (!gIntersections || gIntersectionCounts.empty()) {
+        return;
+    }
+    gState.UseProgram(gContourProgram.GetID());
+    gState.BindVertexArray(gIntersectionVertexArray);
+    gContourProgram.SetInt(gContourModeLocation, 2);
+    glMultiDrawArrays(GL_LINE_STRIP, gIntersectionFirsts.data(), gIntersectionCounts.data(), (GLsizei)gIntersectionCounts.size());
+}
+
+
+/**
+* PreDraw
+* Typically we will use this for setting some sort of 'state'
+* Note: state that never changes is set once in CreateGraphicsPipeline, and everything
+*       here goes through gState so unchanged state costs no OpenGL calls.
+* @return void
+*/
+void PreDraw(){
+    gState.Viewport(0, 0, gScreenWidth, gScreenHeight);
+
+    // Opaque things are drawn offscreen first when graphs are composited over them
+    if(gTransparencyMode != TRANSPARENCY_OFF && !gTransparency.BeginOpaque(gScreenWidth, gScreenHeight, gState)){
+        std::cout << "Translucent graphs are blended in draw order instead" << std::endl;
+        gTransparencyMode = TRANSPARENCY_OFF;
+    }
+
+    //Clear color buffer and Depth Buffer
+  	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+   	gState.UseProgram(gGraphicsPipeline.GetID());
+
+    FrameMatrices matrices = gFrameMatrices;
+    matrices.model = OrbitModelMatrix();
+    matrices.view = gCamera.GetViewMatrix();
+
+    // Projection matrix (in perspective), only rebuilt when the window size changes
+    if(gProjectionWidth != gScreenWidth || gProjectionHeight != gScreenHeight){
+        matrices.projection = ProjectionMatrix();
+        gProjectionWidth = gScreenWidth;
+        gProjectionHeight = gScreenHeight;
+    }
+
+    // Upload the matrices in one call, and only if one of them changed
+    if(!gFrameMatricesUploaded || std::memcmp(&matrices, &gFrameMatrices, sizeof(FrameMatrices)) != 0){
+        gFrameMatrices = matrices;
+        glBindBuffer(GL_UNIFORM_BUFFER, gFrameUniformBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameMatrices), &gFrameMatrices);
+        gFrameMatricesUploaded = true;
+    }
+
+    // Only the chunks in view are drawn, culled again when the camera moves
+    glm::mat4 clip = gFrameMatrices.projection * gFrameMatrices.view * gFrameMatrices.model;
+    if(gDrawCommandsDirty || clip != gCulledMatrix){
+        CullDrawCommands(clip);
+    }
+    if(gContours && gContoursDirty){
+        UpdateContours();
+    }
+    if(gIntersections && gIntersectionsDirty){
+        UpdateIntersections();
+    }
+
+    gGraphicsPipeline.SetInt(gColoringLocation, u_coloring);
+    gGraphicsPipeline.SetInt(gHighlightLocation, u_highlight);
+}
+
+
+
+/**
+* Draws every visible graph once: the arena, the animated graphs and the GPU evaluated ones
+*
+* @param transparency what the pass writes for translucent graphs (u_Transparency)
+* @return void
+*/
+void DrawGraphs(TransparencyMode transparency){
+    // Enable our attributes
+    gState.UseProgram(gGraphicsPipeline.GetID());
+    gGraphicsPipeline.SetInt(gTransparencyLocation, (int)transparency);
+	gState.BindVertexArray(gVertexArrayObject);
+
+    if (gDrawMode == 0) {
+        gState.PolygonMode(GL_FILL);
+    } else {
+        gState.PolygonMode(GL_LINE);
+    }
+    //Render data: every visible graph in one call
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, gDrawCounts.data(), GL_UNSIGNED_INT, gDrawOffsets.data(),
+                                  (GLsizei)gDrawCounts.size(), gDrawBaseVertices.data());
+    gProfiler.CountDraw(gDrawIndexCount);
+
+    // Then the current frame of every visible animated graph
+    for (size_t i = 0; i < gAnimations.size(); i++) {
+        if (gAnimations[i] && gGraphs[i].visible) {
+            gProfiler.CountDraw(gAnimations[i]->Draw(gState));
+        }
+    }
+
+    // And the graphs evaluated on the GPU
+    DrawGPUGraphs(transparency);
+}
+
+
+/**
+* Draw
+* The render function gets called once per loop.
+* Typically this includes 'glDraw' related calls, and the relevant setup of buffers
+* for those calls.
+*
+* @return void
+*/
+void Draw(){
+    // The grid, axes, contour lines and intersection curves first, so the graphs blend over them
+    gState.PolygonMode(GL_FILL);
+    gProfiler.CountDraw(gAxesGrid.Draw(gState));
+    DrawContours();
+    DrawIntersections();
+
+    if (gTransparencyMode == TRANSPARENCY_OFF) {
+        DrawGraphs(TRANSPARENCY_OFF);
+        return;
+    }
+    if (u_coloring == 1) {
+        // Opaque, drawn with the grid and axes
+        DrawGraphs(TRANSPARENCY_OFF);
+    } else if (gTransparencyMode == TRANSPARENCY_BLENDED) {
+        gTransparency.BeginBlended(gState);
+        DrawGraphs(TRANSPARENCY_BLENDED);
+    } else {
+        // Every layer draws the graphs again, until one comes out empty
+        for (unsigned int layer = 0; layer < MAX_PEEL_LAYERS; layer++) {
+            gTransparency.BeginLayer(layer, gState);
+            DrawGraphs(TRANSPARENCY_PEELED);
+            if (!gTransparency.EndLayer(gState)) {
+                break;
+            }
+        }
+    }
+    gTransparency.End(gState);
+}
+
+
+/**
+* Helper Function to get OpenGL Version Information
+*
+* @return void
+*/
+void getOpenGLVersionInfo(){
+  std::cout << "Vendor: " << glGetString(GL_VENDOR) << "\n";
+  std::cout << "Renderer: " << glGetString(GL_RENDERER) << "\n";
+  std::cout << "Version: " << glGetString(GL_VERSION) << "\n";
+  std::cout << "Shading language: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << "\n";
+}
+
+
+/**
+* Function called in the main application loop to handle user input
+* Blocks in gScheduler while there is nothing to draw, and marks the
+* scheduler dirty whenever an event changes what is on screen.
+*
+* The user can press 
+*   use the arrow keys to move the camera around origin
+*   H to add highlights to graphs
+*   N to visualize normals of graphs
+*   C to show contour lines, [ and ] to halve and double their interval
+*   I to show the curves where graphs meet
+* @return void
+*/
+void Input(){
+	// Event handler that handles various events in SDL
+	// that are related to input and output
+	SDL_Event e;
+	//Handle events on queue, waiting for the first one if nothing needs drawing
+	bool hasEvent = gScheduler.WaitEvent(e);
+	// Time spent waiting for events is idle time, not input handling
+	gProfiler.BeginStage(PROFILE_INPUT);
+	for(; hasEvent; hasEvent = SDL_PollEvent( &e ) != 0){
 		if(e.type == SDL_QUIT){
 			std::cout << "Goodbye! (Leaving MainApplicationLoop())" << std::endl;
 			gQuit = true;
         } else if (e.type == SDL_KEYDOWN) {
             if (e.key.keysym.sym == SDLK_h) {
                 u_highlight = (u_highlight + 1)%2;
+                gScheduler.MarkDirty();
             } else if (e.key.keysym.sym == SDLK_n) {
                 u_coloring = (u_coloring + 1)%2;
+                gScheduler.MarkDirty();
+            } else if (e.key.keysym.sym == SDLK_i) {
+                gIntersections = !gIntersections;
+                gScheduler.MarkDirty();
+            } else if (e.key.keysym.sym == SDLK_c) {
+                gContours = !gContours;
+                gScheduler.MarkDirty();
+            } else if (gContours && (e.key.keysym.sym == SDLK_LEFTBRACKET || e.key.keysym.sym == SDLK_RIGHTBRACKET)) {
+                // Halving keeps every level, so only the ones in between are extracted
+                float interval = e.key.keysym.sym == SDLK_LEFTBRACKET ? gContourInterval*0.5f : gContourInterval*2.0f;
+                if (interval >= MIN_CONTOUR_INTERVAL) {
+                    gContourInterval = interval;
+                    gContoursDirty = true;
+                    std::cout << "Contour lines every " << gContourInterval << std::endl;
+                    gScheduler.MarkDirty();
+                }
+            } else if (e.key.keysym.sym >= SDLK_1 && e.key.keysym.sym <= SDLK_9) {
+                // Number keys show or hide the first nine graphs
+                size_t graph = e.key.keysym.sym - SDLK_1;
+                if (graph < gGraphs.size()) {
+                    gGraphs[graph].visible = !gGraphs[graph].visible;
+                    UpdateDrawCommands();
+                    gScheduler.MarkDirty();
+                }
+            }
+        } else if (e.type == SDL_MOUSEMOTION) {
+            gMouseX = e.motion.x;
+            gMouseY = e.motion.y;
+            gPickDirty = true;
+        } else if (e.type == SDL_WINDOWEVENT) {
+            if (e.window.event == SDL_WINDOWEVENT_LEAVE) {
+                gMouseX = gMouseY = -1;
+                gPickDirty = true;
+            } else if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                gScreenWidth = e.window.data1;
+                gScreenHeight = e.window.data2;
+                gScheduler.MarkDirty();
+            } else if (e.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                gScheduler.MarkDirty();
+            }
+        }
+        
+        
+        //additional global movement
+        const Uint8 *state = SDL_GetKeyboardState(NULL);
+        
+        float SPEED_T = 0.125f;
+        float SPEED_R = 2.5f;
+           
+
+        //ARROW KEYS - Rotate Theta and Phi
+        if (state[SDL_SCANCODE_LEFT]) {
+            g_RotateTheta = (g_RotateTheta + SPEED_R);
+            gScheduler.MarkDirty();
+        }
+        if (state[SDL_SCANCODE_RIGHT]) {
+            g_RotateTheta = (g_RotateTheta - SPEED_R);
+            gScheduler.MarkDirty();
+        }
+        if (state[SDL_SCANCODE_UP]) {
+            g_RotatePhi = glm::clamp(g_RotatePhi - SPEED_R, 0.0f + SPEED_R, 180.0f - SPEED_R);
+            gScheduler.MarkDirty();
+        }
+        if (state[SDL_SCANCODE_DOWN]) {
+            g_RotatePhi = glm::clamp(g_RotatePhi + SPEED_R, 0.0f + SPEED_R, 180.0f - SPEED_R);
+            gScheduler.MarkDirty();
+        }
+	}
+	gProfiler.EndStage(PROFILE_INPUT);
+}
+
+
+/**
+* Lets every animated graph pick up its newest finished frame and start the next one,
+* marks the scheduler dirty when a new frame can be shown, and makes the next wait
+* end in time for the next animation tick.
+*
+* @return void
+*/
+void UpdateAnimations(){
+    bool hasDeadline = false;
+    std::chrono::steady_clock::time_point deadline;
+    for (std::unique_ptr<AnimatedGraph>& animation : gAnimations) {
+        if (!animation) {
+            continue;
+        }
+        if (animation->Update()) {
+            gScheduler.MarkDirty();
+        }
+        if (!hasDeadline || animation->NextDeadline() < deadline) {
+            deadline = animation->NextDeadline();
+            hasDeadline = true;
+        }
+    }
+    if (hasDeadline) {
+        gScheduler.WakeBy(deadline);
+    }
+}
+
+
+/**
+* Returns the frame counters of all animated graphs together, for the title and the
+* summary printed on exit. Empty if nothing is animated.
+*
+* @return summary text
+*/
+std::string AnimationSummary(){
+    AnimationStats total{0, 0, 0, 0, 0.0, 0.0};
+    unsigned int count = 0;
+    for (std::unique_ptr<AnimatedGraph>& animation : gAnimations) {
+        if (!animation) {
+            continue;
+        }
+        AnimationStats stats = animation->GetStats();
+        total.produced += stats.produced;
+        total.displayed += stats.displayed;
+        total.dropped += stats.dropped;
+        total.skipped += stats.skipped;
+        total.latencyMs = std::max(total.latencyMs, stats.latencyMs);
+        total.worstLatencyMs = std::max(total.worstLatencyMs, stats.worstLatencyMs);
+        count++;
+    }
+    if (count == 0) {
+        return "";
+    }
+    char summary[160];
+    std::snprintf(summary, sizeof(summary), "anim %llu shown, %llu dropped, %llu skipped, latency %.1f ms (worst %.1f)",
+                  (unsigned long long)total.displayed, (unsigned long long)total.dropped,
+                  (unsigned long long)total.skipped, total.latencyMs, total.worstLatencyMs);
+    return summary;
+}
+
+
+/**
+* Sets the window title from the last pick and, with --profile, the frame times and
+* animation counters
+*
+* @return void
+*/
+void UpdateWindowTitle(){
+	std::string title = "OpenGL: 3D Graphing Calculator";
+	if(!gPickSummary.empty()){
+		title += " | " + gPickSummary;
+	}
+	if(gProfiler.IsEnabled()){
+		title += " | " + gProfiler.Summary();
+		std::string animation = AnimationSummary();
+		if(!animation.empty()){
+			title += " | " + animation;
+		}
+	}
+	SDL_SetWindowTitle(gGraphicsApplicationWindow, title.c_str());
+}
+
+
+/**
+* Finds the graph under a pixel of the window. The camera ray through the pixel is
+* traced through the MinMaxPyramid of every visible graph that has one, in model
+* space where the graphs' vertices are (x, height, y).
+*
+* @param pixelX column of the pixel, from the left
+* @param pixelY row of the pixel, from the top
+* @param graph receives the index in gGraphs of the nearest graph hit
+* @param position receives the point hit on its triangles, as (x, y, height)
+* @return true if a graph is under the pixel
+*/
+bool PickGraph(int pixelX, int pixelY, size_t& graph, glm::vec3& position){
+    glm::mat4 clip = ProjectionMatrix() * gCamera.GetViewMatrix() * OrbitModelMatrix();
+    glm::mat4 unproject = glm::inverse(clip);
+    float ndcX = 2.0f*(pixelX + 0.5f)/gScreenWidth - 1.0f;
+    float ndcY = 1.0f - 2.0f*(pixelY + 0.5f)/gScreenHeight;
+    glm::vec4 nearPoint = unproject * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPoint = unproject * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint)/nearPoint.w;
+    glm::vec3 direction = glm::vec3(farPoint)/farPoint.w - origin;
+
+    float nearest = INFINITY;
+    for (size_t i = 0; i < gGraphMeshes.size(); i++) {
+        if (!gGraphs[i].visible || !gGraphMeshes[i] || !gGraphMeshes[i]->pyramid) {
+            continue;
+        }
+        PyramidHit hit;
+        if (gGraphMeshes[i]->pyramid->intersect(origin, direction, hit) && hit.distance < nearest) {
+            nearest = hit.distance;
+            graph = i;
+            position = glm::vec3(hit.position.x, hit.position.z, hit.position.y);
+        }
+    }
+    return nearest < INFINITY;
+}
+
+
+/**
+* Picks the graph under the mouse again if the mouse or the picture changed, and
+* shows it with f(x,y) evaluated exactly at the point hit in the title
+*
+* @return void
+*/
+void UpdatePick(){
+    if (!gPicking || !gPickDirty) {
+        return;
+    }
+    gPickDirty = false;
+    std::string summary;
+    size_t graph = 0;
+    glm::vec3 position;
+    if (gMouseX >= 0 && PickGraph(gMouseX, gMouseY, graph, position)) {
+        // The triangles only pass through the samples, so the height hit is not f(x,y)
+        float value = Equation::forThread(gGraphs[graph].equation).value(position.x, position.y);
+        char text[96];
+        std::snprintf(text, sizeof(text), ": x = %.4g, y = %.4g, f(x,y) = %.6g", position.x, position.y, value);
+        summary = "z = " + gGraphs[graph].equation + text;
+    }
+    if (summary != gPickSummary) {
+        gPickSummary = summary;
+        UpdateWindowTitle();
+    }
+}
+
+
+/**
+* Main Application Loop
+* This is an infinite loop, but it only draws when gScheduler says
+* something changed (including a new frame of an animated graph).
+* Otherwise it sleeps in Input().
+*
+* @return void
+*/
+void MainLoop(){
+
+	// While application is running
+	while(!gQuit){
+		// Handle Input
+		Input();
+		UpdateAnimations();
+		ApplyRefinements();
+		if(gQuit || !gScheduler.FrameDue()){
+			UpdatePick();
+			continue;
+		}
+		gScheduler.BeginFrame();
+		gProfiler.BeginFrame();
+		// Setup anything (i.e. OpenGL State) that needs to take
+		// place before draw calls
+		gProfiler.BeginStage(PROFILE_PREDRAW);
+		PreDraw();
+		gProfiler.EndStage(PROFILE_PREDRAW);
+		// Draw Calls in OpenGL
+		gProfiler.BeginStage(PROFILE_DRAW);
+		Draw();
+		gProfiler.EndStage(PROFILE_DRAW);
+		gProfiler.EndGPU();
+		//Update screen of our specified window
+		gProfiler.BeginStage(PROFILE_SWAP);
+		SDL_GL_SwapWindow(gGraphicsApplicationWindow);
+		gProfiler.EndStage(PROFILE_SWAP);
+		gProfiler.EndFrame();
+
+		if(gProfiler.ReportDue()){
+			UpdateWindowTitle();
+		}
+		// What is under the mouse may have moved with the camera or the graphs
+		gPickDirty = true;
+		UpdatePick();
+	}
+
+	if(gProfiler.IsEnabled()){
+		gProfiler.Finish();
+		std::cout << gProfiler.Summary() << std::endl;
+	}
+	std::string animation = AnimationSummary();
+	if(!animation.empty()){
+		std::cout << animation << std::endl;
+	}
+}
+
+
+
+/**
+* The last function called in the program
+* This functions responsibility is to destroy any global
+* objects in which we have create dmemory.
+*
+* @return void
+*/
+void CleanUp(){
+	//Destroy our SDL2 Window
+	SDL_DestroyWindow(gGraphicsApplicationWindow );
+	gGraphicsApplicationWindow = nullptr;
+
+    // Let the builders skip what is left, then delete our OpenGL Objects
+    gStopRefining = true;
+    if (gBuilders) {
+        // Running levels may still queue the next one, which then returns at once
+        gBuilders->wait();
+        gBuilders.reset();
+    }
+    DeleteGeometry();
+    DeleteGPUGraphs();
+    gProducers.reset();
+    glDeleteBuffers(1, &gFrameUniformBuffer);
+
+	// Delete our Graphics pipeline
+    gGraphicsPipeline.Destroy();
+    gAxesGrid.Destroy();
+    gTransparency.Destroy();
+    DeleteContours();
+
+	//Quit SDL subsystems
+	SDL_Quit();
+}
+
+
+/**
+* Renders one image per equation on the CPU with SoftwareRasterizer, for machines
+* without OpenGL. Same camera, geometry and graph shading as the OpenGL path, but over
+* the grid .obj, blending translucent graphs in draw order and without contour lines,
+* so the images are close to those of OpenGL rather than identical.
+*
+* @param pathFormat printf format of the output files, given the image index
+* @param equations one image is written per equation
+* @param threadCount threads used by the rasterizer, 0 for one per core
+* @return program status
+*/
+int RenderSoftware(const std::string& pathFormat, const std::vector<std::string>& equations, unsigned int threadCount){
+    SoftwareRasterizer rasterizer(gScreenWidth, gScreenHeight, threadCount);
+    SoftwareUniforms uniforms;
+    uniforms.view = gCamera.GetViewMatrix();
+    uniforms.model = OrbitModelMatrix();
+    uniforms.projection = ProjectionMatrix();
+    uniforms.coloring = u_coloring;
+    uniforms.highlight = u_highlight;
+
+    // The rasterizer has no grid shader, so it draws the grid .obj with its texture
+    OBJModel grid("./objects/grid/grid.obj");
+    Image diffuse(grid.getTexture());
+    diffuse.LoadPPM(true);
+    uniforms.diffuse = &diffuse;
+
+    std::vector<GLfloat> vertexData;
+    std::vector<GLuint> indexBufferData;
+    std::vector<ArenaRange> ranges;
+    std::vector<uint8_t> pixels;
+    double rasterSeconds = 0.0;
+    bool success = true;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < equations.size() && success; i++) {
+        gGraphs = {SceneGraph{equations[i], Graph::paletteColor(1), true, (unsigned int)gRESOLUTION, false,
+                                ImplicitSurface::isImplicit(equations[i]), ParametricSurface::isParametric(equations[i])}};
+        gGraphMeshes.clear();
+        BuildGeometry(vertexData, indexBufferData, ranges, &grid);
+        FlattenGeometry(vertexData, indexBufferData, ranges);
+
+        auto rasterStart = std::chrono::steady_clock::now();
+        rasterizer.Clear(0.1f, 0.1f, 0.1f);
+        rasterizer.DrawElements(vertexData, indexBufferData, uniforms);
+        rasterizer.ReadPixels(pixels);
+        std::chrono::duration<double> rasterElapsed = std::chrono::steady_clock::now() - rasterStart;
+        rasterSeconds += rasterElapsed.count();
+
+        char filePath[1024];
+        std::snprintf(filePath, sizeof(filePath), pathFormat.c_str(), (unsigned int)i);
+        success = WriteImage(filePath, gScreenWidth, gScreenHeight, pixels.data());
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Rendered " << equations.size() << " images of " << gScreenWidth << "x" << gScreenHeight
+              << " on the CPU in " << elapsed.count() << " s (" << equations.size()/elapsed.count() << " images/s, "
+              << rasterSeconds/equations.size()*1000.0 << " ms rasterizing per image)" << std::endl;
+
+    return success ? 0 : 1;
+}
+
+
+// Most threads --threads accepts (0 is one per core)
+const unsigned int MAX_THREAD_COUNT = 1024;
+
+/**
+* Reads a whole string as a number within [min, max], rejecting signs, trailing
+* characters and values that do not fit
+*
+* @param text the string
+* @param min smallest value accepted
+* @param max largest value accepted
+* @param value receives the number
+* @return false, leaving value unchanged, if text is not such a number
+*/
+bool ReadUnsigned(const std::string& text, unsigned int min, unsigned int max, unsigned int& value){
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long parsed = text.empty() || !std::isdigit((unsigned char)text[0]) ? 0 : std::strtoull(text.c_str(), &end, 10);
+    if (end == nullptr || *end != '\0' || errno == ERANGE || parsed < min || parsed > max) {
+        return false;
+    }
+    value = (unsigned int)parsed;
+    return true;
+}
+
+
+/**
+* Parses a whole argument as a number within [min, max] (see ReadUnsigned)
+*
+* @param text the argument
+* @param option the option it belongs to, for the message
+* @param min smallest value accepted
+* @param max largest value accepted
+* @param value receives the number
+* @return false (after printing why) if text is not such a number
+*/
+bool ParseUnsigned(const std::string& text, const std::string& option, unsigned int min, unsigned int max, unsigned int& value){
+    if (!ReadUnsigned(text, min, max, value)) {
+        std::cout << "INPUT ERROR: " << option << " needs a whole number from " << min << " to " << max << ", not " << text << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+/**
+* Reads a whole string as a finite number, rejecting trailing characters
+*
+* @param text the string
+* @param value receives the number
+* @return false, leaving value unchanged, if text is not such a number
+*/
+bool ReadFloat(const std::string& text, float& value){
+    char* end = nullptr;
+    float parsed = std::strtof(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || !std::isfinite(parsed)) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+
+/**
+* Parses a whole argument as a finite number (see ReadFloat)
+*
+* @param text the argument
+* @param option the option it belongs to, for the message
+* @param value receives the number
+* @return false (after printing why) if text is not such a number
+*/
+bool ParseFloat(const std::string& text, const std::string& option, float& value){
+    if (!ReadFloat(text, value)) {
+        std::cout << "INPUT ERROR: " << option << " needs a number, not " << text << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+/**
+* Returns the file extension for the argument of --format. WriteImage decides the
+* encoding from the extension, so only formats it writes are accepted.
+*
+* @param format ppm or png
+* @param extension receives ".ppm" or ".png"
+* @return false (after printing why) for anything else
+*/
+bool ParseImageFormat(const std::string& format, std::string& extension){
+    if (format != "ppm" && format != "png") {
+        std::cout << "INPUT ERROR: --format must be ppm or png, not " << format << std::endl;
+        return false;
+    }
+    extension = "." + format;
+    return true;
+}
+
+
+/**
+* Sets gTransparencyMode from the argument of --transparency
+*
+* @param mode blended, peel or off
+* @return false (after printing why) for anything else
+*/
+bool SetTransparencyMode(const std::string& mode){
+    if (mode == "blended") {
+        gTransparencyMode = TRANSPARENCY_BLENDED;
+    } else if (mode == "peel") {
+        gTransparencyMode = TRANSPARENCY_PEELED;
+    } else if (mode == "off") {
+        gTransparencyMode = TRANSPARENCY_OFF;
+    } else {
+        std::cout << "INPUT ERROR: --transparency must be blended, peel or off, not " << mode << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+/**
+* Turns contour lines on every interval in z, from the argument of --contours
+*
+* @param interval z between two levels, at least MIN_CONTOUR_INTERVAL
+* @return false (after printing why) if it is not a finite number that large
+*/
+bool SetContourInterval(const std::string& interval){
+    float value = 0.0f;
+    if (!ReadFloat(interval, value) || value < MIN_CONTOUR_INTERVAL) {
+        std::cout << "INPUT ERROR: --contours needs an interval of at least " << MIN_CONTOUR_INTERVAL << ", not " << interval << std::endl;
+        return false;
+    }
+    gContours = true;
+    gContourInterval = value;
+    gContoursDirty = true;
+    return true;
+}
+
+
+// Widest and tallest image --headless renders, the GL_MAX_RENDERBUFFER_SIZE most drivers support
+const unsigned int MAX_HEADLESS_SIZE = 16384;
+
+/**
+* Renders one image per equation without a window or display, then exits.
+* Uses an EGL surfaceless context (Mesa llvmpipe works without a GPU), draws into
+* a framebuffer object and reads images back through pixel buffers so the next
+* image is drawn while the previous one is written.
+*
+*   ./project --headless <output prefix> [--size WxH] [--camera theta phi radius]
+*             [--format ppm|png] [--software [--threads n]] [--transparency blended|peel|off]
+*             [--contours interval] "<equation>" ...
+*
+* Writes <output prefix>0000.ppm, <output prefix>0001.ppm, ...
+* With --software no OpenGL is used at all (see RenderSoftware).
+*
+* @return program status
+*/
+int RenderHeadless(int argc, char* args[]){
+    const char* usage = "Usage: ./project --headless <output prefix> [--size WxH] [--camera theta phi radius] [--format ppm|png] [--software [--threads n] | --gpu] [--no-cull] [--transparency blended|peel|off] [--contours interval] \"<equation>\" ...";
+    if (argc < 4) {
+        std::cout << usage << std::endl;
+        return 1;
+    }
+
+    std::string prefix = args[2];
+    std::string extension = ".ppm";
+    bool software = false;
+    unsigned int threadCount = 0;
+    std::vector<std::string> equations;
+    for (int i = 3; i < argc; i++) {
+        std::string argument = args[i];
+        if (argument == "--size" && i + 1 < argc) {
+            std::string size = args[++i];
+            size_t separator = size.find('x');
+            unsigned int width = 0;
+            unsigned int height = 0;
+            if (!ParseUnsigned(size.substr(0, separator), "--size <width>", 1, MAX_HEADLESS_SIZE, width) ||
+                !ParseUnsigned(separator == std::string::npos ? size : size.substr(separator + 1), "--size <height>", 1,
+                               MAX_HEADLESS_SIZE, height)) {
+                std::cout << "Usage: --size WxH, or --size N for a square image" << std::endl;
+                return 1;
+            }
+            gScreenWidth = width;
+            gScreenHeight = height;
+        } else if (argument == "--camera" && i + 3 < argc) {
+            if (!ParseFloat(args[++i], "--camera <theta>", g_RotateTheta) ||
+                !ParseFloat(args[++i], "--camera <phi>", g_RotatePhi) ||
+                !ParseFloat(args[++i], "--camera <radius>", g_CameraRadius)) {
+                std::cout << "Usage: --camera theta phi radius, with the angles in degrees" << std::endl;
+                return 1;
+            }
+            if (!(g_CameraRadius > 0.0f)) {
+                std::cout << "INPUT ERROR: --camera needs a positive radius, not " << g_CameraRadius << std::endl;
+                return 1;
+            }
+        } else if (argument == "--format" && i + 1 < argc) {
+            if (!ParseImageFormat(args[++i], extension)) {
+                std::cout << usage << std::endl;
+                return 1;
+            }
+        } else if (argument == "--software") {
+            software = true;
+        } else if (argument == "--gpu") {
+            gGPUEvaluate = true;
+        } else if (argument == "--no-cull") {
+            gCullChunks = false;
+        } else if (argument == "--contours" && i + 1 < argc) {
+            if (!SetContourInterval(args[++i])) {
+                return 1;
+            }
+        } else if (argument == "--threads" && i + 1 < argc) {
+            if (!ParseUnsigned(args[++i], "--threads", 0, MAX_THREAD_COUNT, threadCount)) {
+                return 1;
+            }
+        } else if (argument == "--transparency" && i + 1 < argc) {
+            if (!SetTransparencyMode(args[++i])) {
+                return 1;
+            }
+        } else {
+            equations.push_back(argument);
+        }
+    }
+    if (equations.empty()) {
+        std::cout << "INPUT ERROR: Please specify at least one equation to render." << std::endl;
+        return 1;
+    }
+    if (software) {
+        return RenderSoftware(prefix + "%04u" + extension, equations, threadCount);
+    }
+
+    OffscreenContext context;
+    if (!context.Create()) {
+        return 1;
+    }
+    CreateGraphicsPipeline();
+
+    OffscreenTarget target;
+    if (!target.Create(gScreenWidth, gScreenHeight)) {
+        return 1;
+    }
+
+    std::vector<uint8_t> pixels;
+    unsigned int written = 0;
+    bool success = true;
+    // Writes the oldest image still in flight
+    auto writeNext = [&]() {
+        if (!target.FinishReadback(pixels)) {
+            success = false;
+            return;
+        }
+        char index[16];
+        std::snprintf(index, sizeof(index), "%04u", written++);
+        if (!WriteImage(prefix + index + extension, gScreenWidth, gScreenHeight, pixels.data())) {
+            success = false;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < equations.size() && success; i++) {
+        gGraphs = {SceneGraph{equations[i], Graph::paletteColor(1), true, (unsigned int)gRESOLUTION, false,
+                                ImplicitSurface::isImplicit(equations[i]), ParametricSurface::isParametric(equations[i])}};
+        gGraphMeshes.clear();
+        PrepareGPUEvaluation();
+        DeleteGeometry();
+        VertexSpecification();
+
+        target.Bind();
+        PreDraw();
+        Draw();
+
+        if (target.ReadbackQueueFull()) {
+            writeNext();
+        }
+        target.StartReadback();
+    }
+    while (success && target.ReadbackPending()) {
+        writeNext();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Rendered " << written << " images of " << gScreenWidth << "x" << gScreenHeight
+              << " in " << elapsed.count() << " s (" << written/elapsed.count() << " images/s)" << std::endl;
+
+    target.Destroy();
+    DeleteGeometry();
+    DeleteGPUGraphs();
+    glDeleteBuffers(1, &gFrameUniformBuffer);
+    gGraphicsPipeline.Destroy();
+    gAxesGrid.Destroy();
+    gTransparency.Destroy();
+    DeleteContours();
+    context.Destroy();
+    return success ? 0 : 1;
+}
+
+
+// Most samples per side --batch accepts, as many as a --serve request
+const unsigned int MAX_BATCH_RESOLUTION = 4097;
+
+/**
+* Evaluates many equations on a thread pool with the Graph sampling code and prints
+* statistics for each one, in input order, as soon as it and everything before it is done.
+*
+*   ./project --batch <file or -> [--threads n] [--resolution n] [--heightmaps <prefix>]
+*             [--format ppm|png] [--json]
+*
+* Input has one equation per line, or one JSON object per line such as
+*   {"equation": "sin(x)*cos(y)", "id": "wave", "resolution": 201}
+* Blank lines and lines starting with # are skipped. Output is tab separated, or JSON
+* lines when --json is given. Height maps are written as <prefix>00000.ppm, ...
+*
+* @return program status (1 if any equation failed)
+*/
+int RunBatch(int argc, char* args[]){
+    if (argc < 3) {
+        std::cout << "Usage: ./project --batch <file or -> [--threads n] [--resolution n] [--heightmaps <prefix>] [--format ppm|png] [--json]" << std::endl;
+        return 1;
+    }
+
+    std::string inputPath = args[2];
+    unsigned int threadCount = 0;
+    unsigned int resolution = gRESOLUTION;
+    std::string heightMapPrefix = "";
+    std::string extension = ".ppm";
+    bool jsonOutput = false;
+    for (int i = 3; i < argc; i++) {
+        std::string argument = args[i];
+        if (argument == "--threads" && i + 1 < argc) {
+            if (!ParseUnsigned(args[++i], "--threads", 0, MAX_THREAD_COUNT, threadCount)) {
+                return 1;
+            }
+        } else if (argument == "--resolution" && i + 1 < argc) {
+            if (!ParseUnsigned(args[++i], "--resolution", 2, MAX_BATCH_RESOLUTION, resolution)) {
+                return 1;
             }
+        } else if (argument == "--heightmaps" && i + 1 < argc) {
+            heightMapPrefix = args[++i];
+        } else if (argument == "--format" && i + 1 < argc) {
+            if (!ParseImageFormat(args[++i], extension)) {
+                return 1;
+            }
+        } else if (argument == "--json") {
+            jsonOutput = true;
+        } else {
+            std::cout << "Unknown batch option " << argument << std::endl;
+            return 1;
         }
-        
-        
-        //additional global movement
-        const Uint8 *state = SDL_GetKeyboardState(NULL);
-        
-        float SPEED_T = 0.125f;
-        float SPEED_R = 2.5f;
-           
+    }
 
-        //ARROW KEYS - Rotate Theta and Phi
-        if (state[SDL_SCANCODE_LEFT]) {
-            g_RotateTheta = (g_RotateTheta + SPEED_R);
+    // Read every job up front
+    struct BatchJob {
+        std::string equation;
+        std::string id;
+        unsigned int resolution;
+        std::string error; // set if the line could not be parsed
+    };
+    std::vector<BatchJob> jobs;
+    std::ifstream inputFile;
+    if (inputPath != "-") {
+        inputFile.open(inputPath);
+        if (!inputFile.is_open()) {
+            std::cout << "Could not open " << inputPath << std::endl;
+            return 1;
         }
-        if (state[SDL_SCANCODE_RIGHT]) {
-            g_RotateTheta = (g_RotateTheta - SPEED_R);
+    }
+    std::istream& input = inputPath == "-" ? std::cin : inputFile;
+    std::string line;
+    while (std::getline(input, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
         }
-        if (state[SDL_SCANCODE_UP]) {
-            g_RotatePhi = glm::clamp(g_RotatePhi - SPEED_R, 0.0f + SPEED_R, 180.0f - SPEED_R);
+        size_t last = line.find_last_not_of(" \t\r");
+        line = line.substr(first, last - first + 1);
+
+        BatchJob job = {line, "", resolution, ""};
+        if (line[0] == '{') {
+            std::map<std::string, std::string> fields;
+            if (!ParseJSONObject(line, fields, job.error)) {
+                job.equation = "";
+            } else if (fields.count("equation") == 0) {
+                job.equation = "";
+                job.error = "missing \"equation\"";
+            } else {
+                job.equation = fields["equation"];
+                job.id = fields.count("id") ? fields["id"] : "";
+                if (fields.count("resolution") &&
+                    !ReadUnsigned(fields["resolution"], 2, MAX_BATCH_RESOLUTION, job.resolution)) {
+                    job.error = "\"resolution\" must be a whole number from 2 to " + std::to_string(MAX_BATCH_RESOLUTION) +
+                                ", not " + fields["resolution"];
+                }
+            }
         }
-        if (state[SDL_SCANCODE_DOWN]) {
-            g_RotatePhi = glm::clamp(g_RotatePhi + SPEED_R, 0.0f + SPEED_R, 180.0f - SPEED_R);
+        jobs.push_back(job);
+    }
+
+    struct BatchResult {
+        bool done;
+        std::string error;
+        HeightStats stats;
+        double milliseconds;
+    };
+    std::vector<BatchResult> results(jobs.size(), BatchResult{false, "", HeightStats(), 0.0});
+    std::mutex outputMutex;
+    size_t nextOutput = 0;
+    unsigned int failures = 0;
+
+    if (!jsonOutput) {
+        std::cout << "index\tid\tequation\tmin\tmax\tnan_fraction\tout_of_range_fraction\tms\terror" << std::endl;
+    }
+    // Prints one finished result
+    auto printResult = [&](size_t i) {
+        const BatchJob& job = jobs[i];
+        const BatchResult& result = results[i];
+        double samples = result.stats.sampleCount;
+        double nanFraction = samples > 0 ? result.stats.undefinedCount/samples : NAN;
+        double outOfRangeFraction = samples > 0 ? result.stats.outOfBoundsCount/samples : NAN;
+        if (jsonOutput) {
+            std::cout << "{\"index\":" << i << ",\"id\":" << JSONString(job.id)
+                      << ",\"equation\":" << JSONString(job.equation);
+            if (result.error.empty()) {
+                std::cout << ",\"resolution\":" << job.resolution
+                          << ",\"min\":" << JSONNumber(result.stats.min) << ",\"max\":" << JSONNumber(result.stats.max)
+                          << ",\"nan_fraction\":" << JSONNumber(nanFraction)
+                          << ",\"out_of_range_fraction\":" << JSONNumber(outOfRangeFraction);
+            } else {
+                std::cout << ",\"error\":" << JSONString(result.error);
+            }
+            std::cout << ",\"ms\":" << JSONNumber(result.milliseconds) << "}" << std::endl;
+        } else {
+            std::cout << i << "\t" << job.id << "\t" << job.equation << "\t";
+            if (result.error.empty()) {
+                std::cout << result.stats.min << "\t" << result.stats.max << "\t" << nanFraction << "\t" << outOfRangeFraction;
+            } else {
+                std::cout << "\t\t\t";
+            }
+            std::cout << "\t" << result.milliseconds << "\t" << result.error << std::endl;
         }
-	}
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threadCount);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            pool.submit([&, i]() {
+                const BatchJob& job = jobs[i];
+                BatchResult result = {true, job.error, HeightStats(), 0.0};
+                auto jobStart = std::chrono::steady_clock::now();
+
+                // Each task owns its Equation: expression evaluation is not thread safe.
+                // An exception (e.g. running out of memory) fails this job only, as the pool does not catch it.
+                if (result.error.empty()) {
+                    try {
+                        Equation expression(job.equation);
+                        if (!expression.isValid()) {
+                            result.error = expression.getError();
+                        } else {
+                            std::vector<float> heights((size_t)job.resolution*job.resolution);
+                            Graph::sampleHeights(expression, job.resolution, heights.data(), &result.stats);
+
+                            if (!heightMapPrefix.empty()) {
+                                std::vector<uint8_t> pixels(heights.size()*3);
+                                for (size_t p = 0; p < heights.size(); p++) {
+                                    uint8_t gray = (uint8_t)(std::clamp(heights[p], 0.0f, 1.0f)*255.0f + 0.5f);
+                                    pixels[p*3 + 0] = pixels[p*3 + 1] = pixels[p*3 + 2] = gray;
+                                }
+                                char index[16];
+                                std::snprintf(index, sizeof(index), "%05u", (unsigned int)i);
+                                if (!WriteImage(heightMapPrefix + index + extension, job.resolution, job.resolution, pixels.data())) {
+                                    result.error = "could not write the height map";
+                                }
+                            }
+                        }
+                    } catch (const std::exception& exception) {
+                        result.error = std::string("could not evaluate the equation: ") + exception.what();
+                    }
+                }
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - jobStart;
+                result.milliseconds = elapsed.count();
+
+                std::lock_guard<std::mutex> lock(outputMutex);
+                results[i] = result;
+                if (!result.error.empty()) {
+                    failures++;
+                }
+                while (nextOutput < results.size() && results[nextOutput].done) {
+                    printResult(nextOutput++);
+                }
+            });
+        }
+        pool.wait();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cerr << jobs.size() << " equations (" << failures << " failed) in " << elapsed.count() << " s, "
+              << jobs.size()/elapsed.count() << " equations/s" << std::endl;
+    return failures == 0 ? 0 : 1;
 }
 
 
 /**
-* Main Application Loop
-* This is an infinite loop
+* Appends a graph with the next palette color to gGraphs
 *
-* @return void
+* @param equation z = f(x,y)
+* @return the new graph, to change its defaults
 */
-void MainLoop(){
+SceneGraph& AddGraph(const std::string& equation){
+    // An equation that only compiles once t is a variable is animated, one that only
+    // compiles with z is an implicit surface, and three components in u and v are a
+    // parametric surface
+    bool animated = false;
+    bool implicit = false;
+    bool parametric = false;
+    if (!Equation(equation).isValid()) {
+        animated = Equation(equation, {"x", "y", "t"}).isValid();
+        implicit = !animated && Equation(equation, {"x", "y", "z"}).isValid();
+        parametric = !animated && !implicit && ParametricSurface::isParametric(equation);
+    }
+    gGraphs.push_back(SceneGraph{equation, Graph::paletteColor(gGraphs.size() + 1), true, (unsigned int)gRESOLUTION,
+                                 animated, implicit, parametric});
+    return gGraphs.back();
+}
 
-	// While application is running
-	while(!gQuit){
-		// Handle Input
-		Input();
-		// Setup anything (i.e. OpenGL State) that needs to take
-		// place before draw calls
-		PreDraw();
-		// Draw Calls in OpenGL
-		Draw();
-		//Update screen of our specified window
-		SDL_GL_SwapWindow(gGraphicsApplicationWindow);
-	}
+
+// Most samples per side of an implicit surface in a scene file, about 135 million in its cube
+const unsigned int MAX_IMPLICIT_RESOLUTION = 513;
+
+/**
+* Appends the graphs of a scene file to gGraphs. The file has one equation per line,
+* or one JSON object per line such as
+*   {"equation": "sin(x)*cos(y)", "color": "#ff8000", "opacity": 0.5, "visible": false, "resolution": 201}
+* Parametric surfaces also take "umin", "umax", "vmin" and "vmax" (0 to 2 pi by default).
+* "resolution" is at most MAX_BATCH_RESOLUTION, or MAX_IMPLICIT_RESOLUTION for implicit surfaces.
+* Blank lines and lines starting with # are skipped.
+*
+* @param filePath scene file
+* @return false if the file could not be read or a line is malformed
+*/
+bool LoadScene(const std::string& filePath){
+    std::ifstream inputFile(filePath);
+    if (!inputFile.is_open()) {
+        std::cout << "Could not open scene " << filePath << std::endl;
+        return false;
+    }
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(inputFile, line)) {
+        lineNumber++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        size_t last = line.find_last_not_of(" \t\r");
+        line = line.substr(first, last - first + 1);
+        if (line[0] != '{') {
+            AddGraph(line);
+            continue;
+        }
+
+        std::map<std::string, std::string> fields;
+        std::string error;
+        if (!ParseJSONObject(line, fields, error)) {
+            std::cout << filePath << ":" << lineNumber << ": " << error << std::endl;
+            return false;
+        }
+        if (fields.count("equation") == 0) {
+            std::cout << filePath << ":" << lineNumber << ": missing \"equation\"" << std::endl;
+            return false;
+        }
+        SceneGraph& graph = AddGraph(fields["equation"]);
+        if (fields.count("color")) {
+            unsigned int rgb = 0;
+            if (fields["color"].size() != 7 || std::sscanf(fields["color"].c_str(), "#%6x", &rgb) != 1) {
+                std::cout << filePath << ":" << lineNumber << ": \"color\" must look like #rrggbb" << std::endl;
+                return false;
+            }
+            graph.color = glm::vec3((rgb >> 16)/255.0f, ((rgb >> 8) & 0xFF)/255.0f, (rgb & 0xFF)/255.0f);
+        }
+        if (fields.count("opacity")) {
+            if (!ReadFloat(fields["opacity"], graph.opacity) || graph.opacity < 0.0f || graph.opacity > 1.0f) {
+                std::cout << filePath << ":" << lineNumber << ": \"opacity\" must be a number from 0 to 1" << std::endl;
+                return false;
+            }
+        }
+        if (fields.count("visible")) {
+            if (fields["visible"] != "true" && fields["visible"] != "false") {
+                std::cout << filePath << ":" << lineNumber << ": \"visible\" must be true or false" << std::endl;
+                return false;
+            }
+            graph.visible = fields["visible"] == "true";
+        }
+        const char* parameterBounds[4] = {"umin", "umax", "vmin", "vmax"};
+        for (unsigned int bound = 0; bound < 4; bound++) {
+            if (fields.count(parameterBounds[bound]) &&
+                !ReadFloat(fields[parameterBounds[bound]], graph.parameterRange[bound])) {
+                std::cout << filePath << ":" << lineNumber << ": \"" << parameterBounds[bound] << "\" must be a number" << std::endl;
+                return false;
+            }
+        }
+        if (!(graph.parameterRange[0] < graph.parameterRange[1]) || !(graph.parameterRange[2] < graph.parameterRange[3])) {
+            std::cout << filePath << ":" << lineNumber << ": \"umin\" and \"vmin\" must be less than \"umax\" and \"vmax\"" << std::endl;
+            return false;
+        }
+        if (fields.count("resolution")) {
+            // Implicit surfaces sample a cube, so they are bounded much lower
+            unsigned int maxResolution = graph.implicit ? MAX_IMPLICIT_RESOLUTION : MAX_BATCH_RESOLUTION;
+            if (!ReadUnsigned(fields["resolution"], 2, maxResolution, graph.resolution)) {
+                std::cout << filePath << ":" << lineNumber << ": \"resolution\" must be a whole number from 2 to "
+                          << maxResolution << (graph.implicit ? " for an implicit surface" : "") << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
+// Largest --cache-mb, 1 TB (0 keeps no responses)
+const unsigned int MAX_CACHE_MEGABYTES = 1u << 20;
+
+/**
+* Runs the graph service until SIGINT or SIGTERM (see GraphServer.hpp for the protocol).
+* Equations are evaluated, meshed and drawn once and then answered from memory.
+*
+*   ./project --serve <socket path> [--threads n] [--cache-mb n]
+*
+* @return program status
+*/
+int RunServer(int argc, char* args[]){
+    if (argc < 3) {
+        std::cout << "Usage: ./project --serve <socket path> [--threads n] [--cache-mb n]" << std::endl;
+        return 1;
+    }
+
+    unsigned int threadCount = 0;
+    unsigned int cacheMegabytes = 256;
+    // So the cache size in bytes still fits in size_t
+    unsigned int maxCacheMegabytes = (unsigned int)std::min<size_t>(SIZE_MAX >> 20, MAX_CACHE_MEGABYTES);
+    for (int i = 3; i < argc; i++) {
+        std::string argument = args[i];
+        if (argument == "--threads" && i + 1 < argc) {
+            if (!ParseUnsigned(args[++i], "--threads", 0, MAX_THREAD_COUNT, threadCount)) {
+                return 1;
+            }
+        } else if (argument == "--cache-mb" && i + 1 < argc) {
+            if (!ParseUnsigned(args[++i], "--cache-mb", 0, maxCacheMegabytes, cacheMegabytes)) {
+                return 1;
+            }
+        } else {
+            std::cout << "Unknown server option " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    GraphServer server(args[2], threadCount, (size_t)cacheMegabytes << 20);
+    return server.run() ? 0 : 1;
+}
 
+// Bounds of --pyramid: samples per side, and tile sides (rounded up to a power of two by HeightPyramidWriter)
+const unsigned int MAX_PYRAMID_DIMENSION = 1u << 20;
+const unsigned int MIN_PYRAMID_TILE = 2;
+const unsigned int MAX_PYRAMID_TILE = 4096;
 
 /**
-* The last function called in the program
-* This functions responsibility is to destroy any global
-* objects in which we have create dmemory.
+* Writes a tiled height pyramid of one equation to disk without opening a window.
+* Used for resolutions that do not fit in memory (print exports, deep zoom).
 *
-* @return void
+*   ./project --pyramid <file> <dimension> "<equation>" [tile size]
+*
+* The tile size is rounded up to a power of two between MIN_PYRAMID_TILE and MAX_PYRAMID_TILE.
+*
+* @return program status
 */
-void CleanUp(){
-	//Destroy our SDL2 Window
-	SDL_DestroyWindow(gGraphicsApplicationWindow );
-	gGraphicsApplicationWindow = nullptr;
+int ExportPyramid(int argc, char* args[]){
+    if (argc < 5) {
+        std::cout << "Usage: ./project --pyramid <file> <dimension> \"<equation>\" [tile size]" << std::endl;
+        return 1;
+    }
 
-    // Delete our OpenGL Objects
-    glDeleteBuffers(1, &gVertexBufferObject);
-    glDeleteVertexArrays(1, &gVertexArrayObject);
+    std::string filePath = args[2];
+    unsigned int dimension = 0;
+    unsigned int tileSize = 256;
+    if (!ParseUnsigned(args[3], "--pyramid <dimension>", 2, MAX_PYRAMID_DIMENSION, dimension) ||
+        (argc >= 6 && !ParseUnsigned(args[5], "--pyramid [tile size]", MIN_PYRAMID_TILE, MAX_PYRAMID_TILE, tileSize))) {
+        return 1;
+    }
 
-	// Delete our Graphics pipeline
-    glDeleteProgram(gGraphicsPipelineShaderProgram);
+    HeightPyramidWriter writer(filePath, dimension, tileSize);
+    if (!writer.write(args[4])) {
+        return 1;
+    }
 
-	//Quit SDL subsystems
-	SDL_Quit();
+    HeightPyramidReader reader(filePath);
+    if (!reader.isOpen()) {
+        return 1;
+    }
+    if (reader.getTileSize() != tileSize) {
+        std::cout << "Tile size " << tileSize << " rounded up to the power of two " << reader.getTileSize() << std::endl;
+    }
+    std::cout << "Wrote " << filePath << ": " << reader.getLevelCount() << " levels of "
+              << reader.getTileSize() << "x" << reader.getTileSize() << " tiles" << std::endl;
+    for (unsigned int level = 0; level < reader.getLevelCount(); level++) {
+        std::cout << "  level " << level << ": " << reader.getDimension(level) << "x" << reader.getDimension(level) << std::endl;
+    }
+    return 0;
+}
+
+
+/**
+* Writes the part of a height pyramid a view of [minX, maxX] x [minY, maxY] shows as a grayscale
+* image, read from the coarsest level that still has the requested samples across the view.
+* Only the tiles of that level that overlap the view are read, so deep zooms into pyramids
+* much larger than memory stay fast.
+*
+*   ./project --pyramid-view <file> <output image> <minX> <maxX> <minY> <maxY> [samples across]
+*
+* @return program status
+*/
+int ViewPyramid(int argc, char* args[]){
+    if (argc < 8) {
+        std::cout << "Usage: ./project --pyramid-view <file> <output image> <minX> <maxX> <minY> <maxY> [samples across]" << std::endl;
+        return 1;
+    }
+
+    float bounds[4];
+    const char* names[4] = {"<minX>", "<maxX>", "<minY>", "<maxY>"};
+    for (unsigned int i = 0; i < 4; i++) {
+        if (!ParseFloat(args[4 + i], std::string("--pyramid-view ") + names[i], bounds[i])) {
+            return 1;
+        }
+    }
+    if (!(bounds[0] < bounds[1]) || !(bounds[2] < bounds[3])) {
+        std::cout << "INPUT ERROR: --pyramid-view needs minX < maxX and minY < maxY" << std::endl;
+        return 1;
+    }
+    unsigned int samplesAcross = 1024;
+    if (argc >= 9 && !ParseUnsigned(args[8], "--pyramid-view [samples across]", 2, MAX_HEADLESS_SIZE, samplesAcross)) {
+        return 1;
+    }
+
+    HeightPyramidReader reader(args[2]);
+    if (!reader.isOpen()) {
+        return 1;
+    }
+    float domainMin = reader.sampleCoordinate(0, 0);
+    float domainMax = reader.sampleCoordinate(0, reader.getDimension(0) - 1);
+    if (bounds[1] < domainMin || bounds[0] > domainMax || bounds[3] < domainMin || bounds[2] > domainMax) {
+        std::cout << "INPUT ERROR: the view is outside the pyramid's domain [" << domainMin << ", " << domainMax << "]" << std::endl;
+        return 1;
+    }
+    unsigned int level = reader.chooseLevel(bounds[0], bounds[1], samplesAcross);
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned int firstColumn = 0;
+    unsigned int firstRow = 0;
+    std::vector<float> region = reader.readRegion(level, bounds[0], bounds[1], bounds[2], bounds[3], width, height,
+                                                  firstColumn, firstRow);
+    if (region.empty()) {
+        std::cout << "Could not read the view from " << args[2] << std::endl;
+        return 1;
+    }
+
+    // Undefined samples (-1) are black, like the height maps of --batch
+    std::vector<uint8_t> pixels(region.size()*3);
+    for (size_t p = 0; p < region.size(); p++) {
+        uint8_t gray = (uint8_t)(std::clamp(region[p], 0.0f, 1.0f)*255.0f + 0.5f);
+        pixels[p*3 + 0] = pixels[p*3 + 1] = pixels[p*3 + 2] = gray;
+    }
+    if (!WriteImage(args[3], width, height, pixels.data())) {
+        return 1;
+    }
+    std::cout << "Wrote " << args[3] << ": " << width << "x" << height << " samples from level " << level << " ("
+              << reader.getDimension(level) << "x" << reader.getDimension(level) << "), starting at column "
+              << firstColumn << " and row " << firstRow << std::endl;
+    return 0;
+}
+
+
+/**
+* Writes a synthetic grid mesh with roughly the given number of triangles, using v/vt/vn faces
+*
+* @return path of the written .obj
+*/
+std::string WriteBenchmarkOBJ(unsigned int faceCount){
+    unsigned int quads = (unsigned int)std::ceil(std::sqrt(faceCount/2.0));
+    std::string filePath = "./generated/bench_" + std::to_string(faceCount) + ".obj";
+
+    std::ofstream outFile(filePath);
+    outFile << "# Generated benchmark grid with " << 2*quads*quads << " faces" << std::endl;
+
+    for (unsigned int y = 0; y <= quads; y++) {
+        for (unsigned int x = 0; x <= quads; x++) {
+            float s = (float)x/quads;
+            float t = (float)y/quads;
+            outFile << "v " << s*10.0f - 5.0f << " " << std::sin(s*20.0f)*std::cos(t*20.0f) << " " << t*10.0f - 5.0f << "\n";
+            outFile << "vt " << s << " " << t << "\n";
+            outFile << "vn 0 1 0\n";
+        }
+    }
+
+    for (unsigned int y = 0; y < quads; y++) {
+        for (unsigned int x = 0; x < quads; x++) {
+            unsigned int a = x + y*(quads + 1) + 1;
+            unsigned int b = a + 1;
+            unsigned int c = a + quads + 1;
+            unsigned int d = c + 1;
+            outFile << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << "\n";
+            outFile << "f " << b << "/" << b << "/" << b << " " << d << "/" << d << "/" << d << " " << c << "/" << c << "/" << c << "\n";
+        }
+    }
+
+    outFile.close();
+    return filePath;
+}
+
+
+// Most faces --bench-obj writes, about 15 GB of OBJ
+const unsigned int MAX_BENCHMARK_FACES = 1u << 28;
+
+/**
+* Times OBJModel loading on synthetic meshes of 1/8, 1/4, 1/2 and all of the requested
+* face count. Linear scaling shows up as a constant faces per second column.
+*
+*   ./project --bench-obj [faces]
+*
+* At least 8 faces, so the smallest mesh is not empty.
+*
+* @return program status
+*/
+int BenchmarkOBJ(int argc, char* args[]){
+    unsigned int faceCount = 1000000;
+    if (argc >= 3 && !ParseUnsigned(args[2], "--bench-obj [faces]", 8, MAX_BENCHMARK_FACES, faceCount)) {
+        return 1;
+    }
+
+    std::cout << "faces\tvertices\tseconds\tfaces/s\tMB/s" << std::endl;
+    for (unsigned int divisor = 8; divisor >= 1; divisor /= 2) {
+        std::string filePath = WriteBenchmarkOBJ(faceCount/divisor);
+        std::string cacheFile = filePath + ".meshcache";
+        std::remove(cacheFile.c_str());
+        std::ifstream sizeFile(filePath, std::ios::binary | std::ios::ate);
+        double megabytes = sizeFile.tellg()/1e6;
+        sizeFile.close();
+
+        auto start = std::chrono::steady_clock::now();
+        OBJModel model(filePath);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        size_t faces = model.getIBO().size()/3;
+        std::cout << faces << "\t" << model.getVBO().size()/12 << "\t" << elapsed.count()
+                  << "\t" << faces/elapsed.count() << "\t" << megabytes/elapsed.count() << std::endl;
+
+        std::remove(filePath.c_str());
+        std::remove(cacheFile.c_str());
+    }
+    return 0;
+}
+
+
+/**
+* Writes a synthetic grid mesh in memory with what ParseOBJParallel has to carry across chunk
+* boundaries: vertices and faces interleaved row by row, so every chunk starts with elements
+* before it, every face form (v, v/t, v//n, v/t/n), negative (relative) indices, quads to fan
+* triangulate, comments and an mtllib line at the end
+*
+* @param faceCount about how many triangles to write
+* @return the .obj text
+*/
+std::string WriteCheckOBJ(unsigned int faceCount){
+    unsigned int quads = (unsigned int)std::ceil(std::sqrt(faceCount/2.0));
+    std::ostringstream text;
+    text << "# Generated parser check grid with " << 2*quads*quads << " faces\n";
+
+    for (unsigned int y = 0; y <= quads; y++) {
+        for (unsigned int x = 0; x <= quads; x++) {
+            float s = (float)x/quads;
+            float t = (float)y/quads;
+            text << "v " << s*10.0f - 5.0f << " " << std::sin(s*20.0f)*std::cos(t*20.0f) << " " << t*10.0f - 5.0f << "\n";
+            text << "vt " << s << " " << t << "\n";
+            text << "vn 0 1 0\n";
+        }
+        if (y == 0) {
+            continue;
+        }
+
+        // The quads between this row and the last, right after the vertices they use
+        long count = (long)(y + 1)*(quads + 1);
+        for (unsigned int x = 0; x < quads; x++) {
+            long a = x + (y - 1)*(quads + 1) + 1;
+            long b = a + 1;
+            long c = a + quads + 1;
+            long d = c + 1;
+            // Every other row counts back from the last vertex instead
+            if (y % 2 == 0) {
+                a -= count + 1;
+                b -= count + 1;
+                c -= count + 1;
+                d -= count + 1;
+            }
+            switch (x % 4) {
+            case 0:
+                text << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " "
+                     << d << "/" << d << "/" << d << " " << c << "/" << c << "/" << c << "\n";
+                break;
+            case 1:
+                text << "f " << a << "/" << a << " " << b << "/" << b << " " << d << "/" << d << " " << c << "/" << c << "\n";
+                break;
+            case 2:
+                text << "f " << a << "//" << a << " " << b << "//" << b << " " << c << "//" << c << " # lower\n";
+                text << "f " << b << "//" << b << " " << d << "//" << d << " " << c << "//" << c << "\n";
+                break;
+            default:
+                text << "f " << a << " " << b << " " << c << "\n";
+                text << "  f\t" << b << " " << d << " " << c << "\n";
+            }
+        }
+    }
+
+    text << "mtllib check grid.mtl\n";
+    return text.str();
+}
+
+
+/**
+* Tests if two parses of an .obj produced the same data
+*
+* @return true if every array and the material file match
+*/
+bool SameOBJData(const OBJData& a, const OBJData& b){
+    return a.verts == b.verts && a.texts == b.texts && a.norms == b.norms && a.faces == b.faces &&
+           a.materialFile == b.materialFile;
+}
+
+
+/**
+* Checks that ParseOBJParallel gives exactly what a serial ParseOBJ does on a synthetic mesh
+* (see WriteCheckOBJ) for several thread counts, so chunks split at different lines, and that
+* both report the same error for a bad index in a late chunk.
+*
+*   ./project --check-obj [faces]
+*
+* At least 8 faces, like --bench-obj. Chunks are at least 1 MB, so the default mesh is large
+* enough to be split for every thread count tried.
+*
+* @return program status, 1 if any parse differs
+*/
+int CheckOBJ(int argc, char* args[]){
+    unsigned int faceCount = 1000000;
+    if (argc >= 3 && !ParseUnsigned(args[2], "--check-obj [faces]", 8, MAX_BENCHMARK_FACES, faceCount)) {
+        return 1;
+    }
+
+    std::string text = WriteCheckOBJ(faceCount);
+    // A face after three quarters of the file pointing past the last vertex
+    std::string broken = text;
+    size_t line = broken.find('\n', broken.size()*3/4) + 1;
+    broken.insert(line, "f 1 2 " + std::to_string(broken.size()) + "\n");
+
+    OBJData serial;
+    std::string serialError;
+    if (!ParseOBJ(text.data(), text.data() + text.size(), serial, serialError)) {
+        std::cout << "Serial parse failed: " << serialError << std::endl;
+        return 1;
+    }
+    OBJData brokenSerial;
+    std::string brokenSerialError;
+    if (ParseOBJ(broken.data(), broken.data() + broken.size(), brokenSerial, brokenSerialError)) {
+        std::cout << "Serial parse accepted a face past the last vertex" << std::endl;
+        return 1;
+    }
+
+    std::cout << text.size()/1e6 << " MB, " << serial.faces.size()/9 << " triangles" << std::endl;
+    std::cout << "threads\tdata\terror" << std::endl;
+    bool same = true;
+    for (unsigned int threadCount : {2u, 3u, 4u, 5u, 7u, 8u, 16u}) {
+        OBJData parallel;
+        std::string error;
+        bool parsed = ParseOBJParallel(text.data(), text.data() + text.size(), parallel, error, threadCount);
+        bool sameData = parsed && SameOBJData(serial, parallel);
+
+        OBJData brokenParallel;
+        std::string brokenError;
+        bool brokenParsed = ParseOBJParallel(broken.data(), broken.data() + broken.size(), brokenParallel,
+                                             brokenError, threadCount);
+        bool sameError = !brokenParsed && brokenError == brokenSerialError;
+
+        std::cout << threadCount << "\t" << (sameData ? "same" : "DIFFERENT") << "\t"
+                  << (sameError ? "same" : "DIFFERENT: " + brokenError) << std::endl;
+        same = same && sameData && sameError;
+    }
+    std::cout << (same ? "Parallel parses match the serial one" : "Parallel parses differ from the serial one") << std::endl;
+    return same ? 0 : 1;
+}
+
+
+/**
+* Checks that a triangle mesh is closed and consistently wound: no triangle repeats a vertex,
+* and every directed edge is used by exactly one triangle and its reverse by another one
+*
+* @param indices the triangles
+* @param eulerCharacteristic receives vertices - edges + faces, counting used vertices only
+* @return true if the mesh is closed and consistently wound
+*/
+bool CheckClosedMesh(const std::vector<unsigned int>& indices, long& eulerCharacteristic){
+    std::vector<unsigned long long> edges;
+    edges.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (int corner = 0; corner < 3; corner++) {
+            unsigned long long from = indices[i + corner];
+            unsigned long long to = indices[i + (corner + 1) % 3];
+            if (from == to) {
+                return false;
+            }
+            edges.push_back(from << 32 | to);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    if (std::adjacent_find(edges.begin(), edges.end()) != edges.end()) {
+        return false;
+    }
+    for (unsigned long long edge : edges) {
+        if (!std::binary_search(edges.begin(), edges.end(), (edge & 0xffffffffull) << 32 | edge >> 32)) {
+            return false;
+        }
+    }
+
+    std::vector<unsigned int> vertices(indices);
+    std::sort(vertices.begin(), vertices.end());
+    size_t vertexCount = std::unique(vertices.begin(), vertices.end()) - vertices.begin();
+    eulerCharacteristic = (long)vertexCount - (long)(edges.size()/2) + (long)(indices.size()/3);
+    return true;
+}
+
+
+/**
+* Checks ImplicitSurface on surfaces of known topology: a sphere (genus 0), a torus (genus 1)
+* and a plate with five holes (genus 5). Each must come out as a closed, consistently wound
+* mesh whose Euler characteristic is 2 - 2*genus.
+*
+*   ./project --check-implicit [resolution]
+*
+* @return program status, 1 if any surface fails
+*/
+int CheckImplicit(int argc, char* args[]){
+    unsigned int resolution = 129;
+    if (argc >= 3 && !ParseUnsigned(args[2], "--check-implicit [resolution]", 2, MAX_IMPLICIT_RESOLUTION, resolution)) {
+        return 1;
+    }
+
+    struct KnownSurface {
+        const char* name;
+        const char* equation;
+        long genus;
+    };
+    const KnownSurface surfaces[] = {
+        {"sphere", "x^2 + y^2 + z^2 - 16", 0},
+        {"torus", "(sqrt(x^2 + y^2) - 3)^2 + z^2 - 1", 1},
+        // A 9x3x1 box with 5 round holes through it, 1.2 wide and 0.6 apart
+        {"genus 5 plate", "max(abs(x) - 4.5, abs(y) - 1.5, abs(z) - 0.5, "
+                          "0.36 - y^2 - min((x + 3.6)^2, (x + 1.8)^2, x^2, (x - 1.8)^2, (x - 3.6)^2))", 5},
+    };
+
+    std::cout << "surface\tvertices\ttriangles\tclosed\tEuler characteristic (expected)" << std::endl;
+    bool passed = true;
+    for (const KnownSurface& known : surfaces) {
+        ImplicitSurface surface(known.equation, resolution);
+        long eulerCharacteristic = 0;
+        bool closed = !surface.getIBO().empty() && CheckClosedMesh(surface.getIBO(), eulerCharacteristic);
+        long expected = 2 - 2*known.genus;
+
+        std::cout << known.name << "\t" << surface.getVBO().size()/12 << "\t" << surface.getIBO().size()/3 << "\t"
+                  << (closed ? "yes" : "NO") << "\t";
+        if (closed) {
+            std::cout << eulerCharacteristic << " (" << expected << ")";
+        }
+        std::cout << std::endl;
+        passed = passed && closed && eulerCharacteristic == expected;
+    }
+    std::cout << (passed ? "Every surface has the expected topology" : "Some surfaces do not have the expected topology") << std::endl;
+    return passed ? 0 : 1;
 }
 
 
@@ -654,35 +3088,124 @@ void CleanUp(){
 */
 int main( int argc, char* args[] ){
 
-    std::cout << std::endl << "Enter up to 3 equations in terms of variables x and y. (note: z axis is UP) " << std::endl;
+    // Linked shader programs are reused across runs until the shaders or the driver change
+    ShaderProgram::SetBinaryCacheDirectory("./generated/");
+
+    if (argc >= 2 && std::string(args[1]) == "--pyramid") {
+        return ExportPyramid(argc, args);
+    }
+    if (argc >= 2 && std::string(args[1]) == "--pyramid-view") {
+        return ViewPyramid(argc, args);
+    }
+    if (argc >= 2 && std::string(args[1]) == "--bench-obj") {
+        return BenchmarkOBJ(argc, args);
+    }
+    if (argc >= 2 && std::string(args[1]) == "--check-obj") {
+        return CheckOBJ(argc, args);
+    }
+    if (argc >= 2 && std::string(args[1]) == "--check-implicit") {
+        return CheckImplicit(argc, args);
+    }
+    if (argc >= 2 && std::string(args[1]) == "--batch") {
+        return RunBatch(argc, args);
+    }
+    if (argc >= 2 && std::string(args[1]) == "--serve") {
+        return RunServer(argc, args);
+    }
+    if (argc >= 2 && std::string(args[1]) == "--headless") {
+        return RenderHeadless(argc, args);
+    }
+
+    std::cout << std::endl << "Enter equations in terms of variables x and y, or --scene <file> with one per line. (note: z axis is UP) " << std::endl;
     std::cout << "Example: ./project \"x^2 + y^2\" \"1/(x*y)\" ..." << std::endl;
     std::cout << "will graph equations:" << std::endl;
     std::cout << "z = x^2 + y^2" << std::endl;
-    std::cout << "z = 1/x*y" << std::endl << std::endl;
-
-    std::cout << "Press N to toggle the normals, H to toggle x-y grid highlights, and use the arrow keys to turn the camera" << std::endl;
+    std::cout << "z = 1/x*y" << std::endl;
+    std::cout << "Equations that also use t, such as \"sin(x + t)*cos(y)\", are animated with t in seconds." << std::endl;
+    std::cout << "Equations that use z instead, such as \"x^2 + y^2 + z^2 - 16\", are drawn as the surface where they are 0." << std::endl;
+    std::cout << "Three components in u and v, such as \"4*cos(u)*sin(v/2), 4*sin(u)*sin(v/2), 4*cos(v/2)\", are a parametric surface." << std::endl << std::endl;
+
+    std::cout << "Press N to toggle the normals, H to toggle x-y grid highlights, 1-9 to show or hide a graph, and use the arrow keys to turn the camera" << std::endl;
+    std::cout << "Press C to show contour lines, [ and ] to halve and double the z interval between them" << std::endl;
+    std::cout << "Press I to highlight where the graphs meet" << std::endl;
+    std::cout << "Hover over a graph to see x, y and f(x,y) under the mouse in the title" << std::endl;
+    std::cout << "Options: --max-fps <n> caps the frame rate, --vsync off|on|adaptive (default adaptive)" << std::endl;
+    std::cout << "         --profile shows frame time percentiles in the title, --profile-csv <file> also logs every frame" << std::endl;
+    std::cout << "         --no-progressive builds graphs at full resolution before the first frame instead of refining them while shown" << std::endl;
+    std::cout << "         --gpu evaluates the equations in a generated shader instead of on the CPU" << std::endl;
+    std::cout << "         --no-cull draws every part of the graphs instead of only those in view" << std::endl;
+    std::cout << "         --transparency blended|peel|off draws overlapping graphs with weighted blending (default), exact depth peeling or in draw order" << std::endl;
+    std::cout << "         --contours <interval> shows contour lines every interval in z from the start (1 with C)" << std::endl;
+    std::cout << "         --intersections highlights where the graphs meet from the start" << std::endl;
     std::cout << std::endl;
 
-    if (argc < 2) {
+    // Rendering options may come before or after the equations
+    gProgressive = true;
+    gPicking = true;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = args[i];
+        if (argument == "--max-fps" && i + 1 < argc) {
+            if (!ParseUnsigned(args[++i], "--max-fps", 0, MAX_FRAME_CAP, gFrameCap)) {
+                return 1;
+            }
+        } else if (argument == "--vsync" && i + 1 < argc) {
+            std::string mode = args[++i];
+            if (mode == "off") {
+                gVSync = VSYNC_OFF;
+            } else if (mode == "on") {
+                gVSync = VSYNC_ON;
+            } else if (mode == "adaptive") {
+                gVSync = VSYNC_ADAPTIVE;
+            } else {
+                std::cout << "INPUT ERROR: --vsync must be off, on or adaptive, not " << mode << std::endl;
+                return 1;
+            }
+        } else if (argument == "--profile") {
+            gProfile = true;
+        } else if (argument == "--no-progressive") {
+            gProgressive = false;
+        } else if (argument == "--gpu") {
+            gGPUEvaluate = true;
+        } else if (argument == "--no-cull") {
+            gCullChunks = false;
+        } else if (argument == "--contours" && i + 1 < argc) {
+            if (!SetContourInterval(args[++i])) {
+                return 1;
+            }
+        } else if (argument == "--intersections") {
+            gIntersections = true;
+        } else if (argument == "--transparency" && i + 1 < argc) {
+            if (!SetTransparencyMode(args[++i])) {
+                return 1;
+            }
+        } else if (argument == "--profile-csv" && i + 1 < argc) {
+            gProfile = true;
+            gProfileCSV = args[++i];
+        } else if (argument == "--scene" && i + 1 < argc) {
+            if (!LoadScene(args[++i])) {
+                return 1;
+            }
+        } else {
+            AddGraph(argument);
+        }
+    }
+
+    if (gGraphs.empty()) {
         std::cout << std::endl << "INPUT ERROR: Please specify an expression to load in terms of variables x and y." << std::endl;
         return 0;
     }
-    
-    if (argc >= 2) {
-        gEquations.push_back(args[1]);
-    }
-    if (argc >= 3) {
-        gEquations.push_back(args[2]);
-    }
-    if (argc >= 4) {
-        gEquations.push_back(args[3]);
+    PrepareGPUEvaluation();
+    if (gGraphs.size() >= MAX_GRAPH_COLORS) {
+        std::cout << "INPUT ERROR: At most " << MAX_GRAPH_COLORS - 1 << " graphs can be shown at once." << std::endl;
+        return 1;
     }
     
 	// 1. Setup the graphics program
 	InitializeProgram();
 	
-	// 2. Setup our geometry
+	// 2. Setup our geometry, coarse at first unless --no-progressive
 	VertexSpecification();
+	StartRefinement();
 	
 	// 3. Create our graphics pipeline
 	// 	- At a minimum, this means the vertex and fragment shader